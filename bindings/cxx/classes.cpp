@@ -1207,6 +1207,23 @@ void *Logic::data_pointer()
 	return _structure->data;
 }
 
+/* Have the shared pointer hold a reference to the packet's buffer. */
+static shared_ptr<void> share_packet_data(
+	const struct sr_datafeed_packet *packet, void *data)
+{
+	struct sr_buffer *const buf = sr_packet_buffer_ref(packet);
+
+	if (!buf)
+		return nullptr;
+	return shared_ptr<void>{data,
+		[buf](void *) { sr_buffer_unref(buf); }};
+}
+
+shared_ptr<void> Logic::shared_data()
+{
+	return share_packet_data(_parent->_structure, _structure->data);
+}
+
 size_t Logic::data_length() const
 {
 	return _structure->length;
@@ -1238,6 +1255,11 @@ void *Analog::data_pointer()
 	return _structure->data;
 }
 
+shared_ptr<void> Analog::shared_data()
+{
+	return share_packet_data(_parent->_structure, _structure->data);
+}
+
 void Analog::get_data_as_float(float *dest)
 {
 	check(sr_analog_to_float(_structure, dest));
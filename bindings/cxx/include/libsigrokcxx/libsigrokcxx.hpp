@@ -749,6 +749,14 @@ class SR_API Logic :
 public:
 	/* Pointer to data. */
 	void *data_pointer();
+	/**
+	 * Data which stays valid after the datafeed callback returned.
+	 * Points to the same memory as data_pointer(), without copying.
+	 * Only valid from within the datafeed callback. Returns an empty
+	 * pointer when the data is not held in a shared buffer, the data
+	 * must then be copied to keep it.
+	 */
+	std::shared_ptr<void> shared_data();
 	/* Data length in bytes. */
 	size_t data_length() const;
 	/* Size of each sample in bytes. */
@@ -773,6 +781,11 @@ class SR_API Analog :
 public:
 	/** Pointer to data. */
 	void *data_pointer();
+	/**
+	 * Data which stays valid after the datafeed callback returned.
+	 * See Logic::shared_data().
+	 */
+	std::shared_ptr<void> shared_data();
 	/**
 	 * Fills dest pointer with the analog data converted to float.
 	 * The pointer must have space for num_samples() floats.
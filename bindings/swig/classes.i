@@ -80,6 +80,8 @@ template< class T > class enable_shared_from_this;
 #define SR_PRIV
 
 %ignore sigrok::DatafeedCallbackData;
+%ignore sigrok::Logic::shared_data;
+%ignore sigrok::Analog::shared_data;
 
 #ifndef SWIGJAVA
 
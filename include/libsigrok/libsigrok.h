@@ -176,6 +176,10 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_logic_rle. */
+	SR_DF_LOGIC_RLE,
+	/** Payload is struct sr_datafeed_analog_timed. */
+	SR_DF_ANALOG_TIMED,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -483,6 +487,26 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_buffer
+ * Opaque structure representing a reference counted sample buffer.
+ *
+ * None of the fields of this structure are meant to be accessed directly.
+ *
+ * @see sr_packet_buffer_ref(), sr_buffer_unref().
+ */
+struct sr_buffer;
+
+/**
+ * @struct sr_sessionfile_reader
+ * Opaque structure providing random access to a session file's samples.
+ *
+ * None of the fields of this structure are meant to be accessed directly.
+ *
+ * @see sr_sessionfile_reader_open(), sr_sessionfile_reader_close().
+ */
+struct sr_sessionfile_reader;
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -514,6 +538,29 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Run-length encoded logic datafeed payload for type SR_DF_LOGIC_RLE.
+ *
+ * Carries a sequence of (value, repetition count) pairs. Each value
+ * has the same memory layout as one sample of an SR_DF_LOGIC packet
+ * of the same unitsize. Expanding all runs in order yields the very
+ * sample data which an SR_DF_LOGIC packet would have carried.
+ *
+ * @see sr_logic_rle_expand()
+ */
+struct sr_datafeed_logic_rle {
+	/** Number of runs, i.e. items in values and lengths. */
+	uint64_t num_runs;
+	/** Number of samples, i.e. the sum of all run lengths. */
+	uint64_t num_samples;
+	/** Size of an individual sample value in bytes. */
+	uint16_t unitsize;
+	/** Sample values, num_runs * unitsize bytes. */
+	void *values;
+	/** Repetition count for each of the values, never zero. */
+	uint64_t *lengths;
+};
+
 /** Analog datafeed payload for type SR_DF_ANALOG. */
 struct sr_datafeed_analog {
 	void *data;
@@ -523,6 +570,23 @@ struct sr_datafeed_analog {
 	struct sr_analog_spec *spec;
 };
 
+/**
+ * Analog datafeed payload with host timestamps, for type
+ * SR_DF_ANALOG_TIMED.
+ *
+ * Low rate devices like multimeters may send several readings in one
+ * packet. The timestamps tell when each of the readings was taken.
+ */
+struct sr_datafeed_analog_timed {
+	/** The samples, like the payload of an SR_DF_ANALOG packet. */
+	struct sr_datafeed_analog analog;
+	/**
+	 * Time of each sample, in microseconds since the Unix epoch as
+	 * returned by g_get_real_time(). Has analog.num_samples items.
+	 */
+	int64_t *timestamps;
+};
+
 struct sr_analog_encoding {
 	uint8_t unitsize;
 	gboolean is_signed;
@@ -581,6 +645,26 @@ struct sr_analog_spec {
 	int8_t spec_digits;
 };
 
+/** How datafeed dispatch on a separate thread handles a full queue. */
+enum sr_dispatch_overflow {
+	/** Block the sender until the consumer thread caught up. */
+	SR_DISPATCH_OVERFLOW_BLOCK = 10000,
+	/** Drop logic and analog data, keep all other packets. */
+	SR_DISPATCH_OVERFLOW_DROP,
+};
+
+/** Statistics of datafeed dispatch on a separate thread. */
+struct sr_session_dispatch_stats {
+	/** Number of packets queued for dispatch. */
+	uint64_t packets;
+	/** Number of data packets dropped because the queue was full. */
+	uint64_t dropped;
+	/** Number of times a sender blocked because the queue was full. */
+	uint64_t stalls;
+	/** Highest number of packets which were queued at the same time. */
+	uint64_t max_fill;
+};
+
 /** Generic option struct used by various subsystems. */
 struct sr_option {
 	/* Short name suitable for commandline usage, [a-z0-9-]. */
@@ -618,12 +702,16 @@ struct sr_resource {
 enum sr_output_flag {
 	/** If set, this output module writes the output itself. */
 	SR_OUTPUT_INTERNAL_IO_HANDLING = 0x01,
+	/** If set, this output module accepts SR_DF_LOGIC_RLE packets. */
+	SR_OUTPUT_LOGIC_RLE = 0x02,
 };
 
 struct sr_input;
 struct sr_input_module;
 struct sr_output;
 struct sr_output_module;
+/** Opaque destination of output module text, see sr_output_send_sink(). */
+struct sr_output_sink;
 struct sr_transform;
 struct sr_transform_module;
 
@@ -1267,6 +1355,23 @@ enum sr_configkey {
 	 */
 	SR_CONF_GATE_TIME,
 
+	/**
+	 * Number of samples which the device could not take in time.
+	 * Counts since the most recent start of an acquisition.
+	 * @arg type: uint64
+	 * @arg get: get the number of missed samples
+	 */
+	SR_CONF_SAMPLES_MISSED,
+
+	/**
+	 * Samples per second which the most recent acquisition achieved.
+	 * Devices which measure it also send it in a SR_DF_META packet
+	 * when the acquisition ends.
+	 * @arg type: uint64
+	 * @arg get: get the achieved samples per second
+	 */
+	SR_CONF_THROUGHPUT,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 };
 
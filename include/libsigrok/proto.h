@@ -30,6 +30,8 @@
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *buf);
+SR_API int sr_analog_to_double(const struct sr_datafeed_analog *analog,
+		double *buf);
 SR_API const char *sr_analog_si_prefix(float *value, int *digits);
 SR_API gboolean sr_analog_si_prefix_friendly(enum sr_unit unit);
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
@@ -57,6 +59,9 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count);
+SR_API uint64_t sr_logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t *run_idx, uint64_t *run_pos, uint8_t *output,
+		uint64_t count);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -68,6 +73,9 @@ SR_API int sr_log_loglevel_get(void);
 SR_API int sr_log_callback_set(sr_log_callback cb, void *cb_data);
 SR_API int sr_log_callback_set_default(void);
 SR_API int sr_log_callback_get(sr_log_callback *cb, void **cb_data);
+SR_API int sr_log_ring_start(size_t entries);
+SR_API int sr_log_ring_flush(sr_log_callback cb, void *cb_data);
+SR_API int sr_log_ring_stop(void);
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -145,6 +153,20 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_logic_rle_set(struct sr_session *session,
+		gboolean accept);
+SR_API gboolean sr_session_logic_rle_get(struct sr_session *session);
+SR_API int sr_session_analog_timed_set(struct sr_session *session,
+		gboolean accept);
+SR_API gboolean sr_session_analog_timed_get(struct sr_session *session);
+SR_API int sr_session_analog_batch_set(struct sr_session *session,
+		size_t max_samples, uint64_t max_age_ms);
+SR_API int sr_session_analog_batch_get(struct sr_session *session,
+		size_t *max_samples, uint64_t *max_age_ms);
+SR_API int sr_session_dispatch_set(struct sr_session *session,
+		size_t queue_depth, enum sr_dispatch_overflow overflow);
+SR_API int sr_session_dispatch_stats_get(struct sr_session *session,
+		struct sr_session_dispatch_stats *stats);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -158,6 +180,35 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet);
 
+/*--- session_file_reader.c -------------------------------------------------*/
+
+SR_API int sr_sessionfile_reader_open(const char *filename,
+		struct sr_sessionfile_reader **reader);
+SR_API void sr_sessionfile_reader_close(struct sr_sessionfile_reader *reader);
+SR_API int sr_sessionfile_reader_logic_get(
+		const struct sr_sessionfile_reader *reader,
+		unsigned int *unitsize, uint64_t *num_samples);
+SR_API unsigned int sr_sessionfile_reader_analog_count(
+		const struct sr_sessionfile_reader *reader);
+SR_API int sr_sessionfile_reader_analog_get(
+		const struct sr_sessionfile_reader *reader,
+		unsigned int index, uint64_t *num_samples);
+SR_API int sr_sessionfile_reader_logic_read(
+		struct sr_sessionfile_reader *reader,
+		uint64_t start, uint64_t end, uint8_t *data);
+SR_API int sr_sessionfile_reader_analog_read(
+		struct sr_sessionfile_reader *reader, unsigned int index,
+		uint64_t start, uint64_t end, float *data);
+
+/*--- buffer.c --------------------------------------------------------------*/
+
+SR_API struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf);
+SR_API void sr_buffer_unref(struct sr_buffer *buf);
+SR_API void *sr_buffer_data_get(struct sr_buffer *buf);
+SR_API size_t sr_buffer_size_get(struct sr_buffer *buf);
+SR_API struct sr_buffer *sr_packet_buffer_ref(
+		const struct sr_datafeed_packet *packet);
+
 /*--- input/input.c ---------------------------------------------------------*/
 
 SR_API const struct sr_input_module **sr_input_list(void);
@@ -200,6 +251,24 @@ SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
 SR_API int sr_output_free(const struct sr_output *o);
 
+typedef int (*sr_output_sink_write_callback)(const void *data, size_t length,
+		void *cb_data);
+
+SR_API struct sr_output_sink *sr_output_sink_new_callback(
+		sr_output_sink_write_callback cb, void *cb_data,
+		size_t buffer_size);
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd,
+		size_t buffer_size);
+SR_API struct sr_output_sink *sr_output_sink_new_buffer(void);
+SR_API const char *sr_output_sink_buffer_get(struct sr_output_sink *sink,
+		size_t *length);
+SR_API void sr_output_sink_buffer_clear(struct sr_output_sink *sink);
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink);
+SR_API int sr_output_sink_free(struct sr_output_sink *sink);
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink);
+
 /*--- transform/transform.c -------------------------------------------------*/
 
 SR_API const struct sr_transform_module **sr_transform_list(void);
@@ -157,12 +157,159 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/*
+ * Conversion kernels for analog sample data. Each supported encoding
+ * gets a loop of its own with an inlined reader, instead of calling a
+ * reader routine through a function pointer for every sample. Simple
+ * loops like these get vectorized by the compiler. Scale and offset
+ * only get applied when they are not the identity. Calculations are
+ * done in double precision, results get trimmed to the output type.
+ */
+/** @cond PRIVATE */
+#define ANALOG_CONVERT_LOOP(reader, step) \
+	do { \
+		if (scale == 1.0 && offset == 0.0) { \
+			for (i = 0; i < count; i++) \
+				outbuf[i] = reader(data8 + i * (step)); \
+		} else { \
+			for (i = 0; i < count; i++) \
+				outbuf[i] = reader(data8 + i * (step)) * \
+					scale + offset; \
+		} \
+	} while (0)
+
+#define ANALOG_CONVERT_FUNC(name, type) \
+static int name(const struct sr_analog_encoding *encoding, \
+		const uint8_t *data8, size_t count, \
+		double scale, double offset, type *outbuf) \
+{ \
+	size_t i; \
+	\
+	if (encoding->is_float) { \
+		if (encoding->unitsize == sizeof(float) && encoding->is_bigendian) \
+			ANALOG_CONVERT_LOOP(read_fltbe, sizeof(float)); \
+		else if (encoding->unitsize == sizeof(float)) \
+			ANALOG_CONVERT_LOOP(read_fltle, sizeof(float)); \
+		else if (encoding->unitsize == sizeof(double) && encoding->is_bigendian) \
+			ANALOG_CONVERT_LOOP(read_dblbe, sizeof(double)); \
+		else if (encoding->unitsize == sizeof(double)) \
+			ANALOG_CONVERT_LOOP(read_dblle, sizeof(double)); \
+		else \
+			return SR_ERR; \
+		return SR_OK; \
+	} \
+	\
+	switch (encoding->unitsize) { \
+	case sizeof(uint8_t): \
+		if (encoding->is_signed) \
+			ANALOG_CONVERT_LOOP(read_i8, sizeof(int8_t)); \
+		else \
+			ANALOG_CONVERT_LOOP(read_u8, sizeof(uint8_t)); \
+		break; \
+	case sizeof(uint16_t): \
+		if (encoding->is_signed && encoding->is_bigendian) \
+			ANALOG_CONVERT_LOOP(read_i16be, sizeof(int16_t)); \
+		else if (encoding->is_signed) \
+			ANALOG_CONVERT_LOOP(read_i16le, sizeof(int16_t)); \
+		else if (encoding->is_bigendian) \
+			ANALOG_CONVERT_LOOP(read_u16be, sizeof(uint16_t)); \
+		else \
+			ANALOG_CONVERT_LOOP(read_u16le, sizeof(uint16_t)); \
+		break; \
+	case sizeof(uint32_t): \
+		if (encoding->is_signed && encoding->is_bigendian) \
+			ANALOG_CONVERT_LOOP(read_i32be, sizeof(int32_t)); \
+		else if (encoding->is_signed) \
+			ANALOG_CONVERT_LOOP(read_i32le, sizeof(int32_t)); \
+		else if (encoding->is_bigendian) \
+			ANALOG_CONVERT_LOOP(read_u32be, sizeof(uint32_t)); \
+		else \
+			ANALOG_CONVERT_LOOP(read_u32le, sizeof(uint32_t)); \
+		break; \
+	default: \
+		return SR_ERR; \
+	} \
+	\
+	return SR_OK; \
+}
+
+ANALOG_CONVERT_FUNC(analog_convert_float, float)
+ANALOG_CONVERT_FUNC(analog_convert_double, double)
+/** @endcond */
+
+/*
+ * Common part of the conversion to single and double precision.
+ * Checks arguments, and gets the sample count and scale/offset.
+ * Input data which already is in the requested format gets copied,
+ * in which case *done is set.
+ */
+static int analog_convert_prepare(const struct sr_datafeed_analog *analog,
+		void *outbuf, size_t out_unitsize, size_t *count,
+		double *scale, double *offset, gboolean *done)
+{
+	gboolean host_bigendian;
+	const struct sr_analog_encoding *encoding;
+
+	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
+		return SR_ERR_ARG;
+	if (!outbuf)
+		return SR_ERR_ARG;
+
+	encoding = analog->encoding;
+	*count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	*offset = encoding->offset.p;
+	*offset /= encoding->offset.q;
+	*scale = encoding->scale.p;
+	*scale /= encoding->scale.q;
+
+	/*
+	 * Immediately handle the special case where input data needs
+	 * no conversion at all because it already is in the caller's
+	 * native format, and neither scale nor offset apply.
+	 */
+#ifdef WORDS_BIGENDIAN
+	host_bigendian = TRUE;
+#else
+	host_bigendian = FALSE;
+#endif
+	*done = encoding->is_float && encoding->unitsize == out_unitsize &&
+		encoding->is_bigendian == host_bigendian &&
+		*scale == 1.0 && *offset == 0.0;
+	if (*done)
+		memcpy(outbuf, analog->data, *count * out_unitsize);
+
+	return SR_OK;
+}
+
+/*
+ * Error messages for unsupported input property combinations
+ * will only be seen by developers and maintainers of input
+ * formats or acquisition device drivers. Terse output is
+ * acceptable there, users shall never see them.
+ */
+static void analog_convert_unsupported(const struct sr_analog_encoding *encoding,
+		const char *target)
+{
+	char type_text[10];
+
+	snprintf(type_text, sizeof(type_text), "%c%d%s",
+		encoding->is_float ? 'f' : encoding->is_signed ? 'i' : 'u',
+		encoding->unitsize * 8, encoding->is_bigendian ? "be" : "le");
+	sr_err("Unsupported type for analog-to-%s conversion: %s.",
+		target, type_text);
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
  * The caller must provide the #outbuf space for the conversion result,
  * and is expected to free allocated space after use.
  *
+ * Accepts sample values in different widths and data types and
+ * endianess formats (floating point or signed or unsigned integer,
+ * in either endianess, for a set of supported widths). Common
+ * scale/offset factors apply to all sample values.
+ *
  * @param[in] analog The analog payload to convert. Must not be NULL.
  *                   analog->data, analog->meaning, and analog->encoding
  *                   must not be NULL.
@@ -172,210 +319,68 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
  * @retval SR_ERR Unsupported encoding.
  * @retval SR_ERR_ARG Invalid argument.
  *
+ * @see sr_analog_to_double()
+ *
  * @since 0.4.0
  */
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *outbuf)
 {
 	size_t count;
-	gboolean host_bigendian;
-	gboolean input_float, input_signed, input_bigendian;
-	size_t input_unitsize;
-	double scale, offset, value;
-	const uint8_t *data8;
-	gboolean input_is_native;
-	char type_text[10];
+	double scale, offset;
+	gboolean done;
+	int ret;
 
-	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
-		return SR_ERR_ARG;
-	if (!outbuf)
-		return SR_ERR_ARG;
+	ret = analog_convert_prepare(analog, outbuf, sizeof(outbuf[0]),
+		&count, &scale, &offset, &done);
+	if (ret != SR_OK || done)
+		return ret;
 
-	count = analog->num_samples * g_slist_length(analog->meaning->channels);
+	ret = analog_convert_float(analog->encoding, analog->data, count,
+		scale, offset, outbuf);
+	if (ret != SR_OK)
+		analog_convert_unsupported(analog->encoding, "float");
 
-	/*
-	 * Determine properties of the input data's and the host's
-	 * native formats, to simplify test conditions below.
-	 * Error messages for unsupported input property combinations
-	 * will only be seen by developers and maintainers of input
-	 * formats or acquisition device drivers. Terse output is
-	 * acceptable there, users shall never see them.
-	 */
-#ifdef WORDS_BIGENDIAN
-	host_bigendian = TRUE;
-#else
-	host_bigendian = FALSE;
-#endif
-	input_float = analog->encoding->is_float;
-	input_signed = analog->encoding->is_signed;
-	input_bigendian = analog->encoding->is_bigendian;
-	input_unitsize = analog->encoding->unitsize;
+	return ret;
+}
 
-	/*
-	 * Prepare the iteration over the sample data: Get the common
-	 * scale/offset factors which apply to all individual values.
-	 * Position the read pointer on the first byte of input data.
-	 */
-	offset = analog->encoding->offset.p;
-	offset /= analog->encoding->offset.q;
-	scale = analog->encoding->scale.p;
-	scale /= analog->encoding->scale.q;
-	data8 = analog->data;
+/**
+ * Convert an analog datafeed payload to an array of doubles.
+ *
+ * Like sr_analog_to_float(), but keeps double precision, which is
+ * needed for input data with more than 24 significant bits, or for
+ * scale/offset factors which would otherwise lose precision.
+ *
+ * @param[in] analog The analog payload to convert. Must not be NULL.
+ *                   analog->data, analog->meaning, and analog->encoding
+ *                   must not be NULL.
+ * @param[out] outbuf Memory where to store the result. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_to_double(const struct sr_datafeed_analog *analog,
+		double *outbuf)
+{
+	size_t count;
+	double scale, offset;
+	gboolean done;
+	int ret;
 
-	/*
-	 * Immediately handle the special case where input data needs
-	 * no conversion because it already is in the application's
-	 * native format. Do apply scale/offset though when applicable
-	 * on our way out.
-	 */
-	input_is_native = input_float &&
-		input_unitsize == sizeof(outbuf[0]) &&
-		input_bigendian == host_bigendian;
-	if (input_is_native) {
-		memcpy(outbuf, data8, count * sizeof(outbuf[0]));
-		if (scale != 1.0 || offset != 0.0) {
-			while (count--) {
-				*outbuf *= scale;
-				*outbuf += offset;
-				outbuf++;
-			}
-		}
-		return SR_OK;
-	}
+	ret = analog_convert_prepare(analog, outbuf, sizeof(outbuf[0]),
+		&count, &scale, &offset, &done);
+	if (ret != SR_OK || done)
+		return ret;
 
-	/*
-	 * Accept sample values in different widths and data types and
-	 * endianess formats (floating point or signed or unsigned
-	 * integer, in either endianess, for a set of supported widths).
-	 * Common scale/offset factors apply to all sample values.
-	 *
-	 * Do most internal calculations on double precision values.
-	 * Only trim the result data to single precision, since that's
-	 * the routine's result data type in its public API which needs
-	 * to be kept for compatibility. It remains an option for later
-	 * to add another public routine which returns double precision
-	 * result data, call sites could migrate at their own pace.
-	 */
-	if (input_float && input_unitsize == sizeof(float)) {
-		float (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_fltbe_inc;
-		else
-			reader = read_fltle_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_float && input_unitsize == sizeof(double)) {
-		double (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_dblbe_inc;
-		else
-			reader = read_dblle_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_float) {
-		snprintf(type_text, sizeof(type_text), "%c%zu%s",
-			'f', input_unitsize * 8, input_bigendian ? "be" : "le");
-		sr_err("Unsupported type for analog-to-float conversion: %s.",
-			type_text);
-		return SR_ERR;
-	}
+	ret = analog_convert_double(analog->encoding, analog->data, count,
+		scale, offset, outbuf);
+	if (ret != SR_OK)
+		analog_convert_unsupported(analog->encoding, "double");
 
-	if (input_unitsize == sizeof(uint8_t) && input_signed) {
-		int8_t (*reader)(const uint8_t **p);
-		reader = read_i8_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint8_t)) {
-		uint8_t (*reader)(const uint8_t **p);
-		reader = read_u8_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint16_t) && input_signed) {
-		int16_t (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_i16be_inc;
-		else
-			reader = read_i16le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint16_t)) {
-		uint16_t (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_u16be_inc;
-		else
-			reader = read_u16le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint32_t) && input_signed) {
-		int32_t (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_i32be_inc;
-		else
-			reader = read_i32le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint32_t)) {
-		uint32_t (*reader)(const uint8_t **p);
-		if (input_bigendian)
-			reader = read_u32be_inc;
-		else
-			reader = read_u32le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	snprintf(type_text, sizeof(type_text), "%c%zu%s",
-		input_float ? 'f' : input_signed ? 'i' : 'u',
-		input_unitsize * 8, input_bigendian ? "be" : "le");
-	sr_err("Unsupported type for analog-to-float conversion: %s.",
-		type_text);
-	return SR_ERR;
+	return ret;
 }
 
 /**
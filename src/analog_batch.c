@@ -0,0 +1,366 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Batching of analog readings from low rate devices
+ *
+ * Multimeters, LCR meters, scales and power supplies take a few readings
+ * per second. Sending each of them in a packet of its own costs more than
+ * handling the one sample in it. The batch collects readings per channel
+ * and measured quantity, and sends them as SR_DF_ANALOG_TIMED packets,
+ * which keep the time when each reading was taken.
+ *
+ * The session's settings tell how many readings to collect, and how long
+ * to hold them back at most. See sr_session_analog_batch_set().
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "analog_batch"
+/** @endcond */
+
+/* Collected readings of one channel's measured quantity. */
+struct batch_queue {
+	struct sr_channel *channel;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GByteArray *data;
+	GArray *timestamps;
+	size_t count;
+	/* Monotonic time [us] when the oldest reading was queued. */
+	int64_t since;
+};
+
+struct sr_analog_batch {
+	const struct sr_dev_inst *sdi;
+	size_t max_samples;
+	int64_t max_age_us;
+	GSList *queues;
+};
+
+/**
+ * Create a batch for a device's analog readings.
+ *
+ * Takes the session's batch settings, should be called when the
+ * acquisition starts.
+ *
+ * @param sdi The device instance which sends the readings.
+ *
+ * @return The new batch. Free it with sr_analog_batch_free().
+ *
+ * @private
+ */
+SR_PRIV struct sr_analog_batch *sr_analog_batch_new(
+	const struct sr_dev_inst *sdi)
+{
+	struct sr_analog_batch *batch;
+
+	batch = g_malloc0(sizeof(*batch));
+	batch->sdi = sdi;
+	batch->max_samples = 1;
+	if (sdi && sdi->session) {
+		batch->max_samples = MAX(sdi->session->analog_batch_samples, 1);
+		batch->max_age_us = sdi->session->analog_batch_age_ms * 1000;
+	}
+
+	return batch;
+}
+
+/**
+ * Check whether the batch holds back readings.
+ *
+ * @param batch The batch, can be NULL.
+ *
+ * @return TRUE when readings can get collected before they are sent.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_analog_batch_active(const struct sr_analog_batch *batch)
+{
+	return batch && batch->max_samples > 1;
+}
+
+static int send_timed(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_analog *analog, int64_t *timestamps)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog_timed timed;
+
+	timed.analog = *analog;
+	timed.timestamps = timestamps;
+	packet.type = SR_DF_ANALOG_TIMED;
+	packet.payload = &timed;
+
+	return sr_session_send(sdi, &packet);
+}
+
+static int queue_flush(struct sr_analog_batch *batch, struct batch_queue *q)
+{
+	struct sr_datafeed_analog analog;
+	GSList channels;
+	int ret;
+
+	if (!q->count)
+		return SR_OK;
+
+	channels.data = q->channel;
+	channels.next = NULL;
+	q->meaning.channels = &channels;
+	analog.data = q->data->data;
+	analog.num_samples = q->count;
+	analog.encoding = &q->encoding;
+	analog.meaning = &q->meaning;
+	analog.spec = &q->spec;
+	ret = send_timed(batch->sdi, &analog, (int64_t *)q->timestamps->data);
+	q->meaning.channels = NULL;
+
+	g_byte_array_set_size(q->data, 0);
+	g_array_set_size(q->timestamps, 0);
+	q->count = 0;
+
+	return ret;
+}
+
+static gboolean same_format(const struct batch_queue *q,
+	const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *enc;
+
+	enc = analog->encoding;
+	if (enc->unitsize != q->encoding.unitsize ||
+			enc->is_signed != q->encoding.is_signed ||
+			enc->is_float != q->encoding.is_float ||
+			enc->is_bigendian != q->encoding.is_bigendian ||
+			enc->digits != q->encoding.digits ||
+			enc->is_digits_decimal != q->encoding.is_digits_decimal)
+		return FALSE;
+	if (enc->scale.p != q->encoding.scale.p ||
+			enc->scale.q != q->encoding.scale.q ||
+			enc->offset.p != q->encoding.offset.p ||
+			enc->offset.q != q->encoding.offset.q)
+		return FALSE;
+	if (analog->meaning->unit != q->meaning.unit ||
+			analog->meaning->mqflags != q->meaning.mqflags)
+		return FALSE;
+
+	return analog->spec->spec_digits == q->spec.spec_digits;
+}
+
+static struct batch_queue *find_queue(struct sr_analog_batch *batch,
+	struct sr_channel *channel, enum sr_mq mq)
+{
+	struct batch_queue *q;
+	GSList *l;
+
+	for (l = batch->queues; l; l = l->next) {
+		q = l->data;
+		if (q->channel == channel && q->meaning.mq == mq)
+			return q;
+	}
+
+	q = g_malloc0(sizeof(*q));
+	q->channel = channel;
+	q->meaning.mq = mq;
+	q->data = g_byte_array_new();
+	q->timestamps = g_array_new(FALSE, FALSE, sizeof(int64_t));
+	batch->queues = g_slist_append(batch->queues, q);
+
+	return q;
+}
+
+/* Send readings which were held back for too long. */
+static int flush_expired(struct sr_analog_batch *batch, int64_t now)
+{
+	struct batch_queue *q;
+	GSList *l;
+	int ret;
+
+	if (!batch->max_age_us)
+		return SR_OK;
+
+	for (l = batch->queues; l; l = l->next) {
+		q = l->data;
+		if (!q->count || now - q->since < batch->max_age_us)
+			continue;
+		ret = queue_flush(batch, q);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Submit analog readings.
+ *
+ * The readings get the current time as their timestamp. They are sent
+ * right away unless the session has batching enabled. Packets for more
+ * than one channel are never held back.
+ *
+ * @param batch The batch, see sr_analog_batch_new().
+ * @param analog The readings, like the payload of an SR_DF_ANALOG packet.
+ *               The batch copies what it keeps.
+ *
+ * @retval SR_OK Success.
+ * @retval other Sending a packet failed.
+ *
+ * @private
+ */
+SR_PRIV int sr_analog_batch_submit(struct sr_analog_batch *batch,
+	const struct sr_datafeed_analog *analog)
+{
+	struct batch_queue *q;
+	int64_t realtime, now, *timestamps;
+	size_t i;
+	int ret;
+
+	if (!batch || !analog)
+		return SR_ERR_ARG;
+	if (!analog->num_samples)
+		return SR_OK;
+
+	realtime = g_get_real_time();
+	now = g_get_monotonic_time();
+
+	if (!sr_analog_batch_active(batch) || !analog->meaning->channels ||
+			analog->meaning->channels->next) {
+		/* Keep the order of readings which are sent right away. */
+		ret = sr_analog_batch_flush(batch);
+		if (ret != SR_OK)
+			return ret;
+		if (analog->num_samples == 1)
+			return send_timed(batch->sdi, analog, &realtime);
+		timestamps = g_malloc(analog->num_samples * sizeof(timestamps[0]));
+		for (i = 0; i < analog->num_samples; i++)
+			timestamps[i] = realtime;
+		ret = send_timed(batch->sdi, analog, timestamps);
+		g_free(timestamps);
+		return ret;
+	}
+
+	q = find_queue(batch, analog->meaning->channels->data,
+		analog->meaning->mq);
+	if (q->count && !same_format(q, analog)) {
+		ret = queue_flush(batch, q);
+		if (ret != SR_OK)
+			return ret;
+	}
+	if (!q->count) {
+		q->encoding = *analog->encoding;
+		q->meaning = *analog->meaning;
+		q->meaning.channels = NULL;
+		q->spec = *analog->spec;
+		q->since = now;
+	}
+
+	g_byte_array_append(q->data, analog->data,
+		analog->num_samples * analog->encoding->unitsize);
+	for (i = 0; i < analog->num_samples; i++)
+		g_array_append_val(q->timestamps, realtime);
+	q->count += analog->num_samples;
+
+	if (q->count >= batch->max_samples) {
+		ret = queue_flush(batch, q);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return flush_expired(batch, now);
+}
+
+/**
+ * Send readings which were held back for longer than the session allows.
+ *
+ * Readings only get checked for their age when new ones are submitted.
+ * Drivers call this from their receive callbacks, also upon timeouts,
+ * so that the readings of a device which stops sending still arrive.
+ *
+ * @param batch The batch, can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval other Sending a packet failed.
+ *
+ * @private
+ */
+SR_PRIV int sr_analog_batch_poll(struct sr_analog_batch *batch)
+{
+	if (!batch)
+		return SR_OK;
+
+	return flush_expired(batch, g_get_monotonic_time());
+}
+
+/**
+ * Send all readings which the batch holds back.
+ *
+ * Must be called before the acquisition ends.
+ *
+ * @param batch The batch, can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval other Sending a packet failed.
+ *
+ * @private
+ */
+SR_PRIV int sr_analog_batch_flush(struct sr_analog_batch *batch)
+{
+	GSList *l;
+	int ret;
+
+	if (!batch)
+		return SR_OK;
+
+	for (l = batch->queues; l; l = l->next) {
+		ret = queue_flush(batch, l->data);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+static void queue_free(void *data)
+{
+	struct batch_queue *q;
+
+	q = data;
+	g_byte_array_free(q->data, TRUE);
+	g_array_free(q->timestamps, TRUE);
+	g_free(q);
+}
+
+/**
+ * Free a batch. Readings which it still holds get discarded.
+ *
+ * @param batch The batch, can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_analog_batch_free(struct sr_analog_batch *batch)
+{
+	if (!batch)
+		return;
+
+	g_slist_free_full(batch->queues, queue_free);
+	g_free(batch);
+}
@@ -477,7 +477,7 @@ static int sanity_check_all_output_modules(void)
 			sr_err("No description in module '%s'.", d);
 			errors++;
 		}
-		if (!outputs[i]->receive) {
+		if (!outputs[i]->receive && !outputs[i]->receive_append) {
 			sr_err("No receive in module '%s'.", d);
 			errors++;
 		}
@@ -0,0 +1,426 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stddef.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Reference counted sample buffers.
+ */
+
+/**
+ * @defgroup grp_buffer Sample buffers
+ *
+ * Reference counted sample buffers which back datafeed packets.
+ *
+ * Drivers which receive sample data into memory they own (USB transfer
+ * buffers, file chunks) can hand these buffers to the session without
+ * copying. Datafeed callbacks which need the sample data beyond the
+ * lifetime of the callback can take a reference with
+ * sr_packet_buffer_ref() instead of copying the data, and release it
+ * with sr_buffer_unref() when done.
+ *
+ * @{
+ */
+
+/** @cond PRIVATE */
+struct sr_buffer_pool {
+	GMutex mutex;
+	size_t buffer_size;
+	size_t max_idle;
+	size_t max_buffers;
+	GSList *idle;
+	size_t idle_count;
+	size_t outstanding;
+	gboolean destroyed;
+};
+
+struct sr_buffer {
+	gint refcount;
+	struct sr_buffer_pool *pool;
+	size_t size;
+	/* Sample data follows the header, 64bit aligned. */
+	uint64_t data[];
+};
+
+/* Stack of buffers which back packets currently being dispatched. */
+static GPrivate dispatch_stack = G_PRIVATE_INIT(NULL);
+/** @endcond */
+
+static void buffer_pool_free(struct sr_buffer_pool *pool)
+{
+	g_slist_free_full(pool->idle, g_free);
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+static void buffer_release(struct sr_buffer *buf)
+{
+	struct sr_buffer_pool *pool;
+	gboolean free_pool;
+
+	pool = buf->pool;
+	if (!pool) {
+		g_free(buf);
+		return;
+	}
+
+	g_mutex_lock(&pool->mutex);
+	pool->outstanding--;
+	if (!pool->destroyed && pool->idle_count < pool->max_idle) {
+		pool->idle = g_slist_prepend(pool->idle, buf);
+		pool->idle_count++;
+		buf = NULL;
+	}
+	free_pool = pool->destroyed && !pool->outstanding;
+	g_mutex_unlock(&pool->mutex);
+
+	g_free(buf);
+	if (free_pool)
+		buffer_pool_free(pool);
+}
+
+/**
+ * Create a pool of equally sized sample buffers.
+ *
+ * Released buffers are kept for re-use, up to @a max_idle of them. The
+ * pool itself stays alive until it got destroyed and all buffers which
+ * were taken from it have been released.
+ *
+ * @param buffer_size Size of each buffer in bytes.
+ * @param max_idle Number of released buffers to keep for re-use.
+ * @param max_buffers Number of buffers which may be in use at the same
+ *                    time, or 0 for no limit.
+ *
+ * @return The new pool, or NULL upon error.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t buffer_size,
+		size_t max_idle, size_t max_buffers)
+{
+	struct sr_buffer_pool *pool;
+
+	if (!buffer_size)
+		return NULL;
+
+	pool = g_malloc0(sizeof(*pool));
+	g_mutex_init(&pool->mutex);
+	pool->buffer_size = buffer_size;
+	pool->max_idle = max_idle;
+	pool->max_buffers = max_buffers;
+
+	return pool;
+}
+
+/**
+ * Destroy a buffer pool.
+ *
+ * Buffers which are still in use remain valid. The pool's memory is
+ * released when the last of them got released.
+ *
+ * @param pool The pool to destroy. May be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_destroy(struct sr_buffer_pool *pool)
+{
+	gboolean free_pool;
+
+	if (!pool)
+		return;
+
+	g_mutex_lock(&pool->mutex);
+	pool->destroyed = TRUE;
+	free_pool = !pool->outstanding;
+	g_mutex_unlock(&pool->mutex);
+
+	if (free_pool)
+		buffer_pool_free(pool);
+}
+
+/**
+ * Take a buffer from a pool.
+ *
+ * @param pool The pool to take the buffer from.
+ *
+ * @return A buffer with a reference count of one, or NULL upon error or
+ *         when the pool's maximum number of buffers is in use. Its
+ *         content is undefined.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool)
+{
+	struct sr_buffer *buf;
+
+	if (!pool)
+		return NULL;
+
+	g_mutex_lock(&pool->mutex);
+	if (pool->max_buffers && pool->outstanding >= pool->max_buffers) {
+		g_mutex_unlock(&pool->mutex);
+		sr_err("All %zu sample buffers are in use.", pool->max_buffers);
+		return NULL;
+	}
+	buf = NULL;
+	if (pool->idle) {
+		buf = pool->idle->data;
+		pool->idle = g_slist_delete_link(pool->idle, pool->idle);
+		pool->idle_count--;
+	}
+	if (!buf)
+		buf = g_try_malloc(sizeof(*buf) + pool->buffer_size);
+	if (buf)
+		pool->outstanding++;
+	g_mutex_unlock(&pool->mutex);
+
+	if (!buf) {
+		sr_err("Cannot allocate %zu bytes sample buffer.",
+			pool->buffer_size);
+		return NULL;
+	}
+
+	buf->refcount = 1;
+	buf->pool = pool;
+	buf->size = pool->buffer_size;
+
+	return buf;
+}
+
+/**
+ * Allocate a buffer which does not belong to a pool.
+ *
+ * @param size Size of the buffer in bytes.
+ *
+ * @return A buffer with a reference count of one, or NULL upon error.
+ *         Its content is undefined.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_new(size_t size)
+{
+	struct sr_buffer *buf;
+
+	buf = g_try_malloc(sizeof(*buf) + size);
+	if (!buf) {
+		sr_err("Cannot allocate %zu bytes sample buffer.", size);
+		return NULL;
+	}
+
+	buf->refcount = 1;
+	buf->pool = NULL;
+	buf->size = size;
+
+	return buf;
+}
+
+/**
+ * Get the buffer which a data pointer was obtained from.
+ *
+ * @param data The start of a buffer's data, as returned by
+ *             sr_buffer_data_get().
+ *
+ * @return The buffer. No reference is taken.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_from_data(void *data)
+{
+	if (!data)
+		return NULL;
+
+	return (struct sr_buffer *)((uint8_t *)data -
+		offsetof(struct sr_buffer, data));
+}
+
+/**
+ * Check whether other references to a buffer exist.
+ *
+ * Drivers which re-use a buffer for the next acquisition (like USB
+ * transfers do) must not overwrite it while a consumer still holds
+ * a reference.
+ *
+ * @param buf The buffer to check.
+ *
+ * @return TRUE if anybody besides the caller holds a reference.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_buffer_is_shared(struct sr_buffer *buf)
+{
+	if (!buf)
+		return FALSE;
+
+	return g_atomic_int_get(&buf->refcount) > 1;
+}
+
+/**
+ * Mark a buffer as backing the packets which get sent next.
+ *
+ * Pushes the buffer onto the calling thread's dispatch stack, which
+ * sr_packet_buffer_ref() searches.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_dispatch_push(struct sr_buffer *buf)
+{
+	GSList *stack;
+
+	stack = g_private_get(&dispatch_stack);
+	g_private_set(&dispatch_stack, g_slist_prepend(stack, buf));
+}
+
+/**
+ * Undo the most recent sr_buffer_dispatch_push().
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_dispatch_pop(void)
+{
+	GSList *stack;
+
+	stack = g_private_get(&dispatch_stack);
+	if (!stack)
+		return;
+	g_private_set(&dispatch_stack, g_slist_delete_link(stack, stack));
+}
+
+/**
+ * Take an additional reference to a buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return The buffer.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf)
+{
+	g_atomic_int_inc(&buf->refcount);
+
+	return buf;
+}
+
+/**
+ * Release a reference to a buffer.
+ *
+ * The buffer's memory is released or returned to its pool when the
+ * last reference got released.
+ *
+ * @param buf The buffer. May be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_buffer_unref(struct sr_buffer *buf)
+{
+	if (!buf)
+		return;
+
+	if (g_atomic_int_dec_and_test(&buf->refcount))
+		buffer_release(buf);
+}
+
+/**
+ * Get the start of a buffer's data.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void *sr_buffer_data_get(struct sr_buffer *buf)
+{
+	return buf->data;
+}
+
+/**
+ * Get the size of a buffer's data in bytes.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API size_t sr_buffer_size_get(struct sr_buffer *buf)
+{
+	return buf->size;
+}
+
+/**
+ * Take a reference to the buffer which backs a datafeed packet.
+ *
+ * This is only valid from within a datafeed callback, for the packet
+ * that is being passed to it. The returned reference keeps the packet's
+ * sample data valid after the callback returned; release it with
+ * sr_buffer_unref(). The packet structure itself is not covered, only
+ * the sample data it points to.
+ *
+ * @param packet The packet passed to the datafeed callback.
+ *
+ * @return The buffer holding the packet's sample data, or NULL if the
+ *         packet is not backed by a buffer. Callers must copy the data
+ *         in the latter case.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_buffer *sr_packet_buffer_ref(
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const uint8_t *data, *start;
+	struct sr_buffer *buf;
+	GSList *l;
+
+	if (!packet || !packet->payload)
+		return NULL;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		data = analog->data;
+		break;
+	default:
+		return NULL;
+	}
+	if (!data)
+		return NULL;
+
+	for (l = g_private_get(&dispatch_stack); l; l = l->next) {
+		buf = l->data;
+		start = (const uint8_t *)buf->data;
+		if (data >= start && data < start + buf->size)
+			return sr_buffer_ref(buf);
+	}
+
+	return NULL;
+}
+
+/** @} */
@@ -23,6 +23,7 @@
  * Conversion helper functions.
  */
 
+#include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -107,3 +108,71 @@ SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 
 	return SR_OK;
 }
+
+/**
+ * Expand run-length encoded logic data to plain logic samples.
+ *
+ * This is a helper for consumers of SR_DF_LOGIC_RLE packets which
+ * need the SR_DF_LOGIC memory layout. Expansion is incremental so that
+ * long runs can be processed in chunks of caller specified size. The
+ * read position is kept in run_idx and run_pos, which the caller must
+ * set to zero before the first call for a packet.
+ *
+ * @param[in] rle The run-length encoded input data.
+ * @param[in,out] run_idx Index of the run to continue expansion with.
+ * @param[in,out] run_pos Number of samples already taken from that run.
+ * @param[out] output The expanded samples, rle->unitsize bytes each.
+ *                    Must provide space for count samples.
+ * @param[in] count The maximum number of samples to expand.
+ *
+ * @return The number of samples which were written to the output
+ *         buffer. Zero when all runs were expanded.
+ */
+SR_API uint64_t sr_logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t *run_idx, uint64_t *run_pos, uint8_t *output,
+		uint64_t count)
+{
+	const uint8_t *value;
+	uint64_t written, remain, copy_count, done;
+	size_t unitsize;
+
+	if (!rle || !run_idx || !run_pos || !output)
+		return 0;
+
+	unitsize = rle->unitsize;
+	written = 0;
+	while (written < count && *run_idx < rle->num_runs) {
+		remain = rle->lengths[*run_idx] - *run_pos;
+		if (!remain) {
+			(*run_idx)++;
+			*run_pos = 0;
+			continue;
+		}
+		copy_count = MIN(remain, count - written);
+		value = (const uint8_t *)rle->values + *run_idx * unitsize;
+
+		/*
+		 * Place one copy of the value, then double the filled
+		 * range with each memcpy() call. Long runs take few
+		 * library calls instead of one per sample.
+		 */
+		memcpy(output, value, unitsize);
+		done = 1;
+		while (done < copy_count) {
+			remain = MIN(done, copy_count - done);
+			memcpy(output + done * unitsize, output,
+				remain * unitsize);
+			done += remain;
+		}
+		output += copy_count * unitsize;
+		written += copy_count;
+
+		*run_pos += copy_count;
+		if (*run_pos == rle->lengths[*run_idx]) {
+			(*run_idx)++;
+			*run_pos = 0;
+		}
+	}
+
+	return written;
+}
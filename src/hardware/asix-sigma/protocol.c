@@ -1458,8 +1458,6 @@ static int alloc_sample_buffer(struct dev_context *devc,
 	return SR_OK;
 }
 
-static uint16_t sigma_deinterlace_data_4x4(uint16_t indata, int idx);
-static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx);
 
 static int fetch_sample_buffer(struct dev_context *devc)
 {
@@ -1493,9 +1491,9 @@ static int fetch_sample_buffer(struct dev_context *devc)
 		ts = read_u16le_inc(&rdptr);
 		data = read_u16le_inc(&rdptr);
 		if (interp->samples_per_event == 4) {
-			data = sigma_deinterlace_data_4x4(data, 0);
+			data = sr_transpose_4x4(data) & 0xf;
 		} else if (interp->samples_per_event == 2) {
-			data = sigma_deinterlace_data_2x8(data, 0);
+			data = sr_transpose_8x2(data) & 0xff;
 		}
 		interp->last.ts = ts;
 		interp->last.sample = data;
@@ -1808,53 +1806,13 @@ static uint16_t sigma_dram_cluster_data(struct sigma_dram_cluster *cl, int idx)
 	return read_u16le((const uint8_t *)&cl->samples[idx]);
 }
 
-/*
- * Deinterlace sample data that was retrieved at 100MHz samplerate.
- * One 16bit item contains two samples of 8bits each. The bits of
- * multiple samples are interleaved.
- */
-static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx)
-{
-	uint16_t outdata;
-
-	indata >>= idx;
-	outdata = 0;
-	outdata |= (indata >> (0 * 2 - 0)) & (1 << 0);
-	outdata |= (indata >> (1 * 2 - 1)) & (1 << 1);
-	outdata |= (indata >> (2 * 2 - 2)) & (1 << 2);
-	outdata |= (indata >> (3 * 2 - 3)) & (1 << 3);
-	outdata |= (indata >> (4 * 2 - 4)) & (1 << 4);
-	outdata |= (indata >> (5 * 2 - 5)) & (1 << 5);
-	outdata |= (indata >> (6 * 2 - 6)) & (1 << 6);
-	outdata |= (indata >> (7 * 2 - 7)) & (1 << 7);
-	return outdata;
-}
-
-/*
- * Deinterlace sample data that was retrieved at 200MHz samplerate.
- * One 16bit item contains four samples of 4bits each. The bits of
- * multiple samples are interleaved.
- */
-static uint16_t sigma_deinterlace_data_4x4(uint16_t indata, int idx)
-{
-	uint16_t outdata;
-
-	indata >>= idx;
-	outdata = 0;
-	outdata |= (indata >> (0 * 4 - 0)) & (1 << 0);
-	outdata |= (indata >> (1 * 4 - 1)) & (1 << 1);
-	outdata |= (indata >> (2 * 4 - 2)) & (1 << 2);
-	outdata |= (indata >> (3 * 4 - 3)) & (1 << 3);
-	return outdata;
-}
-
 static void sigma_decode_dram_cluster(struct dev_context *devc,
 	struct sigma_dram_cluster *dram_cluster,
 	size_t events_in_cluster)
 {
 	uint16_t tsdiff, ts, sample, item16;
 	size_t count;
-	size_t evt;
+	size_t evt, idx;
 
 	/*
 	 * If this cluster is not adjacent to the previously received
@@ -1886,25 +1844,27 @@ static void sigma_decode_dram_cluster(struct dev_context *devc,
 	for (evt = 0; evt < events_in_cluster; evt++) {
 		item16 = sigma_dram_cluster_data(dram_cluster, evt);
 		if (devc->interp.samples_per_event == 4) {
-			sample = sigma_deinterlace_data_4x4(item16, 0);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_4x4(item16, 1);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_4x4(item16, 2);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_4x4(item16, 3);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
+			/*
+			 * 200MHz: Four samples of 4bits each, with the
+			 * bits of the samples interleaved.
+			 */
+			item16 = sr_transpose_4x4(item16);
+			for (idx = 0; idx < 4; idx++) {
+				sample = (item16 >> (4 * idx)) & 0xf;
+				check_and_submit_sample(devc, sample, 1);
+				devc->interp.last.sample = sample;
+			}
 		} else if (devc->interp.samples_per_event == 2) {
-			sample = sigma_deinterlace_data_2x8(item16, 0);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_2x8(item16, 1);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
+			/*
+			 * 100MHz: Two samples of 8bits each, with the
+			 * bits of the samples interleaved.
+			 */
+			item16 = sr_transpose_8x2(item16);
+			for (idx = 0; idx < 2; idx++) {
+				sample = (item16 >> (8 * idx)) & 0xff;
+				check_and_submit_sample(devc, sample, 1);
+				devc->interp.last.sample = sample;
+			}
 		} else {
 			sample = item16;
 			check_and_submit_sample(devc, sample, 1);
@@ -19,8 +19,10 @@
 
 #include <config.h>
 #include "protocol.h"
-#include <time.h>
-#include <sys/timerfd.h>
+
+static const uint32_t scanopts[] = {
+	SR_CONF_CONN,
+};
 
 static const uint32_t drvopts[] = {
 	SR_CONF_THERMOMETER,
@@ -32,6 +34,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+	SR_CONF_SAMPLES_MISSED | SR_CONF_GET,
 };
 
 /*
@@ -56,17 +59,41 @@ static const uint64_t samplerates[] = {
 	SR_HZ(1),
 };
 
+static void clear_helper(struct dev_context *devc)
+{
+	g_mutex_clear(&devc->stats_mutex);
+	g_free(devc->sysfs_root);
+}
+
+static int dev_clear(const struct sr_dev_driver *di)
+{
+	return std_dev_clear_with_callback(di, (std_dev_clear_callback)clear_helper);
+}
+
 static GSList *scan(struct sr_dev_driver *di, GSList *options)
 {
 	struct dev_context *devc;
 	struct sr_dev_inst *sdi;
+	struct sr_config *src;
+	const char *sysfs_root;
 	gboolean status;
+	GSList *l;
 	int i;
 
-	(void)options;
+	/* Tests and setups which mount sysfs elsewhere can pass its root. */
+	sysfs_root = DEFAULT_SYSFS_ROOT;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_CONN)
+			sysfs_root = g_variant_get_string(src->data, NULL);
+	}
 
 	devc = g_malloc0(sizeof(struct dev_context));
 	devc->samplerate = SR_HZ(10);
+	devc->sysfs_root = g_strdup(sysfs_root);
+	devc->timer_fd = -1;
+	devc->event_fd = -1;
+	g_mutex_init(&devc->stats_mutex);
 
 	sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	sdi->status = SR_ST_INACTIVE;
@@ -74,7 +101,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	sdi->model = g_strdup("ACME");
 	sdi->priv = devc;
 
-	status = bl_acme_is_sane();
+	status = bl_acme_is_sane(devc->sysfs_root);
 	if (!status)
 		goto err_out;
 
@@ -88,7 +115,8 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 		 * not, and we're already at the fifth probe - see if we can
 		 * detect a temperature probe.
 		 */
-		status = bl_acme_detect_probe(bl_acme_get_enrg_addr(i),
+		status = bl_acme_detect_probe(devc->sysfs_root,
+					      bl_acme_get_enrg_addr(i),
 					      PROBE_NUM(i), ENRG_PROBE_NAME);
 		if (status) {
 			/* Energy probe detected. */
@@ -100,7 +128,8 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 				continue;
 			}
 		} else if (i >= TEMP_PRB_START_INDEX) {
-			status = bl_acme_detect_probe(bl_acme_get_temp_addr(i),
+			status = bl_acme_detect_probe(devc->sysfs_root,
+					      bl_acme_get_temp_addr(i),
 					      PROBE_NUM(i), TEMP_PROBE_NAME);
 			if (status) {
 				/* Temperature probe detected. */
@@ -125,6 +154,8 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	return std_scan_complete(di, g_slist_append(NULL, sdi));
 
 err_out:
+	g_mutex_clear(&devc->stats_mutex);
+	g_free(devc->sysfs_root);
 	g_free(devc);
 	sr_dev_inst_free(sdi);
 
@@ -150,6 +181,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_SAMPLERATE:
 		*data = g_variant_new_uint64(devc->samplerate);
 		break;
+	case SR_CONF_SAMPLES_MISSED:
+		*data = g_variant_new_uint64(bl_acme_get_samples_missed(devc));
+		break;
 	case SR_CONF_PROBE_FACTOR:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -216,7 +250,7 @@ static int config_list(uint32_t key, GVariant **data,
 	if (!cg) {
 		switch (key) {
 		case SR_CONF_DEVICE_OPTIONS:
-			return STD_CONFIG_LIST(key, data, sdi, cg, NO_OPTS, drvopts, devopts);
+			return STD_CONFIG_LIST(key, data, sdi, cg, scanopts, drvopts, devopts);
 		case SR_CONF_SAMPLERATE:
 			*data = std_gvar_samplerates_steps(ARRAY_AND_SIZE(samplerates));
 			break;
@@ -272,62 +306,39 @@ static int dev_acquisition_open(const struct sr_dev_inst *sdi)
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	struct itimerspec tspec = {
-		.it_interval = { 0, 0 },
-		.it_value = { 0, 0 }
-	};
-
-	if (dev_acquisition_open(sdi))
-		return SR_ERR;
 
 	devc = sdi->priv;
-	devc->samples_missed = 0;
-	devc->timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
-	if (devc->timer_fd < 0) {
-		sr_err("Error creating timer fd");
-		return SR_ERR;
-	}
 
-	tspec.it_interval.tv_sec = 0;
-	tspec.it_interval.tv_nsec = SR_HZ_TO_NS(devc->samplerate);
-	tspec.it_value = tspec.it_interval;
-
-	if (timerfd_settime(devc->timer_fd, 0, &tspec, NULL)) {
-		sr_err("Failed to set timer");
-		close(devc->timer_fd);
+	if (dev_acquisition_open(sdi))
 		return SR_ERR;
-	}
-
-	devc->channel = g_io_channel_unix_new(devc->timer_fd);
-	g_io_channel_set_flags(devc->channel, G_IO_FLAG_NONBLOCK, NULL);
-	g_io_channel_set_encoding(devc->channel, NULL, NULL);
-	g_io_channel_set_buffered(devc->channel, FALSE);
-
-	sr_session_source_add_channel(sdi->session, devc->channel,
-		G_IO_IN | G_IO_ERR, 1000, bl_acme_receive_data, (void *)sdi);
 
 	std_session_send_df_header(sdi);
 	sr_sw_limits_acquisition_start(&devc->limits);
 
+	if (bl_acme_acquisition_start(sdi) != SR_OK) {
+		dev_acquisition_close(sdi);
+		std_session_send_df_end(sdi);
+		return SR_ERR;
+	}
+
 	return SR_OK;
 }
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	uint64_t samples_missed;
 
 	devc = sdi->priv;
 
+	bl_acme_acquisition_stop(sdi);
 	dev_acquisition_close(sdi);
-	sr_session_source_remove_channel(sdi->session, devc->channel);
-	g_io_channel_shutdown(devc->channel, FALSE, NULL);
-	g_io_channel_unref(devc->channel);
-	devc->channel = NULL;
 
 	std_session_send_df_end(sdi);
 
-	if (devc->samples_missed > 0)
-		sr_warn("%" PRIu64 " samples missed", devc->samples_missed);
+	samples_missed = bl_acme_get_samples_missed(devc);
+	if (samples_missed > 0)
+		sr_warn("%" PRIu64 " samples missed", samples_missed);
 
 	return SR_OK;
 }
@@ -340,7 +351,7 @@ static struct sr_dev_driver baylibre_acme_driver_info = {
 	.cleanup = std_cleanup,
 	.scan = scan,
 	.dev_list = std_dev_list,
-	.dev_clear = std_dev_clear,
+	.dev_clear = dev_clear,
 	.config_get = config_get,
 	.config_set = config_set,
 	.config_list = config_list,
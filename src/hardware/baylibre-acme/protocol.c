@@ -23,7 +23,10 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <time.h>
 #include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <glib/gstdio.h>
 #include "protocol.h"
 #include "gpio.h"
@@ -31,6 +34,12 @@
 #define ACME_REV_A		1
 #define ACME_REV_B		2
 
+/*
+ * Frames which the main loop has not picked up yet. Beyond this, the
+ * acquisition thread drops frames and counts them as missed samples.
+ */
+#define MAX_QUEUED_FRAMES	1024
+
 enum channel_type {
 	ENRG_PWR = 1,
 	ENRG_CURR,
@@ -40,6 +49,7 @@ enum channel_type {
 };
 
 struct channel_group_priv {
+	const char *sysfs_root;
 	uint8_t rev;
 	int hwmon_num;
 	int probe_type;
@@ -52,10 +62,24 @@ struct channel_priv {
 	int ch_type;
 	int fd;
 	int digits;
-	float val;
 	struct channel_group_priv *probe;
 };
 
+/* An enabled channel, as the acquisition thread reads it. */
+struct acme_reader {
+	struct sr_channel *ch;
+	int fd;
+	int hwmon_num;
+	int digits;
+	gboolean failed;
+};
+
+/* The readings of all enabled channels on one timer tick. */
+struct acme_frame {
+	int64_t timestamp;
+	float values[];
+};
+
 #define EEPROM_SERIAL_SIZE		16
 #define EEPROM_TAG_SIZE			32
 
@@ -114,48 +138,54 @@ SR_PRIV uint8_t bl_acme_get_temp_addr(int index)
 	return temp_i2c_addrs[index];
 }
 
-SR_PRIV gboolean bl_acme_is_sane(void)
+SR_PRIV gboolean bl_acme_is_sane(const char *sysfs_root)
 {
 	gboolean status;
 
 	/*
-	 * We expect sysfs to be present and mounted at /sys, ina226 and
-	 * tmp435 sensors detected by the system and their appropriate
-	 * drivers loaded and functional.
+	 * We expect sysfs to be present and mounted at /sys (or the
+	 * root the user specified), ina226 and tmp435 sensors detected
+	 * by the system and their appropriate drivers loaded and
+	 * functional.
 	 */
-	status = g_file_test("/sys", G_FILE_TEST_IS_DIR);
+	status = g_file_test(sysfs_root, G_FILE_TEST_IS_DIR);
 	if (!status) {
-		sr_err("/sys/ directory not found - sysfs not mounted?");
+		sr_err("%s/ directory not found - sysfs not mounted?",
+		       sysfs_root);
 		return FALSE;
 	}
 
 	return TRUE;
 }
 
-static void probe_name_path(unsigned int addr, GString *path)
+static void probe_name_path(const char *sysfs_root, unsigned int addr,
+			    GString *path)
 {
-	g_string_printf(path,
-			"/sys/class/i2c-adapter/i2c-1/1-00%02x/name", addr);
+	g_string_printf(path, "%s/class/i2c-adapter/i2c-1/1-00%02x/name",
+			sysfs_root, addr);
 }
 
 /*
  * For given address fill buf with the path to appropriate hwmon entry.
  */
-static void probe_hwmon_path(unsigned int addr, GString *path)
+static void probe_hwmon_path(const char *sysfs_root, unsigned int addr,
+			     GString *path)
 {
-	g_string_printf(path,
-			"/sys/class/i2c-adapter/i2c-1/1-00%02x/hwmon", addr);
+	g_string_printf(path, "%s/class/i2c-adapter/i2c-1/1-00%02x/hwmon",
+			sysfs_root, addr);
 }
 
-static void probe_eeprom_path(unsigned int addr, GString *path)
+static void probe_eeprom_path(const char *sysfs_root, unsigned int addr,
+			      GString *path)
 {
 	g_string_printf(path,
-			"/sys/class/i2c-dev/i2c-1/device/1-00%02x/eeprom",
-			addr + 0x10);
+			"%s/class/i2c-dev/i2c-1/device/1-00%02x/eeprom",
+			sysfs_root, addr + 0x10);
 }
 
-SR_PRIV gboolean bl_acme_detect_probe(unsigned int addr,
-				      int prb_num, const char *prb_name)
+SR_PRIV gboolean bl_acme_detect_probe(const char *sysfs_root,
+				      unsigned int addr, int prb_num,
+				      const char *prb_name)
 {
 	gboolean ret = FALSE, status;
 	char *buf = NULL;
@@ -163,7 +193,7 @@ SR_PRIV gboolean bl_acme_detect_probe(unsigned int addr,
 	GError *err = NULL;
 	gsize size;
 
-	probe_name_path(addr, path);
+	probe_name_path(sysfs_root, addr, path);
 	status = g_file_get_contents(path->str, &buf, &size, &err);
 	if (!status) {
 		/* Don't log "No such file or directory" messages. */
@@ -180,7 +210,7 @@ SR_PRIV gboolean bl_acme_detect_probe(unsigned int addr,
 		 * Correct driver registered on this address - but is
 		 * there an actual probe connected?
 		 */
-		probe_hwmon_path(addr, path);
+		probe_hwmon_path(sysfs_root, addr, path);
 		status = g_file_test(path->str, G_FILE_TEST_IS_DIR);
 		if (status) {
 			/* We have found an ACME probe. */
@@ -194,14 +224,14 @@ SR_PRIV gboolean bl_acme_detect_probe(unsigned int addr,
 	return ret;
 }
 
-static int get_hwmon_index(unsigned int addr)
+static int get_hwmon_index(const char *sysfs_root, unsigned int addr)
 {
 	int status, hwmon;
 	GString *path = g_string_sized_new(64);
 	GError *err = NULL;
 	GDir *dir;
 
-	probe_hwmon_path(addr, path);
+	probe_hwmon_path(sysfs_root, addr, path);
 	dir = g_dir_open(path->str, 0, &err);
 	if (!dir) {
 		sr_err("Error opening %s: %s", path->str, err->message);
@@ -269,14 +299,15 @@ static void append_channel(struct sr_dev_inst *sdi, struct sr_channel_group *cg,
 	cg->channels = g_slist_append(cg->channels, ch);
 }
 
-static int read_probe_eeprom(unsigned int addr, struct probe_eeprom *eeprom)
+static int read_probe_eeprom(const char *sysfs_root, unsigned int addr,
+			     struct probe_eeprom *eeprom)
 {
 	GString *path = g_string_sized_new(64);
 	char eeprom_buf[EEPROM_SIZE];
 	ssize_t rd;
 	int fd;
 
-	probe_eeprom_path(addr, path);
+	probe_eeprom_path(sysfs_root, addr, path);
 	fd = g_open(path->str, O_RDONLY);
 	g_string_free(path, TRUE);
 	if (fd < 0)
@@ -321,18 +352,22 @@ static int revB_addr_to_num(unsigned int addr)
 SR_PRIV gboolean bl_acme_register_probe(struct sr_dev_inst *sdi, int type,
 					unsigned int addr, int prb_num)
 {
+	struct dev_context *devc;
 	struct sr_channel_group *cg;
 	struct channel_group_priv *cgp;
 	struct probe_eeprom eeprom;
 	int hwmon, status;
 	uint32_t gpio;
 
+	devc = sdi->priv;
+
 	/* Obtain the hwmon index. */
-	hwmon = get_hwmon_index(addr);
+	hwmon = get_hwmon_index(devc->sysfs_root, addr);
 	if (hwmon < 0)
 		return FALSE;
 
 	cgp = g_malloc0(sizeof(struct channel_group_priv));
+	cgp->sysfs_root = devc->sysfs_root;
 	cg = sr_channel_group_new(sdi, NULL, cgp);
 
 	/*
@@ -340,7 +375,7 @@ SR_PRIV gboolean bl_acme_register_probe(struct sr_dev_inst *sdi, int type,
 	 * a revision A probe.
 	 */
 	memset(&eeprom, 0, sizeof(struct probe_eeprom));
-	status = read_probe_eeprom(addr, &eeprom);
+	status = read_probe_eeprom(devc->sysfs_root, addr, &eeprom);
 	cgp->rev = status < 0 ? ACME_REV_A : ACME_REV_B;
 
 	prb_num = cgp->rev == ACME_REV_A ? prb_num : revB_addr_to_num(addr);
@@ -414,8 +449,8 @@ static int get_shunt_path(const struct sr_channel_group *cg, GString *path)
 	}
 
 	g_string_append_printf(path,
-			       "/sys/class/hwmon/hwmon%d/shunt_resistor",
-			       cgp->hwmon_num);
+			       "%s/class/hwmon/hwmon%d/shunt_resistor",
+			       cgp->sysfs_root, cgp->hwmon_num);
 
 	/*
 	 * The shunt_resistor sysfs attribute is available
@@ -439,20 +474,23 @@ static int get_shunt_path(const struct sr_channel_group *cg, GString *path)
 SR_PRIV void bl_acme_maybe_set_update_interval(const struct sr_dev_inst *sdi,
 					       uint64_t samplerate)
 {
+	struct dev_context *devc;
 	struct sr_channel_group *cg;
 	struct channel_group_priv *cgp;
 	GString *hwmon;
 	GSList *l;
 	FILE *fd;
 
+	devc = sdi->priv;
+
 	for (l = sdi->channel_groups; l != NULL; l = l->next) {
 		cg = l->data;
 		cgp = cg->priv;
 
 		hwmon = g_string_sized_new(64);
 		g_string_append_printf(hwmon,
-				"/sys/class/hwmon/hwmon%d/update_interval",
-				cgp->hwmon_num);
+				"%s/class/hwmon/hwmon%d/update_interval",
+				devc->sysfs_root, cgp->hwmon_num);
 
 		if (g_file_test(hwmon->str, G_FILE_TEST_EXISTS)) {
 			fd = g_fopen(hwmon->str, "w");
@@ -629,34 +667,10 @@ static int type_digits(int type)
 	}
 }
 
-static float read_sample(struct sr_channel *ch)
-{
-	struct channel_priv *chp;
-	char buf[16];
-	ssize_t len;
-	int fd;
-
-	chp = ch->priv;
-	fd = chp->fd;
-
-	lseek(fd, 0, SEEK_SET);
-
-	len = read(fd, buf, sizeof(buf));
-	if (len < 0) {
-		sr_err("Error reading from channel %s (hwmon: %d): %s",
-			ch->name, chp->probe->hwmon_num, g_strerror(errno));
-		ch->enabled = FALSE;
-		return -1.0;
-	}
-
-	chp->digits = type_digits(chp->ch_type);
-	return strtol(buf, NULL, 10) * powf(10, -chp->digits);
-}
-
 SR_PRIV int bl_acme_open_channel(struct sr_channel *ch)
 {
 	struct channel_priv *chp;
-	char path[64];
+	char *path;
 	const char *file;
 	int fd;
 
@@ -673,17 +687,21 @@ SR_PRIV int bl_acme_open_channel(struct sr_channel *ch)
 		return SR_ERR;
 	}
 
-	snprintf(path, sizeof(path), "/sys/class/hwmon/hwmon%d/%s",
-		 chp->probe->hwmon_num, file);
+	path = g_strdup_printf("%s/class/hwmon/hwmon%d/%s",
+			       chp->probe->sysfs_root, chp->probe->hwmon_num,
+			       file);
 
 	fd = open(path, O_RDONLY);
 	if (fd < 0) {
 		sr_err("Error opening %s: %s", path, g_strerror(errno));
+		g_free(path);
 		ch->enabled = FALSE;
 		return SR_ERR;
 	}
+	g_free(path);
 
 	chp->fd = fd;
+	chp->digits = type_digits(chp->ch_type);
 
 	return 0;
 }
@@ -697,102 +715,313 @@ SR_PRIV void bl_acme_close_channel(struct sr_channel *ch)
 	chp->fd = -1;
 }
 
-SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
+static float read_value(struct acme_reader *reader)
+{
+	char buf[16];
+	ssize_t len;
+
+	if (reader->failed)
+		return NAN;
+
+	/* hwmon attributes are reread from the start, no seek needed. */
+	len = pread(reader->fd, buf, sizeof(buf) - 1, 0);
+	if (len < 0) {
+		sr_err("Error reading from channel %s (hwmon: %d): %s",
+			reader->ch->name, reader->hwmon_num, g_strerror(errno));
+		reader->failed = TRUE;
+		return NAN;
+	}
+	buf[len] = '\0';
+
+	return strtol(buf, NULL, 10) * powf(10, -reader->digits);
+}
+
+static struct acme_frame *read_frame(struct dev_context *devc)
+{
+	struct acme_frame *frame;
+	size_t i;
+
+	frame = g_malloc(sizeof(*frame) +
+			 devc->num_readers * sizeof(frame->values[0]));
+	frame->timestamp = g_get_real_time();
+	for (i = 0; i < devc->num_readers; i++)
+		frame->values[i] = read_value(&devc->readers[i]);
+
+	return frame;
+}
+
+static void add_samples_missed(struct dev_context *devc, uint64_t count)
+{
+	g_mutex_lock(&devc->stats_mutex);
+	devc->samples_missed += count;
+	g_mutex_unlock(&devc->stats_mutex);
+}
+
+SR_PRIV uint64_t bl_acme_get_samples_missed(struct dev_context *devc)
+{
+	uint64_t count;
+
+	g_mutex_lock(&devc->stats_mutex);
+	count = devc->samples_missed;
+	g_mutex_unlock(&devc->stats_mutex);
+
+	return count;
+}
+
+/*
+ * Read all enabled channels on each timer tick, so that the readings'
+ * timing does not depend on how busy the session's main loop is.
+ */
+static gpointer acquisition_thread(gpointer data)
 {
-	uint64_t nrexpiration;
+	struct dev_context *devc;
+	struct acme_frame *frame;
+	uint64_t expirations, missed, one;
+	ssize_t len;
+
+	devc = data;
+	one = 1;
+
+	while (!g_atomic_int_get(&devc->acq_stop)) {
+		len = read(devc->timer_fd, &expirations, sizeof(expirations));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len != sizeof(expirations)) {
+			sr_err("Failed to read timer information.");
+			break;
+		}
+		if (g_atomic_int_get(&devc->acq_stop))
+			break;
+
+		/* We were not able to read on the previous ticks. */
+		missed = expirations - 1;
+
+		if (g_async_queue_length(devc->frames) >= MAX_QUEUED_FRAMES) {
+			missed++;
+		} else {
+			frame = read_frame(devc);
+			g_async_queue_push(devc->frames, frame);
+			if (write(devc->event_fd, &one, sizeof(one)) < 0)
+				sr_warn("Failed to signal new samples.");
+		}
+
+		if (missed)
+			add_samples_missed(devc, missed);
+	}
+
+	return NULL;
+}
+
+static void send_frame(const struct sr_dev_inst *sdi, struct acme_frame *frame)
+{
+	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog analog;
+	struct sr_datafeed_analog_timed timed;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct sr_dev_inst *sdi;
+	struct acme_reader *reader;
+	GSList chonly;
+	size_t i;
+
+	devc = sdi->priv;
+
+	packet.type = SR_DF_ANALOG_TIMED;
+	packet.payload = &timed;
+	sr_analog_init(&timed.analog, &encoding, &meaning, &spec, 0);
+	timed.timestamps = &frame->timestamp;
+
+	std_session_send_df_frame_begin(sdi);
+
+	/*
+	 * Due to different units used in each channel we're sending
+	 * samples one-by-one.
+	 */
+	for (i = 0; i < devc->num_readers; i++) {
+		reader = &devc->readers[i];
+		if (!reader->ch->enabled)
+			continue;
+		if (isnan(frame->values[i])) {
+			reader->ch->enabled = FALSE;
+			continue;
+		}
+		chonly.next = NULL;
+		chonly.data = reader->ch;
+		timed.analog.num_samples = 1;
+		timed.analog.meaning->channels = &chonly;
+		timed.analog.meaning->mq = channel_to_mq(reader->ch);
+		timed.analog.meaning->unit = channel_to_unit(reader->ch);
+		timed.analog.encoding->digits = reader->digits;
+		timed.analog.spec->spec_digits = reader->digits;
+		timed.analog.data = &frame->values[i];
+		sr_session_send(sdi, &packet);
+	}
+
+	std_session_send_df_frame_end(sdi);
+}
+
+/*
+ * Start the acquisition thread. The enabled channels must have been
+ * opened with bl_acme_open_channel() before.
+ */
+SR_PRIV int bl_acme_acquisition_start(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
 	struct sr_channel *ch;
 	struct channel_priv *chp;
-	struct dev_context *devc;
-	GSList *chl, chonly;
-	unsigned i;
+	struct acme_reader *reader;
+	struct itimerspec tspec;
+	GError *error;
+	GSList *chl;
 
-	(void)fd;
-	(void)revents;
+	devc = sdi->priv;
 
-	sdi = cb_data;
-	if (!sdi)
-		return TRUE;
+	devc->readers = g_malloc0(g_slist_length(sdi->channels) *
+				  sizeof(devc->readers[0]));
+	devc->num_readers = 0;
+	for (chl = sdi->channels; chl; chl = chl->next) {
+		ch = chl->data;
+		chp = ch->priv;
+		if (!ch->enabled)
+			continue;
+		reader = &devc->readers[devc->num_readers++];
+		reader->ch = ch;
+		reader->fd = chp->fd;
+		reader->hwmon_num = chp->probe->hwmon_num;
+		reader->digits = chp->digits;
+	}
 
-	devc = sdi->priv;
-	if (!devc)
-		return TRUE;
+	g_mutex_lock(&devc->stats_mutex);
+	devc->samples_missed = 0;
+	g_mutex_unlock(&devc->stats_mutex);
+	g_atomic_int_set(&devc->acq_stop, 0);
+	devc->frames = g_async_queue_new_full(g_free);
+	devc->event_fd = -1;
+
+	devc->timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (devc->timer_fd < 0) {
+		sr_err("Error creating timer fd");
+		goto err_out;
+	}
 
-	packet.type = SR_DF_ANALOG;
-	packet.payload = &analog;
-	sr_analog_init(&analog, &encoding, &meaning, &spec, 0);
+	devc->event_fd = eventfd(0, EFD_NONBLOCK);
+	if (devc->event_fd < 0) {
+		sr_err("Error creating event fd");
+		goto err_out;
+	}
 
-	if (read(devc->timer_fd, &nrexpiration, sizeof(nrexpiration)) < 0) {
-		sr_warn("Failed to read timer information");
-		return TRUE;
+	tspec.it_interval.tv_sec = SR_HZ_TO_NS(devc->samplerate) / 1000000000;
+	tspec.it_interval.tv_nsec = SR_HZ_TO_NS(devc->samplerate) % 1000000000;
+	tspec.it_value = tspec.it_interval;
+
+	if (timerfd_settime(devc->timer_fd, 0, &tspec, NULL)) {
+		sr_err("Failed to set timer");
+		goto err_out;
 	}
 
-	/*
-	 * We were not able to process the previous timer expiration, we are
-	 * overloaded.
-	 */
-	if (nrexpiration > 1)
-		devc->samples_missed += nrexpiration - 1;
+	devc->channel = g_io_channel_unix_new(devc->event_fd);
+	g_io_channel_set_flags(devc->channel, G_IO_FLAG_NONBLOCK, NULL);
+	g_io_channel_set_encoding(devc->channel, NULL, NULL);
+	g_io_channel_set_buffered(devc->channel, FALSE);
+
+	sr_session_source_add_channel(sdi->session, devc->channel,
+		G_IO_IN | G_IO_ERR, 1000, bl_acme_receive_data, (void *)sdi);
+
+	error = NULL;
+	devc->acq_thread = g_thread_try_new("baylibre-acme",
+		acquisition_thread, devc, &error);
+	if (!devc->acq_thread) {
+		sr_err("Cannot create acquisition thread: %s.",
+			error->message);
+		g_error_free(error);
+		bl_acme_acquisition_stop(sdi);
+		return SR_ERR;
+	}
 
-	/*
-	 * XXX This is a nasty workaround...
-	 *
-	 * At high sampling rates and maximum channels we are not able to
-	 * acquire samples fast enough, even though frontends still think
-	 * that samples arrive on time. This causes shifts in frontend
-	 * plots.
-	 *
-	 * To compensate for the delay we check if any clock events were
-	 * missed and - if so - don't really read the next value, but send
-	 * the same sample as fast as possible. We do it until we are back
-	 * on schedule.
-	 *
-	 * At high sampling rate this doesn't seem to visibly reduce the
-	 * accuracy.
-	 */
-	for (i = 0; i < nrexpiration; i++) {
-		std_session_send_df_frame_begin(sdi);
+	return SR_OK;
 
-		/*
-		 * Due to different units used in each channel we're sending
-		 * samples one-by-one.
-		 */
-		for (chl = sdi->channels; chl; chl = chl->next) {
-			ch = chl->data;
-			chp = ch->priv;
+err_out:
+	bl_acme_acquisition_stop(sdi);
 
-			if (!ch->enabled)
-				continue;
-			chonly.next = NULL;
-			chonly.data = ch;
-			analog.num_samples = 1;
-			analog.meaning->channels = &chonly;
-			analog.meaning->mq = channel_to_mq(chl->data);
-			analog.meaning->unit = channel_to_unit(ch);
-
-			if (i < 1)
-				chp->val = read_sample(ch);
-
-			analog.encoding->digits  = chp->digits;
-			analog.spec->spec_digits = chp->digits;
-			analog.data = &chp->val;
-			sr_session_send(sdi, &packet);
-		}
+	return SR_ERR;
+}
+
+/* Stop the acquisition thread, discard the frames which it has queued. */
+SR_PRIV void bl_acme_acquisition_stop(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct itimerspec tspec;
+
+	devc = sdi->priv;
+
+	if (devc->acq_thread) {
+		/* Have the timer expire right away, to wake the thread. */
+		g_atomic_int_set(&devc->acq_stop, 1);
+		tspec.it_interval.tv_sec = 0;
+		tspec.it_interval.tv_nsec = 0;
+		tspec.it_value.tv_sec = 0;
+		tspec.it_value.tv_nsec = 1;
+		timerfd_settime(devc->timer_fd, 0, &tspec, NULL);
+		g_thread_join(devc->acq_thread);
+		devc->acq_thread = NULL;
+	}
 
-		std_session_send_df_frame_end(sdi);
+	if (devc->channel) {
+		sr_session_source_remove_channel(sdi->session, devc->channel);
+		g_io_channel_shutdown(devc->channel, FALSE, NULL);
+		g_io_channel_unref(devc->channel);
+		devc->channel = NULL;
 	}
 
-	sr_sw_limits_update_samples_read(&devc->limits, 1);
+	if (devc->event_fd >= 0)
+		close(devc->event_fd);
+	devc->event_fd = -1;
+	if (devc->timer_fd >= 0)
+		close(devc->timer_fd);
+	devc->timer_fd = -1;
 
-	if (sr_sw_limits_check(&devc->limits)) {
-		sr_dev_acquisition_stop(sdi);
+	if (devc->frames)
+		g_async_queue_unref(devc->frames);
+	devc->frames = NULL;
+
+	g_free(devc->readers);
+	devc->readers = NULL;
+	devc->num_readers = 0;
+}
+
+SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct acme_frame *frame;
+	uint64_t count;
+
+	(void)fd;
+	(void)revents;
+
+	sdi = cb_data;
+	if (!sdi)
 		return TRUE;
+
+	devc = sdi->priv;
+	if (!devc || !devc->frames)
+		return TRUE;
+
+	/* Reset the event counter, the queue tells how much there is. */
+	if (read(devc->event_fd, &count, sizeof(count)) < 0 &&
+	    errno != EAGAIN)
+		sr_warn("Failed to read event information");
+
+	while (!sr_sw_limits_check(&devc->limits)) {
+		frame = g_async_queue_try_pop(devc->frames);
+		if (!frame)
+			return TRUE;
+		send_frame(sdi, frame);
+		g_free(frame);
+		sr_sw_limits_update_samples_read(&devc->limits, 1);
 	}
 
+	sr_dev_acquisition_stop(sdi);
+
 	return TRUE;
 }
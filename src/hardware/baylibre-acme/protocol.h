@@ -44,28 +44,48 @@
 /* For the user we number the probes starting from 1. */
 #define PROBE_NUM(n) ((n) + 1)
 
+/* Where sysfs is mounted, unless the conn= scan option says otherwise. */
+#define DEFAULT_SYSFS_ROOT	"/sys"
+
 enum probe_type {
 	PROBE_ENRG = 1,
 	PROBE_TEMP,
 };
 
+struct acme_reader;
+
 struct dev_context {
 	uint64_t samplerate;
 	struct sr_sw_limits limits;
+	char *sysfs_root;
 
 	uint32_t num_channels;
+	GMutex stats_mutex;
 	uint64_t samples_missed;
+
+	/*
+	 * The acquisition thread reads all enabled channels on each timer
+	 * tick. It queues the frames, and signals the event fd which has
+	 * the session's main loop pick them up.
+	 */
+	GThread *acq_thread;
+	gint acq_stop;
 	int timer_fd;
+	int event_fd;
 	GIOChannel *channel;
+	GAsyncQueue *frames;
+	struct acme_reader *readers;
+	size_t num_readers;
 };
 
 SR_PRIV uint8_t bl_acme_get_enrg_addr(int index);
 SR_PRIV uint8_t bl_acme_get_temp_addr(int index);
 
-SR_PRIV gboolean bl_acme_is_sane(void);
+SR_PRIV gboolean bl_acme_is_sane(const char *sysfs_root);
 
-SR_PRIV gboolean bl_acme_detect_probe(unsigned int addr,
-				      int prb_num, const char *prb_name);
+SR_PRIV gboolean bl_acme_detect_probe(const char *sysfs_root,
+				      unsigned int addr, int prb_num,
+				      const char *prb_name);
 SR_PRIV gboolean bl_acme_register_probe(struct sr_dev_inst *sdi, int type,
 					unsigned int addr, int prb_num);
 
@@ -84,6 +104,11 @@ SR_PRIV int bl_acme_read_power_state(const struct sr_channel_group *cg,
 SR_PRIV int bl_acme_set_power_off(const struct sr_channel_group *cg,
 				  gboolean off);
 
+SR_PRIV uint64_t bl_acme_get_samples_missed(struct dev_context *devc);
+
+SR_PRIV int bl_acme_acquisition_start(const struct sr_dev_inst *sdi);
+SR_PRIV void bl_acme_acquisition_stop(const struct sr_dev_inst *sdi);
+
 SR_PRIV int bl_acme_receive_data(int fd, int revents, void *cb_data);
 
 SR_PRIV int bl_acme_open_channel(struct sr_channel *ch);
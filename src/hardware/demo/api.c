@@ -47,6 +47,11 @@ static const char *logic_pattern_str[] = {
 	"graycode",
 };
 
+static const char *test_mode_str[] = {
+	"off",
+	"max-throughput",
+};
+
 static const uint32_t scanopts[] = {
 	SR_CONF_NUM_LOGIC_CHANNELS,
 	SR_CONF_NUM_ANALOG_CHANNELS,
@@ -69,6 +74,9 @@ static const uint32_t devopts[] = {
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TEST_MODE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+	SR_CONF_BUFFERSIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_THROUGHPUT | SR_CONF_GET,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -147,6 +155,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc->num_analog_channels = num_analog_channels;
 	devc->limit_frames = limit_frames;
 	devc->capture_ratio = 20;
+	devc->packet_size = DEFAULT_PACKET_SIZE;
 	devc->stl = NULL;
 
 	if (num_logic_channels > 0) {
@@ -220,6 +229,7 @@ static void clear_helper(struct dev_context *devc)
 	void *value;
 
 	demo_free_analog_pattern(devc);
+	g_free(devc->packet_data);
 
 	/* Analog generators. */
 	g_hash_table_iter_init(&iter, devc->ch_ag);
@@ -259,6 +269,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_FRAMES:
 		*data = g_variant_new_uint64(devc->limit_frames);
 		break;
+	case SR_CONF_THROUGHPUT:
+		*data = g_variant_new_uint64(devc->throughput);
+		break;
 	case SR_CONF_AVERAGING:
 		*data = g_variant_new_boolean(devc->avg);
 		break;
@@ -315,6 +328,12 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_TEST_MODE:
+		*data = g_variant_new_string(test_mode_str[devc->max_throughput]);
+		break;
+	case SR_CONF_BUFFERSIZE:
+		*data = g_variant_new_uint64(devc->packet_size);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -330,7 +349,8 @@ static int config_set(uint32_t key, GVariant *data,
 	struct sr_channel *ch;
 	GVariant *mq_tuple_child;
 	GSList *l;
-	int logic_pattern, analog_pattern;
+	int logic_pattern, analog_pattern, idx;
+	uint64_t size;
 
 	devc = sdi->priv;
 
@@ -428,6 +448,17 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_TEST_MODE:
+		if ((idx = std_str_idx(data, ARRAY_AND_SIZE(test_mode_str))) < 0)
+			return SR_ERR_ARG;
+		devc->max_throughput = idx == 1;
+		break;
+	case SR_CONF_BUFFERSIZE:
+		size = g_variant_get_uint64(data);
+		if (!size || size > MAX_PACKET_SIZE)
+			return SR_ERR_ARG;
+		devc->packet_size = size;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -451,6 +482,9 @@ static int config_list(uint32_t key, GVariant **data,
 		case SR_CONF_TRIGGER_MATCH:
 			*data = std_gvar_array_i32(ARRAY_AND_SIZE(trigger_matches));
 			break;
+		case SR_CONF_TEST_MODE:
+			*data = g_variant_new_strv(ARRAY_AND_SIZE(test_mode_str));
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -494,13 +528,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	struct dev_context *devc;
 	GSList *l;
 	struct sr_channel *ch;
-	int bitpos;
+	int bitpos, ret;
 	uint8_t mask;
 	struct sr_trigger *trigger;
 
 	devc = sdi->priv;
 	devc->sent_samples = 0;
 	devc->sent_frame_samples = 0;
+	devc->sent_bytes = 0;
 
 	/* Setup triggers */
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
@@ -561,7 +596,25 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->first_partial_logic_index,
 		devc->first_partial_logic_mask);
 
-	sr_session_source_add(sdi->session, -1, 0, 100,
+	devc->step = 0;
+	devc->throughput = 0;
+	if (devc->max_throughput) {
+		ret = demo_generate_packet_data((struct sr_dev_inst *)sdi);
+		if (ret != SR_OK) {
+			if (devc->stl) {
+				soft_trigger_logic_free(devc->stl);
+				devc->stl = NULL;
+			}
+			return ret;
+		}
+	}
+
+	/*
+	 * In the max-throughput test mode, have the callback run again
+	 * as soon as the main loop is idle.
+	 */
+	sr_session_source_add(sdi->session, -1, 0,
+			devc->max_throughput ? 0 : 100,
 			demo_prepare_data, (struct sr_dev_inst *)sdi);
 
 	std_session_send_df_header(sdi);
@@ -569,10 +622,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	if (devc->limit_frames > 0)
 		std_session_send_df_frame_begin(sdi);
 
+	devc->batch = sr_analog_batch_new(sdi);
+
 	/* We use this timestamp to decide how many more samples to send. */
 	devc->start_us = g_get_monotonic_time();
 	devc->spent_us = 0;
-	devc->step = 0;
 
 	return SR_OK;
 }
@@ -580,13 +634,32 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	double elapsed;
 
 	sr_session_source_remove(sdi->session, -1);
 
 	devc = sdi->priv;
+	sr_analog_batch_flush(devc->batch);
+	sr_analog_batch_free(devc->batch);
+	devc->batch = NULL;
 	if (devc->limit_frames > 0)
 		std_session_send_df_frame_end(sdi);
 
+	if (devc->max_throughput) {
+		elapsed = (g_get_monotonic_time() - devc->start_us) / 1e6;
+		if (elapsed > 0)
+			devc->throughput = devc->sent_samples / elapsed;
+		sr_info("Sent %" PRIu64 " samples (%" PRIu64 " bytes) in %.3f s, "
+			"%" PRIu64 " samples/s, %.0f bytes/s.",
+			devc->sent_samples, devc->sent_bytes, elapsed,
+			devc->throughput,
+			elapsed > 0 ? devc->sent_bytes / elapsed : 0.0);
+		sr_session_send_meta(sdi, SR_CONF_THROUGHPUT,
+			g_variant_new_uint64(devc->throughput));
+		g_free(devc->packet_data);
+		devc->packet_data = NULL;
+	}
+
 	std_session_send_df_end(sdi);
 
 	if (devc->stl) {
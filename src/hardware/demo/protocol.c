@@ -399,6 +399,54 @@ static void logic_fixup_feed(struct dev_context *devc,
 	}
 }
 
+/*
+ * Pregenerate one packet of logic data for the max-throughput test mode.
+ * All packets carry the same data, which saves the pattern generation
+ * and the disabled channels' fixup for each of them.
+ */
+SR_PRIV int demo_generate_packet_data(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_logic logic;
+	uint8_t *data;
+	uint64_t size, chunk, len, off;
+
+	devc = sdi->priv;
+	g_free(devc->packet_data);
+	devc->packet_data = NULL;
+
+	if (!devc->logic_unitsize) {
+		devc->packet_samples = MAX(devc->packet_size / sizeof(float), 1);
+		return SR_OK;
+	}
+	devc->packet_samples = MAX(devc->packet_size / devc->logic_unitsize, 1);
+	if (!devc->enabled_logic_channels)
+		return SR_OK;
+
+	size = devc->packet_samples * devc->logic_unitsize;
+	data = g_try_malloc(size);
+	if (!data) {
+		sr_err("Cannot allocate %" PRIu64 " bytes packet data.", size);
+		return SR_ERR_MALLOC;
+	}
+	chunk = LOGIC_BUFSIZE / devc->logic_unitsize * devc->logic_unitsize;
+	for (off = 0; off < size; off += len) {
+		len = MIN(chunk, size - off);
+		logic_generator(sdi, len);
+		memcpy(data + off, devc->logic_data, len);
+	}
+	logic.length = size;
+	logic.unitsize = devc->logic_unitsize;
+	logic.data = data;
+	logic_fixup_feed(devc, &logic);
+	devc->packet_data = data;
+
+	sr_dbg("Pregenerated %" PRIu64 " samples of logic data.",
+		devc->packet_samples);
+
+	return SR_OK;
+}
+
 static void send_analog_packet(struct analog_gen *ag,
 		struct sr_dev_inst *sdi, uint64_t *analog_sent,
 		uint64_t analog_pos, uint64_t analog_todo)
@@ -525,6 +573,7 @@ static void send_analog_packet(struct analog_gen *ag,
 		}
 		ag->packet.num_samples = sending_now;
 		sr_session_send(sdi, &packet);
+		devc->sent_bytes += sending_now * sizeof(float);
 
 		/* Whichever channel group gets there first. */
 		*analog_sent = MAX(*analog_sent, sending_now);
@@ -564,7 +613,8 @@ do_send:
 		ag->packet.data = &ag->avg_val;
 		ag->packet.num_samples = 1;
 
-		sr_session_send(sdi, &packet);
+		sr_analog_batch_submit(devc->batch, &ag->packet);
+		devc->sent_bytes += sizeof(float);
 		*analog_sent = ag->num_avgs;
 
 		ag->num_avgs = 0;
@@ -582,6 +632,7 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	struct analog_gen *ag;
 	GHashTableIter iter;
 	void *value;
+	uint8_t *logic_data;
 	uint64_t samples_todo, logic_done, analog_done, analog_sent, sending_now;
 	int64_t elapsed_us, limit_us, todo_us;
 	int64_t trigger_offset;
@@ -593,6 +644,8 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	sdi = cb_data;
 	devc = sdi->priv;
 
+	sr_analog_batch_poll(devc->batch);
+
 	/* Just in case. */
 	if (devc->cur_samplerate <= 0
 			|| (devc->num_logic_channels <= 0
@@ -610,8 +663,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		todo_us = MAX(0, elapsed_us - devc->spent_us);
 
 	/* How many samples are outstanding since the last round? */
-	samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
-			/ G_USEC_PER_SEC;
+	if (devc->max_throughput)
+		samples_todo = devc->packet_samples;
+	else
+		samples_todo = (todo_us * devc->cur_samplerate
+				+ G_USEC_PER_SEC - 1) / G_USEC_PER_SEC;
 
 	if (devc->limit_samples > 0) {
 		if (devc->limit_samples < devc->sent_samples)
@@ -648,13 +704,20 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	while (logic_done < samples_todo || analog_done < samples_todo) {
 		/* Logic */
 		if (logic_done < samples_todo) {
-			sending_now = MIN(samples_todo - logic_done,
-					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
+			if (devc->packet_data) {
+				sending_now = MIN(samples_todo - logic_done,
+						devc->packet_samples);
+				logic_data = devc->packet_data;
+			} else {
+				sending_now = MIN(samples_todo - logic_done,
+						LOGIC_BUFSIZE / devc->logic_unitsize);
+				logic_generator(sdi, sending_now * devc->logic_unitsize);
+				logic_data = devc->logic_data;
+			}
 			/* Check for trigger and send pre-trigger data if needed */
 			if (devc->stl && (!devc->trigger_fired)) {
 				trigger_offset = soft_trigger_logic_check(devc->stl,
-						devc->logic_data, sending_now * devc->logic_unitsize,
+						logic_data, sending_now * devc->logic_unitsize,
 						&pre_trigger_samples);
 				if (trigger_offset > -1) {
 					devc->trigger_fired = TRUE;
@@ -672,9 +735,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 				if (devc->trigger_fired && (trigger_offset < (int)sending_now)) {
 					/* Send after-trigger data */
 					logic.length = (sending_now - trigger_offset) * devc->logic_unitsize;
-					logic.data = devc->logic_data + trigger_offset * devc->logic_unitsize;
-					logic_fixup_feed(devc, &logic);
+					logic.data = logic_data + trigger_offset * devc->logic_unitsize;
+					if (!devc->packet_data)
+						logic_fixup_feed(devc, &logic);
 					sr_session_send(sdi, &packet);
+					devc->sent_bytes += logic.length;
 					logic_done += sending_now - trigger_offset;
 					/* End acquisition */
 					sr_dbg("Triggered, stopping acquisition.");
@@ -687,9 +752,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			} else if (!devc->stl) {
 				/* No trigger defined, send logic samples */
 				logic.length = sending_now * devc->logic_unitsize;
-				logic.data = devc->logic_data;
-				logic_fixup_feed(devc, &logic);
+				logic.data = logic_data;
+				if (!devc->packet_data)
+					logic_fixup_feed(devc, &logic);
 				sr_session_send(sdi, &packet);
+				devc->sent_bytes += logic.length;
 				logic_done += sending_now;
 			}
 		}
@@ -711,9 +778,13 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	uint64_t min = MIN(logic_done, analog_done);
 	devc->sent_samples += min;
 	devc->sent_frame_samples += min;
-	devc->spent_us += todo_us;
+	if (devc->max_throughput)
+		devc->spent_us = g_get_monotonic_time() - devc->start_us;
+	else
+		devc->spent_us += todo_us;
 
 	if (devc->limit_frames && devc->sent_frame_samples >= SAMPLES_PER_FRAME) {
+		sr_analog_batch_flush(devc->batch);
 		std_session_send_df_frame_end(sdi);
 		devc->sent_frame_samples = 0;
 		devc->limit_frames--;
@@ -731,11 +802,10 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			g_hash_table_iter_init(&iter, devc->ch_ag);
 			while (g_hash_table_iter_next(&iter, NULL, &value)) {
 				ag = value;
-				packet.type = SR_DF_ANALOG;
-				packet.payload = &ag->packet;
 				ag->packet.data = &ag->avg_val;
 				ag->packet.num_samples = 1;
-				sr_session_send(sdi, &packet);
+				sr_analog_batch_submit(devc->batch, &ag->packet);
+				devc->sent_bytes += sizeof(float);
 			}
 		}
 		sr_dbg("Requested number of samples reached.");
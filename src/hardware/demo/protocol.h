@@ -37,6 +37,9 @@
 /* This is a development feature: it starts a new frame every n samples. */
 #define SAMPLES_PER_FRAME		1000UL
 #define DEFAULT_LIMIT_FRAMES		0
+/* Logic packet size in bytes for the max-throughput test mode. */
+#define DEFAULT_PACKET_SIZE		(256 * 1024)
+#define MAX_PACKET_SIZE			(64 * 1024 * 1024)
 
 #define DEFAULT_ANALOG_ENCODING_DIGITS	4
 #define DEFAULT_ANALOG_SPEC_DIGITS		4
@@ -121,6 +124,17 @@ struct dev_context {
 	int64_t start_us;
 	int64_t spent_us;
 	uint64_t step;
+	/*
+	 * Max-throughput test mode: ignore the samplerate's timing, send
+	 * pregenerated logic data as fast as the session accepts it.
+	 */
+	gboolean max_throughput;
+	uint64_t packet_size;
+	uint64_t packet_samples;
+	uint8_t *packet_data;
+	uint64_t sent_bytes;
+	/* Samples per second which the last acquisition achieved. */
+	uint64_t throughput;
 	/* Logic */
 	int32_t num_logic_channels;
 	size_t logic_unitsize;
@@ -134,6 +148,8 @@ struct dev_context {
 	GHashTable *ch_ag;
 	gboolean avg; /* True if averaging is enabled */
 	uint64_t avg_samples;
+	/* Averaged values are readings like a meter's, they get batched. */
+	struct sr_analog_batch *batch;
 	size_t enabled_logic_channels;
 	size_t enabled_analog_channels;
 	size_t first_partial_logic_index;
@@ -162,6 +178,7 @@ struct analog_gen {
 
 SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc);
 SR_PRIV void demo_free_analog_pattern(struct dev_context *devc);
+SR_PRIV int demo_generate_packet_data(struct sr_dev_inst *sdi);
 SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data);
 
 #endif
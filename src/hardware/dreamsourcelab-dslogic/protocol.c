@@ -71,6 +71,9 @@
 #define DSLOGIC_ATOMIC_SAMPLES		(sizeof(uint64_t) * 8)
 #define DSLOGIC_ATOMIC_BYTES		sizeof(uint64_t)
 
+/* Number of runs to accumulate before RLE data gets sent. */
+#define DSLOGIC_RLE_RUN_COUNT		(64 * 1024)
+
 /*
  * The FPGA is configured with TLV tuples. Length is specified as the
  * number of 16-bit words.
@@ -425,6 +428,15 @@ static bool set_trigger(const struct sr_dev_inst *sdi, struct fpga_config *cfg)
 	return num_trigger_stages != 0;
 }
 
+static gboolean rle_mode_required(const struct dev_context *devc)
+{
+	if (devc->continuous_mode)
+		return FALSE;
+
+	return devc->limit_samples > DS_MAX_LOGIC_DEPTH *
+		ceil(devc->cur_samplerate * 1.0 / DS_MAX_LOGIC_SAMPLERATE);
+}
+
 static int fpga_configure(const struct sr_dev_inst *sdi)
 {
 	const struct dev_context *const devc = sdi->priv;
@@ -484,9 +496,7 @@ static int fpga_configure(const struct sr_dev_inst *sdi)
 		if (devc->clock_edge == DS_EDGE_FALLING)
 			mode |= DS_MODE_CLK_EDGE;
 	}
-	if (devc->limit_samples > DS_MAX_LOGIC_DEPTH *
-		ceil(devc->cur_samplerate * 1.0 / DS_MAX_LOGIC_SAMPLERATE)
-		&& !devc->continuous_mode) {
+	if (rle_mode_required(devc)) {
 		/* Enable RLE for long captures.
 		 * Without this, captured data present errors.
 		 */
@@ -684,7 +694,10 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
-	g_free(devc->deinterleave_buffer);
+	sr_buffer_pool_destroy(devc->deinterleave_pool);
+	devc->deinterleave_pool = NULL;
+	feed_queue_logic_free(devc->feed_queue);
+	devc->feed_queue = NULL;
 }
 
 static void free_transfer(struct libusb_transfer *transfer)
@@ -724,45 +737,100 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
-static void deinterleave_buffer(const uint8_t *src, size_t length,
-	uint16_t *dst_ptr, size_t channel_count, uint16_t channel_mask)
+static int lowest_bit(uint64_t value)
 {
-	uint16_t sample;
-
-	for (const uint64_t *src_ptr = (uint64_t*)src;
-		src_ptr < (uint64_t*)(src + length);
-		src_ptr += channel_count) {
-		for (int bit = 0; bit != 64; bit++) {
-			const uint64_t *word_ptr = src_ptr;
-			sample = 0;
-			for (unsigned int channel = 0; channel != 16;
-				channel++) {
-				const uint16_t m = channel_mask >> channel;
-				if (!m)
-					break;
-				if ((m & 1) && ((*word_ptr++ >> bit) & UINT64_C(1)))
-					sample |= 1 << channel;
+#ifdef __GNUC__
+	return __builtin_ctzll(value);
+#else
+	int bit;
+
+	for (bit = 0; !(value & 1); bit++)
+		value >>= 1;
+	return bit;
+#endif
+}
+
+/*
+ * Send samples of a transfer as runs of identical samples, straight
+ * from the channels' sample words. A block's words tell which samples
+ * differ from the one before them, only these start a run and get
+ * assembled from the words' bits.
+ */
+static int send_runs(struct dev_context *devc, const uint8_t *data,
+	size_t first, size_t count)
+{
+	const struct sr_bitplanes *const bp = &devc->planes;
+	const uint8_t *block;
+	uint64_t words[8 * sizeof(uint16_t)], changes;
+	size_t pos, end, lo, hi, plane;
+	int bit, next, ret;
+	uint16_t value;
+	uint8_t sample[sizeof(uint16_t)];
+
+	end = first + count;
+	for (pos = first; pos < end; pos += hi - lo) {
+		block = data + (pos / DSLOGIC_ATOMIC_SAMPLES) * bp->block_size;
+		lo = pos % DSLOGIC_ATOMIC_SAMPLES;
+		hi = MIN(DSLOGIC_ATOMIC_SAMPLES, lo + end - pos);
+
+		changes = 0;
+		for (plane = 0; plane < bp->plane_count; plane++) {
+			words[plane] = read_u64le(block +
+				plane * DSLOGIC_ATOMIC_BYTES);
+			changes |= words[plane] ^ (words[plane] << 1);
+		}
+		/* Runs start at the first sample, and where samples change. */
+		changes &= ~UINT64_C(0) << lo;
+		if (hi < DSLOGIC_ATOMIC_SAMPLES)
+			changes &= ~(~UINT64_C(0) << hi);
+		changes |= UINT64_C(1) << lo;
+
+		bit = lo;
+		while (changes) {
+			changes &= changes - 1;
+			next = changes ? lowest_bit(changes) : (int)hi;
+			value = 0;
+			for (plane = 0; plane < bp->plane_count; plane++) {
+				if (words[plane] & (UINT64_C(1) << bit))
+					value |= 1 << bp->positions[plane];
 			}
-			*dst_ptr++ = sample;
+			write_u16le(sample, value);
+			ret = feed_queue_logic_submit_one(devc->feed_queue,
+				sample, next - bit);
+			if (ret != SR_OK)
+				return ret;
+			bit = next;
 		}
 	}
+
+	return feed_queue_logic_flush(devc->feed_queue);
 }
 
-static void send_data(struct sr_dev_inst *sdi,
-	uint16_t *data, size_t sample_count)
+/*
+ * Send samples of a transfer. In RLE mode they get sent as runs, else
+ * the deinterleaved samples in buf get sent.
+ */
+static int send_data(struct sr_dev_inst *sdi, const uint8_t *data,
+	struct sr_buffer *buf, size_t first, size_t count)
 {
-	const struct sr_datafeed_logic logic = {
-		.length = sample_count * sizeof(uint16_t),
-		.unitsize = sizeof(uint16_t),
-		.data = data
-	};
-
-	const struct sr_datafeed_packet packet = {
-		.type = SR_DF_LOGIC,
-		.payload = &logic
-	};
-
-	sr_session_send(sdi, &packet);
+	struct dev_context *const devc = sdi->priv;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet;
+
+	/*
+	 * Long captures in RLE mode mostly consist of idle periods.
+	 * Have the session feed carry runs of identical samples.
+	 */
+	if (devc->feed_queue)
+		return send_runs(devc, data, first, count);
+
+	logic.length = count * sizeof(uint16_t);
+	logic.unitsize = sizeof(uint16_t);
+	logic.data = (uint16_t *)sr_buffer_data_get(buf) + first;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	return sr_session_send_buffer(sdi, &packet, buf);
 }
 
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
@@ -770,14 +838,14 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	struct sr_dev_inst *const sdi = transfer->user_data;
 	struct dev_context *const devc = sdi->priv;
 	const size_t channel_count = enabled_channel_count(sdi);
-	const uint16_t channel_mask = enabled_channel_mask(sdi);
 	const unsigned int cur_sample_count = DSLOGIC_ATOMIC_SAMPLES *
 		transfer->actual_length /
 		(DSLOGIC_ATOMIC_BYTES * channel_count);
 
 	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
-	int trigger_offset;
+	int trigger_offset, ret;
+	struct sr_buffer *buf;
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -842,8 +910,24 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 */
 		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
-			devc->deinterleave_buffer, channel_count, channel_mask);
+
+		/*
+		 * Deinterleave into a reference counted buffer, consumers
+		 * may hold on to it while the next transfer comes in. RLE
+		 * mode needs no deinterleaved samples.
+		 */
+		buf = NULL;
+		if (!devc->feed_queue) {
+			buf = sr_buffer_pool_get(devc->deinterleave_pool);
+			if (!buf) {
+				abort_acquisition(devc);
+				free_transfer(transfer);
+				return;
+			}
+			sr_bitplanes_to_samples(&devc->planes,
+				sr_buffer_data_get(buf), transfer->buffer,
+				transfer->actual_length / devc->planes.block_size);
+		}
 
 		/* Send the incoming transfer to the session bus. */
 		if (devc->trigger_pos > devc->sent_samples
@@ -851,20 +935,31 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 			/* DSLogic trigger in this block. Send trigger position. */
 			trigger_offset = devc->trigger_pos - devc->sent_samples;
 			/* Pre-trigger samples. */
-			send_data(sdi, devc->deinterleave_buffer, trigger_offset);
+			ret = send_data(sdi, transfer->buffer, buf, 0,
+				trigger_offset);
 			devc->sent_samples += trigger_offset;
 			/* Trigger position. */
 			devc->trigger_pos = 0;
-			std_session_send_df_trigger(sdi);
+			if (ret == SR_OK)
+				ret = std_session_send_df_trigger(sdi);
 			/* Post trigger samples. */
 			num_samples -= trigger_offset;
-			send_data(sdi, devc->deinterleave_buffer
-				+ trigger_offset, num_samples);
+			if (ret == SR_OK)
+				ret = send_data(sdi, transfer->buffer, buf,
+					trigger_offset, num_samples);
 			devc->sent_samples += num_samples;
 		} else {
-			send_data(sdi, devc->deinterleave_buffer, num_samples);
+			ret = send_data(sdi, transfer->buffer, buf, 0,
+				num_samples);
 			devc->sent_samples += num_samples;
 		}
+		sr_buffer_unref(buf);
+		if (ret != SR_OK) {
+			sr_err("Cannot send sample data: %s.", sr_strerror(ret));
+			abort_acquisition(devc);
+			free_transfer(transfer);
+			return;
+		}
 	}
 
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
@@ -963,12 +1058,31 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
-	devc->deinterleave_buffer = g_try_malloc(DSLOGIC_ATOMIC_SAMPLES *
-		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t));
-	if (!devc->deinterleave_buffer) {
-		sr_err("Deinterleave buffer malloc failed.");
-		g_free(devc->deinterleave_buffer);
-		return SR_ERR_MALLOC;
+	ret = sr_bitplanes_init(&devc->planes, DSLOGIC_ATOMIC_BYTES, FALSE,
+		enabled_channel_mask(sdi), sizeof(uint16_t));
+	if (ret != SR_OK) {
+		sr_err("Unsupported channel selection.");
+		return ret;
+	}
+
+	feed_queue_logic_free(devc->feed_queue);
+	devc->feed_queue = NULL;
+	if (rle_mode_required(devc)) {
+		devc->feed_queue = feed_queue_logic_alloc_rle(sdi,
+			DSLOGIC_RLE_RUN_COUNT, sizeof(uint16_t));
+		if (!devc->feed_queue) {
+			sr_err("RLE feed queue malloc failed.");
+			return SR_ERR_MALLOC;
+		}
+	} else {
+		devc->deinterleave_pool = sr_buffer_pool_new(
+			DSLOGIC_ATOMIC_SAMPLES *
+			(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) *
+			sizeof(uint16_t), num_transfers, 0);
+		if (!devc->deinterleave_pool) {
+			sr_err("Deinterleave buffer pool malloc failed.");
+			return SR_ERR_MALLOC;
+		}
 	}
 
 	devc->num_transfers = num_transfers;
@@ -132,7 +132,9 @@ struct dev_context {
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
 
-	uint16_t *deinterleave_buffer;
+	struct sr_bitplanes planes;
+	struct sr_buffer_pool *deinterleave_pool;
+	struct feed_queue_logic *feed_queue;
 
 	uint16_t mode;
 	uint32_t trigger_pos;
@@ -293,6 +293,10 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
 
+	/* Buffers still referenced by consumers outlive the pool. */
+	sr_buffer_pool_destroy(devc->buffer_pool);
+	devc->buffer_pool = NULL;
+
 	/* Free the deinterlace buffers if we had them. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
 		g_free(devc->logic_buffer);
@@ -314,7 +318,7 @@ static void free_transfer(struct libusb_transfer *transfer)
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
+	sr_buffer_unref(sr_buffer_from_data(transfer->buffer));
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
@@ -332,8 +336,31 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_buffer *buf;
 	int ret;
 
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	/*
+	 * Don't overwrite sample data which a consumer still holds on
+	 * to, receive into a fresh buffer instead. Consumers which keep
+	 * more than the pool allows end the acquisition.
+	 */
+	buf = sr_buffer_from_data(transfer->buffer);
+	if (sr_buffer_is_shared(buf)) {
+		buf = sr_buffer_pool_get(devc->buffer_pool);
+		if (!buf) {
+			fx2lafw_abort_acquisition(devc);
+			free_transfer(transfer);
+			return;
+		}
+		sr_buffer_unref(sr_buffer_from_data(transfer->buffer));
+		transfer->buffer = sr_buffer_data_get(buf);
+	}
+
 	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
 		return;
 
@@ -342,7 +369,7 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
-static void mso_send_data_proc(struct sr_dev_inst *sdi,
+static void mso_send_data_proc(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint8_t *data, size_t length, size_t sample_width)
 {
 	size_t i;
@@ -352,6 +379,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 
+	(void)buf;
 	(void)sample_width;
 
 	devc = sdi->priv;
@@ -394,7 +422,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &analog_packet);
 }
 
-static void la_send_data_proc(struct sr_dev_inst *sdi,
+static void la_send_data_proc(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint8_t *data, size_t length, size_t sample_width)
 {
 	const struct sr_datafeed_logic logic = {
@@ -408,13 +436,15 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	/* The samples are passed on straight from the transfer buffer. */
+	sr_session_send_buffer(sdi, &packet, buf);
 }
 
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
+	struct sr_buffer *buf;
 	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize, processed_samples;
@@ -422,6 +452,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
+	buf = sr_buffer_from_data(transfer->buffer);
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -478,7 +509,8 @@ check_trigger:
 			if (devc->limit_samples && devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
+			devc->send_data_proc(sdi, buf,
+				(uint8_t *)transfer->buffer + processed_samples * unitsize,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
 			processed_samples += num_samples;
@@ -496,7 +528,7 @@ check_trigger:
 					devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
+			devc->send_data_proc(sdi, buf, (uint8_t *)transfer->buffer
 					+ processed_samples * unitsize
 					+ trigger_offset * unitsize,
 					num_samples * unitsize, unitsize);
@@ -636,7 +668,7 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct libusb_transfer *transfer;
 	unsigned int i, num_transfers;
 	int timeout, ret;
-	unsigned char *buf;
+	struct sr_buffer *buf;
 	size_t size;
 
 	devc = sdi->priv;
@@ -670,23 +702,35 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
+	/*
+	 * Transfer buffers are reference counted, so that sample data can
+	 * be passed to the session without copying. Limit how many of
+	 * them consumers can hold on to.
+	 */
+	devc->buffer_pool = sr_buffer_pool_new(size, num_transfers,
+		num_transfers + NUM_HELD_BUFFERS);
+	if (!devc->buffer_pool) {
+		sr_err("USB transfer buffer pool malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+
 	timeout = get_timeout(devc);
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
+		if (!(buf = sr_buffer_pool_get(devc->buffer_pool))) {
 			sr_err("USB transfer buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
 		transfer = libusb_alloc_transfer(0);
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
+				2 | LIBUSB_ENDPOINT_IN, sr_buffer_data_get(buf), size,
 				receive_transfer, (void *)sdi, timeout);
 		sr_info("submitting transfer: %d", i);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
+			sr_buffer_unref(buf);
 			fx2lafw_abort_acquisition(devc);
 			return SR_ERR;
 		}
@@ -38,6 +38,8 @@
 #define MAX_RENUM_DELAY_MS	3000
 #define NUM_SIMUL_TRANSFERS	32
 #define MAX_EMPTY_TRANSFERS	(NUM_SIMUL_TRANSFERS * 2)
+/* Transfer buffers which consumers may hold on to, on top of the transfers. */
+#define NUM_HELD_BUFFERS	NUM_SIMUL_TRANSFERS
 
 #define NUM_CHANNELS		16
 
@@ -120,7 +122,8 @@ struct dev_context {
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
-	void (*send_data_proc)(struct sr_dev_inst *sdi,
+	struct sr_buffer_pool *buffer_pool;
+	void (*send_data_proc)(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 		uint8_t *data, size_t length, size_t sample_width);
 	uint8_t *logic_buffer;
 	float *analog_buffer;
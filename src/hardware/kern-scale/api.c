@@ -145,6 +145,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	sr_sw_limits_acquisition_start(&devc->limits);
 	std_session_send_df_header(sdi);
+	devc->batch = sr_analog_batch_new(sdi);
 
 	serial_source_add(sdi->session, serial, G_IO_IN, 50,
 		      kern_scale_receive_data, (void *)sdi);
@@ -152,6 +153,18 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	sr_analog_batch_flush(devc->batch);
+	sr_analog_batch_free(devc->batch);
+	devc->batch = NULL;
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 #define SCALE(ID, CHIPSET, VENDOR, MODEL, CONN, PACKETSIZE, \
 			VALID, PARSE) \
 	&((struct scale_info) { \
@@ -170,7 +183,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		VENDOR, MODEL, CONN, PACKETSIZE, \
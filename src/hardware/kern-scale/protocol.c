@@ -31,7 +31,6 @@ static void handle_packet(const uint8_t *buf, struct sr_dev_inst *sdi,
 {
 	struct scale_info *scale;
 	float floatval;
-	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -54,9 +53,7 @@ static void handle_packet(const uint8_t *buf, struct sr_dev_inst *sdi,
 
 	if (analog.meaning->mq != 0) {
 		/* Got a measurement. */
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
-		sr_session_send(sdi, &packet);
+		sr_analog_batch_submit(devc->batch, &analog);
 		sr_sw_limits_update_samples_read(&devc->limits, 1);
 	}
 }
@@ -124,6 +121,7 @@ SR_PRIV int kern_scale_receive_data(int fd, int revents, void *cb_data)
 		handle_new_data(sdi, info);
 		g_free(info);
 	}
+	sr_analog_batch_poll(devc->batch);
 
 	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
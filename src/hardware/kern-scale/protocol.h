@@ -50,6 +50,8 @@ struct dev_context {
 	uint8_t buf[SCALE_BUFSIZE];
 	int bufoffset;
 	int buflen;
+
+	struct sr_analog_batch *batch;
 };
 
 SR_PRIV int kern_scale_receive_data(int fd, int revents, void *cb_data);
@@ -1069,8 +1069,18 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		} else {
 			return SR_ERR_ARG;
 		}
-		devc->feed_queue = feed_queue_logic_alloc(sdi,
-			LA2016_CONVBUFFER_SIZE, unitsize);
+		/*
+		 * Normal mode captures are run-length compressed by
+		 * the device. Pass the (value, repeat count) pairs to
+		 * the session as is instead of expanding them here.
+		 */
+		if (devc->continuous) {
+			devc->feed_queue = feed_queue_logic_alloc(sdi,
+				LA2016_CONVBUFFER_SIZE, unitsize);
+		} else {
+			devc->feed_queue = feed_queue_logic_alloc_rle(sdi,
+				LA2016_CONVBUFFER_SIZE, unitsize);
+		}
 		if (!devc->feed_queue) {
 			sr_err("Cannot allocate buffer for session feed.");
 			return SR_ERR_MALLOC;
@@ -581,9 +581,13 @@ static void la2016_prepare_stream(const struct sr_dev_inst *sdi)
 			continue;
 		channel_mask = 1UL << ch->index;
 		stream->enabled_mask |= channel_mask;
-		stream->channel_masks[stream->enabled_count++] = channel_mask;
+		stream->enabled_count++;
 	}
-	stream->channel_index = 0;
+	if (!stream->enabled_mask)
+		return;
+	sr_bitplanes_init(&stream->planes, sizeof(uint16_t), FALSE,
+		stream->enabled_mask, devc->model->channel_count == 32 ?
+		sizeof(uint32_t) : sizeof(uint16_t));
 }
 
 /*
@@ -1449,26 +1453,23 @@ static void send_chunk(struct sr_dev_inst *sdi,
  * sampled later. After all 16bit entities for all enabled channels
  * were seen, the first enabled channel's next chunk follows.
  *
- * Implementor's note: This routine is inspired by convert_sample_data()
- * in the https://github.com/AlexUg/sigrok implementation. Which in turn
- * appears to have been derived from the saleae-logic16 sigrok driver.
- * The code is phrased conservatively to verify the layout as discussed
- * above, performance was not a priority. Operation was verified with an
- * LA2016 device. The LA5032 reportedly shares the 16 samples per channel
- * layout, just round-robins through a potentially larger set of enabled
- * channels before returning to the first of the channels.
+ * Implementor's note: The layout was originally verified with a routine
+ * which was inspired by convert_sample_data() in the
+ * https://github.com/AlexUg/sigrok implementation. Which in turn appears
+ * to have been derived from the saleae-logic16 sigrok driver. Operation
+ * was verified with an LA2016 device. The LA5032 reportedly shares the
+ * 16 samples per channel layout, just round-robins through a potentially
+ * larger set of enabled channels before returning to the first of the
+ * channels. The common bit plane conversion now does the transpose, and
+ * keeps incomplete blocks across USB transfers.
  */
 static void stream_data(struct sr_dev_inst *sdi,
 	const uint8_t *data_buffer, size_t data_length)
 {
 	struct dev_context *devc;
 	struct stream_state_t *stream;
-	size_t bit_count;
-	const uint8_t *rp;
-	uint32_t sample_value;
-	uint8_t sample_buff[sizeof(sample_value)];
-	size_t bit_idx;
-	uint32_t ch_mask;
+	uint8_t sample_buff[512 * sizeof(uint32_t)];
+	size_t used, count;
 
 	devc = sdi->priv;
 	stream = &devc->stream;
@@ -1481,40 +1482,22 @@ static void stream_data(struct sr_dev_inst *sdi,
 
 	/* TODO Add soft trigger support when in stream mode? */
 
-	/* All channels' chunks carry 16 samples for one channel. */
-	bit_count = 16;
-	data_length /= sizeof(uint16_t);
-
-	rp = data_buffer;
-	sample_value = 0;
-	while (data_length--) {
-		/* Get another entity. */
-		sample_value = read_u16le_inc(&rp);
-
-		/* Map the entity's bits to a channel's samples. */
-		ch_mask = stream->channel_masks[stream->channel_index];
-		for (bit_idx = 0; bit_idx < bit_count; bit_idx++) {
-			if (sample_value & (1UL << bit_idx))
-				stream->sample_data[bit_idx] |= ch_mask;
-		}
-
-		/*
-		 * Advance to the next channel. Submit a block of
-		 * samples when all channels' data was seen.
-		 */
-		stream->channel_index++;
-		if (stream->channel_index != stream->enabled_count)
+	/*
+	 * Convert the chunks of all channels to samples, and submit
+	 * them to the session feed a buffer at a time.
+	 */
+	while (data_length) {
+		used = sr_bitplanes_convert(&stream->planes, sample_buff,
+			sizeof(sample_buff) / stream->planes.unitsize,
+			data_buffer, data_length, &count);
+		data_buffer += used;
+		data_length -= used;
+		if (!count)
 			continue;
-		for (bit_idx = 0; bit_idx < bit_count; bit_idx++) {
-			sample_value = stream->sample_data[bit_idx];
-			write_u32le(sample_buff, sample_value);
-			feed_queue_logic_submit_one(devc->feed_queue,
-				sample_buff, 1);
-		}
-		sr_sw_limits_update_samples_read(&devc->sw_limits, bit_count);
-		devc->total_samples += bit_count;
-		memset(stream->sample_data, 0, sizeof(stream->sample_data));
-		stream->channel_index = 0;
+		feed_queue_logic_submit_many(devc->feed_queue,
+			sample_buff, count);
+		sr_sw_limits_update_samples_read(&devc->sw_limits, count);
+		devc->total_samples += count;
 	}
 
 	/*
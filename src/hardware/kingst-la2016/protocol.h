@@ -162,9 +162,7 @@ struct dev_context {
 	struct stream_state_t {
 		size_t enabled_count;
 		uint32_t enabled_mask;
-		uint32_t channel_masks[32];
-		size_t channel_index;
-		uint32_t sample_data[32];
+		struct sr_bitplanes planes;
 		uint64_t flush_period_ms;
 		uint64_t last_flushed;
 	} stream;
@@ -325,6 +325,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	devc->reply_pending = FALSE;
 	devc->req_sent_at = 0;
 
+	devc->batch = sr_analog_batch_new(sdi);
+
 	serial = sdi->conn;
 	serial_source_add(sdi->session, serial, G_IO_IN, 10,
 			hcs_receive_data, (void *)sdi);
@@ -332,6 +334,18 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	sr_analog_batch_flush(devc->batch);
+	sr_analog_batch_free(devc->batch);
+	devc->batch = NULL;
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 static struct sr_dev_driver manson_hcs_3xxx_driver_info = {
 	.name = "manson-hcs-3xxx",
 	.longname = "Manson HCS-3xxx",
@@ -347,7 +361,7 @@ static struct sr_dev_driver manson_hcs_3xxx_driver_info = {
 	.dev_open = std_serial_dev_open,
 	.dev_close = std_serial_dev_close,
 	.dev_acquisition_start = dev_acquisition_start,
-	.dev_acquisition_stop = std_serial_dev_acquisition_stop,
+	.dev_acquisition_stop = dev_acquisition_stop,
 	.context = NULL,
 };
 SR_REGISTER_DEV_DRIVER(manson_hcs_3xxx_driver_info);
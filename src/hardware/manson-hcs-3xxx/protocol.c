@@ -118,7 +118,6 @@ SR_PRIV int hcs_parse_volt_curr_mode(struct sr_dev_inst *sdi, char **tokens)
 static void send_sample(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -128,8 +127,6 @@ static void send_sample(struct sr_dev_inst *sdi)
 
 	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
 
-	packet.type = SR_DF_ANALOG;
-	packet.payload = &analog;
 	analog.meaning->channels = sdi->channels;
 	analog.num_samples = 1;
 
@@ -137,13 +134,13 @@ static void send_sample(struct sr_dev_inst *sdi)
 	analog.meaning->unit = SR_UNIT_VOLT;
 	analog.meaning->mqflags = SR_MQFLAG_DC;
 	analog.data = &devc->voltage;
-	sr_session_send(sdi, &packet);
+	sr_analog_batch_submit(devc->batch, &analog);
 
 	analog.meaning->mq = SR_MQ_CURRENT;
 	analog.meaning->unit = SR_UNIT_AMPERE;
 	analog.meaning->mqflags = 0;
 	analog.data = &devc->current;
-	sr_session_send(sdi, &packet);
+	sr_analog_batch_submit(devc->batch, &analog);
 
 
 	sr_sw_limits_update_samples_read(&devc->limits, 1);
@@ -226,6 +223,7 @@ SR_PRIV int hcs_receive_data(int fd, int revents, void *cb_data)
 	} else {
 		/* Timeout. */
 	}
+	sr_analog_batch_poll(devc->batch);
 
 	if (sr_sw_limits_check(&devc->limits)) {
 		sr_dev_acquisition_stop(sdi);
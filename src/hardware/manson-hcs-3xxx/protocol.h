@@ -77,6 +77,8 @@ struct dev_context {
 
 	char buf[50];
 	int buflen;
+
+	struct sr_analog_batch *batch; /**< Readings to be sent in batches. */
 };
 
 SR_PRIV int hcs_parse_volt_curr_mode(struct sr_dev_inst *sdi, char **tokens);
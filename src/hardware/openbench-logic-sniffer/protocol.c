@@ -354,6 +354,159 @@ SR_PRIV void abort_acquisition(const struct sr_dev_inst *sdi)
 	std_session_send_df_end(sdi);
 }
 
+/*
+ * Prepare the expansion of received samples. Disabled channel groups
+ * are not transferred, the enabled groups' bytes follow each other.
+ */
+static void ols_prepare_changroups(struct dev_context *devc)
+{
+	unsigned int i;
+
+	devc->num_changroups = 0;
+	for (i = 0; i < 4; i++) {
+		if (devc->capture_flags & (CAPTURE_FLAG_DISABLE_CHANGROUP_1 << i))
+			devc->changroup_byte[i] = -1;
+		else
+			devc->changroup_byte[i] = devc->num_changroups++;
+	}
+}
+
+/* Expand a received sample to 32 bits little endian. */
+static inline void ols_expand_sample(const struct dev_context *devc,
+		const uint8_t *raw, uint8_t *sample)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) {
+		sample[i] = devc->changroup_byte[i] < 0 ?
+			0 : raw[devc->changroup_byte[i]];
+	}
+}
+
+/*
+ * Store a sample which repeats count times.
+ *
+ * The OLS sends its sample buffer backwards. Samples get stored in
+ * reverse order, from the end of the buffer towards its start, so we
+ * can dump this on the session bus later. Here cropping to
+ * devc->unitsize happens.
+ */
+static void ols_store_run(struct dev_context *devc, const uint8_t *sample,
+		uint64_t count)
+{
+	uint8_t *dst;
+	size_t size, done, copy;
+
+	count = MIN(count, devc->limit_samples - devc->num_samples);
+	if (!count)
+		return;
+	devc->num_samples += count;
+	dst = devc->raw_sample_buf +
+		(devc->limit_samples - devc->num_samples) * devc->unitsize;
+	size = count * devc->unitsize;
+
+	if (devc->unitsize == 1) {
+		memset(dst, sample[0], size);
+		return;
+	}
+	/* Double the filled part of the run until it is complete. */
+	memcpy(dst, sample, devc->unitsize);
+	for (done = devc->unitsize; done < size; done += copy) {
+		copy = MIN(done, size - done);
+		memcpy(dst + done, dst, copy);
+	}
+}
+
+/* Store count consecutive samples which are not run length encoded. */
+static void ols_store_samples(struct dev_context *devc, const uint8_t *raw,
+		size_t count)
+{
+	uint8_t *dst, sample[4];
+	size_t i;
+
+	dst = devc->raw_sample_buf +
+		(devc->limit_samples - devc->num_samples) * devc->unitsize;
+	devc->num_samples += count;
+
+	if (devc->unitsize == 1 && devc->num_changroups == 1 &&
+			devc->changroup_byte[0] == 0) {
+		for (i = 0; i < count; i++)
+			dst[-1 - (ptrdiff_t)i] = raw[i];
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		dst -= devc->unitsize;
+		ols_expand_sample(devc, raw, sample);
+		memcpy(dst, sample, devc->unitsize);
+		raw += devc->num_changroups;
+	}
+}
+
+/* Decode a chunk of received data, samples may span chunks. */
+static void ols_decode_data(struct dev_context *devc, const uint8_t *buf,
+		size_t len)
+{
+	const uint8_t *raw;
+	uint8_t sample[4];
+	uint32_t value;
+	size_t ngroups, copy, count, i;
+
+	ngroups = devc->num_changroups;
+	while (len && devc->num_samples < devc->limit_samples) {
+		/* Blocks of plain samples need no per sample decisions. */
+		if (!(devc->capture_flags & CAPTURE_FLAG_RLE) &&
+				!devc->num_bytes && len >= ngroups) {
+			count = MIN(len / ngroups,
+				devc->limit_samples - devc->num_samples);
+			ols_store_samples(devc, buf, count);
+			devc->cnt_samples += count;
+			devc->cnt_samples_rle += count;
+			buf += count * ngroups;
+			len -= count * ngroups;
+			continue;
+		}
+
+		/* Take the next sample from buf, or complete a partial one. */
+		if (!devc->num_bytes && len >= ngroups) {
+			raw = buf;
+			buf += ngroups;
+			len -= ngroups;
+		} else {
+			copy = MIN(ngroups - devc->num_bytes, len);
+			memcpy(&devc->sample[devc->num_bytes], buf, copy);
+			devc->num_bytes += copy;
+			buf += copy;
+			len -= copy;
+			if (devc->num_bytes < ngroups)
+				break;
+			devc->num_bytes = 0;
+			raw = devc->sample;
+		}
+		devc->cnt_samples++;
+		devc->cnt_samples_rle++;
+
+		/*
+		 * In RLE mode the high bit of the sample is the "count"
+		 * flag, meaning this sample is the number of times the
+		 * following sample occurred.
+		 */
+		if ((devc->capture_flags & CAPTURE_FLAG_RLE) &&
+				(raw[ngroups - 1] & 0x80)) {
+			value = 0;
+			for (i = 0; i < ngroups; i++)
+				value |= (uint32_t)raw[i] << (i * 8);
+			value &= ~(UINT32_C(0x80) << ((ngroups - 1) * 8));
+			devc->rle_count = value;
+			devc->cnt_samples_rle += value;
+			continue;
+		}
+
+		ols_expand_sample(devc, raw, sample);
+		ols_store_run(devc, sample, (uint64_t)devc->rle_count + 1);
+		devc->rle_count = 0;
+	}
+}
+
 SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 {
 	struct dev_context *devc;
@@ -361,10 +514,8 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	struct sr_serial_dev_inst *serial;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	uint32_t sample;
-	int num_changroups, offset, j;
-	unsigned int i;
-	unsigned char byte;
+	uint8_t buf[4096];
+	int len, num_pre_trigger_samples;
 
 	(void)fd;
 
@@ -385,165 +536,75 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 		}
 		/* fill with 1010... for debugging */
 		memset(devc->raw_sample_buf, 0x82, devc->limit_samples * 4);
-	}
-
-	num_changroups = 0;
-	for (i = 0x20; i > 0x02; i >>= 1) {
-		if ((devc->capture_flags & i) == 0) {
-			num_changroups++;
-		}
+		ols_prepare_changroups(devc);
 	}
 
 	if (revents == G_IO_IN && devc->num_samples < devc->limit_samples) {
-		if (serial_read_nonblocking(serial, &byte, 1) != 1)
-			return FALSE;
-		devc->cnt_bytes++;
-
-		/* Ignore it if we've read enough. */
-		if (devc->num_samples >= devc->limit_samples)
+		/* Drain everything the device has sent so far. */
+		do {
+			len = serial_read_nonblocking(serial, buf, sizeof(buf));
+			if (len < 0)
+				return FALSE;
+			sr_spew("Received %d bytes.", len);
+			devc->cnt_bytes += len;
+			ols_decode_data(devc, buf, len);
+		} while (len == sizeof(buf) &&
+			devc->num_samples < devc->limit_samples);
+
+		/* Data past the requested amount of samples gets ignored. */
+		if (devc->num_samples < devc->limit_samples)
 			return TRUE;
+	}
 
-		devc->sample[devc->num_bytes++] = byte;
-		sr_spew("Received byte 0x%.2x.", byte);
-		if (devc->num_bytes == num_changroups) {
-			devc->cnt_samples++;
-			devc->cnt_samples_rle++;
-			/*
-			 * Got a full sample. Convert from the OLS's little-endian
-			 * sample to the local format.
-			 */
-			sample = devc->sample[0] | (devc->sample[1] << 8) |
-				 (devc->sample[2] << 16) |
-				 (devc->sample[3] << 24);
-			sr_dbg("Received sample 0x%.*x.", devc->num_bytes * 2,
-			       sample);
-			if (devc->capture_flags & CAPTURE_FLAG_RLE) {
-				/*
-				 * In RLE mode the high bit of the sample is the
-				 * "count" flag, meaning this sample is the number
-				 * of times the previous sample occurred.
-				 */
-				if (devc->sample[devc->num_bytes - 1] & 0x80) {
-					/* Clear the high bit. */
-					sample &= ~(0x80 << (devc->num_bytes -
-							     1) * 8);
-					devc->rle_count = sample;
-					devc->cnt_samples_rle +=
-						devc->rle_count;
-					sr_dbg("RLE count: %u.",
-					       devc->rle_count);
-					devc->num_bytes = 0;
-					return TRUE;
-				}
-			}
-			devc->num_samples += devc->rle_count + 1;
-			if (devc->num_samples > devc->limit_samples) {
-				/* Save us from overrunning the buffer. */
-				devc->rle_count -=
-					devc->num_samples - devc->limit_samples;
-				devc->num_samples = devc->limit_samples;
-			}
-
-			if (num_changroups < 4) {
-				/*
-				 * Some channel groups may have been turned
-				 * off, to speed up transfer between the
-				 * hardware and the PC. Expand that here before
-				 * submitting it over the session bus --
-				 * whatever is listening on the bus will be
-				 * expecting a full sample of devc->unitsize bytes,
-				 * based on the maximum number of channels.
-				 * For simplicity we expand the sample to 32 bits
-				 * little endian, and crop below
-				 */
-				j = 0;
-				uint8_t tmp_sample[4] = { 0, 0, 0, 0 };
-				for (i = 0; i < 4; i++) {
-					if (((devc->capture_flags >> 2) &
-					     (1 << i)) == 0) {
-						/*
-						 * This channel group was
-						 * enabled, copy from received
-						 * sample.
-						 */
-						tmp_sample[i] =
-							devc->sample[j++];
-					}
-				}
-				memcpy(devc->sample, tmp_sample, 4);
-				sr_spew("Expanded sample: 0x%.2hhx%.2hhx%.2hhx%.2hhx ",
-					devc->sample[3], devc->sample[2],
-					devc->sample[1], devc->sample[0]);
-			}
-
-			/*
-			 * the OLS sends its sample buffer backwards.
-			 * store it in reverse order here, so we can dump
-			 * this on the session bus later.
-			 * Here cropping to devc->unitsize happens
-			 */
-			offset = (devc->limit_samples - devc->num_samples) * devc->unitsize;
-			for (i = 0; i <= devc->rle_count; i++) {
-				memcpy(devc->raw_sample_buf + offset + (i * devc->unitsize),
-				       devc->sample, devc->unitsize);
-			}
-			memset(devc->sample, 0, 4);
-			devc->num_bytes = 0;
-			devc->rle_count = 0;
-		}
-	} else {
+	/*
+	 * This is the main loop telling us a timeout was reached, or
+	 * we've acquired all the samples we asked for -- we're done.
+	 * Send the (properly-ordered) buffer to the frontend.
+	 */
+	sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
+	       devc->cnt_bytes, devc->cnt_samples,
+	       devc->cnt_samples_rle);
+	if (devc->trigger_at_smpl != OLS_NO_TRIGGER) {
 		/*
-		 * This is the main loop telling us a timeout was reached, or
-		 * we've acquired all the samples we asked for -- we're done.
-		 * Send the (properly-ordered) buffer to the frontend.
+		 * A trigger was set up, so we need to tell the frontend
+		 * about it.
 		 */
-		sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
-		       devc->cnt_bytes, devc->cnt_samples,
-		       devc->cnt_samples_rle);
-		if (devc->trigger_at_smpl != OLS_NO_TRIGGER) {
-			/*
-			 * A trigger was set up, so we need to tell the frontend
-			 * about it.
-			 */
-			if (devc->trigger_at_smpl > 0) {
-				/* There are pre-trigger samples, send those first. */
-				packet.type = SR_DF_LOGIC;
-				packet.payload = &logic;
-				logic.length = devc->trigger_at_smpl * devc->unitsize;
-				logic.unitsize = devc->unitsize;
-				logic.data = devc->raw_sample_buf +
-					     (devc->limit_samples -
-					      devc->num_samples) *
-						     devc->unitsize;
-				sr_session_send(sdi, &packet);
-			}
-
-			/* Send the trigger. */
-			std_session_send_df_trigger(sdi);
+		if (devc->trigger_at_smpl > 0) {
+			/* There are pre-trigger samples, send those first. */
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			logic.length = devc->trigger_at_smpl * devc->unitsize;
+			logic.unitsize = devc->unitsize;
+			logic.data = devc->raw_sample_buf +
+				     (devc->limit_samples -
+				      devc->num_samples) *
+					     devc->unitsize;
+			sr_session_send(sdi, &packet);
 		}
 
-		/* Send post-trigger / all captured samples. */
-		int num_pre_trigger_samples = devc->trigger_at_smpl ==
-							      OLS_NO_TRIGGER ?
-							    0 :
-							    devc->trigger_at_smpl;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length =
-			(devc->num_samples - num_pre_trigger_samples) * devc->unitsize;
-		logic.unitsize = devc->unitsize;
-		logic.data = devc->raw_sample_buf +
-			     (num_pre_trigger_samples + devc->limit_samples -
-			      devc->num_samples) *
-				     devc->unitsize;
-		sr_session_send(sdi, &packet);
-
-		g_free(devc->raw_sample_buf);
-
-		serial_flush(serial);
-		abort_acquisition(sdi);
+		/* Send the trigger. */
+		std_session_send_df_trigger(sdi);
 	}
 
+	/* Send post-trigger / all captured samples. */
+	num_pre_trigger_samples = devc->trigger_at_smpl == OLS_NO_TRIGGER ?
+		0 : devc->trigger_at_smpl;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length =
+		(devc->num_samples - num_pre_trigger_samples) * devc->unitsize;
+	logic.unitsize = devc->unitsize;
+	logic.data = devc->raw_sample_buf +
+		     (num_pre_trigger_samples + devc->limit_samples -
+		      devc->num_samples) *
+			     devc->unitsize;
+	sr_session_send(sdi, &packet);
+
+	g_free(devc->raw_sample_buf);
+
+	serial_flush(serial);
+	abort_acquisition(sdi);
+
 	return TRUE;
 }
 
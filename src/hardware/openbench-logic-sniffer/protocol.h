@@ -123,6 +123,8 @@ struct dev_context {
 	int cnt_samples;
 	int cnt_samples_rle;
 
+	unsigned int num_changroups;
+	int8_t changroup_byte[4];
 	unsigned int rle_count;
 	unsigned char sample[4];
 	unsigned char *raw_sample_buf;
@@ -127,6 +127,23 @@ static int rdtech_dps_read_holding_registers(struct sr_modbus_dev_inst *modbus,
 	return ret;
 }
 
+/* Retries failed reads of several register blocks. */
+static int rdtech_dps_read_register_blocks(struct sr_modbus_dev_inst *modbus,
+	const struct sr_modbus_register_block *blocks, size_t nb_blocks)
+{
+	size_t retries;
+	int ret;
+
+	retries = 3;
+	while (retries--) {
+		ret = sr_modbus_read_register_blocks(modbus, blocks, nb_blocks);
+		if (ret == SR_OK)
+			return ret;
+	}
+
+	return ret;
+}
+
 /* Set one 16bit register. LE format for DPS devices. */
 static int rdtech_dps_set_reg(const struct sr_dev_inst *sdi,
 	uint16_t address, uint16_t value)
@@ -311,7 +328,8 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 	struct dev_context *devc;
 	struct sr_modbus_dev_inst *modbus;
 	gboolean get_config, get_init_state, get_curr_meas;
-	uint16_t registers[14];
+	uint16_t registers[14], prot_registers[2];
+	struct sr_modbus_register_block blocks[2];
 	int ret;
 	const uint8_t *rdptr;
 	uint16_t uset_raw, iset_raw, uout_raw, iout_raw, power_raw;
@@ -369,17 +387,22 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 	switch (devc->model->model_type) {
 	case MODEL_DPS:
 		/*
-		 * Transfer a chunk of registers in a single call. It's
+		 * Transfer two chunks of registers in a single call. It's
 		 * unfortunate that the model dependency and the sparse
 		 * register map force us to open code addresses, sizes,
 		 * and the sequence of the registers and how to interpret
 		 * their bit fields. But then this is not too unusual for
 		 * a hardware specific device driver ...
 		 */
+		blocks[0].address = REG_DPS_USET;
+		blocks[0].nb_registers = REG_DPS_ENABLE - REG_DPS_USET + 1;
+		blocks[0].registers = registers;
+		blocks[1].address = PRE_DPS_OVPSET;
+		blocks[1].nb_registers = 2;
+		blocks[1].registers = prot_registers;
 		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			REG_DPS_USET, REG_DPS_ENABLE - REG_DPS_USET + 1,
-			registers);
+		ret = rdtech_dps_read_register_blocks(modbus,
+			blocks, ARRAY_SIZE(blocks));
 		g_mutex_unlock(&devc->rw_mutex);
 		if (ret != SR_OK)
 			return ret;
@@ -407,16 +430,8 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 		out_state = read_u16be_inc(&rdptr); /* ENABLE */
 		is_out_enabled = out_state != 0;
 
-		/* Transfer another chunk of registers in a single call. */
-		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			PRE_DPS_OVPSET, 2, registers);
-		g_mutex_unlock(&devc->rw_mutex);
-		if (ret != SR_OK)
-			return ret;
-
 		/* Interpret the second registers chunk's values. */
-		rdptr = (const void *)registers;
+		rdptr = (const void *)prot_registers;
 		ovpset_raw = read_u16be_inc(&rdptr); /* PRE OVPSET */
 		ovp_threshold = ovpset_raw * devc->voltage_multiplier;
 		ocpset_raw = read_u16be_inc(&rdptr); /* PRE OCPSET */
@@ -425,14 +440,18 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 		break;
 
 	case MODEL_RD:
-		/* Retrieve a set of adjacent registers. */
+		/* Retrieve two sets of adjacent registers. */
+		blocks[0].address = REG_RD_VOLT_TGT;
+		blocks[0].nb_registers = devc->model->n_ranges > 1
+			? REG_RD_RANGE - REG_RD_VOLT_TGT + 1
+			: REG_RD_ENABLE - REG_RD_VOLT_TGT + 1;
+		blocks[0].registers = registers;
+		blocks[1].address = REG_RD_OVP_THR;
+		blocks[1].nb_registers = 2;
+		blocks[1].registers = prot_registers;
 		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			REG_RD_VOLT_TGT,
-			devc->model->n_ranges > 1
-				? REG_RD_RANGE - REG_RD_VOLT_TGT + 1
-				: REG_RD_ENABLE - REG_RD_VOLT_TGT + 1,
-			registers);
+		ret = rdtech_dps_read_register_blocks(modbus,
+			blocks, ARRAY_SIZE(blocks));
 		g_mutex_unlock(&devc->rw_mutex);
 		if (ret != SR_OK)
 			return ret;
@@ -464,16 +483,8 @@ SR_PRIV int rdtech_dps_get_state(const struct sr_dev_inst *sdi,
 			range = read_u16be_inc(&rdptr) ? 1 : 0; /* RANGE */
 		}
 
-		/* Retrieve a set of adjacent registers. */
-		g_mutex_lock(&devc->rw_mutex);
-		ret = rdtech_dps_read_holding_registers(modbus,
-			REG_RD_OVP_THR, 2, registers);
-		g_mutex_unlock(&devc->rw_mutex);
-		if (ret != SR_OK)
-			return ret;
-
-		/* Interpret the registers' raw content. */
-		rdptr = (const void *)registers;
+		/* Interpret the second set of registers. */
+		rdptr = (const void *)prot_registers;
 		ovpset_raw = read_u16be_inc(&rdptr); /* OVP THR */
 		ovp_threshold = ovpset_raw / devc->voltage_multiplier;
 		ocpset_raw = read_u16be_inc(&rdptr); /* OCP THR */
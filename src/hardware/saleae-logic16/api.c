@@ -578,20 +578,12 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 		channel_bit = 1 << (ch->index);
 
 		devc->cur_channels |= channel_bit;
-
-#ifdef WORDS_BIGENDIAN
-		/*
-		 * Output logic data should be stored in little endian format.
-		 * To speed things up during conversion, do the switcharoo
-		 * here instead.
-		 */
-		channel_bit = 1 << (ch->index ^ 8);
-#endif
-
-		devc->channel_masks[devc->num_channels++] = channel_bit;
+		devc->num_channels++;
 	}
 
-	return SR_OK;
+	/* Also discards data of a previous acquisition. */
+	return sr_bitplanes_init(&devc->planes, sizeof(uint16_t), TRUE,
+		devc->cur_channels, sizeof(uint16_t));
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -646,8 +638,6 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	devc->sent_samples = 0;
 	devc->empty_transfer_count = 0;
-	devc->cur_channel = 0;
-	memset(devc->channel_data, 0, sizeof(devc->channel_data));
 
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
 		int pre_trigger_samples = 0;
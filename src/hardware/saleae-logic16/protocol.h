@@ -78,9 +78,7 @@ struct dev_context {
 	int submitted_transfers;
 	int empty_transfer_count;
 	int num_channels;
-	int cur_channel;
-	uint16_t channel_masks[16];
-	uint16_t channel_data[16];
+	struct sr_bitplanes planes;
 	uint8_t *convbuffer;
 	size_t convbuffer_size;
 	struct soft_trigger_logic *stl;
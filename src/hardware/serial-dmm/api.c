@@ -281,6 +281,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			return ret;
 	}
 
+	devc->batch = sr_analog_batch_new(sdi);
+
 	serial = sdi->conn;
 	serial_source_add(sdi->session, serial, G_IO_IN, 50,
 		cb_func, cb_data);
@@ -288,6 +290,18 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	sr_analog_batch_flush(devc->batch);
+	sr_analog_batch_free(devc->batch);
+	devc->batch = NULL;
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 #define DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		OPEN, REQUEST, VALID, PARSE, DETAILS, \
@@ -309,7 +323,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		VENDOR, MODEL, CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
@@ -46,7 +46,6 @@ static void handle_packet(struct sr_dev_inst *sdi,
 	struct dev_context *devc;
 	float floatval;
 	double doubleval;
-	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -88,11 +87,10 @@ static void handle_packet(struct sr_dev_inst *sdi,
 
 		if (analog.meaning->mq != 0 && channel->enabled) {
 			/* Got a measurement. */
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			sr_session_send(sdi, &packet);
+			sr_analog_batch_submit(devc->batch, &analog);
 			sent_sample = TRUE;
 		}
+		g_slist_free(analog.meaning->channels);
 	}
 
 	if (sent_sample) {
@@ -261,6 +259,7 @@ int receive_data(int fd, int revents, void *cb_data)
 		if (dmm->packet_request && (req_packet(sdi) < 0))
 			return FALSE;
 	}
+	sr_analog_batch_poll(devc->batch);
 
 	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
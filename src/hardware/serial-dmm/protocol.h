@@ -93,6 +93,9 @@ struct dev_context {
 	 * Used only if device needs polling.
 	 */
 	uint64_t req_next_at;
+
+	/** Readings which are held back to be sent in batches. */
+	struct sr_analog_batch *batch;
 };
 
 SR_PRIV int req_packet(struct sr_dev_inst *sdi);
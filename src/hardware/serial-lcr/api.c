@@ -357,6 +357,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	sr_sw_limits_acquisition_start(&devc->limits);
 	std_session_send_df_header(sdi);
+	devc->batch = sr_analog_batch_new(sdi);
 
 	serial = sdi->conn;
 	serial_source_add(sdi->session, serial, G_IO_IN, 50,
@@ -365,6 +366,18 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	sr_analog_batch_flush(devc->batch);
+	sr_analog_batch_free(devc->batch);
+	devc->batch = NULL;
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 #define LCR_ES51919(id, vendor, model) \
 	&((struct lcr_info) { \
 		{ \
@@ -382,7 +395,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		vendor, model, ES51919_CHANNEL_COUNT, NULL, \
@@ -416,7 +429,7 @@ SR_REGISTER_DEV_DRIVER_LIST(lcr_es51919_drivers,
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		vendor, model, \
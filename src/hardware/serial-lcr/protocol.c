@@ -35,22 +35,29 @@ static void send_frame_start(struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 	info = &devc->parse_info;
 
-	/* Communicate changes of frequency or model before data values. */
+	/*
+	 * Communicate changes of frequency or model before data values.
+	 * Readings which were taken before the change get sent first.
+	 */
 	freq = info->output_freq;
+	model = info->circuit_model;
+	if (freq != devc->output_freq ||
+			(model && model != devc->circuit_model))
+		sr_analog_batch_flush(devc->batch);
 	if (freq != devc->output_freq) {
 		devc->output_freq = freq;
 		sr_session_send_meta(sdi, SR_CONF_OUTPUT_FREQUENCY,
 			g_variant_new_double(freq));
 	}
-	model = info->circuit_model;
 	if (model && model != devc->circuit_model) {
 		devc->circuit_model = model;
 		sr_session_send_meta(sdi, SR_CONF_EQUIV_CIRCUIT_MODEL,
 			g_variant_new_string(model));
 	}
 
-	/* Data is about to get sent. Start a new frame. */
-	std_session_send_df_frame_begin(sdi);
+	/* Data is about to get sent. Start a new frame, unless batching. */
+	if (!sr_analog_batch_active(devc->batch))
+		std_session_send_df_frame_begin(sdi);
 }
 
 static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt)
@@ -61,7 +68,6 @@ static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt)
 	size_t ch_idx;
 	int rc;
 	float value;
-	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -89,14 +95,13 @@ static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt)
 				send_frame_start(sdi);
 				frame = TRUE;
 			}
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			sr_session_send(sdi, &packet);
+			sr_analog_batch_submit(devc->batch, &analog);
 		}
 		g_slist_free(analog.meaning->channels);
 	}
 	if (frame) {
-		std_session_send_df_frame_end(sdi);
+		if (!sr_analog_batch_active(devc->batch))
+			std_session_send_df_frame_end(sdi);
 		sr_sw_limits_update_frames_read(&devc->limits, 1);
 	}
 
@@ -194,6 +199,7 @@ SR_PRIV int lcr_receive_data(int fd, int revents, void *cb_data)
 		ret = handle_new_data(sdi);
 	else
 		ret = handle_timeout(sdi);
+	sr_analog_batch_poll(devc->batch);
 	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
 	if (ret != SR_OK)
@@ -63,6 +63,7 @@ struct dev_context {
 	uint64_t output_freq;
 	const char *circuit_model;
 	int64_t req_next_at;
+	struct sr_analog_batch *batch;
 };
 
 SR_PRIV int lcr_receive_data(int fd, int revents, void *cb_data);
@@ -265,6 +265,10 @@ static struct sr_key_info sr_key_info_config[] = {
 
 	{SR_CONF_GATE_TIME, SR_T_RATIONAL_PERIOD, "gate_time",
 		"Gate time", NULL},
+	{SR_CONF_SAMPLES_MISSED, SR_T_UINT64, "samples_missed",
+		"Samples missed", NULL},
+	{SR_CONF_THROUGHPUT, SR_T_UINT64, "throughput",
+		"Throughput", NULL},
 	ALL_ZERO
 };
 
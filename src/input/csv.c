@@ -34,6 +34,9 @@
 
 #define CHUNK_SIZE	(4 * 1024 * 1024)
 
+/* Amount of text per thread which parallel parsing processes at once. */
+#define PARALLEL_CHUNK	(256 * 1024)
+
 /*
  * The CSV input module has the following options:
  *
@@ -91,6 +94,11 @@
  *     up to the end of the current text line. Can be empty to disable
  *     comment support. Defaults to semicolon.
  *
+ * threads: Specifies the number of threads which parse the text lines.
+ *     Defaults to 1, which parses in the caller's thread. 0 selects one
+ *     thread per processor. The resulting data is identical to the one
+ *     of single threaded parsing.
+ *
  * Typical examples of using these options:
  * - ... -I csv:column_formats=*l ...
  *   All columns are single-bit logic data. Identical to the previous
@@ -202,6 +210,14 @@ struct column_details {
 	GString **channel_names;
 };
 
+/* A column's text within the input buffer, not NUL terminated. */
+struct column_text {
+	const char *text;
+	size_t length;
+};
+
+struct parse_job;
+
 struct context {
 	gboolean started;
 
@@ -225,6 +241,7 @@ struct context {
 	const char *column_formats;
 	size_t column_want_count;
 	struct column_details *column_details;
+	struct column_text *column_text;
 
 	/* Line number to start processing. */
 	size_t start_line;
@@ -256,6 +273,14 @@ struct context {
 	/* List of previously created sigrok channels. */
 	GSList *prev_sr_channels;
 	GSList **prev_df_channels;
+
+	/* Parallel parsing of text lines, see process_parallel(). */
+	size_t threads;
+	struct sr_input_workers *workers;
+	struct parse_job **jobs;
+	size_t job_count;
+	/* Errors get reported by the calling thread, not the workers. */
+	gboolean quiet;
 };
 
 /*
@@ -612,6 +637,7 @@ static int make_column_details_from_format(const struct sr_input *in,
 	inc->analog_datafeed_digits = g_malloc0(inc->analog_channels * sizeof(inc->analog_datafeed_digits[0]));
 	inc->analog_datafeed_channels = g_malloc0(inc->analog_channels * sizeof(inc->analog_datafeed_channels[0]));
 	inc->column_details = g_malloc0_n(column_count, sizeof(inc->column_details[0]));
+	inc->column_text = g_malloc0_n(column_count, sizeof(inc->column_text[0]));
 	column_idx = channel_idx = analog_idx = 0;
 	channel_name = g_string_sized_new(64);
 	for (format_idx = 0; format_idx < format_count; format_idx++) {
@@ -731,6 +757,27 @@ static const struct column_details *lookup_column_details(struct context *inc, s
  * columns.
  */
 
+/*
+ * Find the next occurrence of a (short) sequence in a run of text,
+ * which need not be NUL terminated. Leaves the search for the first
+ * character to memchr(), which typically is vectorized.
+ */
+static const char *find_seq(const char *text, const char *end,
+	const char *seq, size_t seq_len)
+{
+	const char *p;
+
+	while (text < end && (p = memchr(text, seq[0], end - text))) {
+		if ((size_t)(end - p) < seq_len)
+			return NULL;
+		if (memcmp(p, seq, seq_len) == 0)
+			return p;
+		text = p + 1;
+	}
+
+	return NULL;
+}
+
 static void strip_comment(char *buf, const GString *prefix)
 {
 	char *ptr;
@@ -776,6 +823,7 @@ static char **split_line(char *buf, struct context *inc)
  * Parse a multi-bit field into several logic channels.
  *
  * @param[in] column	The input text, a run of bin/hex/oct digits.
+ * @param[in] length	The input text's length.
  * @param[in] inc	The input module's context.
  * @param[in] details	The column processing details.
  *
@@ -785,10 +833,10 @@ static char **split_line(char *buf, struct context *inc)
  * This routine modifies the logic levels in the current sample set,
  * based on the text input and a user provided format spec.
  */
-static int parse_logic(const char *column, struct context *inc,
-	const struct column_details *details)
+static int parse_logic(const char *column, size_t length,
+	struct context *inc, const struct column_details *details)
 {
-	size_t length, ch_rem, ch_idx, ch_inc;
+	size_t ch_rem, ch_idx, ch_inc;
 	const char *rdptr;
 	char c;
 	gboolean valid;
@@ -801,10 +849,10 @@ static int parse_logic(const char *column, struct context *inc,
 	 * on the value's radix). Prepare the mapping of text digits to
 	 * (a number of) logic channels.
 	 */
-	length = strlen(column);
 	if (!length) {
-		sr_err("Column %zu in line %zu is empty.", details->col_nr,
-			inc->line_number);
+		if (!inc->quiet)
+			sr_err("Column %zu in line %zu is empty.",
+				details->col_nr, inc->line_number);
 		return SR_ERR;
 	}
 	rdptr = &column[length];
@@ -838,8 +886,10 @@ static int parse_logic(const char *column, struct context *inc,
 		}
 		if (!valid) {
 			type_text = col_format_text[details->text_format];
-			sr_err("Invalid text '%s' in %s type column %zu in line %zu.",
-				column, type_text, details->col_nr, inc->line_number);
+			if (!inc->quiet)
+				sr_err("Invalid text '%.*s' in %s type column %zu in line %zu.",
+					(int)length, column, type_text,
+					details->col_nr, inc->line_number);
 			return SR_ERR;
 		}
 		/* Use the digit's bits for logic channels' data. */
@@ -886,6 +936,7 @@ static int parse_logic(const char *column, struct context *inc,
  * Parse a floating point text into an analog value.
  *
  * @param[in] column	The input text, a floating point number.
+ * @param[in] length	The input text's length.
  * @param[in] inc	The input module's context.
  * @param[in] details	The column processing details.
  *
@@ -895,38 +946,30 @@ static int parse_logic(const char *column, struct context *inc,
  * This routine modifies the analog values in the current sample set,
  * based on the text input and a user provided format spec.
  */
-static int parse_analog(const char *column, struct context *inc,
-	const struct column_details *details)
+static int parse_analog(const char *column, size_t length,
+	struct context *inc, const struct column_details *details)
 {
-	size_t length;
-	double dvalue; float fvalue;
-	csv_analog_t value;
+	double dvalue;
 	int ret;
 
 	if (!format_is_analog(details->text_format))
 		return SR_ERR_BUG;
 
-	length = strlen(column);
 	if (!length) {
-		sr_err("Column %zu in line %zu is empty.", details->col_nr,
-			inc->line_number);
+		if (!inc->quiet)
+			sr_err("Column %zu in line %zu is empty.",
+				details->col_nr, inc->line_number);
 		return SR_ERR;
 	}
-	if (sizeof(value) == sizeof(double)) {
-		ret = sr_atod_ascii(column, &dvalue);
-		value = dvalue;
-	} else if (sizeof(value) == sizeof(float)) {
-		ret = sr_atof_ascii(column, &fvalue);
-		value = fvalue;
-	} else {
-		ret = SR_ERR_BUG;
-	}
+	ret = sr_atod_ascii_len(column, length, &dvalue);
 	if (ret != SR_OK) {
-		sr_err("Cannot parse analog text %s in column %zu in line %zu.",
-			column, details->col_nr, inc->line_number);
+		if (!inc->quiet)
+			sr_err("Cannot parse analog text %.*s in column %zu in line %zu.",
+				(int)length, column, details->col_nr,
+				inc->line_number);
 		return SR_ERR_DATA;
 	}
-	set_analog_value(inc, details->channel_offset, value);
+	set_analog_value(inc, details->channel_offset, dvalue);
 
 	return SR_OK;
 }
@@ -935,6 +978,7 @@ static int parse_analog(const char *column, struct context *inc,
  * Parse a timestamp text, auto-determine samplerate.
  *
  * @param[in] column	The input text, a floating point number.
+ * @param[in] length	The input text's length.
  * @param[in] inc	The input module's context.
  * @param[in] details	The column processing details.
  *
@@ -945,8 +989,8 @@ static int parse_analog(const char *column, struct context *inc,
  * samplerate from text rows' timestamp values. Only simple formats are
  * supported, user provided values always take precedence.
  */
-static int parse_timestamp(const char *column, struct context *inc,
-	const struct column_details *details)
+static int parse_timestamp(const char *column, size_t length,
+	struct context *inc, const struct column_details *details)
 {
 	double ts, rate;
 	int ret;
@@ -985,12 +1029,12 @@ static int parse_timestamp(const char *column, struct context *inc,
 	 */
 	if (inc->calc_samplerate)
 		return SR_OK;
-	ret = sr_atod_ascii(column, &ts);
+	ret = sr_atod_ascii_len(column, length, &ts);
 	if (ret != SR_OK)
 		ts = 0.0;
 	if (!ts) {
-		sr_info("Cannot convert timestamp text %s in line %zu (or zero value).",
-			column, inc->line_number);
+		sr_info("Cannot convert timestamp text %.*s in line %zu (or zero value).",
+			(int)length, column, inc->line_number);
 		inc->prev_timestamp = 0.0;
 		return SR_OK;
 	}
@@ -1026,18 +1070,19 @@ static int parse_timestamp(const char *column, struct context *inc,
  * This routine exists to unify dispatch code paths, mapping input file
  * columns' data types to their respective parse routines.
  */
-static int parse_ignore(const char *column, struct context *inc,
-	const struct column_details *details)
+static int parse_ignore(const char *column, size_t length,
+	struct context *inc, const struct column_details *details)
 {
 	(void)column;
+	(void)length;
 	(void)inc;
 	(void)details;
 
 	return SR_OK;
 }
 
-typedef int (*col_parse_cb)(const char *column, struct context *inc,
-	const struct column_details *details);
+typedef int (*col_parse_cb)(const char *column, size_t length,
+	struct context *inc, const struct column_details *details);
 
 static const col_parse_cb col_parse_funcs[] = {
 	[FORMAT_NONE] = parse_ignore,
@@ -1218,6 +1263,7 @@ static int init(struct sr_input *in, GHashTable *options)
 		sr_err("Invalid start line %zu.", inc->start_line);
 		return SR_ERR_ARG;
 	}
+	inc->threads = g_variant_get_uint32(g_hash_table_lookup(options, "threads"));
 
 	/*
 	 * Scan flexible, to get prefered format specs which describe
@@ -1527,21 +1573,345 @@ static int initial_receive(const struct sr_input *in)
 	return ret;
 }
 
-static int process_buffer(struct sr_input *in, gboolean is_eof)
+/* Remove a trailing comment, and whitespace around the remaining text. */
+static void trim_comment(const struct context *inc,
+	const char **line, const char **end)
 {
-	struct context *inc;
-	gsize num_columns;
-	size_t line_idx, col_idx, col_nr;
+	const char *sep;
+
+	if (!inc->comment->len)
+		return;
+	sep = find_seq(*line, *end, inc->comment->str, inc->comment->len);
+	if (!sep)
+		return;
+	while (*line < sep && g_ascii_isspace((*line)[0]))
+		(*line)++;
+	while (sep > *line && g_ascii_isspace(sep[-1]))
+		sep--;
+	*end = sep;
+}
+
+/*
+ * Locate the columns in a text line, and have them parsed into the
+ * current sample set. Text after the last column of interest is not
+ * inspected.
+ */
+static int parse_columns(struct context *inc, const char *line,
+	const char *end)
+{
+	size_t col_idx, col_nr;
 	const struct column_details *details;
 	col_parse_cb parse_func;
+	const char *column, *col_end, *sep;
+	int ret;
+
+	/* Locate the columns, check for minimum length. */
+	column = line;
+	for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+		if (!column) {
+			if (!inc->quiet)
+				sr_err("Insufficient column count %zu in line %zu.",
+					col_idx, inc->line_number);
+			return SR_ERR;
+		}
+		sep = find_seq(column, end,
+			inc->delimiter->str, inc->delimiter->len);
+		col_end = sep ? sep : end;
+		while (col_end > column && g_ascii_isspace(col_end[-1]))
+			col_end--;
+		inc->column_text[col_idx].text = column;
+		inc->column_text[col_idx].length = col_end - column;
+		column = sep ? sep + inc->delimiter->len : NULL;
+	}
+
+	/* Have the columns processed. */
+	for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+		col_nr = col_idx + 1;
+		details = lookup_column_details(inc, col_nr);
+		if (!details || !details->text_format)
+			continue;
+		parse_func = col_parse_funcs[details->text_format];
+		if (!parse_func)
+			continue;
+		ret = parse_func(inc->column_text[col_idx].text,
+			inc->column_text[col_idx].length, inc, details);
+		if (ret != SR_OK)
+			return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Process one text line. The text is not NUL terminated, and remains
+ * in the input buffer. Columns get located and parsed in place.
+ */
+static int process_line(struct sr_input *in, const char *line,
+	const char *end)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+
+	inc->line_number++;
+	if (inc->line_number < inc->start_line) {
+		sr_spew("Line %zu skipped (before start).", inc->line_number);
+		return SR_OK;
+	}
+	if (line == end) {
+		sr_spew("Blank line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Remove trailing comment. */
+	trim_comment(inc, &line, &end);
+	if (line == end) {
+		sr_spew("Comment-only line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->use_header && !inc->header_seen) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header_seen = TRUE;
+		return SR_OK;
+	}
+
+	/* Have the columns of the current text line processed. */
+	clear_logic_samples(inc);
+	clear_analog_samples(inc);
+	ret = parse_columns(inc, line, end);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Send sample data to the session bus (buffered). */
+	ret = queue_logic_samples(in);
+	ret += queue_analog_samples(in);
+	if (ret != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Parallel parsing splits a run of text lines into parts, which worker
+ * threads parse into rows of sample data. The calling thread then queues
+ * the rows for submission, in the order of the input text. The result is
+ * identical to processing the lines one after another.
+ *
+ * Workers use a copy of the context, with their own sample memory. They
+ * stop at the first line which fails to parse, without logging. That
+ * line gets processed again in the calling thread, which reports the
+ * error with the correct line number.
+ */
+struct parse_job {
+	struct context inc;
+	const char *text, *end;
+	size_t line_count;
+	size_t row_count, row_alloc;
+	uint8_t *logic_rows;
+	csv_analog_t *analog_rows;
+	struct column_text *column_text;
+	const char *fail_line, *fail_end;
+};
+
+static void parse_job_run(gpointer data, gpointer user_data)
+{
+	struct parse_job *job;
+	struct context *inc;
+	const char *line, *eol, *text, *end;
+	size_t term_len;
+
+	(void)user_data;
+
+	job = data;
+	inc = &job->inc;
+	term_len = strlen(inc->termination);
+
+	line = job->text;
+	do {
+		eol = find_seq(line, job->end, inc->termination, term_len);
+		text = line;
+		end = eol ? eol : job->end;
+		if (text != end)
+			trim_comment(inc, &text, &end);
+		if (text != end) {
+			if (job->row_count == job->row_alloc) {
+				job->row_alloc = job->row_alloc ? 2 * job->row_alloc : 1024;
+				job->logic_rows = g_realloc(job->logic_rows,
+					job->row_alloc * inc->sample_unit_size);
+				job->analog_rows = g_realloc(job->analog_rows,
+					job->row_alloc * inc->analog_channels *
+					sizeof(job->analog_rows[0]));
+			}
+			if (inc->logic_channels) {
+				inc->sample_buffer = &job->logic_rows[
+					job->row_count * inc->sample_unit_size];
+				memset(inc->sample_buffer, 0, inc->sample_unit_size);
+			}
+			if (inc->analog_channels) {
+				inc->analog_sample_buffer = &job->analog_rows[
+					job->row_count * inc->analog_channels];
+				memset(inc->analog_sample_buffer, 0,
+					inc->analog_channels * sizeof(job->analog_rows[0]));
+			}
+			if (parse_columns(inc, text, end) != SR_OK) {
+				job->fail_line = line;
+				job->fail_end = eol ? eol : job->end;
+				return;
+			}
+			job->row_count++;
+		}
+		job->line_count++;
+		if (eol)
+			line = eol + term_len;
+	} while (eol);
+}
+
+static void parse_jobs_free(struct context *inc)
+{
+	size_t idx;
+
+	sr_input_workers_free(inc->workers);
+	inc->workers = NULL;
+	for (idx = 0; idx < inc->job_count; idx++) {
+		g_free(inc->jobs[idx]->logic_rows);
+		g_free(inc->jobs[idx]->analog_rows);
+		g_free(inc->jobs[idx]->column_text);
+		g_free(inc->jobs[idx]);
+	}
+	g_free(inc->jobs);
+	inc->jobs = NULL;
+	inc->job_count = 0;
+}
+
+/*
+ * Check whether subsequent text lines can get parsed in parallel. Line
+ * numbers, the header line, and samplerate detection from timestamps
+ * depend on previous lines, and are handled by the serial code path.
+ */
+static gboolean parallel_ready(struct context *inc)
+{
+	size_t col_idx;
+
+	if (!inc->workers)
+		return FALSE;
+	if (inc->line_number + 1 < inc->start_line)
+		return FALSE;
+	if (inc->use_header && !inc->header_seen)
+		return FALSE;
+	if (!inc->calc_samplerate) {
+		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+			if (format_is_timestamp(inc->column_details[col_idx].text_format))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Process a run of text lines on the worker threads. */
+static int process_parallel(struct sr_input *in, const char *text,
+	const char *end)
+{
+	struct context *inc;
+	struct parse_job *job;
+	size_t term_len, count, idx, row, ch;
+	const char *start, *pos, *eol;
+	int ret;
+
+	inc = in->priv;
+	term_len = strlen(inc->termination);
+
+	if (!inc->jobs) {
+		inc->job_count = sr_input_workers_count(inc->workers);
+		inc->jobs = g_malloc0(inc->job_count * sizeof(inc->jobs[0]));
+		for (idx = 0; idx < inc->job_count; idx++) {
+			job = g_malloc0(sizeof(*job));
+			job->column_text = g_malloc0(inc->column_want_count *
+				sizeof(job->column_text[0]));
+			inc->jobs[idx] = job;
+		}
+	}
+
+	/* Split the text at line boundaries, into parts of similar size. */
+	start = text;
+	for (count = 0; start && count < inc->job_count; count++) {
+		job = inc->jobs[count];
+		job->inc = *inc;
+		job->inc.quiet = TRUE;
+		job->inc.column_text = job->column_text;
+		job->inc.analog_datafeed_buf_size = 1;
+		job->line_count = 0;
+		job->row_count = 0;
+		job->fail_line = NULL;
+		job->text = start;
+		job->end = end;
+		start = NULL;
+		if (count + 1 < inc->job_count) {
+			pos = text + (end - text) / inc->job_count * (count + 1);
+			if (pos < job->text)
+				pos = job->text;
+			eol = find_seq(pos, end, inc->termination, term_len);
+			if (eol) {
+				job->end = eol;
+				start = eol + term_len;
+			}
+		}
+	}
+
+	sr_input_workers_run(inc->workers, (gpointer *)inc->jobs, count);
+
+	/* Queue the rows for submission, in the order of the input text. */
+	for (idx = 0; idx < count; idx++) {
+		job = inc->jobs[idx];
+		for (row = 0; row < job->row_count; row++) {
+			clear_logic_samples(inc);
+			if (inc->logic_channels) {
+				memcpy(inc->sample_buffer,
+					&job->logic_rows[row * inc->sample_unit_size],
+					inc->sample_unit_size);
+			}
+			clear_analog_samples(inc);
+			for (ch = 0; ch < inc->analog_channels; ch++) {
+				set_analog_value(inc, ch, job->analog_rows[
+					row * inc->analog_channels + ch]);
+			}
+			ret = queue_logic_samples(in);
+			ret += queue_analog_samples(in);
+			if (ret != SR_OK) {
+				sr_err("Sending samples failed.");
+				return SR_ERR;
+			}
+		}
+		inc->line_number += job->line_count;
+		if (job->fail_line) {
+			ret = process_line(in, job->fail_line, job->fail_end);
+			return ret != SR_OK ? ret : SR_ERR;
+		}
+	}
+
+	return SR_OK;
+}
+
+static int process_buffer(struct sr_input *in, gboolean is_eof)
+{
+	struct context *inc;
+	size_t term_len;
 	int ret;
 	char *processed_up_to;
-	char **lines, *line, **columns, *column;
+	const char *line, *eol, *end;
 
 	inc = in->priv;
 	if (!inc->started) {
 		std_session_send_df_header(in->sdi);
 		inc->started = TRUE;
+		if (inc->threads != 1)
+			inc->workers = sr_input_workers_new(inc->threads,
+				parse_job_run, NULL);
 	}
 
 	/*
@@ -1559,97 +1929,45 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	 */
 	if (!in->buf->len)
 		return SR_OK;
+	if (inc->workers && !is_eof && in->buf->len <
+			PARALLEL_CHUNK * sr_input_workers_count(inc->workers))
+		return SR_OK;
+	term_len = strlen(inc->termination);
 	if (is_eof) {
+		end = in->buf->str + in->buf->len;
 		processed_up_to = in->buf->str + in->buf->len;
 	} else {
 		processed_up_to = g_strrstr_len(in->buf->str, in->buf->len,
 			inc->termination);
 		if (!processed_up_to)
 			return SR_OK;
-		*processed_up_to = '\0';
-		processed_up_to += strlen(inc->termination);
+		end = processed_up_to;
+		processed_up_to += term_len;
 	}
 
-	/* Split input text lines and process their columns. */
-	ret = SR_OK;
-	lines = g_strsplit(in->buf->str, inc->termination, 0);
-	for (line_idx = 0; (line = lines[line_idx]); line_idx++) {
-		inc->line_number++;
-		if (inc->line_number < inc->start_line) {
-			sr_spew("Line %zu skipped (before start).", inc->line_number);
-			continue;
-		}
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->use_header && !inc->header_seen) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header_seen = TRUE;
-			continue;
-		}
-
-		/* Split the line into columns, check for minimum length. */
-		columns = split_line(line, inc);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (num_columns < inc->column_want_count) {
-			sr_err("Insufficient column count %zu in line %zu.",
-				num_columns, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		/* Have the columns of the current text line processed. */
-		clear_logic_samples(inc);
-		clear_analog_samples(inc);
-		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
-			column = columns[col_idx];
-			col_nr = col_idx + 1;
-			details = lookup_column_details(inc, col_nr);
-			if (!details || !details->text_format)
-				continue;
-			parse_func = col_parse_funcs[details->text_format];
-			if (!parse_func)
-				continue;
-			ret = parse_func(column, inc, details);
-			if (ret != SR_OK) {
-				g_strfreev(columns);
-				g_strfreev(lines);
-				return SR_ERR;
-			}
-		}
-
-		/* Send sample data to the session bus (buffered). */
-		ret = queue_logic_samples(in);
-		ret += queue_analog_samples(in);
-		if (ret != SR_OK) {
-			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
+	/*
+	 * Walk the text lines in the input buffer, process their columns.
+	 * Nothing gets copied or allocated, text is parsed where it is.
+	 * Have large amounts of text parsed in parallel when possible.
+	 */
+	line = in->buf->str;
+	do {
+		if (end - line >= PARALLEL_CHUNK && parallel_ready(inc)) {
+			ret = process_parallel(in, line, end);
+			if (ret != SR_OK)
+				return ret;
+			break;
 		}
-
-		g_strfreev(columns);
-	}
-	g_strfreev(lines);
+		eol = find_seq(line, end, inc->termination, term_len);
+		ret = process_line(in, line, eol ? eol : end);
+		if (ret != SR_OK)
+			return ret;
+		if (eol)
+			line = eol + term_len;
+	} while (eol);
 	g_string_erase(in->buf, 0, processed_up_to - in->buf->str);
 
-	return ret;
+	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
@@ -1724,6 +2042,9 @@ static void cleanup(struct sr_input *in)
 	/* TODO Release channel names (before releasing details). */
 	g_free(inc->column_details);
 	inc->column_details = NULL;
+	g_free(inc->column_text);
+	inc->column_text = NULL;
+	parse_jobs_free(inc);
 
 	/* Clear internal state, but keep what .init() has provided. */
 	save_ctx = *inc;
@@ -1736,6 +2057,7 @@ static void cleanup(struct sr_input *in)
 	inc->use_header = save_ctx.use_header;
 	inc->prev_sr_channels = save_ctx.prev_sr_channels;
 	inc->prev_df_channels = save_ctx.prev_df_channels;
+	inc->threads = save_ctx.threads;
 }
 
 static int reset(struct sr_input *in)
@@ -1761,6 +2083,7 @@ enum option_index {
 	OPT_SAMPLERATE,
 	OPT_COL_SEP,
 	OPT_COMMENT,
+	OPT_THREADS,
 	OPT_MAX,
 };
 
@@ -1815,6 +2138,11 @@ static struct sr_option options[] = {
 		"The text which starts comments at the end of text lines, semicolon by default.",
 		NULL, NULL,
 	},
+	[OPT_THREADS] = {
+		"threads", "Parser threads",
+		"The number of threads which parse the input text, 1 by default. 0 uses one thread per processor.",
+		NULL, NULL,
+	},
 	[OPT_MAX] = ALL_ZERO,
 };
 
@@ -1838,6 +2166,7 @@ static const struct sr_option *get_options(void)
 		options[OPT_SAMPLERATE].def = g_variant_ref_sink(g_variant_new_uint64(0));
 		options[OPT_COL_SEP].def = g_variant_ref_sink(g_variant_new_string(","));
 		options[OPT_COMMENT].def = g_variant_ref_sink(g_variant_new_string(";"));
+		options[OPT_THREADS].def = g_variant_ref_sink(g_variant_new_uint32(1));
 	}
 
 	return options;
@@ -29,6 +29,9 @@ struct feed_queue_logic {
 	uint8_t *data_bytes;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	gboolean is_rle;
+	uint64_t *run_lengths;
+	struct sr_datafeed_logic_rle logic_rle;
 };
 
 SR_API struct feed_queue_logic *feed_queue_logic_alloc(
@@ -57,22 +60,117 @@ SR_API struct feed_queue_logic *feed_queue_logic_alloc(
 	return q;
 }
 
-SR_API int feed_queue_logic_submit_one(struct feed_queue_logic *q,
+/*
+ * Allocate a queue which accumulates runs of sample values, and sends
+ * SR_DF_LOGIC_RLE packets to the session. The run_count specifies how
+ * many (value, length) pairs get buffered before a flush is forced.
+ * Submission of repeated values then is independent of the repeat
+ * count, as is the amount of data which gets passed to the session.
+ */
+SR_API struct feed_queue_logic *feed_queue_logic_alloc_rle(
+	const struct sr_dev_inst *sdi,
+	size_t run_count, size_t unit_size)
+{
+	struct feed_queue_logic *q;
+
+	q = feed_queue_logic_alloc(sdi, run_count, unit_size);
+	if (!q)
+		return NULL;
+	q->run_lengths = g_try_malloc(q->alloc_count * sizeof(q->run_lengths[0]));
+	if (!q->run_lengths) {
+		feed_queue_logic_free(q);
+		return NULL;
+	}
+
+	q->is_rle = TRUE;
+	q->packet.type = SR_DF_LOGIC_RLE;
+	q->packet.payload = &q->logic_rle;
+	q->logic_rle.unitsize = q->unit_size;
+	q->logic_rle.values = q->data_bytes;
+	q->logic_rle.lengths = q->run_lengths;
+
+	return q;
+}
+
+static int feed_queue_logic_submit_run(struct feed_queue_logic *q,
 	const uint8_t *data, size_t repeat_count)
 {
 	uint8_t *wrptr;
 	int ret;
 
+	if (!repeat_count)
+		return SR_OK;
+
+	/* Extend the most recent run when the value did not change. */
+	if (q->fill_count) {
+		wrptr = &q->data_bytes[(q->fill_count - 1) * q->unit_size];
+		if (memcmp(wrptr, data, q->unit_size) == 0) {
+			q->run_lengths[q->fill_count - 1] += repeat_count;
+			q->logic_rle.num_samples += repeat_count;
+			return SR_OK;
+		}
+	}
+
 	wrptr = &q->data_bytes[q->fill_count * q->unit_size];
-	while (repeat_count--) {
-		memcpy(wrptr, data, q->unit_size);
-		wrptr += q->unit_size;
-		q->fill_count++;
+	memcpy(wrptr, data, q->unit_size);
+	q->run_lengths[q->fill_count] = repeat_count;
+	q->logic_rle.num_samples += repeat_count;
+	q->fill_count++;
+	if (q->fill_count == q->alloc_count) {
+		ret = feed_queue_logic_flush(q);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Replicate one sample value into a run of samples. Doubles the size
+ * of the copied block in each step, instead of copying sample by sample.
+ */
+static void fill_repeated(uint8_t *wrptr, const uint8_t *data,
+	size_t unit_size, size_t count)
+{
+	size_t done, copy_count;
+
+	if (!count)
+		return;
+	if (unit_size == 1) {
+		memset(wrptr, data[0], count);
+		return;
+	}
+
+	memcpy(wrptr, data, unit_size);
+	done = 1;
+	while (done < count) {
+		copy_count = MIN(done, count - done);
+		memcpy(&wrptr[done * unit_size], wrptr, copy_count * unit_size);
+		done += copy_count;
+	}
+}
+
+SR_API int feed_queue_logic_submit_one(struct feed_queue_logic *q,
+	const uint8_t *data, size_t repeat_count)
+{
+	uint8_t *wrptr;
+	size_t space, copy_count;
+	int ret;
+
+	if (q->is_rle)
+		return feed_queue_logic_submit_run(q, data, repeat_count);
+
+	while (repeat_count) {
+		space = q->alloc_count - q->fill_count;
+		copy_count = MIN(repeat_count, space);
+		wrptr = &q->data_bytes[q->fill_count * q->unit_size];
+		fill_repeated(wrptr, data, q->unit_size, copy_count);
+		q->fill_count += copy_count;
+		repeat_count -= copy_count;
 		if (q->fill_count == q->alloc_count) {
 			ret = feed_queue_logic_flush(q);
 			if (ret != SR_OK)
 				return ret;
-			wrptr = &q->data_bytes[0];
 		}
 	}
 
@@ -86,6 +184,16 @@ SR_API int feed_queue_logic_submit_many(struct feed_queue_logic *q,
 	size_t space, copy_count;
 	int ret;
 
+	if (q->is_rle) {
+		while (samples_count--) {
+			ret = feed_queue_logic_submit_run(q, data, 1);
+			if (ret != SR_OK)
+				return ret;
+			data += q->unit_size;
+		}
+		return SR_OK;
+	}
+
 	wrptr = &q->data_bytes[q->fill_count * q->unit_size];
 	while (samples_count) {
 		space = q->alloc_count - q->fill_count;
@@ -116,10 +224,12 @@ SR_API int feed_queue_logic_flush(struct feed_queue_logic *q)
 		return SR_OK;
 
 	q->logic.length = q->fill_count * q->unit_size;
+	q->logic_rle.num_runs = q->fill_count;
 	ret = sr_session_send(q->sdi, &q->packet);
 	if (ret != SR_OK)
 		return ret;
 	q->fill_count = 0;
+	q->logic_rle.num_samples = 0;
 
 	return SR_OK;
 }
@@ -146,6 +256,7 @@ SR_API void feed_queue_logic_free(struct feed_queue_logic *q)
 		return;
 
 	g_free(q->data_bytes);
+	g_free(q->run_lengths);
 	g_free(q);
 }
 
@@ -233,10 +344,18 @@ SR_API int feed_queue_analog_scale_offset(struct feed_queue_analog *q,
 SR_API int feed_queue_analog_submit_one(struct feed_queue_analog *q,
 	float data, size_t repeat_count)
 {
+	float *wrptr;
+	size_t space, copy_count, idx;
 	int ret;
 
-	while (repeat_count--) {
-		q->data_values[q->fill_count++] = data;
+	while (repeat_count) {
+		space = q->alloc_count - q->fill_count;
+		copy_count = MIN(repeat_count, space);
+		wrptr = &q->data_values[q->fill_count];
+		for (idx = 0; idx < copy_count; idx++)
+			wrptr[idx] = data;
+		q->fill_count += copy_count;
+		repeat_count -= copy_count;
 		if (q->fill_count == q->alloc_count) {
 			ret = feed_queue_analog_flush(q);
 			if (ret != SR_OK)
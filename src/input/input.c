@@ -31,6 +31,7 @@
 
 /** @cond PRIVATE */
 #define CHUNK_SIZE	(4 * 1024 * 1024)
+#define INPUT_MAX_THREADS	64
 /** @endcond */
 
 /**
@@ -703,4 +704,145 @@ SR_API void sr_input_free(const struct sr_input *in)
 	g_free((gpointer)in);
 }
 
+/** @cond PRIVATE */
+struct sr_input_workers {
+	GThreadPool *pool;
+	size_t threads;
+	GFunc func;
+	gpointer user_data;
+	GMutex mutex;
+	GCond cond;
+	size_t pending;
+};
+/** @endcond */
+
+static void workers_thread(gpointer data, gpointer user_data)
+{
+	struct sr_input_workers *workers;
+
+	workers = user_data;
+	workers->func(data, workers->user_data);
+
+	g_mutex_lock(&workers->mutex);
+	workers->pending--;
+	g_cond_broadcast(&workers->cond);
+	g_mutex_unlock(&workers->mutex);
+}
+
+/**
+ * Create worker threads which input modules can parse text on.
+ *
+ * @param threads The number of threads. 0 selects one per processor.
+ * @param func The routine which processes one job.
+ * @param user_data Passed to @a func as its second argument.
+ *
+ * @return The workers, or NULL when fewer than two threads would get
+ *         used (callers should process their input in the calling
+ *         thread then), or upon error.
+ *
+ * @private
+ */
+SR_PRIV struct sr_input_workers *sr_input_workers_new(size_t threads,
+		GFunc func, gpointer user_data)
+{
+	struct sr_input_workers *workers;
+	GError *error;
+
+	if (!threads) {
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		threads = g_get_num_processors();
+#else
+		threads = 2;
+#endif
+	}
+	threads = MIN(threads, INPUT_MAX_THREADS);
+	if (threads < 2 || !func)
+		return NULL;
+
+	workers = g_malloc0(sizeof(*workers));
+	workers->threads = threads;
+	workers->func = func;
+	workers->user_data = user_data;
+	g_mutex_init(&workers->mutex);
+	g_cond_init(&workers->cond);
+
+	error = NULL;
+	workers->pool = g_thread_pool_new(workers_thread, workers,
+		threads, TRUE, &error);
+	if (!workers->pool) {
+		sr_err("Cannot create parser threads: %s.", error->message);
+		g_error_free(error);
+		sr_input_workers_free(workers);
+		return NULL;
+	}
+	sr_dbg("Parsing input on %zu threads.", threads);
+
+	return workers;
+}
+
+/**
+ * Get the number of worker threads.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_input_workers_count(const struct sr_input_workers *workers)
+{
+	return workers ? workers->threads : 0;
+}
+
+/**
+ * Process a set of jobs on the worker threads, and wait for all of
+ * them to complete. Jobs may complete in any order.
+ *
+ * @param workers The workers.
+ * @param jobs The jobs, passed to the workers' routine one at a time.
+ * @param count The number of jobs.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_workers_run(struct sr_input_workers *workers,
+		gpointer *jobs, size_t count)
+{
+	GError *error;
+	size_t idx;
+
+	g_mutex_lock(&workers->mutex);
+	workers->pending += count;
+	g_mutex_unlock(&workers->mutex);
+
+	for (idx = 0; idx < count; idx++) {
+		error = NULL;
+		if (g_thread_pool_push(workers->pool, jobs[idx], &error))
+			continue;
+		/* Run the job in the calling thread instead. */
+		sr_warn("Cannot queue parser job: %s.", error->message);
+		g_error_free(error);
+		workers_thread(jobs[idx], workers);
+	}
+
+	g_mutex_lock(&workers->mutex);
+	while (workers->pending)
+		g_cond_wait(&workers->cond, &workers->mutex);
+	g_mutex_unlock(&workers->mutex);
+}
+
+/**
+ * Terminate worker threads and release their resources.
+ *
+ * @param workers The workers. May be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_workers_free(struct sr_input_workers *workers)
+{
+	if (!workers)
+		return;
+
+	if (workers->pool)
+		g_thread_pool_free(workers->pool, FALSE, TRUE);
+	g_cond_clear(&workers->cond);
+	g_mutex_clear(&workers->mutex);
+	g_free(workers);
+}
+
 /** @} */
@@ -45,6 +45,10 @@
  *   only this many timescale ticks. This can speed up operation on long
  *   captures (default 0, don't compress).
  *
+ * threads: The number of threads which parse the data section's text
+ *   (default 1, parse in the caller's thread). 0 selects one thread per
+ *   processor. Sample data is identical to single threaded parsing.
+ *
  * Based on Verilog standard IEEE Std 1364-2001 Version C
  *
  * Supported features:
@@ -114,6 +118,7 @@
 #include <glib.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -121,8 +126,11 @@
 #define LOG_PREFIX "input/vcd"
 
 #define CHUNK_SIZE (4 * 1024 * 1024)
+#define PARALLEL_CHUNK (256 * 1024)
 #define SCOPE_SEP '.'
 
+struct parse_job;
+
 struct context {
 	struct vcd_user_opt {
 		size_t maxchannels; /* sigrok channels (output) */
@@ -131,6 +139,7 @@ struct context {
 		uint64_t compress;
 		uint64_t skip_starttime;
 		gboolean skip_specified;
+		size_t threads;
 	} options;
 	gboolean use_skip;
 	gboolean started;
@@ -138,7 +147,9 @@ struct context {
 	uint64_t prev_timestamp;
 	uint64_t samplerate;
 	size_t vcdsignals; /* VCD signals (input) */
-	GSList *ignored_signals;
+	GHashTable *ignored_signals;
+	GHashTable *signals; /* VCD identifier -> list of vcd_channel */
+	struct vcd_channel **analog_channels;
 	gboolean data_after_timestamp;
 	gboolean ignore_end_keyword;
 	gboolean skip_until_end;
@@ -172,6 +183,9 @@ struct context {
 		GSList *sr_channels;
 		GSList *sr_groups;
 	} prev;
+	struct sr_input_workers *workers;
+	struct parse_job **jobs;
+	size_t job_count;
 };
 
 struct vcd_channel {
@@ -680,6 +694,15 @@ static int parse_scope(struct context *inc, char *contents, gboolean is_up)
 	return SR_OK;
 }
 
+static void ignore_signal(struct context *inc, const char *id)
+{
+	if (!inc->ignored_signals) {
+		inc->ignored_signals = g_hash_table_new_full(g_str_hash,
+			g_str_equal, g_free, NULL);
+	}
+	g_hash_table_insert(inc->ignored_signals, g_strdup(id), NULL);
+}
+
 /**
  * Parse a $var section which describes a VCD signal ("variable").
  *
@@ -725,8 +748,7 @@ static int parse_header_var(struct context *inc, char *contents)
 	} else if (is_str) {
 		sr_warn("Skipping id %s, name '%s%s', unsupported type '%s'.",
 			id, ref, idx ? idx : "", type);
-		inc->ignored_signals = g_slist_append(inc->ignored_signals,
-			g_strdup(id));
+		ignore_signal(inc, id);
 		return SR_OK;
 	} else {
 		sr_err("Unsupported signal type: '%s'", type);
@@ -763,8 +785,7 @@ static int parse_header_var(struct context *inc, char *contents)
 	if (inc->options.maxchannels && next_size > inc->options.maxchannels) {
 		sr_warn("Skipping '%s%s', exceeds requested channel count %zu.",
 			ref, idx ? idx : "", inc->options.maxchannels);
-		inc->ignored_signals = g_slist_append(inc->ignored_signals,
-			g_strdup(id));
+		ignore_signal(inc, id);
 		return SR_OK;
 	}
 
@@ -797,6 +818,30 @@ static int parse_header_var(struct context *inc, char *contents)
 	return SR_OK;
 }
 
+/*
+ * Map VCD identifiers to the (possibly several) signals which share
+ * them, in their order of declaration. Data lines then need not search
+ * the list of all signals for every value change.
+ */
+static void create_signal_map(struct context *inc)
+{
+	GSList *l, *list;
+	struct vcd_channel *vcd_ch;
+
+	inc->signals = g_hash_table_new_full(g_str_hash, g_str_equal,
+		NULL, (GDestroyNotify)g_slist_free);
+	for (l = inc->channels; l; l = l->next) {
+		vcd_ch = l->data;
+		list = g_hash_table_lookup(inc->signals, vcd_ch->identifier);
+		if (list) {
+			list = g_slist_append(list, vcd_ch);
+			continue;
+		}
+		list = g_slist_append(NULL, vcd_ch);
+		g_hash_table_insert(inc->signals, vcd_ch->identifier, list);
+	}
+}
+
 /**
  * Construct the name of the nth sigrok channel for a VCD signal.
  *
@@ -969,10 +1014,13 @@ static void create_feeds(const struct sr_input *in)
 	}
 
 	/* Create one feed per analog channel. */
+	inc->analog_channels = g_malloc0(inc->analog_count *
+		sizeof(inc->analog_channels[0]));
 	for (l = inc->channels; l; l = l->next) {
 		vcd_ch = l->data;
 		if (vcd_ch->type != SR_CHANNEL_ANALOG)
 			continue;
+		inc->analog_channels[vcd_ch->array_index] = vcd_ch;
 		ch_idx = vcd_ch->array_index;
 		ch_idx += inc->logic_count;
 		ch = g_slist_nth_data(in->sdi->channels, ch_idx);
@@ -1108,6 +1156,7 @@ done_section:
 	if (!check_header_in_reread(in))
 		return SR_ERR_DATA;
 	create_feeds(in);
+	create_signal_map(inc);
 
 	/*
 	 * Allocate space for text to number conversion, and buffers to
@@ -1154,8 +1203,7 @@ done_section:
 static void add_samples(const struct sr_input *in, size_t count, gboolean flush)
 {
 	struct context *inc;
-	GSList *ch_list;
-	struct vcd_channel *vcd_ch;
+	size_t idx;
 	struct feed_queue_analog *q;
 	float value;
 
@@ -1167,31 +1215,23 @@ static void add_samples(const struct sr_input *in, size_t count, gboolean flush)
 		if (flush)
 			feed_queue_logic_flush(inc->feed_logic);
 	}
-	for (ch_list = inc->channels; ch_list; ch_list = ch_list->next) {
-		vcd_ch = ch_list->data;
-		if (vcd_ch->type != SR_CHANNEL_ANALOG)
-			continue;
-		q = vcd_ch->feed_analog;
+	for (idx = 0; idx < inc->analog_count; idx++) {
+		q = inc->analog_channels[idx]->feed_analog;
 		if (!q)
 			continue;
-		value = inc->current_floats[vcd_ch->array_index];
+		value = inc->current_floats[idx];
 		feed_queue_analog_submit_one(q, value, count);
 		if (flush)
 			feed_queue_analog_flush(q);
 	}
 }
 
-static gint vcd_compare_id(gconstpointer a, gconstpointer b)
-{
-	return strcmp((const char *)a, (const char *)b);
-}
-
 static gboolean is_ignored(struct context *inc, const char *id)
 {
-	GSList *ignored;
+	if (!inc->ignored_signals)
+		return FALSE;
 
-	ignored = g_slist_find_custom(inc->ignored_signals, id, vcd_compare_id);
-	return ignored != NULL;
+	return g_hash_table_contains(inc->ignored_signals, id);
 }
 
 /*
@@ -1241,10 +1281,9 @@ static void process_bits(struct context *inc, char *identifier,
 	size = 0;
 	have_int = FALSE;
 	int_val = 0;
-	for (l = inc->channels; l; l = l->next) {
+	l = g_hash_table_lookup(inc->signals, identifier);
+	for (; l; l = l->next) {
 		vcd_ch = l->data;
-		if (g_strcmp0(identifier, vcd_ch->identifier) != 0)
-			continue;
 		if (vcd_ch->type == SR_CHANNEL_ANALOG) {
 			/* Special case for 'integer' VCD signal types. */
 			size = vcd_ch->size; /* Flag for "VCD signal found". */
@@ -1315,12 +1354,11 @@ static void process_real(struct context *inc, char *identifier, float real_val)
 	struct vcd_channel *vcd_ch;
 
 	found = FALSE;
-	for (l = inc->channels; l; l = l->next) {
+	l = g_hash_table_lookup(inc->signals, identifier);
+	for (; l; l = l->next) {
 		vcd_ch = l->data;
 		if (vcd_ch->type != SR_CHANNEL_ANALOG)
 			continue;
-		if (g_strcmp0(identifier, vcd_ch->identifier) != 0)
-			continue;
 
 		/* Found our (analog) channel. */
 		found = TRUE;
@@ -1466,6 +1504,88 @@ static gboolean vcd_string_valid(const char *s)
 	return TRUE;
 }
 
+/*
+ * Numbers prefixed by '#' are timestamps, which translate to sigrok
+ * sample numbers. Apply optional downsampling, and apply the 'skip'
+ * logic. Check the recent timestamp for plausibility. Submit the
+ * corresponding number of samples of previously accumulated data
+ * values to the session feed.
+ */
+static int process_timestamp(const struct sr_input *in, uint64_t timestamp)
+{
+	struct context *inc;
+	int ret;
+	size_t count;
+
+	inc = in->priv;
+
+	sr_spew("Got timestamp: %" PRIu64, timestamp);
+	ret = ts_stats_check(&inc->ts_stats, timestamp);
+	if (ret != SR_OK)
+		return ret;
+	if (inc->options.downsample > 1) {
+		timestamp /= inc->options.downsample;
+		sr_spew("Downsampled timestamp: %" PRIu64, timestamp);
+	}
+
+	/*
+	 * Skip < 0 => skip until first timestamp.
+	 * Skip = 0 => don't skip
+	 * Skip > 0 => skip until timestamp >= skip.
+	 */
+	if (inc->options.skip_specified && !inc->use_skip) {
+		sr_dbg("Seeding skip from user spec %" PRIu64,
+			inc->options.skip_starttime);
+		inc->prev_timestamp = inc->options.skip_starttime;
+		inc->use_skip = TRUE;
+	}
+	if (!inc->use_skip) {
+		sr_dbg("Seeding skip from first timestamp");
+		inc->options.skip_starttime = timestamp;
+		inc->prev_timestamp = timestamp;
+		inc->use_skip = TRUE;
+		return SR_OK;
+	}
+	if (inc->options.skip_starttime && timestamp < inc->options.skip_starttime) {
+		sr_spew("Timestamp skipped, before user spec");
+		inc->prev_timestamp = inc->options.skip_starttime;
+		return SR_OK;
+	}
+	if (timestamp == inc->prev_timestamp) {
+		/*
+		 * Ignore repeated timestamps (e.g. sigrok outputs
+		 * these). Can also happen when downsampling makes
+		 * distinct input values end up at the same scaled
+		 * down value. Also transparently covers the initial
+		 * timestamp.
+		 */
+		sr_spew("Timestamp is identical to previous timestamp");
+		return SR_OK;
+	}
+	if (timestamp < inc->prev_timestamp) {
+		sr_err("Invalid timestamp: %" PRIu64 " (leap backwards).", timestamp);
+		return SR_ERR_DATA;
+	}
+	if (inc->options.compress) {
+		/* Compress long idle periods */
+		count = timestamp - inc->prev_timestamp;
+		if (count > inc->options.compress) {
+			sr_dbg("Long idle period, compressing");
+			count = timestamp - inc->options.compress;
+			inc->prev_timestamp = count;
+		}
+	}
+
+	/* Generate samples from prev_timestamp up to timestamp - 1. */
+	count = timestamp - inc->prev_timestamp;
+	sr_spew("Got a new timestamp, feeding %zu samples", count);
+	add_samples(in, count, FALSE);
+	inc->prev_timestamp = timestamp;
+	inc->data_after_timestamp = FALSE;
+
+	return SR_OK;
+}
+
 /* Parse one text line of the data section. */
 static int parse_textline(const struct sr_input *in, char *line)
 {
@@ -1476,7 +1596,6 @@ static int parse_textline(const struct sr_input *in, char *line)
 	gboolean is_real, is_multibit, is_singlebit, is_string;
 	uint64_t timestamp;
 	char *identifier, *endptr;
-	size_t count;
 
 	inc = in->priv;
 
@@ -1562,14 +1681,7 @@ static int parse_textline(const struct sr_input *in, char *line)
 			continue;
 		}
 
-		/*
-		 * Numbers prefixed by '#' are timestamps, which translate
-		 * to sigrok sample numbers. Apply optional downsampling,
-		 * and apply the 'skip' logic. Check the recent timestamp
-		 * for plausibility. Submit the corresponding number of
-		 * samples of previously accumulated data values to the
-		 * session feed.
-		 */
+		/* Numbers prefixed by '#' are timestamps. */
 		is_timestamp = curr_first == '#' && g_ascii_isdigit(curr_word[1]);
 		if (is_timestamp) {
 			endptr = NULL;
@@ -1579,71 +1691,9 @@ static int parse_textline(const struct sr_input *in, char *line)
 				ret = SR_ERR_DATA;
 				break;
 			}
-			sr_spew("Got timestamp: %" PRIu64, timestamp);
-			ret = ts_stats_check(&inc->ts_stats, timestamp);
+			ret = process_timestamp(in, timestamp);
 			if (ret != SR_OK)
 				break;
-			if (inc->options.downsample > 1) {
-				timestamp /= inc->options.downsample;
-				sr_spew("Downsampled timestamp: %" PRIu64, timestamp);
-			}
-
-			/*
-			 * Skip < 0 => skip until first timestamp.
-			 * Skip = 0 => don't skip
-			 * Skip > 0 => skip until timestamp >= skip.
-			 */
-			if (inc->options.skip_specified && !inc->use_skip) {
-				sr_dbg("Seeding skip from user spec %" PRIu64,
-					inc->options.skip_starttime);
-				inc->prev_timestamp = inc->options.skip_starttime;
-				inc->use_skip = TRUE;
-			}
-			if (!inc->use_skip) {
-				sr_dbg("Seeding skip from first timestamp");
-				inc->options.skip_starttime = timestamp;
-				inc->prev_timestamp = timestamp;
-				inc->use_skip = TRUE;
-				continue;
-			}
-			if (inc->options.skip_starttime && timestamp < inc->options.skip_starttime) {
-				sr_spew("Timestamp skipped, before user spec");
-				inc->prev_timestamp = inc->options.skip_starttime;
-				continue;
-			}
-			if (timestamp == inc->prev_timestamp) {
-				/*
-				 * Ignore repeated timestamps (e.g. sigrok
-				 * outputs these). Can also happen when
-				 * downsampling makes distinct input values
-				 * end up at the same scaled down value.
-				 * Also transparently covers the initial
-				 * timestamp.
-				 */
-				sr_spew("Timestamp is identical to previous timestamp");
-				continue;
-			}
-			if (timestamp < inc->prev_timestamp) {
-				sr_err("Invalid timestamp: %" PRIu64 " (leap backwards).", timestamp);
-				ret = SR_ERR_DATA;
-				break;
-			}
-			if (inc->options.compress) {
-				/* Compress long idle periods */
-				count = timestamp - inc->prev_timestamp;
-				if (count > inc->options.compress) {
-					sr_dbg("Long idle period, compressing");
-					count = timestamp - inc->options.compress;
-					inc->prev_timestamp = count;
-				}
-			}
-
-			/* Generate samples from prev_timestamp up to timestamp - 1. */
-			count = timestamp - inc->prev_timestamp;
-			sr_spew("Got a new timestamp, feeding %zu samples", count);
-			add_samples(in, count, FALSE);
-			inc->prev_timestamp = timestamp;
-			inc->data_after_timestamp = FALSE;
 			continue;
 		}
 		inc->data_after_timestamp = TRUE;
@@ -1863,6 +1913,363 @@ static int parse_textline(const struct sr_input *in, char *line)
 	return ret;
 }
 
+/*
+ * Parallel parsing splits a run of text lines into parts, which worker
+ * threads translate into lists of timestamps and value changes. The
+ * calling thread then applies these events in the order of the input
+ * text, which is where samples get generated. The result is identical
+ * to processing the lines one after another.
+ *
+ * Workers only read the input text and the channel setup, and assume
+ * that their part does not start within a skipped section. They stop
+ * at the first line which they cannot translate, without logging. The
+ * calling thread processes the remaining text line by line, starting
+ * at that line (or at the part which started in a section), so that
+ * errors get reported as usual.
+ */
+enum vcd_event_type {
+	EVENT_TIMESTAMP,
+	EVENT_BITS,
+	EVENT_REAL,
+	EVENT_STRING,
+};
+
+struct vcd_event {
+	enum vcd_event_type type;
+	uint64_t timestamp;
+	size_t id_offset;
+	size_t bits_offset;
+	size_t bit_count;
+	float real_val;
+};
+
+struct parse_job {
+	struct context *inc;
+	char *text, *end;
+	GArray *events;
+	GString *arena; /* Identifiers and bit values of events. */
+	gboolean skip_until_end;
+	gboolean ignore_end_keyword;
+	char *fail_line;
+};
+
+/* Isolate another word without modifying the text. */
+static const char *job_next_word(const char **pos, const char *end,
+	size_t *len)
+{
+	const char *p, *word;
+
+	p = *pos;
+	while (p < end && isspace((int)*p))
+		p++;
+	if (p == end)
+		return NULL;
+	word = p;
+	while (p < end && !isspace((int)*p))
+		p++;
+	*pos = p;
+	*len = p - word;
+
+	return word;
+}
+
+static gboolean word_is(const char *word, size_t len, const char *text)
+{
+	return len == strlen(text) && memcmp(word, text, len) == 0;
+}
+
+/* Copy text to the job's arena, NUL terminated. Returns its offset. */
+static size_t job_arena_add(struct parse_job *job, const char *text,
+	size_t len)
+{
+	size_t offset;
+
+	offset = job->arena->len;
+	g_string_append_len(job->arena, text, len);
+	g_string_append_c(job->arena, '\0');
+
+	return offset;
+}
+
+/* Translate one text line, mirrors parse_textline(). */
+static gboolean parse_job_line(struct parse_job *job, const char *line,
+	const char *end)
+{
+	struct context *inc;
+	struct vcd_event ev;
+	const char *word, *id, *bits, *p;
+	size_t len, id_len, offset, bit_idx;
+	char first;
+	uint8_t bit_value, *value;
+
+	inc = job->inc;
+
+	while ((word = job_next_word(&line, end, &len))) {
+		first = g_ascii_tolower(word[0]);
+
+		if (job->skip_until_end) {
+			if (word_is(word, len, "$end"))
+				job->skip_until_end = FALSE;
+			continue;
+		}
+		if (job->ignore_end_keyword && word_is(word, len, "$end")) {
+			job->ignore_end_keyword = FALSE;
+			continue;
+		}
+		if (first == '$' && len > 1) {
+			if (word_is(word, len, "$dumpvars") ||
+					word_is(word, len, "$dumpon") ||
+					word_is(word, len, "$dumpoff"))
+				job->ignore_end_keyword = TRUE;
+			else
+				job->skip_until_end = TRUE;
+			continue;
+		}
+
+		memset(&ev, 0, sizeof(ev));
+		if (first == '#' && len > 1 && g_ascii_isdigit(word[1])) {
+			ev.type = EVENT_TIMESTAMP;
+			for (p = &word[1]; p < &word[len]; p++) {
+				if (!g_ascii_isdigit(*p))
+					return FALSE;
+				if (ev.timestamp > (G_MAXUINT64 - 9) / 10)
+					return FALSE;
+				ev.timestamp = ev.timestamp * 10 + (*p - '0');
+			}
+			g_array_append_val(job->events, ev);
+			continue;
+		}
+
+		if (first == 'r' && len > 1) {
+			id = job_next_word(&line, end, &id_len);
+			if (!id)
+				return FALSE;
+			offset = job_arena_add(job, &word[1], len - 1);
+			if (sr_atof_ascii(&job->arena->str[offset], &ev.real_val) != SR_OK)
+				return FALSE;
+			g_string_truncate(job->arena, offset);
+			ev.type = EVENT_REAL;
+			ev.id_offset = job_arena_add(job, id, id_len);
+			g_array_append_val(job->events, ev);
+			continue;
+		}
+		if (first == 'b' && len > 1) {
+			id = job_next_word(&line, end, &id_len);
+			if (!id || len - 1 > inc->conv_bits.max_bits)
+				return FALSE;
+			ev.type = EVENT_BITS;
+			ev.id_offset = job_arena_add(job, id, id_len);
+			ev.bits_offset = job->arena->len;
+			ev.bit_count = len - 1;
+			g_string_set_size(job->arena,
+				ev.bits_offset + inc->conv_bits.unit_size);
+			value = (uint8_t *)&job->arena->str[ev.bits_offset];
+			memset(value, 0, inc->conv_bits.unit_size);
+			bits = &word[len];
+			for (bit_idx = 0; bit_idx < ev.bit_count; bit_idx++) {
+				bit_value = vcd_char_to_value(*(--bits), NULL);
+				if (bit_value == 1)
+					value[bit_idx / 8] |= 1 << (bit_idx % 8);
+				else if (bit_value != 0)
+					return FALSE;
+			}
+			g_array_append_val(job->events, ev);
+			continue;
+		}
+		if (strchr("01lhxzu-", first)) {
+			if (len > 1) {
+				id = &word[1];
+				id_len = len - 1;
+			} else {
+				id = job_next_word(&line, end, &id_len);
+				if (!id)
+					return FALSE;
+			}
+			bit_value = vcd_char_to_value(word[0], NULL);
+			if (bit_value != 0 && bit_value != 1)
+				return FALSE;
+			ev.type = EVENT_BITS;
+			ev.id_offset = job_arena_add(job, id, id_len);
+			ev.bits_offset = job->arena->len;
+			ev.bit_count = 1;
+			g_string_append_c(job->arena, bit_value);
+			g_array_append_val(job->events, ev);
+			continue;
+		}
+		if (first == 's') {
+			id = job_next_word(&line, end, &id_len);
+			if (!id)
+				return FALSE;
+			offset = job_arena_add(job, &word[1], len - 1);
+			if (!vcd_string_valid(&job->arena->str[offset]))
+				return FALSE;
+			g_string_truncate(job->arena, offset);
+			offset = job_arena_add(job, id, id_len);
+			if (!is_ignored(inc, &job->arena->str[offset]))
+				return FALSE;
+			g_string_truncate(job->arena, offset);
+			ev.type = EVENT_STRING;
+			g_array_append_val(job->events, ev);
+			continue;
+		}
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void parse_job_run(gpointer data, gpointer user_data)
+{
+	struct parse_job *job;
+	char *line, *eol;
+	size_t event_count, arena_len;
+	gboolean skip_until_end, ignore_end_keyword;
+
+	(void)user_data;
+
+	job = data;
+	g_array_set_size(job->events, 0);
+	g_string_truncate(job->arena, 0);
+	job->skip_until_end = FALSE;
+	job->ignore_end_keyword = FALSE;
+	job->fail_line = NULL;
+
+	/* The part ends in a line feed, each line has one. */
+	for (line = job->text; line < job->end; line = eol + 1) {
+		eol = memchr(line, '\n', job->end - line);
+		event_count = job->events->len;
+		arena_len = job->arena->len;
+		skip_until_end = job->skip_until_end;
+		ignore_end_keyword = job->ignore_end_keyword;
+		if (memchr(line, '\0', eol - line) ||
+				!parse_job_line(job, line, eol)) {
+			/* Leave the whole line to the calling thread. */
+			g_array_set_size(job->events, event_count);
+			g_string_truncate(job->arena, arena_len);
+			job->skip_until_end = skip_until_end;
+			job->ignore_end_keyword = ignore_end_keyword;
+			job->fail_line = line;
+			return;
+		}
+	}
+}
+
+static void parse_jobs_free(struct context *inc)
+{
+	size_t idx;
+
+	sr_input_workers_free(inc->workers);
+	inc->workers = NULL;
+	for (idx = 0; idx < inc->job_count; idx++) {
+		g_array_free(inc->jobs[idx]->events, TRUE);
+		g_string_free(inc->jobs[idx]->arena, TRUE);
+		g_free(inc->jobs[idx]);
+	}
+	g_free(inc->jobs);
+	inc->jobs = NULL;
+	inc->job_count = 0;
+}
+
+/*
+ * Process the complete text lines in the input buffer on the worker
+ * threads. Advances the read position over the text that was handled,
+ * the caller processes the remainder line by line.
+ */
+static int process_parallel(struct sr_input *in, char **rdptr, size_t *taken)
+{
+	struct context *inc;
+	struct parse_job *job;
+	struct vcd_event *ev;
+	char *text, *end, *pos;
+	size_t count, idx, ev_idx;
+	int ret;
+
+	inc = in->priv;
+
+	text = in->buf->str;
+	end = &in->buf->str[in->buf->len];
+	while (end > text && end[-1] != '\n')
+		end--;
+	if (end - text < PARALLEL_CHUNK)
+		return SR_OK;
+
+	if (!inc->jobs) {
+		inc->job_count = sr_input_workers_count(inc->workers);
+		inc->jobs = g_malloc0(inc->job_count * sizeof(inc->jobs[0]));
+		for (idx = 0; idx < inc->job_count; idx++) {
+			job = g_malloc0(sizeof(*job));
+			job->inc = inc;
+			job->events = g_array_new(FALSE, FALSE, sizeof(*ev));
+			job->arena = g_string_sized_new(256);
+			inc->jobs[idx] = job;
+		}
+	}
+
+	/* Split the text at line boundaries, into parts of similar size. */
+	pos = text;
+	for (count = 0; pos < end && count < inc->job_count; count++) {
+		job = inc->jobs[count];
+		job->text = pos;
+		job->end = end;
+		if (count + 1 < inc->job_count) {
+			pos = text + (end - text) / inc->job_count * (count + 1);
+			if (pos < job->text)
+				pos = job->text;
+			job->end = (char *)memchr(pos, '\n', end - pos) + 1;
+		}
+		pos = job->end;
+	}
+
+	sr_input_workers_run(inc->workers, (gpointer *)inc->jobs, count);
+
+	/* Apply the events, in the order of the input text. */
+	for (idx = 0; idx < count; idx++) {
+		job = inc->jobs[idx];
+		if (inc->skip_until_end || inc->ignore_end_keyword) {
+			*rdptr = job->text;
+			*taken = job->text - text;
+			return SR_OK;
+		}
+		for (ev_idx = 0; ev_idx < job->events->len; ev_idx++) {
+			ev = &g_array_index(job->events, struct vcd_event, ev_idx);
+			switch (ev->type) {
+			case EVENT_TIMESTAMP:
+				ret = process_timestamp(in, ev->timestamp);
+				if (ret != SR_OK)
+					return ret;
+				break;
+			case EVENT_BITS:
+				inc->data_after_timestamp = TRUE;
+				process_bits(inc, &job->arena->str[ev->id_offset],
+					(uint8_t *)&job->arena->str[ev->bits_offset],
+					ev->bit_count);
+				break;
+			case EVENT_REAL:
+				inc->data_after_timestamp = TRUE;
+				process_real(inc, &job->arena->str[ev->id_offset],
+					ev->real_val);
+				break;
+			case EVENT_STRING:
+				inc->data_after_timestamp = TRUE;
+				break;
+			}
+		}
+		inc->skip_until_end = job->skip_until_end;
+		inc->ignore_end_keyword = job->ignore_end_keyword;
+		if (job->fail_line) {
+			*rdptr = job->fail_line;
+			*taken = job->fail_line - text;
+			return SR_OK;
+		}
+	}
+
+	*rdptr = end < &in->buf->str[in->buf->len] ? end : NULL;
+	*taken = end - text;
+
+	return SR_OK;
+}
+
 static int process_buffer(struct sr_input *in, gboolean is_eof)
 {
 	struct context *inc;
@@ -1887,9 +2294,18 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 			sr_session_send_meta(in->sdi, SR_CONF_SAMPLERATE, gvar);
 		}
 
+		if (inc->options.threads != 1)
+			inc->workers = sr_input_workers_new(inc->options.threads,
+				parse_job_run, NULL);
+
 		inc->started = TRUE;
 	}
 
+	/* Accumulate enough text to keep the worker threads busy. */
+	if (inc->workers && !is_eof && in->buf->len <
+			PARALLEL_CHUNK * sr_input_workers_count(inc->workers))
+		return SR_OK;
+
 	/*
 	 * Workaround broken generators which output incomplete text
 	 * lines. Enforce the trailing line feed. Proper input is not
@@ -1902,7 +2318,9 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	ret = SR_OK;
 	rdptr = in->buf->str;
 	taken = 0;
-	while (rdptr) {
+	if (inc->workers)
+		ret = process_parallel(in, &rdptr, &taken);
+	while (ret == SR_OK && rdptr) {
 		rdlen = &in->buf->str[in->buf->len] - rdptr;
 		line = sr_text_next_line(rdptr, rdlen, &rdptr, &taken);
 		if (!line)
@@ -1982,6 +2400,9 @@ static int init(struct sr_input *in, GHashTable *options)
 		inc->options.skip_starttime /= inc->options.downsample;
 	}
 
+	data = g_hash_table_lookup(options, "threads");
+	inc->options.threads = g_variant_get_uint32(data);
+
 	in->sdi = g_malloc0(sizeof(*in->sdi));
 	in->priv = inc;
 
@@ -2059,6 +2480,11 @@ static void cleanup(struct sr_input *in)
 
 	keep_header_for_reread(in);
 
+	if (inc->signals)
+		g_hash_table_destroy(inc->signals);
+	inc->signals = NULL;
+	g_free(inc->analog_channels);
+	inc->analog_channels = NULL;
 	g_slist_free_full(inc->channels, free_channel);
 	inc->channels = NULL;
 	feed_queue_logic_free(inc->feed_logic);
@@ -2071,8 +2497,10 @@ static void cleanup(struct sr_input *in)
 	inc->current_floats = NULL;
 	g_string_free(inc->scope_prefix, TRUE);
 	inc->scope_prefix = NULL;
-	g_slist_free_full(inc->ignored_signals, g_free);
+	if (inc->ignored_signals)
+		g_hash_table_destroy(inc->ignored_signals);
 	inc->ignored_signals = NULL;
+	parse_jobs_free(inc);
 }
 
 static int reset(struct sr_input *in)
@@ -2104,6 +2532,7 @@ enum vcd_option_t {
 	OPT_DOWN_SAMPLE,
 	OPT_SKIP_COUNT,
 	OPT_COMPRESS,
+	OPT_THREADS,
 	OPT_MAX,
 };
 
@@ -2138,6 +2567,11 @@ static struct sr_option options[] = {
 		"Compress idle periods which are longer than the specified number of timescale ticks.",
 		NULL, NULL,
 	},
+	[OPT_THREADS] = {
+		"threads", "Parser threads",
+		"The number of threads which parse the input text, 1 by default. 0 uses one thread per processor.",
+		NULL, NULL,
+	},
 	[OPT_MAX] = ALL_ZERO,
 };
 
@@ -2149,6 +2583,7 @@ static const struct sr_option *get_options(void)
 		options[OPT_DOWN_SAMPLE].def = g_variant_ref_sink(g_variant_new_uint64(1));
 		options[OPT_SKIP_COUNT].def = g_variant_ref_sink(g_variant_new_uint64(~UINT64_C(0)));
 		options[OPT_COMPRESS].def = g_variant_ref_sink(g_variant_new_uint64(0));
+		options[OPT_THREADS].def = g_variant_ref_sink(g_variant_new_uint32(1));
 	}
 
 	return options;
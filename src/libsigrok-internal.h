@@ -1478,6 +1478,22 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * Like receive(), but appends the output text to a string which
+	 * the caller provides. This is the string of an output sink, or
+	 * a new string when the caller uses sr_output_send(). Modules
+	 * implement either this or receive().
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param packet The complete packet.
+	 * @param out The string to append the output text to.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_append) (const struct sr_output *o,
+			const struct sr_datafeed_packet *packet, GString *out);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -1615,8 +1631,13 @@ struct sr_serial_dev_inst {
 		int stop_bits;
 	} comm_params;
 	GString *rcv_buffer;
+	/** RX data which serial_readline() received past a line's end. */
+	GString *readahead;
 	serial_rx_chunk_callback rx_chunk_cb_func;
 	void *rx_chunk_cb_data;
+	/** The caller's callback of the serial port's event source. */
+	sr_receive_data_callback source_cb;
+	void *source_cb_data;
 #ifdef HAVE_LIBSERIALPORT
 	/** libserialport port handle */
 	struct sp_port *sp_data;
@@ -1692,12 +1713,33 @@ struct drv_context {
 
 SR_PRIV int sr_log(int loglevel, const char *format, ...) ATTR_FMT_PRINTF(2, 3);
 
+/*
+ * Messages above this loglevel don't get compiled in at all, see the
+ * --with-max-loglevel configure option.
+ */
+#ifndef SR_LOG_MAX_LEVEL
+#define SR_LOG_MAX_LEVEL SR_LOG_SPEW
+#endif
+
+SR_PRIV extern int sr_log_cur_level;
+
+/*
+ * Whether messages of a loglevel get output. Is checked at the call
+ * site, so that filtered messages neither evaluate their arguments
+ * nor call sr_log().
+ */
+#define sr_log_enabled(loglevel) \
+	((loglevel) <= SR_LOG_MAX_LEVEL && (loglevel) <= sr_log_cur_level)
+
+#define sr_log_if_enabled(loglevel, ...) \
+	(sr_log_enabled(loglevel) ? sr_log(loglevel, __VA_ARGS__) : SR_OK)
+
 /* Message logging helpers with subsystem-specific prefix string. */
-#define sr_spew(...)	sr_log(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_dbg(...)	sr_log(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
-#define sr_info(...)	sr_log(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_warn(...)	sr_log(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
-#define sr_err(...)	sr_log(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_spew(...)	sr_log_if_enabled(SR_LOG_SPEW, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_dbg(...)	sr_log_if_enabled(SR_LOG_DBG,  LOG_PREFIX ": " __VA_ARGS__)
+#define sr_info(...)	sr_log_if_enabled(SR_LOG_INFO, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_warn(...)	sr_log_if_enabled(SR_LOG_WARN, LOG_PREFIX ": " __VA_ARGS__)
+#define sr_err(...)	sr_log_if_enabled(SR_LOG_ERR,  LOG_PREFIX ": " __VA_ARGS__)
 
 /*--- device.c --------------------------------------------------------------*/
 
@@ -1848,8 +1890,30 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+	/** Whether datafeed callbacks accept SR_DF_LOGIC_RLE packets. */
+	gboolean logic_rle;
+	/** Whether datafeed callbacks accept SR_DF_ANALOG_TIMED packets. */
+	gboolean analog_timed;
+	/** Most readings per channel which drivers may batch up. */
+	size_t analog_batch_samples;
+	/** Longest time [ms] which drivers may hold back readings. */
+	uint64_t analog_batch_age_ms;
+
+	/** Queue depth for dispatch on a separate thread, 0 to disable. */
+	size_t dispatch_depth;
+	/** Whether to drop data packets when the dispatch queue is full. */
+	gboolean dispatch_drop;
+	/** Mutex protecting the dispatcher pointer and statistics. */
+	GMutex dispatch_mutex;
+	/** Dispatcher of the running session, or NULL. */
+	struct sr_session_dispatch *dispatch;
+	/** Dispatch statistics of the most recent run. */
+	struct sr_session_dispatch_stats dispatch_stats;
 };
 
+/** Number of samples per SR_DF_LOGIC packet when expanding RLE data. */
+#define LOGIC_RLE_EXPAND_CHUNK	(1024 * 1024)
+
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
 		void *key, GSource *source);
 SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
@@ -1878,10 +1942,29 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf);
+SR_PRIV int sr_session_send_sync(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
 
+/*--- session_dispatch.c ----------------------------------------------------*/
+
+struct sr_session_dispatch;
+
+SR_PRIV struct sr_session_dispatch *sr_session_dispatch_new(size_t depth,
+		gboolean drop);
+SR_PRIV void sr_session_dispatch_finish(struct sr_session_dispatch *dispatch);
+SR_PRIV void sr_session_dispatch_free(struct sr_session_dispatch *dispatch);
+SR_PRIV int sr_session_dispatch_push(struct sr_session_dispatch *dispatch,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+SR_PRIV void sr_session_dispatch_stats_read(
+		struct sr_session_dispatch *dispatch,
+		struct sr_session_dispatch_stats *stats);
+
 /*--- session_file.c --------------------------------------------------------*/
 
 #if !HAVE_ZIP_DISCARD
@@ -1893,6 +1976,32 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/*--- zip_writer.c ----------------------------------------------------------*/
+
+struct sr_zip_writer;
+
+SR_PRIV struct sr_zip_writer *sr_zip_writer_open(const char *filename);
+SR_PRIV int sr_zip_writer_add(struct sr_zip_writer *zw, const char *name,
+		const void *data, size_t length);
+SR_PRIV gboolean sr_zip_compression_supported(int32_t method,
+		gboolean compress);
+SR_PRIV int sr_zip_writer_compression_set(struct sr_zip_writer *zw,
+		int32_t method, uint32_t level);
+SR_PRIV int sr_zip_writer_queue(struct sr_zip_writer *zw, const char *name,
+		void *data, size_t length);
+SR_PRIV int sr_zip_writer_close(struct sr_zip_writer *zw);
+
+/*--- input/input.c ---------------------------------------------------------*/
+
+struct sr_input_workers;
+
+SR_PRIV struct sr_input_workers *sr_input_workers_new(size_t threads,
+		GFunc func, gpointer user_data);
+SR_PRIV size_t sr_input_workers_count(const struct sr_input_workers *workers);
+SR_PRIV void sr_input_workers_run(struct sr_input_workers *workers,
+		gpointer *jobs, size_t count);
+SR_PRIV void sr_input_workers_free(struct sr_input_workers *workers);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -1901,6 +2010,19 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_spec *spec,
                            int digits);
 
+/*--- analog_batch.c --------------------------------------------------------*/
+
+struct sr_analog_batch;
+
+SR_PRIV struct sr_analog_batch *sr_analog_batch_new(
+	const struct sr_dev_inst *sdi);
+SR_PRIV gboolean sr_analog_batch_active(const struct sr_analog_batch *batch);
+SR_PRIV int sr_analog_batch_submit(struct sr_analog_batch *batch,
+	const struct sr_datafeed_analog *analog);
+SR_PRIV int sr_analog_batch_poll(struct sr_analog_batch *batch);
+SR_PRIV int sr_analog_batch_flush(struct sr_analog_batch *batch);
+SR_PRIV void sr_analog_batch_free(struct sr_analog_batch *batch);
+
 /*--- std.c -----------------------------------------------------------------*/
 
 typedef int (*dev_close_callback)(struct sr_dev_inst *sdi);
@@ -1992,6 +2114,20 @@ SR_PRIV void *sr_resource_load(struct sr_context *ctx, int type,
 		const char *name, size_t *size, size_t max_size)
 		G_GNUC_MALLOC G_GNUC_WARN_UNUSED_RESULT;
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+struct sr_buffer_pool;
+
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t buffer_size,
+		size_t max_idle, size_t max_buffers);
+SR_PRIV void sr_buffer_pool_destroy(struct sr_buffer_pool *pool);
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool);
+SR_PRIV struct sr_buffer *sr_buffer_new(size_t size);
+SR_PRIV struct sr_buffer *sr_buffer_from_data(void *data);
+SR_PRIV gboolean sr_buffer_is_shared(struct sr_buffer *buf);
+SR_PRIV void sr_buffer_dispatch_push(struct sr_buffer *buf);
+SR_PRIV void sr_buffer_dispatch_pop(void);
+
 /*--- strutil.c -------------------------------------------------------------*/
 
 SR_PRIV int sr_atol(const char *str, long *ret);
@@ -2001,6 +2137,7 @@ SR_PRIV int sr_atoi(const char *str, int *ret);
 SR_PRIV int sr_atod(const char *str, double *ret);
 SR_PRIV int sr_atof(const char *str, float *ret);
 SR_PRIV int sr_atod_ascii(const char *str, double *ret);
+SR_PRIV int sr_atod_ascii_len(const char *str, size_t len, double *ret);
 SR_PRIV int sr_atod_ascii_digits(const char *str, double *ret, int *digits);
 SR_PRIV int sr_atof_ascii(const char *str, float *ret);
 SR_PRIV int sr_atof_ascii_digits(const char *str, float *ret, int *digits);
@@ -2012,12 +2149,18 @@ SR_PRIV void sr_hexdump_free(GString *s);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+struct soft_trigger_stage;
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
 	int unitsize;
+	int num_words;
+	int num_stages;
+	struct soft_trigger_stage *stages;
+	uint64_t *stage_masks;
 	int cur_stage;
+	gboolean checked;
 	uint8_t *prev_sample;
 	uint8_t *pre_trigger_buffer;
 	uint8_t *pre_trigger_head;
@@ -2032,6 +2175,75 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
+SR_PRIV int64_t soft_trigger_logic_check_rle(struct soft_trigger_logic *st,
+		const struct sr_datafeed_logic_rle *rle, int *pre_trigger_samples);
+
+/*--- transpose.c -----------------------------------------------------------*/
+
+#define SR_BITPLANES_MAX_PLANE_SIZE	8
+#define SR_BITPLANES_MAX_UNITSIZE	4
+
+/* Conversion of channel bit planes to samples, see sr_bitplanes_init(). */
+struct sr_bitplanes {
+	size_t plane_size;
+	gboolean msb_first;
+	size_t unitsize;
+	size_t plane_count;
+	uint8_t positions[8 * SR_BITPLANES_MAX_UNITSIZE];
+	size_t block_size;
+	size_t block_samples;
+	uint8_t pending[8 * SR_BITPLANES_MAX_UNITSIZE *
+		SR_BITPLANES_MAX_PLANE_SIZE];
+	size_t pending_len;
+};
+
+SR_PRIV int sr_bitplanes_init(struct sr_bitplanes *bp, size_t plane_size,
+		gboolean msb_first, uint32_t channel_mask, size_t unitsize);
+SR_PRIV void sr_bitplanes_to_samples(const struct sr_bitplanes *bp,
+		uint8_t *dst, const uint8_t *src, size_t block_count);
+SR_PRIV size_t sr_bitplanes_convert(struct sr_bitplanes *bp, uint8_t *dst,
+		size_t dst_samples, const uint8_t *src, size_t length,
+		size_t *samples);
+SR_PRIV void sr_bitplanes_reset(struct sr_bitplanes *bp);
+
+/**
+ * Transpose the 4x4 bit matrix which the nibbles of a word form.
+ *
+ * Bit c of nibble r becomes bit r of nibble c. Deinterleaves four
+ * samples of four channels, with the channels' bits interleaved.
+ */
+static inline uint16_t sr_transpose_4x4(uint16_t x)
+{
+	uint16_t t;
+
+	t = (x ^ (x >> 3)) & 0x0a0a;
+	x ^= t ^ (t << 3);
+	t = (x ^ (x >> 6)) & 0x00cc;
+	x ^= t ^ (t << 6);
+
+	return x;
+}
+
+/**
+ * Transpose the 8x2 bit matrix which the bit pairs of a word form.
+ *
+ * The even bits end up in the low byte, the odd bits in the high byte.
+ * Deinterleaves two samples of eight channels, with the channels' bits
+ * interleaved.
+ */
+static inline uint16_t sr_transpose_8x2(uint16_t x)
+{
+	uint16_t t;
+
+	t = (x ^ (x >> 1)) & 0x2222;
+	x ^= t ^ (t << 1);
+	t = (x ^ (x >> 2)) & 0x0c0c;
+	x ^= t ^ (t << 2);
+	t = (x ^ (x >> 4)) & 0x00f0;
+	x ^= t ^ (t << 4);
+
+	return x;
+}
 
 /*--- serial.c --------------------------------------------------------------*/
 
@@ -2062,6 +2274,8 @@ SR_PRIV int serial_read_blocking(struct sr_serial_dev_inst *serial, void *buf,
 		size_t count, unsigned int timeout_ms);
 SR_PRIV int serial_read_nonblocking(struct sr_serial_dev_inst *serial, void *buf,
 		size_t count);
+SR_PRIV int serial_read_available(struct sr_serial_dev_inst *serial, void *buf,
+		size_t count, unsigned int timeout_ms);
 SR_PRIV int serial_set_read_chunk_cb(struct sr_serial_dev_inst *serial,
 		serial_rx_chunk_callback cb, void *cb_data);
 SR_PRIV int serial_set_params(struct sr_serial_dev_inst *serial, int baudrate,
@@ -2228,6 +2442,7 @@ SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 
 /*--- tcp.c -----------------------------------------------------------------*/
 
+SR_PRIV gboolean sr_fd_wait_readable(int fd, int timeout_ms);
 SR_PRIV gboolean sr_fd_is_readable(int fd);
 
 SR_PRIV struct sr_tcp_dev_inst *sr_tcp_dev_inst_new(
@@ -2318,6 +2533,8 @@ struct sr_modbus_dev_inst {
 	const char *name;
 	const char *prefix;
 	int priv_size;
+	/* Number of requests which may await their reply at a time. */
+	unsigned int max_pending;
 	GSList *(*scan)(int modbusaddr);
 	int (*dev_inst_new)(void *priv, const char *resource,
 		char **params, const char *serialcomm, int modbusaddr);
@@ -2326,7 +2543,8 @@ struct sr_modbus_dev_inst {
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 	int (*source_remove)(struct sr_session *session, void *priv);
 	int (*send)(void *priv, const uint8_t *buffer, int buffer_size);
-	int (*read_begin)(void *priv, uint8_t *function_code);
+	int (*read_begin)(void *priv, uint8_t *function_code,
+		unsigned int timeout_ms);
 	int (*read_data)(void *priv, uint8_t *buf, int maxlen);
 	int (*read_end)(void *priv);
 	int (*close)(void *priv);
@@ -2335,6 +2553,13 @@ struct sr_modbus_dev_inst {
 	void *priv;
 };
 
+/** A block of holding registers for sr_modbus_read_register_blocks(). */
+struct sr_modbus_register_block {
+	int address;
+	int nb_registers;
+	uint16_t *registers;
+};
+
 SR_PRIV GSList *sr_modbus_scan(struct drv_context *drvc, GSList *options,
 		struct sr_dev_inst *(*probe_device)(struct sr_modbus_dev_inst *modbus));
 SR_PRIV struct sr_modbus_dev_inst *modbus_dev_inst_new(const char *resource,
@@ -2357,6 +2582,9 @@ SR_PRIV int sr_modbus_read_coils(struct sr_modbus_dev_inst *modbus,
 SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
                                              int address, int nb_registers,
                                              uint16_t *registers);
+SR_PRIV int sr_modbus_read_register_blocks(struct sr_modbus_dev_inst *modbus,
+                                           const struct sr_modbus_register_block *blocks,
+                                           size_t nb_blocks);
 SR_PRIV int sr_modbus_write_coil(struct sr_modbus_dev_inst *modbus,
                                  int address, int value);
 SR_PRIV int sr_modbus_write_multiple_registers(struct sr_modbus_dev_inst*modbus,
@@ -2867,6 +3095,9 @@ struct feed_queue_analog;
 SR_API struct feed_queue_logic *feed_queue_logic_alloc(
 	const struct sr_dev_inst *sdi,
 	size_t sample_count, size_t unit_size);
+SR_API struct feed_queue_logic *feed_queue_logic_alloc_rle(
+	const struct sr_dev_inst *sdi,
+	size_t run_count, size_t unit_size);
 SR_API int feed_queue_logic_submit_one(struct feed_queue_logic *q,
 	const uint8_t *data, size_t repeat_count);
 SR_API int feed_queue_logic_submit_many(struct feed_queue_logic *q,
@@ -19,7 +19,9 @@
 
 #include <config.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib/gprintf.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -42,8 +44,11 @@
  * @{
  */
 
-/* Currently selected libsigrok loglevel. Default: SR_LOG_WARN. */
-static int cur_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
+/*
+ * Currently selected libsigrok loglevel. Default: SR_LOG_WARN. The log
+ * helper macros check it before they call sr_log().
+ */
+SR_PRIV int sr_log_cur_level = SR_LOG_WARN; /* Show errors+warnings per default. */
 
 /* Function prototype. */
 static int sr_logv(void *cb_data, int loglevel, const char *format,
@@ -63,6 +68,9 @@ static void *sr_log_cb_data = NULL;
 /** @endcond */
 static int64_t sr_log_start_time = 0;
 
+/* Messages which fit this buffer get printed without an allocation. */
+#define LOG_LINE_SIZE 256
+
 /**
  * Set the libsigrok loglevel.
  *
@@ -90,7 +98,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
 	if (loglevel >= LOGLEVEL_TIMESTAMP && sr_log_start_time == 0)
 		sr_log_start_time = g_get_monotonic_time();
 
-	cur_loglevel = loglevel;
+	sr_log_cur_level = loglevel;
 
 	sr_dbg("libsigrok loglevel set to %d.", loglevel);
 
@@ -106,7 +114,7 @@ SR_API int sr_log_loglevel_set(int loglevel)
  */
 SR_API int sr_log_loglevel_get(void)
 {
-	return cur_loglevel;
+	return sr_log_cur_level;
 }
 
 /**
@@ -184,14 +192,13 @@ SR_API int sr_log_callback_get(sr_log_callback *cb, void **cb_data)
 
 static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args)
 {
-	int ret;
 	uint64_t elapsed_us, minutes;
 	unsigned int rest_us, seconds, microseconds;
-	char *raw_output, *output, c;
-	ssize_t print_len;
-	size_t raw_len;
-	const char *raw_ptr;
-	char *out_ptr;
+	char buf[LOG_LINE_SIZE], *line, *rp, *wp;
+	va_list args_copy;
+	int prefix_len, text_len;
+	size_t size;
+	int ret;
 
 	/* This specific log callback doesn't need the void pointer data. */
 	(void)cb_data;
@@ -199,10 +206,7 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 	(void)loglevel;
 
 	/* Prefix with 'sr:'. Optionally prefix with timestamp. */
-	ret = fputs("sr: ", stderr);
-	if (ret < 0)
-		return SR_ERR;
-	if (cur_loglevel >= LOGLEVEL_TIMESTAMP) {
+	if (sr_log_cur_level >= LOGLEVEL_TIMESTAMP) {
 		elapsed_us = g_get_monotonic_time() - sr_log_start_time;
 
 		minutes = elapsed_us / G_TIME_SPAN_MINUTE;
@@ -210,44 +214,47 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 		seconds = rest_us / G_TIME_SPAN_SECOND;
 		microseconds = rest_us % G_TIME_SPAN_SECOND;
 
-		ret = g_fprintf(stderr, "[%.2" PRIu64 ":%.2u.%.6u] ",
-				minutes, seconds, microseconds);
-		if (ret < 0)
-			return SR_ERR;
+		prefix_len = g_snprintf(buf, sizeof(buf),
+			"sr: [%.2" PRIu64 ":%.2u.%.6u] ",
+			minutes, seconds, microseconds);
+	} else {
+		prefix_len = g_snprintf(buf, sizeof(buf), "sr: ");
 	}
 
-	/* Print the caller's message into a local buffer. */
-	raw_output = NULL;
-	print_len = g_vasprintf(&raw_output, format, args);
-	if (print_len < 0) {
-		g_free(raw_output);
+	/*
+	 * Print the caller's message after the prefix. Only messages which
+	 * don't fit the local buffer need an allocation.
+	 */
+	va_copy(args_copy, args);
+	text_len = g_vsnprintf(&buf[prefix_len], sizeof(buf) - prefix_len,
+		format, args_copy);
+	va_end(args_copy);
+	if (text_len < 0)
 		return SR_ERR;
+	line = buf;
+	size = prefix_len + text_len + 1;
+	if (size > sizeof(buf)) {
+		line = g_malloc(size);
+		memcpy(line, buf, prefix_len);
+		g_vsnprintf(&line[prefix_len], size - prefix_len, format, args);
 	}
-	raw_len = (size_t)print_len;
 
-	/* Copy the string. Strip unwanted line breaks. */
-	output = g_malloc(raw_len + 1);
-	if (!output) {
-		g_free(raw_output);
-		return SR_ERR;
-	}
-	out_ptr = output;
-	raw_ptr = raw_output;
-	while (*raw_ptr) {
-		c = *raw_ptr++;
-		if (c == '\r' || c == '\n')
+	/* Strip unwanted line breaks, terminate the line. */
+	wp = &line[prefix_len];
+	for (rp = wp; *rp; rp++) {
+		if (*rp == '\r' || *rp == '\n')
 			continue;
-		*out_ptr++ = c;
+		*wp++ = *rp;
 	}
-	*out_ptr = '\0';
-	g_free(raw_output);
+	*wp++ = '\n';
 
-	/* Print the trimmed output text. */
-	g_fprintf(stderr, "%s\n", output);
-	fflush(stderr);
-	g_free(output);
+	/* Write the line at once, stderr is not buffered. */
+	size = wp - line;
+	ret = fwrite(line, 1, size, stderr) == size ? SR_OK : SR_ERR;
+	if (line != buf)
+		g_free(line);
 
-	return SR_OK;
+	return ret;
 }
 
 /** @private */
@@ -257,7 +264,7 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 	va_list args;
 
 	/* Only output messages of at least the selected loglevel(s). */
-	if (loglevel > cur_loglevel)
+	if (loglevel > sr_log_cur_level)
 		return SR_OK;
 
 	/* Silently succeed when no logging callback is registered. */
@@ -271,4 +278,554 @@ SR_PRIV int sr_log(int loglevel, const char *format, ...)
 	return ret;
 }
 
+/*
+ * The in-memory ring buffer log sink.
+ *
+ * Messages get recorded with their format string and a copy of their
+ * arguments, formatting is deferred until the ring gets flushed. Writers
+ * reserve a record by incrementing the head index, and publish it by
+ * setting the record's sequence number. When writers lap the reader, the
+ * oldest records get overwritten and are accounted for as lost.
+ *
+ * This relies on format strings which remain valid until the flush,
+ * which is true for libsigrok's messages: These are string literals.
+ */
+
+/* Space for a message's arguments, including copies of strings. */
+#define LOG_RING_ARGS_SIZE 192
+
+struct log_record {
+	/* Record index + 1 when complete, 0 while being written. */
+	gint seq;
+	int loglevel;
+	const char *format;
+	gboolean truncated;
+	uint8_t args[LOG_RING_ARGS_SIZE];
+};
+
+struct log_ring {
+	struct log_record *records;
+	guint mask;
+	gint head;
+	guint tail;
+	sr_log_callback prev_cb;
+	void *prev_cb_data;
+};
+
+static struct log_ring *log_ring;
+static gint log_ring_writers;
+
+enum log_arg_type {
+	LOG_ARG_NONE,
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_LDOUBLE,
+	LOG_ARG_POINTER,
+	LOG_ARG_STRING,
+};
+
+/* A conversion specification of a format string. */
+struct log_conv {
+	const char *start, *end;
+	const char *flags;
+	size_t flags_len;
+	gboolean star_width, star_prec, has_prec;
+	int width, prec;
+	char length[3];
+	char conv;
+	enum log_arg_type type;
+};
+
+/*
+ * Parse the conversion specification at *p, which follows a '%'.
+ * Returns FALSE for conversions which cannot be deferred.
+ */
+static gboolean log_conv_parse(const char *p, struct log_conv *c)
+{
+	size_t len;
+
+	memset(c, 0, sizeof(*c));
+	c->start = p - 1;
+
+	c->flags = p;
+	while (*p && strchr("-+ #0", *p))
+		p++;
+	c->flags_len = p - c->flags;
+
+	if (*p == '*') {
+		c->star_width = TRUE;
+		p++;
+	} else {
+		c->width = -1;
+		while (g_ascii_isdigit(*p))
+			c->width = MAX(c->width, 0) * 10 + (*p++ - '0');
+	}
+	if (*p == '.') {
+		c->has_prec = TRUE;
+		p++;
+		if (*p == '*') {
+			c->star_prec = TRUE;
+			p++;
+		} else {
+			while (g_ascii_isdigit(*p))
+				c->prec = c->prec * 10 + (*p++ - '0');
+		}
+	}
+
+	len = 0;
+	while (*p && strchr("hlLqjzt", *p) && len < sizeof(c->length) - 1)
+		c->length[len++] = *p++;
+
+	c->conv = *p;
+	c->end = *p ? p + 1 : p;
+	switch (c->conv) {
+	case 'd': case 'i':
+		c->type = LOG_ARG_INT;
+		break;
+	case 'u': case 'o': case 'x': case 'X': case 'c':
+		c->type = LOG_ARG_UINT;
+		break;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		c->type = c->length[0] == 'L' ? LOG_ARG_LDOUBLE : LOG_ARG_DOUBLE;
+		break;
+	case 'p':
+		c->type = LOG_ARG_POINTER;
+		break;
+	case 's':
+		c->type = LOG_ARG_STRING;
+		break;
+	case '%':
+		c->type = LOG_ARG_NONE;
+		break;
+	default:
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Fetch an integer argument of the conversion's length. */
+static int64_t log_arg_int(const struct log_conv *c, va_list *args)
+{
+	if (c->conv == 'c' || !c->length[0] || c->length[0] == 'h')
+		return c->type == LOG_ARG_INT ? va_arg(*args, int) :
+			(int64_t)va_arg(*args, unsigned int);
+	if (c->length[0] == 'z')
+		return c->type == LOG_ARG_INT ? va_arg(*args, gssize) :
+			(int64_t)va_arg(*args, size_t);
+	if (c->length[0] == 'j')
+		return c->type == LOG_ARG_INT ? va_arg(*args, intmax_t) :
+			(int64_t)va_arg(*args, uintmax_t);
+	if (c->length[0] == 't')
+		return va_arg(*args, ptrdiff_t);
+	if (c->length[0] == 'l' && !c->length[1])
+		return c->type == LOG_ARG_INT ? va_arg(*args, long) :
+			(int64_t)va_arg(*args, unsigned long);
+
+	return c->type == LOG_ARG_INT ? va_arg(*args, long long) :
+		(int64_t)va_arg(*args, unsigned long long);
+}
+
+static gboolean log_args_put(uint8_t **wp, const uint8_t *end,
+		const void *data, size_t size)
+{
+	if ((size_t)(end - *wp) < size)
+		return FALSE;
+	memcpy(*wp, data, size);
+	*wp += size;
+
+	return TRUE;
+}
+
+/* Copy a message's arguments into a record. */
+static void log_args_capture(struct log_record *rec, va_list ap)
+{
+	va_list args;
+	struct log_conv c;
+	const char *p, *str;
+	const uint8_t *end;
+	uint8_t *wp;
+	int star, prec;
+	size_t len;
+	int64_t i;
+	double d;
+	long double ld;
+	void *ptr;
+	gboolean ok;
+
+	/* A copy which can be passed on by reference. */
+	va_copy(args, ap);
+	wp = rec->args;
+	end = &rec->args[sizeof(rec->args)];
+	ok = TRUE;
+	for (p = rec->format; ok && (p = strchr(p, '%')); p = c.end) {
+		if (!log_conv_parse(p + 1, &c)) {
+			ok = FALSE;
+			break;
+		}
+		if (c.star_width) {
+			star = va_arg(args, int);
+			ok &= log_args_put(&wp, end, &star, sizeof(star));
+		}
+		prec = c.has_prec ? c.prec : -1;
+		if (c.star_prec) {
+			star = va_arg(args, int);
+			ok &= log_args_put(&wp, end, &star, sizeof(star));
+			prec = star;
+		}
+		switch (c.type) {
+		case LOG_ARG_INT:
+		case LOG_ARG_UINT:
+			i = log_arg_int(&c, &args);
+			ok &= log_args_put(&wp, end, &i, sizeof(i));
+			break;
+		case LOG_ARG_DOUBLE:
+			d = va_arg(args, double);
+			ok &= log_args_put(&wp, end, &d, sizeof(d));
+			break;
+		case LOG_ARG_LDOUBLE:
+			ld = va_arg(args, long double);
+			ok &= log_args_put(&wp, end, &ld, sizeof(ld));
+			break;
+		case LOG_ARG_POINTER:
+			ptr = va_arg(args, void *);
+			ok &= log_args_put(&wp, end, &ptr, sizeof(ptr));
+			break;
+		case LOG_ARG_STRING:
+			str = va_arg(args, const char *);
+			if (!str)
+				str = "(null)";
+			/*
+			 * Only the precision's number of characters gets
+			 * printed, the text need not be terminated then.
+			 */
+			len = (prec >= 0) ? strnlen(str, prec) : strlen(str);
+			ok &= log_args_put(&wp, end, str, len);
+			ok &= log_args_put(&wp, end, "", 1);
+			break;
+		default:
+			break;
+		}
+	}
+	va_end(args);
+	rec->truncated = !ok;
+}
+
+static gboolean log_args_get(const uint8_t **rp, const uint8_t *end,
+		void *data, size_t size)
+{
+	if ((size_t)(end - *rp) < size)
+		return FALSE;
+	memcpy(data, *rp, size);
+	*rp += size;
+
+	return TRUE;
+}
+
+/* Format a record's message from the captured arguments. */
+static void log_record_format(const struct log_record *rec, GString *text)
+{
+	struct log_conv c;
+	const char *p, *q, *str;
+	const uint8_t *rp, *end;
+	GString *spec;
+	int star;
+	int64_t i;
+	double d;
+	long double ld;
+	void *ptr;
+
+	spec = g_string_sized_new(16);
+	rp = rec->args;
+	end = &rec->args[sizeof(rec->args)];
+	for (p = rec->format; (q = strchr(p, '%')); p = c.end) {
+		g_string_append_len(text, p, q - p);
+		if (!log_conv_parse(q + 1, &c))
+			break;
+		if (c.type == LOG_ARG_NONE) {
+			g_string_append_c(text, '%');
+			continue;
+		}
+
+		/* Rebuild the specification, with '*' values resolved. */
+		g_string_assign(spec, "%");
+		g_string_append_len(spec, c.flags, c.flags_len);
+		if (c.star_width) {
+			if (!log_args_get(&rp, end, &star, sizeof(star)))
+				break;
+			g_string_append_printf(spec, "%d", star);
+		} else if (c.width >= 0) {
+			g_string_append_printf(spec, "%d", c.width);
+		}
+		if (c.star_prec) {
+			if (!log_args_get(&rp, end, &star, sizeof(star)))
+				break;
+			if (star >= 0)
+				g_string_append_printf(spec, ".%d", star);
+		} else if (c.has_prec) {
+			g_string_append_printf(spec, ".%d", c.prec);
+		}
+
+		switch (c.type) {
+		case LOG_ARG_INT:
+		case LOG_ARG_UINT:
+			if (!log_args_get(&rp, end, &i, sizeof(i)))
+				goto out;
+			if (c.conv == 'c') {
+				g_string_append_c(spec, c.conv);
+				g_string_append_printf(text, spec->str, (int)i);
+			} else if (c.type == LOG_ARG_INT) {
+				g_string_append_printf(spec, "ll%c", c.conv);
+				g_string_append_printf(text, spec->str, (long long)i);
+			} else {
+				g_string_append_printf(spec, "ll%c", c.conv);
+				g_string_append_printf(text, spec->str,
+					(unsigned long long)i);
+			}
+			break;
+		case LOG_ARG_DOUBLE:
+			if (!log_args_get(&rp, end, &d, sizeof(d)))
+				goto out;
+			g_string_append_c(spec, c.conv);
+			g_string_append_printf(text, spec->str, d);
+			break;
+		case LOG_ARG_LDOUBLE:
+			if (!log_args_get(&rp, end, &ld, sizeof(ld)))
+				goto out;
+			g_string_append_printf(spec, "L%c", c.conv);
+			g_string_append_printf(text, spec->str, ld);
+			break;
+		case LOG_ARG_POINTER:
+			if (!log_args_get(&rp, end, &ptr, sizeof(ptr)))
+				goto out;
+			g_string_append_c(spec, c.conv);
+			g_string_append_printf(text, spec->str, ptr);
+			break;
+		case LOG_ARG_STRING:
+			str = (const char *)rp;
+			if (!memchr(str, '\0', end - rp))
+				goto out;
+			rp += strlen(str) + 1;
+			g_string_append_c(spec, c.conv);
+			g_string_append_printf(text, spec->str, str);
+			break;
+		default:
+			break;
+		}
+	}
+	if (!q) {
+		g_string_append(text, p);
+		if (!rec->truncated)
+			goto done;
+	}
+out:
+	g_string_append(text, " [...]");
+done:
+	g_string_free(spec, TRUE);
+}
+
+/* Log callback which appends messages to the ring. */
+static int log_ring_append(void *cb_data, int loglevel,
+		const char *format, va_list args)
+{
+	struct log_ring *ring;
+	struct log_record *rec;
+	guint idx;
+
+	(void)cb_data;
+
+	g_atomic_int_inc(&log_ring_writers);
+	ring = g_atomic_pointer_get(&log_ring);
+	if (ring) {
+		idx = (guint)g_atomic_int_add(&ring->head, 1);
+		rec = &ring->records[idx & ring->mask];
+		g_atomic_int_set(&rec->seq, 0);
+		rec->loglevel = loglevel;
+		rec->format = format;
+		log_args_capture(rec, args);
+		g_atomic_int_set(&rec->seq, (gint)(idx + 1));
+	}
+	g_atomic_int_add(&log_ring_writers, -1);
+
+	return SR_OK;
+}
+
+/* Have the log callback print a complete text. */
+static int log_ring_emit(sr_log_callback cb, void *cb_data, int loglevel,
+		const char *format, ...) ATTR_FMT_PRINTF(4, 5);
+static int log_ring_emit(sr_log_callback cb, void *cb_data, int loglevel,
+		const char *format, ...)
+{
+	va_list args;
+	int ret;
+
+	va_start(args, format);
+	ret = cb(cb_data, loglevel, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+static void log_ring_flush(struct log_ring *ring,
+		sr_log_callback cb, void *cb_data)
+{
+	struct log_record rec, *slot;
+	GString *text;
+	guint head, seq, lost;
+
+	text = g_string_sized_new(LOG_LINE_SIZE);
+	lost = 0;
+	while (TRUE) {
+		head = (guint)g_atomic_int_get(&ring->head);
+		if (head == ring->tail)
+			break;
+		/* Skip records which writers have overwritten already. */
+		if (head - ring->tail > ring->mask + 1) {
+			lost += head - ring->tail - (ring->mask + 1);
+			ring->tail = head - (ring->mask + 1);
+		}
+		/* Wait for records which are still being written. */
+		slot = &ring->records[ring->tail & ring->mask];
+		seq = (guint)g_atomic_int_get(&slot->seq);
+		if (!seq)
+			break;
+		/* Copy the record, then check that it didn't change. */
+		rec = *slot;
+		if (seq != ring->tail + 1 ||
+				(guint)g_atomic_int_get(&slot->seq) != seq) {
+			lost++;
+			ring->tail++;
+			continue;
+		}
+		ring->tail++;
+
+		g_string_truncate(text, 0);
+		log_record_format(&rec, text);
+		log_ring_emit(cb, cb_data, rec.loglevel, "%s", text->str);
+	}
+	if (lost) {
+		log_ring_emit(cb, cb_data, SR_LOG_WARN,
+			"log: %u messages were lost, the ring was full.", lost);
+	}
+	g_string_free(text, TRUE);
+}
+
+/**
+ * Record log messages in an in-memory ring buffer.
+ *
+ * Messages get recorded with their arguments, and get formatted when
+ * sr_log_ring_flush() is called. This makes logging cheap enough for
+ * hot paths, with any loglevel. Recording does not take locks, any
+ * thread may log. When the ring is full, the oldest messages are
+ * overwritten.
+ *
+ * The log callback which was active before gets restored by
+ * sr_log_ring_stop().
+ *
+ * @param entries Number of messages the ring can hold. Gets rounded up
+ *                to a power of two.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid number of entries.
+ * @retval SR_ERR The ring is active already.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_ring_start(size_t entries)
+{
+	struct log_ring *ring;
+	size_t size;
+
+	if (!entries || entries > G_MAXINT / 2)
+		return SR_ERR_ARG;
+	if (g_atomic_pointer_get(&log_ring))
+		return SR_ERR;
+
+	for (size = 1; size < entries; size <<= 1)
+		;
+	ring = g_malloc0(sizeof(*ring));
+	ring->records = g_malloc0(size * sizeof(ring->records[0]));
+	ring->mask = size - 1;
+	ring->prev_cb = sr_log_cb;
+	ring->prev_cb_data = sr_log_cb_data;
+
+	g_atomic_pointer_set(&log_ring, ring);
+	sr_log_cb = log_ring_append;
+	sr_log_cb_data = NULL;
+
+	return SR_OK;
+}
+
+/**
+ * Format the messages which were recorded in the ring.
+ *
+ * The callback receives each message's text and loglevel as they were
+ * logged, as if it had been called right away.
+ *
+ * Must not be called from several threads at the same time.
+ *
+ * @param cb The log callback which receives the messages. NULL for the
+ *           callback which was active before sr_log_ring_start().
+ * @param cb_data Data to pass to the callback.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR The ring is not active.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_ring_flush(sr_log_callback cb, void *cb_data)
+{
+	struct log_ring *ring;
+
+	ring = g_atomic_pointer_get(&log_ring);
+	if (!ring)
+		return SR_ERR;
+	if (!cb) {
+		cb = ring->prev_cb;
+		cb_data = ring->prev_cb_data;
+	}
+	if (cb)
+		log_ring_flush(ring, cb, cb_data);
+
+	return SR_OK;
+}
+
+/**
+ * Stop recording log messages in the ring.
+ *
+ * Messages which are still in the ring get passed to the log callback
+ * which was active before sr_log_ring_start(), which gets restored.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR The ring is not active.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_log_ring_stop(void)
+{
+	struct log_ring *ring;
+
+	ring = g_atomic_pointer_get(&log_ring);
+	if (!ring)
+		return SR_ERR;
+
+	if (sr_log_cb == log_ring_append) {
+		sr_log_cb = ring->prev_cb;
+		sr_log_cb_data = ring->prev_cb_data;
+	}
+	/* Wait for writers which may still see the ring. */
+	g_atomic_pointer_set(&log_ring, NULL);
+	while (g_atomic_int_get(&log_ring_writers))
+		g_thread_yield();
+
+	if (ring->prev_cb)
+		log_ring_flush(ring, ring->prev_cb, ring->prev_cb_data);
+	g_free(ring->records);
+	g_free(ring);
+
+	return SR_OK;
+}
+
 /** @} */
@@ -19,15 +19,18 @@
 
 #include <config.h>
 #include <glib.h>
+#include <stdlib.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "modbus"
 
+SR_PRIV extern const struct sr_modbus_dev_inst modbus_tcp_dev;
 SR_PRIV extern const struct sr_modbus_dev_inst modbus_serial_rtu_dev;
 
 static const struct sr_modbus_dev_inst *modbus_devs[] = {
+	&modbus_tcp_dev,
 #ifdef HAVE_SERIAL_COMM
 	&modbus_serial_rtu_dev, /* Must be last as it matches any resource. */
 #endif
@@ -258,7 +261,7 @@ SR_PRIV int sr_modbus_reply(struct sr_modbus_dev_inst *modbus,
 
 	laststart = g_get_monotonic_time();
 
-	ret = modbus->read_begin(modbus->priv, reply);
+	ret = modbus->read_begin(modbus->priv, reply, modbus->read_timeout_ms);
 	if (ret != SR_OK)
 		return ret;
 	if (*reply & 0x80)
@@ -478,6 +481,127 @@ SR_PRIV int sr_modbus_read_holding_registers(struct sr_modbus_dev_inst *modbus,
 	return SR_OK;
 }
 
+static int compare_register_blocks(const void *a, const void *b)
+{
+	const struct sr_modbus_register_block *block_a, *block_b;
+
+	block_a = *(const struct sr_modbus_register_block * const *)a;
+	block_b = *(const struct sr_modbus_register_block * const *)b;
+
+	return block_a->address - block_b->address;
+}
+
+/**
+ * Read several blocks of holding registers.
+ *
+ * Blocks which are adjacent or overlap get merged into a single read
+ * holding registers command, as long as the command's size limit
+ * permits. When the transport supports several requests in flight,
+ * e.g. Modbus TCP, all commands are sent before replies get read.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param blocks The blocks of registers to read. Each block's buffer
+ *               receives its registers' values.
+ * @param nb_blocks The number of blocks.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments,
+ *         SR_ERR_DATA upon invalid data, or SR_ERR on failure.
+ */
+SR_PRIV int sr_modbus_read_register_blocks(struct sr_modbus_dev_inst *modbus,
+		const struct sr_modbus_register_block *blocks, size_t nb_blocks)
+{
+	const struct sr_modbus_register_block **sorted;
+	struct sr_modbus_register_block *reads, *read;
+	size_t nb_reads, i, sent, received, depth, offset;
+	int end, ret;
+	uint16_t *values, scratch[125];
+
+	if (!nb_blocks)
+		return SR_OK;
+	if (!blocks)
+		return SR_ERR_ARG;
+	for (i = 0; i < nb_blocks; i++) {
+		if (blocks[i].address < 0 || blocks[i].nb_registers < 1 ||
+				blocks[i].nb_registers > 125 ||
+				blocks[i].address + blocks[i].nb_registers > 0x10000 ||
+				!blocks[i].registers)
+			return SR_ERR_ARG;
+	}
+
+	/* Merge blocks in the order of their addresses. */
+	sorted = g_malloc(nb_blocks * sizeof(sorted[0]));
+	for (i = 0; i < nb_blocks; i++)
+		sorted[i] = &blocks[i];
+	qsort(sorted, nb_blocks, sizeof(sorted[0]), compare_register_blocks);
+	reads = g_malloc(nb_blocks * sizeof(reads[0]));
+	nb_reads = 0;
+	offset = 0;
+	for (i = 0; i < nb_blocks; i++) {
+		read = nb_reads ? &reads[nb_reads - 1] : NULL;
+		end = sorted[i]->address + sorted[i]->nb_registers;
+		if (read && sorted[i]->address <= read->address + read->nb_registers &&
+				end - read->address <= 125) {
+			if (end > read->address + read->nb_registers) {
+				offset += end - read->address - read->nb_registers;
+				read->nb_registers = end - read->address;
+			}
+			continue;
+		}
+		read = &reads[nb_reads++];
+		read->address = sorted[i]->address;
+		read->nb_registers = sorted[i]->nb_registers;
+		offset += read->nb_registers;
+	}
+	g_free(sorted);
+	sr_spew("Reading %zu register blocks with %zu commands.",
+		nb_blocks, nb_reads);
+
+	/* One buffer holds the values of all commands. */
+	values = g_malloc(offset * sizeof(values[0]));
+	for (i = 0, offset = 0; i < nb_reads; i++) {
+		reads[i].registers = &values[offset];
+		offset += reads[i].nb_registers;
+	}
+
+	depth = MAX(modbus->max_pending, 1);
+	ret = SR_OK;
+	sent = received = 0;
+	while (received < sent || (ret == SR_OK && received < nb_reads)) {
+		while (ret == SR_OK && sent < nb_reads && sent - received < depth) {
+			ret = sr_modbus_read_holding_registers(modbus,
+				reads[sent].address, reads[sent].nb_registers, NULL);
+			if (ret == SR_OK)
+				sent++;
+		}
+		if (received == sent)
+			break;
+		/* After errors, keep reading pending replies to stay in sync. */
+		read = &reads[received++];
+		if (ret == SR_OK) {
+			ret = sr_modbus_read_holding_registers(modbus, -1,
+				read->nb_registers, read->registers);
+		} else {
+			sr_modbus_read_holding_registers(modbus, -1,
+				read->nb_registers, scratch);
+		}
+	}
+
+	/* Hand out the values of the caller's blocks. */
+	for (i = 0; ret == SR_OK && i < nb_blocks; i++) {
+		read = reads;
+		while (blocks[i].address >= read->address + read->nb_registers)
+			read++;
+		memcpy(blocks[i].registers,
+			&read->registers[blocks[i].address - read->address],
+			blocks[i].nb_registers * sizeof(blocks[i].registers[0]));
+	}
+
+	g_free(reads);
+	g_free(values);
+
+	return ret;
+}
+
 /**
  * Send a Modbus write coil command.
  *
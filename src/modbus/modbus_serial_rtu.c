@@ -105,12 +105,15 @@ static int modbus_serial_rtu_send(void *priv,
 	return SR_OK;
 }
 
-static int modbus_serial_rtu_read_begin(void *priv, uint8_t *function_code)
+static int modbus_serial_rtu_read_begin(void *priv, uint8_t *function_code,
+		unsigned int timeout_ms)
 {
 	struct modbus_serial_rtu *modbus = priv;
 	uint8_t slave_addr;
 	int ret;
 
+	(void)timeout_ms;
+
 	ret = serial_read_blocking(modbus->serial, &slave_addr, 1, 500);
 	if (ret != 1 || slave_addr != modbus->slave_addr)
 		return SR_ERR;
@@ -173,6 +176,7 @@ SR_PRIV const struct sr_modbus_dev_inst modbus_serial_rtu_dev = {
 	.name          = "serial_rtu",
 	.prefix        = "",
 	.priv_size     = sizeof(struct modbus_serial_rtu),
+	.max_pending   = 1,
 	.scan          = NULL,
 	.dev_inst_new  = modbus_serial_rtu_dev_inst_new,
 	.open          = modbus_serial_rtu_open,
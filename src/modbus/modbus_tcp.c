@@ -0,0 +1,371 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Modbus TCP transport. Resources look like "tcp-modbus/<host>/<port>",
+ * the port defaults to 502.
+ *
+ * Each frame starts with the MBAP header: a transaction ID, a protocol
+ * ID (always 0), the length of the remainder of the frame, and the
+ * unit ID. The function code and data follow, no checksum. Several
+ * requests can be in flight, replies get matched to requests by their
+ * transaction ID. Replies are handed out in the order of the requests,
+ * those which arrive early are kept until the caller asks for them.
+ */
+
+#include <config.h>
+
+#if defined _WIN32
+#define _WIN32_WINNT 0x0501
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#endif
+
+#include <glib.h>
+#include <string.h>
+
+#if !defined _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "modbus_tcp"
+
+#define DEFAULT_PORT		"502"
+#define MBAP_HEADER_SIZE	7
+#define MAX_PDU_SIZE		253
+#define MAX_PENDING		8
+
+struct modbus_tcp_frame {
+	uint16_t transaction_id;
+	size_t pdu_size;
+	uint8_t pdu[MAX_PDU_SIZE];
+};
+
+struct modbus_tcp {
+	struct sr_tcp_dev_inst *tcp_dev;
+	uint8_t unit_id;
+	uint16_t transaction_id;
+	/* Transaction IDs of requests without a reply yet, oldest first. */
+	GQueue pending;
+	/* Replies which arrived before the caller asked for them. */
+	GSList *early_replies;
+	/* Partially received frame. */
+	uint8_t rx_buf[MBAP_HEADER_SIZE + MAX_PDU_SIZE];
+	size_t rx_len;
+	/* The reply which the caller currently reads. */
+	struct modbus_tcp_frame reply;
+	size_t reply_pos;
+};
+
+static int modbus_tcp_dev_inst_new(void *priv, const char *resource,
+		char **params, const char *serialcomm, int modbusaddr)
+{
+	struct modbus_tcp *modbus = priv;
+
+	(void)resource;
+	(void)serialcomm;
+
+	if (!params || !params[1]) {
+		sr_err("Invalid parameters.");
+		return SR_ERR;
+	}
+
+	modbus->tcp_dev = sr_tcp_dev_inst_new(params[1],
+		params[2] ? params[2] : DEFAULT_PORT);
+	if (!modbus->tcp_dev)
+		return SR_ERR;
+	modbus->unit_id = modbusaddr;
+
+	return SR_OK;
+}
+
+static void modbus_tcp_forget_transactions(struct modbus_tcp *modbus)
+{
+	g_queue_clear(&modbus->pending);
+	g_slist_free_full(modbus->early_replies, g_free);
+	modbus->early_replies = NULL;
+	modbus->rx_len = 0;
+}
+
+static int modbus_tcp_open(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+	int ret, on;
+
+	ret = sr_tcp_connect(modbus->tcp_dev);
+	if (ret != SR_OK)
+		return ret;
+
+	/* Don't hold back requests which follow each other closely. */
+	on = 1;
+	if (setsockopt(modbus->tcp_dev->sock_fd, IPPROTO_TCP, TCP_NODELAY,
+			(const void *)&on, sizeof(on)) != 0)
+		sr_dbg("Cannot disable Nagle's algorithm.");
+
+	modbus_tcp_forget_transactions(modbus);
+
+	return SR_OK;
+}
+
+static int modbus_tcp_source_add(struct sr_session *session, void *priv,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	struct modbus_tcp *modbus = priv;
+
+	return sr_tcp_source_add(session, modbus->tcp_dev,
+		events, timeout, cb, cb_data);
+}
+
+static int modbus_tcp_source_remove(struct sr_session *session, void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	return sr_tcp_source_remove(session, modbus->tcp_dev);
+}
+
+static int modbus_tcp_send(void *priv, const uint8_t *buffer, int buffer_size)
+{
+	struct modbus_tcp *modbus = priv;
+	uint8_t frame[MBAP_HEADER_SIZE + MAX_PDU_SIZE];
+	size_t frame_size, sent;
+	int ret;
+
+	if (buffer_size > MAX_PDU_SIZE)
+		return SR_ERR_ARG;
+	if (g_queue_get_length(&modbus->pending) >= G_MAXUINT16) {
+		sr_err("Too many requests without a reply.");
+		return SR_ERR;
+	}
+
+	modbus->transaction_id++;
+	WB16(&frame[0], modbus->transaction_id);
+	WB16(&frame[2], 0);
+	WB16(&frame[4], buffer_size + 1);
+	W8(&frame[6], modbus->unit_id);
+	memcpy(&frame[MBAP_HEADER_SIZE], buffer, buffer_size);
+	frame_size = MBAP_HEADER_SIZE + buffer_size;
+
+	for (sent = 0; sent < frame_size; sent += ret) {
+		ret = sr_tcp_write_bytes(modbus->tcp_dev,
+			&frame[sent], frame_size - sent);
+		if (ret < 0) {
+			sr_err("Send error.");
+			return SR_ERR;
+		}
+	}
+
+	g_queue_push_tail(&modbus->pending,
+		GUINT_TO_POINTER(modbus->transaction_id));
+	sr_spew("Sent request, transaction %u.", modbus->transaction_id);
+
+	return SR_OK;
+}
+
+/*
+ * Start over with a new connection. Used when the received data cannot
+ * be framed anymore, the requests in flight don't get their replies.
+ */
+static int modbus_tcp_reconnect(struct modbus_tcp *modbus)
+{
+	sr_tcp_disconnect(modbus->tcp_dev);
+
+	return modbus_tcp_open(modbus);
+}
+
+/*
+ * Receive the next frame from the connection. A partial frame is kept
+ * when the timeout expires, reception continues where it stopped.
+ */
+static int modbus_tcp_receive_frame(struct modbus_tcp *modbus,
+		struct modbus_tcp_frame *frame, gint64 deadline_us)
+{
+	size_t want;
+	gint64 remaining_us;
+	int ret;
+
+	while (TRUE) {
+		want = MBAP_HEADER_SIZE;
+		if (modbus->rx_len >= MBAP_HEADER_SIZE) {
+			if (RB16(&modbus->rx_buf[2]) != 0 ||
+					RB16(&modbus->rx_buf[4]) < 2 ||
+					RB16(&modbus->rx_buf[4]) > MAX_PDU_SIZE + 1) {
+				sr_err("Invalid Modbus TCP frame header, reconnecting.");
+				modbus_tcp_reconnect(modbus);
+				return SR_ERR_DATA;
+			}
+			want = MBAP_HEADER_SIZE - 1 + RB16(&modbus->rx_buf[4]);
+		}
+		if (modbus->rx_len == want && want > MBAP_HEADER_SIZE)
+			break;
+
+		/* Sleep in poll() until data arrives or the time is up. */
+		remaining_us = MAX(deadline_us - g_get_monotonic_time(), 0);
+		if (!sr_fd_wait_readable(modbus->tcp_dev->sock_fd,
+				(remaining_us + 999) / 1000)) {
+			if (g_get_monotonic_time() >= deadline_us)
+				return SR_ERR_TIMEOUT;
+			continue;
+		}
+		/* Readable yet no data means the peer closed the connection. */
+		ret = sr_tcp_read_bytes(modbus->tcp_dev,
+			&modbus->rx_buf[modbus->rx_len],
+			want - modbus->rx_len, FALSE);
+		if (ret < 0) {
+			sr_err("Receive error.");
+			return SR_ERR;
+		}
+		if (ret == 0) {
+			sr_err("Connection closed by the device.");
+			return SR_ERR_IO;
+		}
+		modbus->rx_len += ret;
+	}
+
+	frame->transaction_id = RB16(&modbus->rx_buf[0]);
+	frame->pdu_size = modbus->rx_len - MBAP_HEADER_SIZE;
+	memcpy(frame->pdu, &modbus->rx_buf[MBAP_HEADER_SIZE], frame->pdu_size);
+	modbus->rx_len = 0;
+
+	return SR_OK;
+}
+
+static struct modbus_tcp_frame *modbus_tcp_take_early_reply(
+		struct modbus_tcp *modbus, uint16_t transaction_id)
+{
+	struct modbus_tcp_frame *frame;
+	GSList *l;
+
+	for (l = modbus->early_replies; l; l = l->next) {
+		frame = l->data;
+		if (frame->transaction_id == transaction_id) {
+			modbus->early_replies = g_slist_delete_link(
+				modbus->early_replies, l);
+			return frame;
+		}
+	}
+
+	return NULL;
+}
+
+static int modbus_tcp_read_begin(void *priv, uint8_t *function_code,
+		unsigned int timeout_ms)
+{
+	struct modbus_tcp *modbus = priv;
+	struct modbus_tcp_frame *frame;
+	uint16_t transaction_id;
+	gint64 deadline_us;
+	int ret;
+
+	if (g_queue_is_empty(&modbus->pending)) {
+		sr_err("No request awaits a reply.");
+		return SR_ERR;
+	}
+	transaction_id = GPOINTER_TO_UINT(g_queue_pop_head(&modbus->pending));
+
+	frame = modbus_tcp_take_early_reply(modbus, transaction_id);
+	if (frame) {
+		modbus->reply = *frame;
+		g_free(frame);
+	} else {
+		deadline_us = g_get_monotonic_time() + timeout_ms * 1000LL;
+		while (TRUE) {
+			ret = modbus_tcp_receive_frame(modbus,
+				&modbus->reply, deadline_us);
+			if (ret != SR_OK)
+				return ret;
+			if (modbus->reply.transaction_id == transaction_id)
+				break;
+			if (!g_queue_find(&modbus->pending, GUINT_TO_POINTER(
+					modbus->reply.transaction_id))) {
+				sr_dbg("Dropping reply of unknown transaction %u.",
+					modbus->reply.transaction_id);
+				continue;
+			}
+			frame = g_malloc(sizeof(*frame));
+			*frame = modbus->reply;
+			modbus->early_replies = g_slist_append(
+				modbus->early_replies, frame);
+		}
+	}
+	sr_spew("Received reply, transaction %u.", transaction_id);
+
+	*function_code = modbus->reply.pdu[0];
+	modbus->reply_pos = 1;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_read_data(void *priv, uint8_t *buf, int maxlen)
+{
+	struct modbus_tcp *modbus = priv;
+	size_t len;
+
+	len = MIN((size_t)maxlen, modbus->reply.pdu_size - modbus->reply_pos);
+	if (!len)
+		return SR_ERR;
+	memcpy(buf, &modbus->reply.pdu[modbus->reply_pos], len);
+	modbus->reply_pos += len;
+
+	return len;
+}
+
+static int modbus_tcp_read_end(void *priv)
+{
+	(void)priv;
+
+	return SR_OK;
+}
+
+static int modbus_tcp_close(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	modbus_tcp_forget_transactions(modbus);
+
+	return sr_tcp_disconnect(modbus->tcp_dev);
+}
+
+static void modbus_tcp_free(void *priv)
+{
+	struct modbus_tcp *modbus = priv;
+
+	modbus_tcp_forget_transactions(modbus);
+	sr_tcp_dev_inst_free(modbus->tcp_dev);
+}
+
+SR_PRIV const struct sr_modbus_dev_inst modbus_tcp_dev = {
+	.name          = "tcp",
+	.prefix        = "tcp-modbus",
+	.priv_size     = sizeof(struct modbus_tcp),
+	.max_pending   = MAX_PENDING,
+	.scan          = NULL,
+	.dev_inst_new  = modbus_tcp_dev_inst_new,
+	.open          = modbus_tcp_open,
+	.source_add    = modbus_tcp_source_add,
+	.source_remove = modbus_tcp_source_remove,
+	.send          = modbus_tcp_send,
+	.read_begin    = modbus_tcp_read_begin,
+	.read_data     = modbus_tcp_read_data,
+	.read_end      = modbus_tcp_read_end,
+	.close         = modbus_tcp_close,
+	.free          = modbus_tcp_free,
+};
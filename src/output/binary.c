@@ -27,17 +27,16 @@
 #define LOG_PREFIX "output/binary"
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+		GString *out)
 {
 	const struct sr_datafeed_logic *logic;
 
 	(void)o;
 
-	*out = NULL;
 	if (packet->type != SR_DF_LOGIC)
 		return SR_OK;
 	logic = packet->payload;
-	*out = g_string_new_len(logic->data, logic->length);
+	g_string_append_len(out, logic->data, logic->length);
 
 	return SR_OK;
 }
@@ -49,5 +48,5 @@ SR_PRIV struct sr_output_module output_binary = {
 	.exts = NULL,
 	.flags = 0,
 	.options = NULL,
-	.receive = receive,
+	.receive_append = receive,
 };
@@ -63,10 +63,23 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Rows get formatted in batches, straight into the output buffer. */
+#define ROW_BATCH		1024
+/* Longest text of a timestamp, and of an analog value. */
+#define TIME_CELL_MAX		20
+#define FLOAT_CELL_MAX		24
+
 struct ctx_channel {
 	struct sr_channel *ch;
 	char *label;
 	float min, max;
+	/*
+	 * Where to find the channel's value. Logic channels: byte within
+	 * a sample, and the bit's mask. Analog channels: column within a
+	 * row of staged analog values.
+	 */
+	size_t offset;
+	uint8_t mask;
 };
 
 struct context {
@@ -77,6 +90,7 @@ struct context {
 	const char *record;
 	const char *frame;
 	const char *comment;
+	size_t value_len, record_len;
 	gboolean header, did_header;
 	gboolean label_do, label_did, label_names;
 	gboolean time;
@@ -87,6 +101,7 @@ struct context {
 	unsigned int num_analog_channels;
 	unsigned int num_logic_channels;
 	struct ctx_channel *channels;
+	size_t row_max;
 
 	/* Metadata */
 	gboolean trigger;
@@ -95,10 +110,17 @@ struct context {
 	uint32_t channels_seen;
 	uint64_t sample_rate;
 	uint64_t sample_scale;
+	uint64_t ts_mult;
 	uint64_t out_sample_count;
-	uint8_t *previous_sample;
+
+	/* Data of the current set of packets, kept until rows are complete. */
+	gboolean analog_staged, logic_staged;
 	float *analog_samples;
+	size_t analog_size;
 	uint8_t *logic_samples;
+	size_t logic_size, logic_unitsize;
+	float *fdata;
+	size_t fdata_size;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
 
@@ -184,23 +206,43 @@ static int init(struct sr_output *o, GHashTable *options)
 		sr_info("Outputting %d logic values", logic_channels);
 		ctx->num_logic_channels = logic_channels;
 	}
-	ctx->channels = g_malloc(sizeof(struct ctx_channel)
+	ctx->channels = g_malloc0(sizeof(struct ctx_channel)
 		* (ctx->num_analog_channels + ctx->num_logic_channels));
 
-	/* Once more to map the enabled channels. */
+	/*
+	 * Once more to map the enabled channels, and to determine where
+	 * their values are found. Also determine the maximum length of
+	 * a row's text, which lets rows get formatted without checks.
+	 */
+	ctx->value_len = strlen(ctx->value);
+	ctx->record_len = strlen(ctx->record);
+	ctx->row_max = ctx->record_len;
+	if (ctx->time)
+		ctx->row_max += TIME_CELL_MAX + ctx->value_len;
+	if (ctx->do_trigger)
+		ctx->row_max += 1 + ctx->value_len;
 	ctx->channel_count = g_slist_length(o->sdi->channels);
+	analog_channels = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->enabled) {
 			if (ch->type == SR_CHANNEL_ANALOG) {
 				ctx->channels[i].min = FLT_MAX;
 				ctx->channels[i].max = FLT_MIN;
+				ctx->channels[i].offset = analog_channels++;
+				ctx->row_max += FLOAT_CELL_MAX;
 			} else if (ch->type == SR_CHANNEL_LOGIC) {
 				ctx->channels[i].min = 0;
 				ctx->channels[i].max = 1;
+				ctx->channels[i].offset = ch->index / 8;
+				ctx->channels[i].mask = 1 << (ch->index % 8);
+				ctx->row_max += 1;
+				if (ctx->label_do && !ctx->label_names)
+					ctx->channels[i].label = "logic";
 			} else {
 				sr_warn("Unknown channel type %d.", ch->type);
 			}
+			ctx->row_max += ctx->value_len;
 			if (ctx->label_do && ctx->label_names)
 				ctx->channels[i].label = ch->name;
 			ctx->channels[i++].ch = ch;
@@ -215,19 +257,17 @@ static const char *xlabels[] = {
 	"femtoseconds", "attoseconds",
 };
 
-static GString *gen_header(const struct sr_output *o,
-			   const struct sr_datafeed_header *hdr)
+static void gen_header(const struct sr_output *o,
+		       const struct sr_datafeed_header *hdr, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *channels, *l;
 	unsigned int num_channels, i;
 	char *samplerate_s;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 
 	if (ctx->sample_rate == 0) {
 		if (sr_config_get(o->sdi->driver, o->sdi, NULL,
@@ -247,6 +287,10 @@ static GString *gen_header(const struct sr_output *o,
 		sr_info("Set sample rate, scale to %" PRIu64 ", %" PRIu64 " %s",
 			ctx->sample_rate, ctx->sample_scale, ctx->xlabel);
 	}
+	/* Timestamps are integer multiples in the common case. */
+	ctx->ts_mult = 0;
+	if (ctx->sample_rate && ctx->sample_scale % ctx->sample_rate == 0)
+		ctx->ts_mult = ctx->sample_scale / ctx->sample_rate;
 	ctx->title = (o->sdi && o->sdi->driver) ? o->sdi->driver->longname : "unknown";
 
 	/* Some metadata */
@@ -288,8 +332,311 @@ static GString *gen_header(const struct sr_output *o,
 	/* Time column requested but samplerate unknown. Emit a warning. */
 	if (ctx->time && !ctx->sample_rate)
 		sr_warn("Samplerate unknown, cannot provide timestamps.");
+}
 
-	return header;
+/*
+ * Number formatting. The CSV text of large captures mostly consists of
+ * numbers, so avoid the printf() machinery for them.
+ *
+ * Analog values get printed with the least number of digits which
+ * still convert back to the same single precision value. This is the
+ * "%g" format for all values which can be represented by up to six
+ * digits, values which need more digits keep them instead of getting
+ * rounded.
+ */
+static char *format_uint(char *p, uint64_t value)
+{
+	char digits[TIME_CELL_MAX];
+	size_t len;
+
+	len = 0;
+	do {
+		digits[len++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (len)
+		*p++ = digits[--len];
+
+	return p;
+}
+
+static const double pow10_tab[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+ * Find the shortest decimal representation of a value. Returns the
+ * number of significant digits, or 0 when the value is out of the range
+ * where the computation is exact, and the caller needs to fall back to
+ * the C library.
+ */
+static int float_digits(float value, uint32_t *mantissa, int *exponent)
+{
+	double v, scaled, back;
+	uint32_t m;
+	int e, k, d;
+
+	/* Get the decimal exponent, log10() may be off by one. */
+	v = fabs((double)value);
+	e = (int)floor(log10(v));
+	if (e < -12 || e > 12)
+		return 0;
+	if (e >= 0 ? v < pow10_tab[e] : v * pow10_tab[-e] < 1)
+		e--;
+	else if (e >= -1 ? v >= pow10_tab[e + 1] : v * pow10_tab[-e - 1] >= 1)
+		e++;
+
+	/*
+	 * Try increasing numbers of digits. Powers of ten up to 1e22
+	 * are exact doubles, which keeps the scaling exact enough.
+	 */
+	for (d = 1; d <= 9; d++) {
+		k = d - 1 - e;
+		scaled = k >= 0 ? v * pow10_tab[k] : v / pow10_tab[-k];
+		m = (uint32_t)(scaled + 0.5);
+		back = k >= 0 ? m / pow10_tab[k] : m * pow10_tab[-k];
+		if ((float)back != (float)v)
+			continue;
+		/* Strip trailing zeros, which a carry may have created. */
+		while (m >= 10 && m % 10 == 0) {
+			m /= 10;
+			k--;
+		}
+		for (d = 1; d < 10 && m >= pow10_tab[d]; d++)
+			;
+		*mantissa = m;
+		*exponent = d - 1 - k;
+		return d;
+	}
+
+	return 0;
+}
+
+static char *format_float(char *p, float value)
+{
+	static const char *formats[] = {
+		"%.1g", "%.2g", "%.3g", "%.4g", "%.5g",
+		"%.6g", "%.7g", "%.8g", "%.9g",
+	};
+	char digits[10];
+	uint32_t m;
+	int d, e, i, prec;
+	size_t f;
+
+	d = 0;
+	if (isfinite(value) && value != 0)
+		d = float_digits(value, &m, &e);
+	if (!d) {
+		/* Rare, take the slow path. */
+		for (f = 0; f < ARRAY_SIZE(formats); f++) {
+			g_ascii_formatd(p, FLOAT_CELL_MAX, formats[f], value);
+			if (!isfinite(value) ||
+			    (float)g_ascii_strtod(p, NULL) == value)
+				break;
+		}
+		return p + strlen(p);
+	}
+
+	for (i = d; i > 0; i--) {
+		digits[i - 1] = '0' + m % 10;
+		m /= 10;
+	}
+	if (value < 0)
+		*p++ = '-';
+
+	/* Same choice of notation as "%g" makes. */
+	prec = MAX(d, 6);
+	if (e < -4 || e >= prec) {
+		*p++ = digits[0];
+		if (d > 1) {
+			*p++ = '.';
+			memcpy(p, &digits[1], d - 1);
+			p += d - 1;
+		}
+		*p++ = 'e';
+		*p++ = e < 0 ? '-' : '+';
+		if (e < 0)
+			e = -e;
+		if (e < 10)
+			*p++ = '0';
+		return format_uint(p, e);
+	}
+	if (e < 0) {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = -1; i > e; i--)
+			*p++ = '0';
+		memcpy(p, digits, d);
+		return p + d;
+	}
+	for (i = 0; i <= e || i < d; i++) {
+		if (i == e + 1)
+			*p++ = '.';
+		*p++ = i < d ? digits[i] : '0';
+	}
+
+	return p;
+}
+
+static void write_labels(struct context *ctx, GString *out)
+{
+	unsigned int i, num_channels;
+	struct ctx_channel *cc;
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+
+	if (ctx->time)
+		g_string_append_printf(out, "%s%s",
+			ctx->label_names ? "Time" : ctx->xlabel, ctx->value);
+	for (i = 0; i < num_channels; i++) {
+		cc = &ctx->channels[i];
+		g_string_append_printf(out, "%s%s",
+			cc->label ? cc->label : "", ctx->value);
+		/* Unit labels were allocated for analog channels. */
+		if (cc->ch->type == SR_CHANNEL_ANALOG && !ctx->label_names) {
+			g_free(cc->label);
+			cc->label = NULL;
+		}
+	}
+	if (ctx->do_trigger)
+		g_string_append_printf(out, "Trigger%s", ctx->value);
+	/* Drop last separator. */
+	if (ctx->time || num_channels || ctx->do_trigger)
+		g_string_truncate(out, out->len - ctx->value_len);
+	g_string_append(out, ctx->record);
+
+	ctx->label_do = FALSE;
+}
+
+/* Compare the values of the enabled channels in two rows. */
+static gboolean row_equal(const struct context *ctx,
+	const uint8_t *logic, const uint8_t *logic_prev, size_t unitsize,
+	const float *analog, const float *analog_prev)
+{
+	unsigned int i, num_channels;
+	const struct ctx_channel *cc;
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	for (i = 0; i < num_channels; i++) {
+		cc = &ctx->channels[i];
+		if (cc->ch->type == SR_CHANNEL_LOGIC) {
+			if (cc->offset < unitsize &&
+			    ((logic[cc->offset] ^ logic_prev[cc->offset]) & cc->mask))
+				return FALSE;
+		} else if (cc->ch->type == SR_CHANNEL_ANALOG) {
+			if (memcmp(&analog[cc->offset], &analog_prev[cc->offset],
+					sizeof(analog[0])))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static char *write_row(struct context *ctx, char *p, uint64_t snum,
+	const uint8_t *logic, size_t unitsize, const float *analog)
+{
+	unsigned int i, num_channels;
+	struct ctx_channel *cc;
+	char *start;
+	float value;
+
+	start = p;
+	if (ctx->time) {
+		if (!ctx->sample_rate)
+			*p++ = '0';
+		else if (ctx->ts_mult)
+			p = format_uint(p, snum * ctx->ts_mult);
+		else
+			p = format_uint(p, (uint64_t)((double)snum /
+				ctx->sample_rate * ctx->sample_scale));
+		memcpy(p, ctx->value, ctx->value_len);
+		p += ctx->value_len;
+	}
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	for (i = 0; i < num_channels; i++) {
+		cc = &ctx->channels[i];
+		if (cc->ch->type == SR_CHANNEL_LOGIC) {
+			*p++ = cc->offset < unitsize &&
+				(logic[cc->offset] & cc->mask) ? '1' : '0';
+		} else if (cc->ch->type == SR_CHANNEL_ANALOG) {
+			value = analog[cc->offset];
+			cc->max = fmax(value, cc->max);
+			cc->min = fmin(value, cc->min);
+			p = format_float(p, value);
+		}
+		memcpy(p, ctx->value, ctx->value_len);
+		p += ctx->value_len;
+	}
+
+	if (ctx->do_trigger) {
+		*p++ = ctx->trigger ? '1' : '0';
+		memcpy(p, ctx->value, ctx->value_len);
+		p += ctx->value_len;
+		ctx->trigger = FALSE;
+	}
+
+	/* Drop last separator. */
+	if (p != start)
+		p -= ctx->value_len;
+	memcpy(p, ctx->record, ctx->record_len);
+
+	return p + ctx->record_len;
+}
+
+/*
+ * Format rows of samples. Logic data is in the packet's layout, analog
+ * data has one column per enabled analog channel. Either may be NULL
+ * when there are no channels of that type.
+ */
+static void write_rows(struct context *ctx, GString *out,
+	const uint8_t *logic, size_t unitsize, const float *analog,
+	size_t num_samples)
+{
+	const uint8_t *logic_row, *logic_prev;
+	const float *analog_row, *analog_prev;
+	size_t i, row, batch, pos;
+	char *p;
+
+	if (ctx->label_do)
+		write_labels(ctx, out);
+
+	logic_prev = NULL;
+	analog_prev = NULL;
+	for (i = 0; i < num_samples; i += batch) {
+		batch = MIN(num_samples - i, ROW_BATCH);
+		pos = out->len;
+		g_string_set_size(out, pos + batch * ctx->row_max);
+		p = out->str + pos;
+		for (row = i; row < i + batch; row++) {
+			logic_row = logic ? logic + row * unitsize : NULL;
+			analog_row = analog ?
+				analog + row * ctx->num_analog_channels : NULL;
+			if (ctx->dedup && row > 0 && row < num_samples - 1 &&
+			    row_equal(ctx, logic_row, logic_prev, unitsize,
+					analog_row, analog_prev))
+				continue;
+			logic_prev = logic_row;
+			analog_prev = analog_row;
+			p = write_row(ctx, p, ctx->out_sample_count + row,
+				logic_row, unitsize, analog_row);
+		}
+		g_string_truncate(out, p - out->str);
+	}
+	ctx->out_sample_count += num_samples;
+}
+
+/* Get a scratch buffer of at least the given size, content undefined. */
+static void *scratch_get(void *buf, size_t *size, size_t need)
+{
+	if (*size >= need)
+		return buf;
+	g_free(buf);
+	*size = need;
+
+	return g_malloc(need);
 }
 
 /*
@@ -314,215 +661,112 @@ static GString *gen_header(const struct sr_output *o,
  * All of the data for a channel is assumed to be in one frame;
  * otherwise the data in the second packet will overwrite the data in
  * the first packet.
+ *
+ * The staging buffers are kept across sets of packets. Logic-only
+ * data does not get staged at all, see receive().
  */
 static void process_analog(struct context *ctx,
 			   const struct sr_datafeed_analog *analog)
 {
-	int ret;
-	size_t num_rcvd_ch, num_have_ch;
+	size_t num_rcvd_ch, num_have_ch, count, size;
 	size_t idx_have, idx_smpl, idx_rcvd;
-	size_t idx_send;
 	struct sr_analog_meaning *meaning;
+	struct ctx_channel *cc;
 	GSList *l;
-	float *fdata = NULL;
-	struct sr_channel *ch;
+	float *fdata;
 
-	if (!ctx->analog_samples) {
-		ctx->analog_samples = g_malloc(analog->num_samples
-			* sizeof(float) * ctx->num_analog_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = analog->num_samples;
-	}
+	if (!ctx->num_samples)
+		ctx->num_samples = analog->num_samples;
 	if (ctx->num_samples != analog->num_samples)
 		sr_warn("Expecting %u analog samples, got %u.",
 			ctx->num_samples, analog->num_samples);
+	count = MIN(ctx->num_samples, analog->num_samples);
+	if (!ctx->analog_staged) {
+		size = ctx->num_samples * ctx->num_analog_channels * sizeof(float);
+		ctx->analog_samples = scratch_get(ctx->analog_samples,
+			&ctx->analog_size, size);
+		memset(ctx->analog_samples, 0, size);
+		ctx->analog_staged = TRUE;
+	}
 
 	meaning = analog->meaning;
 	num_rcvd_ch = g_slist_length(meaning->channels);
 	ctx->channels_seen += num_rcvd_ch;
 	sr_dbg("Processing packet of %zu analog channels", num_rcvd_ch);
-	fdata = g_malloc(analog->num_samples * num_rcvd_ch * sizeof(float));
-	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+	fdata = ctx->fdata = scratch_get(ctx->fdata, &ctx->fdata_size,
+		analog->num_samples * num_rcvd_ch * sizeof(float));
+	if (sr_analog_to_float(analog, fdata) != SR_OK)
 		sr_warn("Problems converting data to floating point values.");
 
 	num_have_ch = ctx->num_analog_channels + ctx->num_logic_channels;
-	idx_send = 0;
 	for (idx_have = 0; idx_have < num_have_ch; idx_have++) {
-		if (ctx->channels[idx_have].ch->type != SR_CHANNEL_ANALOG)
+		cc = &ctx->channels[idx_have];
+		if (cc->ch->type != SR_CHANNEL_ANALOG)
 			continue;
-		sr_dbg("Looking for channel %s",
-		       ctx->channels[idx_have].ch->name);
 		for (l = meaning->channels, idx_rcvd = 0; l; l = l->next, idx_rcvd++) {
-			ch = l->data;
-			sr_dbg("Checking %s", ch->name);
-			if (ctx->channels[idx_have].ch != ch)
+			if (cc->ch != l->data)
 				continue;
 			if (ctx->label_do && !ctx->label_names) {
-				sr_analog_unit_to_string(analog,
-					&ctx->channels[idx_have].label);
+				g_free(cc->label);
+				sr_analog_unit_to_string(analog, &cc->label);
 			}
-			for (idx_smpl = 0; idx_smpl < analog->num_samples; idx_smpl++)
-				ctx->analog_samples[idx_smpl * ctx->num_analog_channels + idx_send] = fdata[idx_smpl * num_rcvd_ch + idx_rcvd];
+			for (idx_smpl = 0; idx_smpl < count; idx_smpl++)
+				ctx->analog_samples[idx_smpl * ctx->num_analog_channels + cc->offset] = fdata[idx_smpl * num_rcvd_ch + idx_rcvd];
 			break;
 		}
-		idx_send++;
 	}
-	g_free(fdata);
 }
 
 /*
  * We treat logic packets the same as analog packets, though it's not
  * strictly required. This allows us to process mixed signals properly.
+ * The samples are kept in the packet's layout.
  */
 static void process_logic(struct context *ctx,
 			  const struct sr_datafeed_logic *logic)
 {
-	unsigned int i, j, ch, num_samples;
-	int idx;
-	uint8_t *sample;
+	size_t num_samples, count, size;
 
 	num_samples = logic->length / logic->unitsize;
 	ctx->channels_seen += ctx->logic_channel_count;
 	sr_dbg("Logic packet had %d channels", logic->unitsize * 8);
-	if (!ctx->logic_samples) {
-		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = num_samples;
-	}
+	if (!ctx->num_samples)
+		ctx->num_samples = num_samples;
 	if (ctx->num_samples != num_samples)
-		sr_warn("Expecting %u samples, got %u",
+		sr_warn("Expecting %u samples, got %zu",
 			ctx->num_samples, num_samples);
-
-	for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
-		if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-			for (i = 0; i < num_samples; i++) {
-				sample = logic->data + i * logic->unitsize;
-				idx = ctx->channels[j].ch->index;
-				if (ctx->label_do && !ctx->label_names)
-					ctx->channels[j].label = "logic";
-				ctx->logic_samples[i * ctx->num_logic_channels + ch] = sample[idx / 8] & (1 << (idx % 8));
-			}
-			ch++;
-		}
-	}
+	count = MIN(ctx->num_samples, num_samples);
+
+	size = ctx->num_samples * logic->unitsize;
+	ctx->logic_samples = scratch_get(ctx->logic_samples,
+		&ctx->logic_size, size);
+	memcpy(ctx->logic_samples, logic->data, count * logic->unitsize);
+	memset(ctx->logic_samples + count * logic->unitsize, 0,
+		size - count * logic->unitsize);
+	ctx->logic_unitsize = logic->unitsize;
+	ctx->logic_staged = TRUE;
 }
 
-static void dump_saved_values(struct context *ctx, GString **out)
+static void dump_saved_values(struct context *ctx, GString *out)
 {
-	unsigned int i, j, analog_size, num_channels;
-	double sample_time_dbl;
-	uint64_t sample_time_u64;
-	float *analog_sample, value;
-	uint8_t *logic_sample;
-
 	/* If we haven't seen samples we're expecting, skip them. */
-	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
-	    (ctx->num_logic_channels && !ctx->logic_samples)) {
+	if ((ctx->num_analog_channels && !ctx->analog_staged) ||
+	    (ctx->num_logic_channels && !ctx->logic_staged)) {
 		sr_warn("Discarding partial packet");
 	} else {
 		sr_info("Dumping %u samples", ctx->num_samples);
-
-		if (!*out)
-			*out = g_string_sized_new(512);
-		num_channels =
-		    ctx->num_logic_channels + ctx->num_analog_channels;
-
-		if (ctx->label_do) {
-			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
-					ctx->label_names ? "Time" : ctx->xlabel,
-					ctx->value);
-			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
-					ctx->channels[i].label, ctx->value);
-				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
-					g_free(ctx->channels[i].label);
-			}
-			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
-						       ctx->value);
-			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
-
-			ctx->label_do = FALSE;
-		}
-
-		analog_size = ctx->num_analog_channels * sizeof(float);
-		if (ctx->dedup && !ctx->previous_sample)
-			ctx->previous_sample = g_malloc0(analog_size + ctx->num_logic_channels);
-
-		for (i = 0; i < ctx->num_samples; i++) {
-			analog_sample =
-			    &ctx->analog_samples[i * ctx->num_analog_channels];
-			logic_sample =
-			    &ctx->logic_samples[i * ctx->num_logic_channels];
-
-			if (ctx->dedup) {
-				if (i > 0 && i < ctx->num_samples - 1 &&
-				    !memcmp(logic_sample, ctx->previous_sample,
-					    ctx->num_logic_channels) &&
-				    !memcmp(analog_sample,
-					    ctx->previous_sample +
-					    ctx->num_logic_channels,
-					    analog_size))
-					continue;
-				memcpy(ctx->previous_sample, logic_sample,
-				       ctx->num_logic_channels);
-				memcpy(ctx->previous_sample
-				       + ctx->num_logic_channels,
-				       analog_sample, analog_size);
-			}
-
-			if (ctx->time && !ctx->sample_rate) {
-				g_string_append_printf(*out, "0%s", ctx->value);
-			} else if (ctx->time) {
-				sample_time_dbl = ctx->out_sample_count++;
-				sample_time_dbl /= ctx->sample_rate;
-				sample_time_dbl *= ctx->sample_scale;
-				sample_time_u64 = sample_time_dbl;
-				g_string_append_printf(*out, "%" PRIu64 "%s",
-					sample_time_u64, ctx->value);
-			}
-
-			for (j = 0; j < num_channels; j++) {
-				if (ctx->channels[j].ch->type == SR_CHANNEL_ANALOG) {
-					value = ctx->analog_samples[i * ctx->num_analog_channels + j];
-					ctx->channels[j].max =
-					    fmax(value, ctx->channels[j].max);
-					ctx->channels[j].min =
-					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
-				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
-				} else {
-					sr_warn("Unexpected channel type: %d",
-						ctx->channels[i].ch->type);
-				}
-			}
-
-			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
-					ctx->trigger, ctx->value);
-				ctx->trigger = FALSE;
-			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
-		}
+		write_rows(ctx, out,
+			ctx->logic_staged ? ctx->logic_samples : NULL,
+			ctx->logic_unitsize,
+			ctx->analog_staged ? ctx->analog_samples : NULL,
+			ctx->num_samples);
 	}
 
-	/* Discard all of the working space. */
-	g_free(ctx->previous_sample);
-	g_free(ctx->analog_samples);
-	g_free(ctx->logic_samples);
+	/* Start over with the next set of packets. */
 	ctx->channels_seen = 0;
 	ctx->num_samples = 0;
-	ctx->previous_sample = NULL;
-	ctx->analog_samples = NULL;
-	ctx->logic_samples = NULL;
+	ctx->analog_staged = FALSE;
+	ctx->logic_staged = FALSE;
 }
 
 static void save_gnuplot(struct context *ctx)
@@ -657,13 +901,12 @@ static void check_input_constraints(struct context *ctx)
 }
 
 static int receive(const struct sr_output *o,
-		   const struct sr_datafeed_packet *packet, GString **out)
+		   const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -675,21 +918,26 @@ static int receive(const struct sr_output *o,
 		ctx->have_checked = FALSE;
 		ctx->have_frames = FALSE;
 		ctx->pkt_snums = FALSE;
-		*out = gen_header(o, packet->payload);
+		gen_header(o, packet->payload, out);
 		break;
 	case SR_DF_TRIGGER:
 		ctx->trigger = TRUE;
 		break;
 	case SR_DF_LOGIC:
-		*out = g_string_sized_new(512);
 		logic = packet->payload;
 		ctx->pkt_snums = logic->length;
 		ctx->pkt_snums /= logic->length;
 		check_input_constraints(ctx);
+		if (!ctx->channels_seen &&
+		    ctx->logic_channel_count >= ctx->channel_count) {
+			/* Logic data only, rows are complete already. */
+			write_rows(ctx, out, logic->data, logic->unitsize,
+				NULL, logic->length / logic->unitsize);
+			return SR_OK;
+		}
 		process_logic(ctx, logic);
 		break;
 	case SR_DF_ANALOG:
-		*out = g_string_sized_new(512);
 		analog = packet->payload;
 		ctx->pkt_snums = analog->num_samples;
 		ctx->pkt_snums /= g_slist_length(analog->meaning->channels);
@@ -698,7 +946,7 @@ static int receive(const struct sr_output *o,
 		break;
 	case SR_DF_FRAME_BEGIN:
 		ctx->have_frames = TRUE;
-		*out = g_string_new(ctx->frame);
+		g_string_append(out, ctx->frame);
 		/* Fallthrough */
 	case SR_DF_END:
 		/* Got to end of frame/session with part of the data. */
@@ -719,6 +967,7 @@ static int receive(const struct sr_output *o,
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
+	unsigned int i;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
@@ -730,7 +979,14 @@ static int cleanup(struct sr_output *o)
 		g_free((gpointer)ctx->comment);
 		g_free((gpointer)ctx->gnuplot);
 		g_free((gpointer)ctx->value);
-		g_free(ctx->previous_sample);
+		for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+			if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG &&
+			    !ctx->label_names)
+				g_free(ctx->channels[i].label);
+		}
+		g_free(ctx->analog_samples);
+		g_free(ctx->logic_samples);
+		g_free(ctx->fdata);
 		g_free(ctx->channels);
 		g_free(o->priv);
 		o->priv = NULL;
@@ -787,6 +1043,6 @@ SR_PRIV struct sr_output_module output_csv = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
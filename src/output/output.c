@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <string.h>
+#include <unistd.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -49,10 +51,29 @@
  * Output modules generate a newly allocated GString. The caller is then
  * expected to free this with g_string_free() when finished with it.
  *
+ * Alternatively, the output can be sent to a sink (see
+ * sr_output_send_sink()). Sinks accumulate text in a buffer that gets
+ * re-used across packets, and pass it on to a file descriptor or a
+ * write callback in large blocks, or keep it for the caller to pick up.
+ *
  * @{
  */
 
 /** @cond PRIVATE */
+#define SINK_DEFAULT_SIZE (256 * 1024)
+
+struct sr_output_sink {
+	/* Text which was not passed on yet. */
+	GString *buf;
+	/* Pass on text when this much accumulated, never when zero. */
+	size_t flush_size;
+	sr_output_sink_write_callback cb;
+	void *cb_data;
+	int fd;
+	/* The first write error, reported until the sink gets released. */
+	int error;
+};
+
 extern SR_PRIV struct sr_output_module output_bits;
 extern SR_PRIV struct sr_output_module output_hex;
 extern SR_PRIV struct sr_output_module output_ascii;
@@ -325,18 +346,416 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	return op;
 }
 
+/* Have a module append its text for a packet to a string. */
+static int module_receive(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	GString *text;
+	int ret;
+
+	if (o->module->receive_append)
+		return o->module->receive_append(o, packet, out);
+
+	text = NULL;
+	ret = o->module->receive(o, packet, &text);
+	if (text) {
+		g_string_append_len(out, text->str, text->len);
+		g_string_free(text, TRUE);
+	}
+
+	return ret;
+}
+
+/*
+ * Feed SR_DF_LOGIC_RLE data to modules which only accept SR_DF_LOGIC.
+ * Expand the runs in chunks, and concatenate the modules' output text.
+ */
+static int output_send_rle_expanded(const struct sr_output *o,
+		const struct sr_datafeed_logic_rle *rle, GString *out)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint64_t run_idx, run_pos, chunk_count, count;
+	uint8_t *buf;
+	int ret;
+
+	chunk_count = MIN(rle->num_samples, LOGIC_RLE_EXPAND_CHUNK);
+	if (!chunk_count || !rle->unitsize)
+		return SR_OK;
+	buf = g_try_malloc(chunk_count * rle->unitsize);
+	if (!buf)
+		return SR_ERR_MALLOC;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	logic.data = buf;
+
+	ret = SR_OK;
+	run_idx = run_pos = 0;
+	while (ret == SR_OK) {
+		count = sr_logic_rle_expand(rle, &run_idx, &run_pos,
+			buf, chunk_count);
+		if (!count)
+			break;
+		logic.length = count * rle->unitsize;
+		ret = module_receive(o, &packet, out);
+	}
+	g_free(buf);
+
+	return ret;
+}
+
+static gboolean needs_rle_expansion(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet)
+{
+	return packet->type == SR_DF_LOGIC_RLE &&
+		!(o->module->flags & SR_OUTPUT_LOGIC_RLE);
+}
+
+/* Append a module's text for a packet to a string. */
+static int output_send_append(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	if (needs_rle_expansion(o, packet))
+		return output_send_rle_expanded(o, packet->payload, out);
+
+	return module_receive(o, packet, out);
+}
+
+/*
+ * Output modules don't use analog timestamps. Turn SR_DF_ANALOG_TIMED
+ * packets into SR_DF_ANALOG packets, which share the samples.
+ */
+static const struct sr_datafeed_packet *untimed_packet(
+		const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet *untimed)
+{
+	const struct sr_datafeed_analog_timed *timed;
+
+	if (packet->type != SR_DF_ANALOG_TIMED)
+		return packet;
+
+	timed = packet->payload;
+	untimed->type = SR_DF_ANALOG;
+	untimed->payload = &timed->analog;
+
+	return untimed;
+}
+
 /**
  * Send a packet to the specified output instance.
  *
  * The instance's output is returned as a newly allocated GString,
  * which must be freed by the caller.
  *
+ * SR_DF_LOGIC_RLE packets get expanded to SR_DF_LOGIC packets for
+ * output modules which don't accept run-length encoded data.
+ * SR_DF_ANALOG_TIMED packets are passed as SR_DF_ANALOG packets.
+ *
+ * @see sr_output_send_sink()
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	struct sr_datafeed_packet untimed;
+	int ret;
+
+	packet = untimed_packet(packet, &untimed);
+
+	if (o->module->receive && !needs_rle_expansion(o, packet))
+		return o->module->receive(o, packet, out);
+
+	*out = g_string_sized_new(512);
+	ret = output_send_append(o, packet, *out);
+	if (!(*out)->len) {
+		g_string_free(*out, TRUE);
+		*out = NULL;
+	}
+
+	return ret;
+}
+
+/* Pass data on to a sink's destination. */
+static int sink_write(struct sr_output_sink *sink,
+		const char *data, size_t length)
+{
+	ssize_t written;
+	int ret;
+
+	if (!length)
+		return SR_OK;
+
+	if (sink->cb) {
+		ret = sink->cb(data, length, sink->cb_data);
+		if (ret != SR_OK)
+			sink->error = ret;
+		return ret;
+	}
+
+	while (length) {
+		written = write(sink->fd, data, length);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0) {
+			sr_err("Cannot write output: %s.", g_strerror(errno));
+			sink->error = SR_ERR_IO;
+			return SR_ERR_IO;
+		}
+		data += written;
+		length -= written;
+	}
+
+	return SR_OK;
+}
+
+static struct sr_output_sink *sink_new(size_t buffer_size)
+{
+	struct sr_output_sink *sink;
+
+	sink = g_malloc0(sizeof(*sink));
+	sink->flush_size = buffer_size;
+	sink->buf = g_string_sized_new(buffer_size ? buffer_size : 4096);
+	sink->fd = -1;
+	sink->error = SR_OK;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which passes the text to a callback.
+ *
+ * @param cb The callback which receives the text. Returning anything
+ *           but SR_OK makes subsequent sends fail with that code.
+ * @param cb_data Opaque pointer which gets passed to the callback.
+ * @param buffer_size Accumulate at least this many bytes before the
+ *                    callback gets invoked. 0 selects a default.
+ *
+ * @return The sink, or NULL upon error.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_callback(
+		sr_output_sink_write_callback cb, void *cb_data,
+		size_t buffer_size)
+{
+	struct sr_output_sink *sink;
+
+	if (!cb)
+		return NULL;
+
+	sink = sink_new(buffer_size ? buffer_size : SINK_DEFAULT_SIZE);
+	sink->cb = cb;
+	sink->cb_data = cb_data;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which writes the text to a file descriptor.
+ *
+ * The file descriptor is not closed when the sink gets released.
+ *
+ * @param fd The file descriptor.
+ * @param buffer_size Accumulate at least this many bytes before they
+ *                    get written. 0 selects a default.
+ *
+ * @return The sink, or NULL upon error.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd,
+		size_t buffer_size)
+{
+	struct sr_output_sink *sink;
+
+	if (fd < 0)
+		return NULL;
+
+	sink = sink_new(buffer_size ? buffer_size : SINK_DEFAULT_SIZE);
+	sink->fd = fd;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which keeps the text in a growable buffer.
+ *
+ * The caller retrieves the text with sr_output_sink_buffer_get(), and
+ * empties the buffer with sr_output_sink_buffer_clear(). The buffer's
+ * memory gets re-used after it was cleared.
+ *
+ * @return The sink.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_buffer(void)
+{
+	return sink_new(0);
+}
+
+/**
+ * Get the text which accumulated in a sink's buffer.
+ *
+ * For sinks with a destination this is the text which was not passed
+ * on yet.
+ *
+ * @param sink The sink.
+ * @param length Returns the text's length in bytes. May be NULL.
+ *
+ * @return The text, NUL terminated. Remains valid until the next call
+ *         which takes the sink.
+ *
+ * @since 0.6.0
+ */
+SR_API const char *sr_output_sink_buffer_get(struct sr_output_sink *sink,
+		size_t *length)
+{
+	if (!sink) {
+		if (length)
+			*length = 0;
+		return NULL;
+	}
+
+	if (length)
+		*length = sink->buf->len;
+
+	return sink->buf->str;
+}
+
+/**
+ * Discard the text in a sink's buffer.
+ *
+ * @param sink The sink.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_output_sink_buffer_clear(struct sr_output_sink *sink)
+{
+	if (!sink)
+		return;
+
+	g_string_truncate(sink->buf, 0);
+}
+
+/**
+ * Pass all buffered text on to a sink's destination.
+ *
+ * Does nothing for buffer sinks.
+ *
+ * @param sink The sink.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other The text could not be written.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+	if (sink->error != SR_OK)
+		return sink->error;
+	if (!sink->flush_size)
+		return SR_OK;
+
+	ret = sink_write(sink, sink->buf->str, sink->buf->len);
+	g_string_truncate(sink->buf, 0);
+
+	return ret;
+}
+
+/**
+ * Flush and release an output sink.
+ *
+ * @param sink The sink. May be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval other Buffered text could not be written, or an earlier
+ *               write had failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_free(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_OK;
+
+	ret = sr_output_sink_flush(sink);
+	g_string_free(sink->buf, TRUE);
+	g_free(sink);
+
+	return ret;
+}
+
+/**
+ * Send a packet to the specified output instance, and have the output
+ * text go to a sink.
+ *
+ * Output modules append their text to the sink's buffer, which avoids
+ * allocating and copying strings for each packet. Buffered text gets
+ * passed on when the sink's buffer size is reached.
+ *
+ * SR_DF_LOGIC_RLE packets get expanded to SR_DF_LOGIC packets for
+ * output modules which don't accept run-length encoded data.
+ * SR_DF_ANALOG_TIMED packets are passed as SR_DF_ANALOG packets.
+ *
+ * @param o The output instance.
+ * @param packet The packet.
+ * @param sink The sink which receives the output text.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other The module failed, or text could not be written.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	struct sr_datafeed_packet untimed;
+	GString *text;
+	int ret;
+
+	if (!o || !packet || !sink)
+		return SR_ERR_ARG;
+	if (sink->error != SR_OK)
+		return sink->error;
+	packet = untimed_packet(packet, &untimed);
+
+	if (o->module->receive_append || needs_rle_expansion(o, packet)) {
+		ret = output_send_append(o, packet, sink->buf);
+	} else {
+		/*
+		 * Modules which return new strings. Pass large strings
+		 * on without copying them to the buffer.
+		 */
+		text = NULL;
+		ret = o->module->receive(o, packet, &text);
+		if (text && sink->flush_size && text->len >= sink->flush_size) {
+			if (sr_output_sink_flush(sink) == SR_OK)
+				sink_write(sink, text->str, text->len);
+		} else if (text) {
+			g_string_append_len(sink->buf, text->str, text->len);
+		}
+		if (text)
+			g_string_free(text, TRUE);
+	}
+	if (ret != SR_OK)
+		return ret;
+
+	if (sink->flush_size && sink->buf->len >= sink->flush_size)
+		sr_output_sink_flush(sink);
+
+	return sink->error;
 }
 
 /**
@@ -22,16 +22,34 @@
 #include <string.h>
 #include <errno.h>
 #include <glib.h>
-#include <glib/gstdio.h>
 #include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/srzip"
 #define CHUNK_SIZE (4 * 1024 * 1024)
+#define CHUNK_SIZE_MIN (64 * 1024)
+#define CHUNK_SIZE_MAX (1024 * 1024 * 1024)
+
+/* Levels go from 1 to max_level, 0 selects the codec's default. */
+static const struct {
+	const char *name;
+	int32_t method;
+	uint32_t max_level;
+} codecs[] = {
+	{ "deflate", ZIP_CM_DEFLATE, 9 },
+	{ "store", ZIP_CM_STORE, 0 },
+#ifdef ZIP_CM_ZSTD
+	{ "zstd", ZIP_CM_ZSTD, 22 },
+#endif
+};
 
 struct out_context {
 	gboolean zip_created;
+	struct sr_zip_writer *archive;
+	int32_t method;
+	uint32_t level;
+	size_t chunk_size;
 	uint64_t samplerate;
 	char *filename;
 	size_t first_analog_index;
@@ -42,27 +60,64 @@ struct out_context {
 		size_t alloc_size;
 		uint8_t *samples;
 		size_t fill_size;
+		uint64_t chunk_num;
 	} logic_buff;
 	struct analog_buff {
 		size_t alloc_size;
 		float *samples;
 		size_t fill_size;
+		uint64_t chunk_num;
 	} *analog_buff;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
-
-	(void)options;
+	const char *codec;
+	uint32_t level;
+	uint64_t chunk_size;
+	size_t idx;
 
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
 	}
 
+	codec = g_variant_get_string(g_hash_table_lookup(options, "codec"), NULL);
+	for (idx = 0; idx < G_N_ELEMENTS(codecs); idx++) {
+		if (g_ascii_strcasecmp(codec, codecs[idx].name) == 0)
+			break;
+	}
+	if (idx == G_N_ELEMENTS(codecs) ||
+			!sr_zip_compression_supported(codecs[idx].method, TRUE)) {
+		sr_err("Unsupported compression codec '%s'.", codec);
+		return SR_ERR_ARG;
+	}
+
+	level = g_variant_get_uint32(g_hash_table_lookup(options, "level"));
+	if (level > codecs[idx].max_level) {
+		if (codecs[idx].max_level)
+			sr_err("Compression level for codec '%s' must be within "
+				"1 and %u, or 0.", codecs[idx].name,
+				codecs[idx].max_level);
+		else
+			sr_err("Codec '%s' has no compression levels.",
+				codecs[idx].name);
+		return SR_ERR_ARG;
+	}
+
+	chunk_size = g_variant_get_uint64(g_hash_table_lookup(options, "chunksize"));
+	if (chunk_size < CHUNK_SIZE_MIN || chunk_size > CHUNK_SIZE_MAX) {
+		sr_err("Chunk size must be within %d and %d bytes.",
+			CHUNK_SIZE_MIN, CHUNK_SIZE_MAX);
+		return SR_ERR_ARG;
+	}
+
 	outc = g_malloc0(sizeof(*outc));
 	outc->filename = g_strdup(o->filename);
+	outc->method = codecs[idx].method;
+	outc->level = level;
+	outc->chunk_size = chunk_size;
 	o->priv = outc;
 
 	return SR_OK;
@@ -71,8 +126,6 @@ static int init(struct sr_output *o, GHashTable *options)
 static int zip_create(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *zipfile;
-	struct zip_source *versrc, *metasrc;
 	struct sr_channel *ch;
 	size_t ch_nr;
 	size_t alloc_size;
@@ -85,6 +138,7 @@ static int zip_create(const struct sr_output *o)
 	guint logic_channels, enabled_logic_channels;
 	guint enabled_analog_channels;
 	guint index;
+	int ret;
 
 	outc = o->priv;
 
@@ -94,20 +148,24 @@ static int zip_create(const struct sr_output *o)
 		g_variant_unref(gvar);
 	}
 
-	/* Quietly delete it first, libzip wants replace ops otherwise. */
-	g_unlink(outc->filename);
-	zipfile = zip_open(outc->filename, ZIP_CREATE, NULL);
-	if (!zipfile)
+	/*
+	 * The archive is kept open until the output module gets released.
+	 * Chunks get appended as they become available, the archive on disk
+	 * remains valid and complete after each of them.
+	 */
+	outc->archive = sr_zip_writer_open(outc->filename);
+	if (!outc->archive)
 		return SR_ERR;
+	ret = sr_zip_writer_compression_set(outc->archive,
+		outc->method, outc->level);
+	if (ret != SR_OK)
+		return ret;
 
 	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
-	if (zip_add(zipfile, "version", versrc) < 0) {
-		sr_err("Error saving version into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(versrc);
-		zip_discard(zipfile);
-		return SR_ERR;
+	ret = sr_zip_writer_add(outc->archive, "version", "2", 1);
+	if (ret != SR_OK) {
+		sr_err("Error saving version into zipfile.");
+		return ret;
 	}
 
 	/* init "metadata" */
@@ -145,10 +203,16 @@ static int zip_create(const struct sr_output *o)
 	else
 		outc->first_analog_index = 1;
 
-	/* Only set capturefile and probes if we will actually save logic data. */
+	/*
+	 * Only set capturefile and probes if we will actually save logic
+	 * data. The unit size is known in advance, which allows to write
+	 * the metadata once.
+	 */
 	if (enabled_logic_channels > 0) {
 		g_key_file_set_string(meta, devgroup, "capturefile", "logic-1");
 		g_key_file_set_integer(meta, devgroup, "total probes", logic_channels);
+		g_key_file_set_integer(meta, devgroup, "unitsize",
+			(logic_channels + 8 - 1) / 8);
 	}
 
 	s = sr_samplerate_string(outc->samplerate);
@@ -189,7 +253,7 @@ static int zip_create(const struct sr_output *o)
 	/*
 	 * Allocate one samples buffer for all logic channels, and
 	 * several samples buffers for the analog channels. Allocate
-	 * buffers of CHUNK_SIZE size (in bytes), and determine the
+	 * buffers of the chunk size (in bytes), and determine the
 	 * sample counts from the respective channel counts and data
 	 * type widths.
 	 *
@@ -203,7 +267,7 @@ static int zip_create(const struct sr_output *o)
 	 * holding a local buffer won't harm when no data is seen later
 	 * during execution. This simplifies other locations.
 	 */
-	alloc_size = CHUNK_SIZE;
+	alloc_size = outc->chunk_size;
 	outc->logic_buff.zip_unit_size = logic_channels;
 	outc->logic_buff.zip_unit_size += 8 - 1;
 	outc->logic_buff.zip_unit_size /= 8;
@@ -218,7 +282,7 @@ static int zip_create(const struct sr_output *o)
 	alloc_size = sizeof(outc->analog_buff[0]) * outc->analog_ch_count + 1;
 	outc->analog_buff = g_malloc0(alloc_size);
 	for (index = 0; index < outc->analog_ch_count; index++) {
-		alloc_size = CHUNK_SIZE;
+		alloc_size = outc->chunk_size;
 		outc->analog_buff[index].samples = g_try_malloc0(alloc_size);
 		if (!outc->analog_buff[index].samples)
 			return SR_ERR_MALLOC;
@@ -230,158 +294,53 @@ static int zip_create(const struct sr_output *o)
 	metabuf = g_key_file_to_data(meta, &metalen, NULL);
 	g_key_file_free(meta);
 
-	metasrc = zip_source_buffer(zipfile, metabuf, metalen, FALSE);
-	if (zip_add(zipfile, "metadata", metasrc) < 0) {
-		sr_err("Error saving metadata into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(metasrc);
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-
-	if (zip_close(zipfile) < 0) {
-		sr_err("Error saving zipfile: %s", zip_strerror(zipfile));
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
-	}
+	ret = sr_zip_writer_add(outc->archive, "metadata", metabuf, metalen);
 	g_free(metabuf);
+	if (ret != SR_OK) {
+		sr_err("Error saving metadata into zipfile.");
+		return ret;
+	}
 
 	return SR_OK;
 }
 
 /**
- * Append a block of logic data to an srzip archive.
+ * Append the queued logic data to an srzip archive.
+ *
+ * The buffer gets handed over to the archive writer, which compresses
+ * it on a worker thread. A new buffer takes its place.
  *
  * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
- * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Byte sequence length (in bytes, not samples).
+ * @param[in] buff The queued samples.
  *
  * @returns SR_OK et al error codes.
  */
-static int zip_append(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length)
+static int zip_append(const struct sr_output *o, struct logic_buff *buff)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *logicsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	struct zip_source *metasrc;
-	GKeyFile *kf;
-	GError *error;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *metabuf;
-	gsize metalen;
 	char *chunkname;
-	unsigned int next_chunk_num;
+	size_t length;
+	int ret;
 
-	if (!length)
+	if (!buff->fill_size)
 		return SR_OK;
 
 	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
-	}
-	kf = sr_sessionfile_read_metadata(archive, &zs);
-	if (!kf) {
-		zip_discard(archive);
-		return SR_ERR_DATA;
-	}
-	/*
-	 * If the file was only initialized but doesn't yet have any
-	 * data it in, it won't have a unitsize field in metadata yet.
-	 */
-	error = NULL;
-	metabuf = NULL;
-	if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
-		if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
-			sr_err("Failed to check unitsize key: %s", error->message);
-			g_error_free(error);
-			g_key_file_free(kf);
-			zip_discard(archive);
-			return SR_ERR;
-		}
-		g_clear_error(&error);
-
-		/* Add unitsize field. */
-		g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-		metabuf = g_key_file_to_data(kf, &metalen, NULL);
-		metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
-
-		if (zip_replace(archive, zs.index, metasrc) < 0) {
-			sr_err("Failed to replace metadata: %s",
-				zip_strerror(archive));
-			g_key_file_free(kf);
-			zip_source_free(metasrc);
-			zip_discard(archive);
-			g_free(metabuf);
-			return SR_ERR;
-		}
-	}
-	g_key_file_free(kf);
 
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, "logic-1", 7) != 0)
-			continue;
-		if (entry_name[7] == '\0') {
-			/*
-			 * This file has no extra chunks, just a single
-			 * "logic-1". Rename it to "logic-1-1" and continue
-			 * with chunk 2.
-			 */
-			if (zip_rename(archive, i, "logic-1-1") < 0) {
-				sr_err("Failed to rename 'logic-1' to 'logic-1-1': %s",
-					zip_strerror(archive));
-				zip_discard(archive);
-				g_free(metabuf);
-				return SR_ERR;
-			}
-			next_chunk_num = 2;
-			break;
-		} else if (entry_name[7] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + 8, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
-		}
-	}
-
-	if (length % unitsize != 0) {
-		sr_warn("Chunk size %zu not a multiple of the"
-			" unit size %zu.", length, unitsize);
-	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
-	i = zip_add(archive, chunkname, logicsrc);
+	length = buff->fill_size * buff->zip_unit_size;
+	chunkname = g_strdup_printf("logic-1-%" PRIu64, ++buff->chunk_num);
+	ret = sr_zip_writer_queue(outc->archive, chunkname,
+		buff->samples, length);
+	if (ret != SR_OK)
+		sr_err("Failed to add chunk '%s'.", chunkname);
 	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
-		zip_source_free(logicsrc);
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-	g_free(metabuf);
 
-	return SR_OK;
+	buff->fill_size = 0;
+	buff->samples = g_try_malloc(outc->chunk_size);
+	if (!buff->samples)
+		return SR_ERR_MALLOC;
+
+	return ret;
 }
 
 /**
@@ -479,101 +438,121 @@ static int zip_append_queue(const struct sr_output *o,
 			remain -= copy_count;
 		}
 		if (send_count && !remain) {
-			ret = zip_append(o, buff->samples, buff->zip_unit_size,
-				buff->fill_size * buff->zip_unit_size);
+			ret = zip_append(o, buff);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
 		}
 	}
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append(o, buff->samples, buff->zip_unit_size,
-			buff->fill_size * buff->zip_unit_size);
+		ret = zip_append(o, buff);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
 }
 
+/**
+ * Queue run-length encoded logic data for srzip archive writes.
+ *
+ * The srzip format stores plain samples. Runs get expanded directly
+ * into the local buffer, without an intermediate copy of the data.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] rle Logic data runs (session feed packet format).
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_queue_rle(const struct sr_output *o,
+	const struct sr_datafeed_logic_rle *rle)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	const uint8_t *rdptr;
+	uint8_t *value, *wrptr;
+	size_t copy_size, unit_size;
+	uint64_t run_idx, send_count, copy_count, done, chunk;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+	unit_size = buff->zip_unit_size;
+	if (!unit_size || !rle->unitsize)
+		return SR_OK;
+
+	/* Values are truncated or zero padded to the archive's unit size. */
+	copy_size = MIN(rle->unitsize, unit_size);
+	value = g_malloc0(unit_size);
+
+	rdptr = rle->values;
+	for (run_idx = 0; run_idx < rle->num_runs; run_idx++) {
+		memcpy(value, rdptr, copy_size);
+		rdptr += rle->unitsize;
+		send_count = rle->lengths[run_idx];
+		while (send_count) {
+			if (buff->fill_size == buff->alloc_size) {
+				ret = zip_append(o, buff);
+				if (ret != SR_OK) {
+					g_free(value);
+					return ret;
+				}
+			}
+			copy_count = buff->alloc_size - buff->fill_size;
+			copy_count = MIN(copy_count, send_count);
+			wrptr = &buff->samples[buff->fill_size * unit_size];
+			memcpy(wrptr, value, unit_size);
+			done = 1;
+			while (done < copy_count) {
+				chunk = MIN(done, copy_count - done);
+				memcpy(wrptr + done * unit_size, wrptr,
+					chunk * unit_size);
+				done += chunk;
+			}
+			buff->fill_size += copy_count;
+			send_count -= copy_count;
+		}
+	}
+	g_free(value);
+
+	return SR_OK;
+}
+
 /**
  * Append analog data of a channel to an srzip archive.
  *
+ * Like zip_append(), hands the buffer over to the archive writer.
+ *
  * @param[in] o Output module instance.
- * @param[in] values Sample data as array of floating point values.
- * @param[in] count Number of samples (float items, not bytes).
+ * @param[in] buff The channel's queued samples.
  * @param[in] ch_nr 1-based channel number.
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append_analog(const struct sr_output *o,
-	const float *values, size_t count, size_t ch_nr)
+	struct analog_buff *buff, size_t ch_nr)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	size_t size;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
 	char *chunkname;
-	unsigned int next_chunk_num;
+	int ret;
 
 	outc = o->priv;
 
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
-	}
-
-	basename = g_strdup_printf("analog-1-%zu", ch_nr);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
-		}
-	}
-
-	size = sizeof(values[0]) * count;
-	analogsrc = zip_source_buffer(archive, values, size, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_add(archive, chunkname, analogsrc);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		g_free(chunkname);
-		g_free(basename);
-		zip_source_free(analogsrc);
-		zip_discard(archive);
-		return SR_ERR;
-	}
+	chunkname = g_strdup_printf("analog-1-%zu-%" PRIu64,
+		ch_nr, ++buff->chunk_num);
+	ret = sr_zip_writer_queue(outc->archive, chunkname, buff->samples,
+		sizeof(buff->samples[0]) * buff->fill_size);
+	if (ret != SR_OK)
+		sr_err("Failed to add chunk '%s'.", chunkname);
 	g_free(chunkname);
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		g_free(basename);
-		zip_discard(archive);
-		return SR_ERR;
-	}
 
-	g_free(basename);
+	buff->fill_size = 0;
+	buff->samples = g_try_malloc(outc->chunk_size);
+	if (!buff->samples)
+		return SR_ERR_MALLOC;
 
-	return SR_OK;
+	return ret;
 }
 
 /**
@@ -605,11 +584,9 @@ static int zip_append_analog_queue(const struct sr_output *o,
 			buff = &outc->analog_buff[idx];
 			if (!buff->fill_size)
 				continue;
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, buff, nr);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
 		}
 		return SR_OK;
 	}
@@ -658,13 +635,11 @@ static int zip_append_analog_queue(const struct sr_output *o,
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, buff, nr);
 			if (ret != SR_OK) {
 				g_free(values);
 				return ret;
 			}
-			buff->fill_size = 0;
 			remain = buff->alloc_size - buff->fill_size;
 		}
 	}
@@ -672,10 +647,9 @@ static int zip_append_analog_queue(const struct sr_output *o,
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append_analog(o, buff->samples, buff->fill_size, nr);
+		ret = zip_append_analog(o, buff, nr);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
@@ -687,6 +661,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
@@ -719,6 +694,17 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		if (ret != SR_OK)
 			return ret;
 		break;
+	case SR_DF_LOGIC_RLE:
+		if (!outc->zip_created) {
+			if ((ret = zip_create(o)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		logic_rle = packet->payload;
+		ret = zip_append_queue_rle(o, logic_rle);
+		if (ret != SR_OK)
+			return ret;
+		break;
 	case SR_DF_ANALOG:
 		if (!outc->zip_created) {
 			if ((ret = zip_create(o)) != SR_OK)
@@ -746,11 +732,30 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{"codec", "Codec", "Compression codec (deflate, store, zstd)", NULL, NULL},
+	{"level", "Level", "Compression level, 0 for the codec's default", NULL, NULL},
+	{"chunksize", "Chunk size", "Size of archive members in bytes", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	GSList *l = NULL;
+	size_t idx;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string("deflate"));
+		for (idx = 0; idx < G_N_ELEMENTS(codecs); idx++) {
+			if (!sr_zip_compression_supported(codecs[idx].method, TRUE))
+				continue;
+			l = g_slist_append(l, g_variant_ref_sink(
+				g_variant_new_string(codecs[idx].name)));
+		}
+		options[0].values = l;
+		options[1].def = g_variant_ref_sink(g_variant_new_uint32(0));
+		options[2].def = g_variant_ref_sink(g_variant_new_uint64(CHUNK_SIZE));
+	}
+
 	return options;
 }
 
@@ -758,9 +763,13 @@ static int cleanup(struct sr_output *o)
 {
 	struct out_context *outc;
 	size_t idx;
+	int ret;
 
 	outc = o->priv;
 
+	/* Finalize the archive. */
+	ret = sr_zip_writer_close(outc->archive);
+
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
 	g_free(outc->logic_buff.samples);
@@ -771,7 +780,7 @@ static int cleanup(struct sr_output *o)
 	g_free(outc);
 	o->priv = NULL;
 
-	return SR_OK;
+	return ret;
 }
 
 SR_PRIV struct sr_output_module output_srzip = {
@@ -779,7 +788,7 @@ SR_PRIV struct sr_output_module output_srzip = {
 	.name = "srzip",
 	.desc = "srzip session file format data",
 	.exts = (const char*[]){"sr", NULL},
-	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING | SR_OUTPUT_LOGIC_RLE,
 	.options = get_options,
 	.init = init,
 	.receive = receive,
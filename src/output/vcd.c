@@ -31,6 +31,7 @@
 
 #include <ctype.h>
 #include <glib.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -40,7 +41,6 @@
 #define LOG_PREFIX "output/vcd"
 
 static const int with_queue_stats = 0;
-static const int with_pool_stats = 0;
 
 struct vcd_channel_desc {
 	size_t index;
@@ -51,12 +51,21 @@ struct vcd_channel_desc {
 		double real;
 	} last;
 	uint64_t last_rcvd_snum;
+	size_t queue;
 };
 
-/** Queued values for a given sample number. */
-struct vcd_queue_item {
+/** A queued value change. */
+struct vcd_queue_change {
 	uint64_t samplenum;	/**!< sample number, _not_ timestamp */
-	GString *values;	/**!< text of value changes */
+	size_t channel;		/**!< index into the channel descriptions */
+	double value;		/**!< logic bit or analog value */
+};
+
+/** Ring buffer of one data source's value changes. */
+struct vcd_queue {
+	struct vcd_queue_change *changes;
+	size_t size;		/**!< power of two, or zero */
+	size_t head, tail;	/**!< free running indices */
 };
 
 struct context {
@@ -65,12 +74,13 @@ struct context {
 	size_t analog_count;
 	gboolean header_done;
 	uint64_t period;
+	uint64_t ts_mult;
 	struct vcd_channel_desc *channels;
 	uint64_t samplerate;
-	GSList *free_list, *used_list;
-	size_t alloced, freed, reused, pooled;
-	GList *vcd_queue_list;
-	GList *vcd_queue_last;
+	struct vcd_queue *queues;
+	size_t queue_count;
+	size_t *heap;
+	size_t heap_len;
 	gboolean immediate_write;
 	uint8_t *last_logic;
 };
@@ -177,12 +187,40 @@ static GString *vcd_identifier(size_t idx)
  *   writer and the reader.
  */
 
-static void append_vcd_timestamp(GString *s, double ts, gboolean lf)
+static double snum_to_ts(struct context *ctx, uint64_t snum)
+{
+	double ts;
+
+	ts = (double)snum;
+	ts /= ctx->samplerate;
+	ts *= ctx->period;
+
+	return ts;
+}
+
+/*
+ * Timestamps are integer multiples of the sample number for the usual
+ * samplerates, those get formatted without floating point arithmetics.
+ */
+static void append_vcd_timestamp(struct context *ctx, GString *s,
+	uint64_t snum, gboolean lf)
 {
+	char buf[24], *p;
+	uint64_t ts;
 
 	g_string_append_c(s, '\n');
 	g_string_append_c(s, '#');
-	g_string_append_printf(s, "%.0f", ts);
+	if (ctx->ts_mult && snum <= UINT64_MAX / ctx->ts_mult) {
+		ts = snum * ctx->ts_mult;
+		p = &buf[sizeof(buf)];
+		do {
+			*--p = '0' + ts % 10;
+			ts /= 10;
+		} while (ts);
+		g_string_append_len(s, p, &buf[sizeof(buf)] - p);
+	} else {
+		g_string_append_printf(s, "%.0f", snum_to_ts(ctx, snum));
+	}
 	g_string_append_c(s, lf ? '\n' : ' ');
 }
 
@@ -193,11 +231,136 @@ static void format_vcd_value_bit(GString *s, uint8_t bit_value, GString *id)
 	g_string_append(s, id->str);
 }
 
+/*
+ * Real values are printed in the "%.16g" format, without the printf()
+ * machinery for the usual values. Analog data is single precision, the
+ * binary mantissa has at most 24 bits. Scaling it to 16 decimal digits
+ * is exact in 64bit integer arithmetics then, including the rounding
+ * (to nearest, ties to even) which the C library does.
+ */
+#define VCD_REAL_DIGITS		16
+#define VCD_REAL_DIGITS_MIN	UINT64_C(1000000000000000)
+#define VCD_REAL_DIGITS_MAX	UINT64_C(10000000000000000)
+
+static const uint64_t pow5_tab[] = {
+	UINT64_C(1), UINT64_C(5), UINT64_C(25), UINT64_C(125),
+	UINT64_C(625), UINT64_C(3125), UINT64_C(15625), UINT64_C(78125),
+	UINT64_C(390625), UINT64_C(1953125), UINT64_C(9765625),
+	UINT64_C(48828125), UINT64_C(244140625), UINT64_C(1220703125),
+	UINT64_C(6103515625), UINT64_C(30517578125),
+	UINT64_C(152587890625), UINT64_C(762939453125),
+	UINT64_C(3814697265625), UINT64_C(19073486328125),
+};
+
+/*
+ * Get the 16 significant digits of a non-zero finite value, and its
+ * decimal exponent. Returns FALSE when the value is out of the range
+ * where the computation is exact, or "%.16g" would use the exponent
+ * notation. The caller needs to fall back to the C library then.
+ */
+static gboolean real_digits(double value, uint64_t *digits, int *exponent)
+{
+	double v;
+	uint64_t m, q, r, half;
+	int be, e, s, shift, tries;
+	gboolean round_up;
+
+	/* value = m * 2^be, with an odd m. */
+	v = fabs(value);
+	m = (uint64_t)ldexp(frexp(v, &be), 53);
+	be -= 53;
+	while (!(m & 1)) {
+		m >>= 1;
+		be++;
+	}
+
+	/* Get the decimal exponent, log10() may be off by one. */
+	e = (int)floor(log10(v));
+	for (tries = 0; tries < 3; tries++) {
+		if (e < -4 || e >= VCD_REAL_DIGITS)
+			return FALSE;
+
+		/* Scale by 10^s = 5^s * 2^s, keep the remainder. */
+		s = VCD_REAL_DIGITS - 1 - e;
+		if (m > UINT64_MAX / pow5_tab[s])
+			return FALSE;
+		q = m * pow5_tab[s];
+		shift = s + be;
+		round_up = FALSE;
+		if (shift >= 0) {
+			if (shift >= 64 || q > UINT64_MAX >> shift)
+				return FALSE;
+			q <<= shift;
+		} else {
+			shift = -shift;
+			if (shift >= 64)
+				return FALSE;
+			r = q & ((UINT64_C(1) << shift) - 1);
+			half = UINT64_C(1) << (shift - 1);
+			q >>= shift;
+			round_up = r > half || (r == half && (q & 1));
+		}
+		if (q < VCD_REAL_DIGITS_MIN) {
+			e--;
+			continue;
+		}
+		if (q >= VCD_REAL_DIGITS_MAX) {
+			e++;
+			continue;
+		}
+
+		/* A carry makes it the next decade. */
+		if (round_up && ++q == VCD_REAL_DIGITS_MAX) {
+			q = VCD_REAL_DIGITS_MIN;
+			if (++e >= VCD_REAL_DIGITS)
+				return FALSE;
+		}
+		*digits = q;
+		*exponent = e;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 static void format_vcd_value_real(GString *s, double real_value, GString *id)
 {
+	char text[G_ASCII_DTOSTR_BUF_SIZE], *p;
+	uint64_t q;
+	int e, frac, i;
 
 	g_string_append_c(s, 'r');
-	g_string_append_printf(s, "%.16g", real_value);
+	if (real_value == 0) {
+		g_string_append(s, signbit(real_value) ? "-0" : "0");
+	} else if (!isfinite(real_value) || !real_digits(real_value, &q, &e)) {
+		/* Rare, take the slow path. */
+		g_ascii_formatd(text, sizeof(text), "%.16g", real_value);
+		g_string_append(s, text);
+	} else {
+		/*
+		 * Strip trailing zeros of the fraction, like "%g" does.
+		 * Leading zeros of values below 1 are what remains of q.
+		 */
+		frac = VCD_REAL_DIGITS - 1 - e;
+		while (frac > 0 && q % 10 == 0) {
+			q /= 10;
+			frac--;
+		}
+		p = &text[sizeof(text)];
+		for (i = 0; i < frac; i++) {
+			*--p = '0' + q % 10;
+			q /= 10;
+		}
+		if (frac)
+			*--p = '.';
+		do {
+			*--p = '0' + q % 10;
+			q /= 10;
+		} while (q);
+		if (real_value < 0)
+			*--p = '-';
+		g_string_append_len(s, p, &text[sizeof(text)] - p);
+	}
 	g_string_append_c(s, ' ');
 	g_string_append(s, id->str);
 }
@@ -264,8 +427,10 @@ static int init(struct sr_output *o, GHashTable *options)
 		if (desc->type == SR_CHANNEL_LOGIC && num_logic) {
 			num_logic--;
 			desc->last.logic = ~0;
+			desc->queue = 0;
 		} else if (desc->type == SR_CHANNEL_ANALOG && num_analog) {
 			num_analog--;
+			desc->queue = ctx->analog_count - num_analog;
 			/* "Construct" NaN, avoid a compile time error. */
 			desc->last.real = 0.0;
 			desc->last.real = 0.0 / desc->last.real;
@@ -287,6 +452,11 @@ static int init(struct sr_output *o, GHashTable *options)
 	if (ctx->logic_count == 0 && ctx->analog_count == 1)
 		ctx->immediate_write = TRUE;
 
+	/* One queue for all logic channels, one per analog channel. */
+	ctx->queue_count = 1 + ctx->analog_count;
+	ctx->queues = g_malloc0(sizeof(ctx->queues[0]) * ctx->queue_count);
+	ctx->heap = g_malloc0(sizeof(ctx->heap[0]) * ctx->queue_count);
+
 	/*
 	 * Keep a copy of the last logic data bitmap around. To avoid
 	 * iterating over individual bits when nothing in the set has
@@ -334,12 +504,11 @@ static uint64_t get_timescale_freq(uint64_t samplerate)
 }
 
 /* Emit a VCD file header. */
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *l;
 	time_t t;
 	size_t num_channels, i;
@@ -361,6 +530,9 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 	ctx->period = get_timescale_freq(ctx->samplerate);
+	ctx->ts_mult = 0;
+	if (ctx->samplerate && ctx->period % ctx->samplerate == 0)
+		ctx->ts_mult = ctx->period / ctx->samplerate;
 	t = time(NULL);
 	timestamp = g_strdup(ctime(&t));
 	timestamp[strlen(timestamp) - 1] = '\0';
@@ -370,7 +542,6 @@ static GString *gen_header(const struct sr_output *o)
 	frequency_s = sr_period_string(1, ctx->period);
 
 	/* Construct the VCD output file header. */
-	header = g_string_sized_new(512);
 	g_string_printf(header, "$date %s $end\n", timestamp);
 	g_string_append_printf(header, "$version %s %s $end\n",
 		PACKAGE_NAME, sr_package_version_string_get());
@@ -410,31 +581,23 @@ static GString *gen_header(const struct sr_output *o)
 	g_free(timestamp);
 	g_free(samplerate_s);
 	g_free(frequency_s);
-
-	return header;
 }
 
 /*
- * Gets called when a session feed packet was received. Either creates
- * a VCD file header (once in the output module's lifetime), or an empty
- * GString. Callers will append the text representation of sample data
- * to that string as needed.
+ * Gets called when a session feed packet was received. Appends the VCD
+ * file header to the output text (once in the output module's lifetime).
+ * Callers will append the text representation of sample data after it.
  */
-static GString *chk_header(const struct sr_output *o)
+static void chk_header(const struct sr_output *o, GString *out)
 {
 	struct context *ctx;
-	GString *s;
 
 	ctx = o->priv;
 
 	if (!ctx->header_done) {
 		ctx->header_done = TRUE;
-		s = gen_header(o);
-	} else {
-		s = g_string_sized_new(512);
+		gen_header(o, out);
 	}
-
-	return s;
 }
 
 /*
@@ -443,383 +606,121 @@ static GString *chk_header(const struct sr_output *o)
  * have seen samples from all involved channels for a given samplenumber.
  * Data for a given sample number can only get emitted when we are sure
  * no other channel's data can arrive any more.
+ *
+ * Each source of data (all logic channels, each analog channel) has its
+ * own ring buffer of value changes. Data of a source arrives in strict
+ * order of sample numbers, so each ring is sorted by construction, and
+ * queueing is an append. Rings only grow while channels are out of step.
+ * Export merges the rings' heads with a min-heap which is keyed by the
+ * sample number (and the source for equal sample numbers). Values are
+ * kept in binary form, their text gets created at export time.
  */
 
-static struct vcd_queue_item *queue_alloc_item(struct context *ctx, uint64_t snum)
-{
-	GSList *node;
-	struct vcd_queue_item *item;
-
-	/* Get an item from the free list if available. */
-	node = ctx->free_list;
-	if (node) {
-		ctx->reused++;
-
-		/* Unlink GSList node from the free list. */
-		ctx->free_list = node->next;
-		node->next = NULL;
-		item = node->data;
-		node->data = NULL;
-
-		/* Setup content of the item. */
-		item->samplenum = snum;
-		if (!item->values)
-			item->values = g_string_sized_new(32);
-		else
-			g_string_truncate(item->values, 0);
-
-		/* Keep GSList node in the used list (avoid free/alloc). */
-		node->next = ctx->used_list;
-		ctx->used_list = node;
-
-		return item;
-	}
+#define VCD_QUEUE_MIN_SIZE	256
 
-	/* Dynamic allocation of an item. */
-	ctx->alloced++;
-	item = g_malloc0(sizeof(*item));
-	if (!item)
-		return NULL;
-	item->samplenum = snum;
-	item->values = g_string_sized_new(32);
-
-	/* Create a used list item, to later move to the free list. */
-	ctx->used_list = g_slist_prepend(ctx->used_list, item);
-
-	return item;
-}
-
-static void queue_free_item(struct context *ctx, struct vcd_queue_item *item)
+static int queue_push(struct vcd_queue *q, uint64_t snum,
+	size_t channel, double value)
 {
-	GSList *node;
-
-	/*
-	 * Put item back into the free list. We can assume to find a
-	 * used list node, it got allocated when the item was acquired.
-	 */
-	node = ctx->used_list;
-	if (node) {
-		ctx->pooled++;
-
-		ctx->used_list = node->next;
-		node->next = NULL;
-		node->data = item;
-
-		item->samplenum = 0;
-		g_string_truncate(item->values, 0);
-
-		node->next = ctx->free_list;
-		ctx->free_list = node;
-
-		return;
+	struct vcd_queue_change *changes;
+	size_t count, size, i;
+
+	count = q->tail - q->head;
+	if (count == q->size) {
+		size = q->size ? 2 * q->size : VCD_QUEUE_MIN_SIZE;
+		changes = g_try_malloc(size * sizeof(changes[0]));
+		if (!changes)
+			return SR_ERR_MALLOC;
+		for (i = 0; i < count; i++)
+			changes[i] = q->changes[(q->head + i) & (q->size - 1)];
+		g_free(q->changes);
+		q->changes = changes;
+		q->size = size;
+		q->head = 0;
+		q->tail = count;
+		if (with_queue_stats)
+			sr_dbg("%s(), grow to %zu", __func__, size);
 	}
 
-	/*
-	 * Release dynamically allocated resources. Could also be used
-	 * to release free list items when the use list is empty.
-	 */
-	ctx->freed++;
-	if (item->values)
-		g_string_free(item->values, TRUE);
-	g_free(item);
-}
-
-static void queue_drain_pool_cb(gpointer data, gpointer cb_data)
-{
-	struct context *ctx;
-	struct vcd_queue_item *item;
+	changes = &q->changes[q->tail & (q->size - 1)];
+	changes->samplenum = snum;
+	changes->channel = channel;
+	changes->value = value;
+	q->tail++;
 
-	item = data;
-	ctx = cb_data;
-	queue_free_item(ctx, item);
+	return SR_OK;
 }
 
-static void queue_drain_pool(struct context *ctx)
+static const struct vcd_queue_change *queue_peek(const struct vcd_queue *q)
 {
-	GSList *list;
+	if (q->head == q->tail)
+		return NULL;
 
-	/*
-	 * Grab the list and "empty" the context member. Then
-	 * iterate over the items, have dymamic memory released.
-	 * Then free the GSList nodes (but not their data parts).
-	 * Do this for the used and the free lists.
-	 */
-	list = ctx->used_list;
-	ctx->used_list = NULL;
-	g_slist_foreach(list, queue_drain_pool_cb, ctx);
-	g_slist_free(list);
-
-	list = ctx->free_list;
-	ctx->free_list = NULL;
-	g_slist_foreach(list, queue_drain_pool_cb, ctx);
-	g_slist_free(list);
+	return &q->changes[q->head & (q->size - 1)];
 }
 
-static int cmp_snum(gconstpointer l, gconstpointer d)
+/* Heap order: sample number first, then the data source. */
+static gboolean heap_less(struct context *ctx, size_t a, size_t b)
 {
-	const struct vcd_queue_item *list_item;
-	const uint64_t *snum_ptr;
-
-	list_item = l;
-	snum_ptr = d;
-	if (list_item->samplenum > *snum_ptr)
-		return +1;
-	if (list_item->samplenum < *snum_ptr)
-		return -1;
-	return 0;
-}
+	uint64_t snum_a, snum_b;
 
-static int cmp_items(gconstpointer a, gconstpointer b)
-{
-	const struct vcd_queue_item *item_a, *item_b;
-
-	item_a = a;
-	item_b = b;
-	if (item_a->samplenum > item_b->samplenum)
-		return +1;
-	if (item_a->samplenum < item_b->samplenum)
-		return -1;
-	return 0;
+	snum_a = queue_peek(&ctx->queues[a])->samplenum;
+	snum_b = queue_peek(&ctx->queues[b])->samplenum;
+	if (snum_a != snum_b)
+		return snum_a < snum_b;
+
+	return a < b;
 }
 
-/*
- * Position the current pointer of the VCD value queue to a specific
- * sample number. Create a new queue item when needed. The logic assumes
- * a specific use pattern: Reception of striped sample data for channels
- * and processing in strict order of sample numbers within a channel.
- * Lower sample numbers near the start of the queue when channels change
- * between session feed packets, before another linear sequence follows.
- *
- * Naive use of convenience glib routines would severely lose performance.
- * That's why custom code is used, which is as complex as it needs to be,
- * yet shall execute faster than a simpler implementation. For trivial
- * cases (logic only, one analog channel only) this queue is bypassed.
- */
-static int queue_samplenum(struct context *ctx, uint64_t snum)
+static void heap_sift_down(struct context *ctx, size_t pos)
 {
-	struct vcd_queue_item *item, *add_item;
-	GList *walk_list, *after_snum, *before_snum, *add_list;
-	GList *last;
-	gboolean add_after_last, do_search;
-
-	/* Already at that position? */
-	item = ctx->vcd_queue_last ? ctx->vcd_queue_last->data : NULL;
-	if (item && item->samplenum == snum)
-		return SR_OK;
-
-	/*
-	 * Search after the current position in the remaining queue. The
-	 * custom code uses the queue's being sorted by sample number.
-	 * Narrow down a later insert position as much as possible. This
-	 * avoids linear search in huge spaces later on.
-	 */
-	last = NULL;
-	add_after_last = FALSE;
-	after_snum = NULL;
-	before_snum = NULL;
-	walk_list = ctx->vcd_queue_last;
-	while (walk_list) {
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		last = walk_list;
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-		if (item->samplenum > snum) {
-			after_snum = walk_list;
-			break;
-		}
-		if (!walk_list->next)
-			add_after_last = TRUE;
-		walk_list = walk_list->next;
-	}
-
-	/*
-	 * No exact match at or beyond the current position. Run another
-	 * search from the start of the queue, again restrict the space
-	 * which is searched, and narrow down the insert position when
-	 * no match is found.
-	 *
-	 * If the searched sample number is larger than any we have seen
-	 * before, or was in the above covered range but was not found,
-	 * then we know that another queue item needs to get added, and
-	 * where to put it. In that case we need not iterate the earlier
-	 * list items.
-	 */
-	walk_list = ctx->vcd_queue_list;
-	do_search = TRUE;
-	if (add_after_last)
-		do_search = FALSE;
-	if (before_snum)
-		do_search = FALSE;
-	while (do_search && walk_list && walk_list != ctx->vcd_queue_last) {
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-		if (item->samplenum > snum) {
-			after_snum = walk_list;
-			break;
-		}
-		walk_list = walk_list->next;
-	}
-
-	/*
-	 * The complete existing queue was exhausted, no exact match was
-	 * found. A new queue item must get inserted. Identify a good
-	 * position where to start searching for the exact position to
-	 * link the new item to the list. Assume that the combination of
-	 * the glib routine's list traversal and the sample number check
-	 * in the callback is expensive, reduce the amount of work done.
-	 *
-	 * If we have seen an item with a larger sample number than the
-	 * wanted, check its immediate predecessor. If this has a smaller
-	 * sample number, then we found a perfect location to insert the
-	 * new item. If we know that the new item must be inserted after
-	 * the last traversed queue item, start there.
-	 */
-	if (!before_snum) do {
-		if (add_after_last)
-			break;
-		if (!after_snum)
-			break;
-		walk_list = after_snum->prev;
-		if (!walk_list)
+	size_t *heap, child, tmp;
+
+	heap = ctx->heap;
+	while ((child = 2 * pos + 1) < ctx->heap_len) {
+		if (child + 1 < ctx->heap_len &&
+				heap_less(ctx, heap[child + 1], heap[child]))
+			child++;
+		if (!heap_less(ctx, heap[child], heap[pos]))
 			break;
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-	} while (0);
-	add_list = add_after_last ? last : before_snum;
-	if (!add_list) {
-		walk_list = ctx->vcd_queue_list;
-		while (walk_list) {
-			item = walk_list->data;
-			if (!item)
-				break;
-			if (item->samplenum == snum) {
-				ctx->vcd_queue_last = walk_list;
-				return SR_OK;
-			}
-			if (item->samplenum > snum) {
-				after_snum = walk_list;
-				break;
-			}
-			add_list = walk_list;
-			walk_list = walk_list->next;
-		}
-	}
-	if (add_list && (item = add_list->data) && item->samplenum == snum) {
-		ctx->vcd_queue_last = add_list;
-		return SR_OK;
+		tmp = heap[pos];
+		heap[pos] = heap[child];
+		heap[child] = tmp;
+		pos = child;
 	}
-
-	/*
-	 * Create a new queue item for the so far untracked sample
-	 * number. Immediately search for the inserted position (is
-	 * unfortunately not returned from the insert call), and
-	 * cache that position for subsequent lookups.
-	 */
-	if (with_queue_stats)
-		sr_dbg("%s(), queue nr %" PRIu64, __func__, snum);
-	add_item = queue_alloc_item(ctx, snum);
-	if (!add_item)
-		return SR_ERR_MALLOC;
-	if (!add_list)
-		add_list = ctx->vcd_queue_list;
-	if (add_list && add_list->prev)
-		add_list = add_list->prev;
-	walk_list = g_list_insert_sorted(add_list, add_item, cmp_items);
-	if (!walk_list->prev)
-		ctx->vcd_queue_list = walk_list;
-	walk_list = g_list_find_custom(walk_list, &snum, cmp_snum);
-	item = walk_list ? walk_list->data : NULL;
-	if (item && item->samplenum == snum) {
-		ctx->vcd_queue_last = walk_list;
-	}
-	return SR_OK;
 }
 
-/*
- * Prepare to append another text fragment for a value change to the
- * queue item which corresponds to the current sample number. Return
- * the GString which the caller then will append to.
- */
-static GString *queue_value_text_prep(struct context *ctx)
+/* Heapify the sources which have queued changes before a sample number. */
+static void heap_build(struct context *ctx, uint64_t upto_snum)
 {
-	struct vcd_queue_item *item;
-	GString *buff;
-
-	/* Cope with not-yet-positioned write pointers. */
-	item = ctx->vcd_queue_last ? ctx->vcd_queue_last->data : NULL;
-	if (!item)
-		return NULL;
+	const struct vcd_queue_change *change;
+	size_t i;
 
-	/* Create a GString if not done already. */
-	buff = item->values;
-	if (!buff) {
-		buff = g_string_sized_new(20);
-		item->values = buff;
+	ctx->heap_len = 0;
+	for (i = 0; i < ctx->queue_count; i++) {
+		change = queue_peek(&ctx->queues[i]);
+		if (!change || change->samplenum >= upto_snum)
+			continue;
+		ctx->heap[ctx->heap_len++] = i;
 	}
-
-	/* Separate items with spaces (if previous content is present). */
-	if (buff->len)
-		g_string_append_c(buff, ' ');
-
-	return buff;
-}
-
-static double snum_to_ts(struct context *ctx, uint64_t snum)
-{
-	double ts;
-
-	ts = (double)snum;
-	ts /= ctx->samplerate;
-	ts *= ctx->period;
-
-	return ts;
+	i = ctx->heap_len / 2;
+	while (i--)
+		heap_sift_down(ctx, i);
 }
 
 /*
- * Unqueue one item of the VCD values queue which corresponds to one
- * sample number. Append all of the text to the passed in GString.
+ * Append the text of a queued value change to the caller's text. The
+ * caller has emitted the sample number's timestamp before.
  */
-static int unqueue_item(struct context *ctx,
-	struct vcd_queue_item *item, GString *s)
+static void unqueue_change(struct context *ctx,
+	const struct vcd_queue_change *change, GString *s)
 {
-	double ts;
-	GString *buff;
-	gboolean is_empty;
-
-	/*
-	 * Start the sample number's string with the timestamp. Append
-	 * all value changes. Terminate lines for items which have a
-	 * timestamp but no value changes, assuming this is the last
-	 * entry which corresponds to SR_DF_END.
-	 */
-	ts = snum_to_ts(ctx, item->samplenum);
-	buff = item->values;
-	is_empty = !buff || !buff->len || !buff->str || !*buff->str;
-	append_vcd_timestamp(s, ts, is_empty);
-	if (!is_empty)
-		g_string_append(s, buff->str);
+	struct vcd_channel_desc *desc;
 
-	return SR_OK;
+	desc = &ctx->channels[change->channel];
+	if (desc->type == SR_CHANNEL_LOGIC)
+		format_vcd_value_bit(s, change->value != 0.0, desc->name);
+	else
+		format_vcd_value_real(s, change->value, desc->name);
 }
 
 /*
@@ -931,13 +832,13 @@ static uint64_t get_max_snum_flush(struct context *ctx)
  * Pass all queued value changes when we are certain we have received
  * data from all channels.
  */
-static int write_completed_changes(struct context *ctx, GString *out)
+static void write_completed_changes(struct context *ctx, GString *out)
 {
-	uint64_t upto_snum;
-	GList **listref, *node;
-	struct vcd_queue_item *item;
-	int rc;
+	uint64_t upto_snum, snum;
+	const struct vcd_queue_change *change;
+	struct vcd_queue *q;
 	size_t dumped;
+	gboolean first;
 
 	/* Determine the number which all data was received for so far. */
 	upto_snum = get_max_snum_export(ctx);
@@ -945,33 +846,104 @@ static int write_completed_changes(struct context *ctx, GString *out)
 		sr_spew("%s(), check up to %" PRIu64, __func__, upto_snum);
 
 	/*
-	 * Forward and consume those items from the head of the list
+	 * Forward and consume those changes from the heads of the queues
 	 * which we completely have accumulated and are certain about.
+	 * Emit one timestamp per sample number, followed by all of its
+	 * value changes.
 	 */
 	dumped = 0;
-	listref = &ctx->vcd_queue_list;
-	while (*listref) {
-		/* Find items before the targetted sample number. */
-		node = *listref;
-		item = node->data;
-		if (!item)
-			break;
-		if (item->samplenum >= upto_snum)
-			break;
+	heap_build(ctx, upto_snum);
+	while (ctx->heap_len) {
+		q = &ctx->queues[ctx->heap[0]];
+		snum = queue_peek(q)->samplenum;
+		if (with_queue_stats)
+			sr_dbg("%s(), dump nr %" PRIu64, __func__, snum);
+		dumped++;
+		append_vcd_timestamp(ctx, out, snum, FALSE);
+		first = TRUE;
+		while (ctx->heap_len) {
+			q = &ctx->queues[ctx->heap[0]];
+			if (queue_peek(q)->samplenum != snum)
+				break;
+			while ((change = queue_peek(q)) &&
+					change->samplenum == snum) {
+				if (!first)
+					g_string_append_c(out, ' ');
+				first = FALSE;
+				unqueue_change(ctx, change, out);
+				q->head++;
+			}
+			/* Drop the source from the heap when it's done. */
+			change = queue_peek(q);
+			if (!change || change->samplenum >= upto_snum)
+				ctx->heap[0] = ctx->heap[--ctx->heap_len];
+			heap_sift_down(ctx, 0);
+		}
+	}
+	if (with_queue_stats)
+		sr_spew("%s(), dumped %zu", __func__, dumped);
+}
 
+/*
+ * Check one set of logic samples for value changes. Emit or queue the
+ * text for the sample number and those channels which have changed.
+ */
+static int write_logic_sample(struct context *ctx, GString *out,
+	const uint8_t *sample, size_t unit_size, uint64_t snum_curr)
+{
+	uint8_t *last_logic, prevbit, curbit;
+	gboolean changed;
+	size_t p, index;
+	struct vcd_channel_desc *desc;
+	int rc;
+
+	/* Check whether any logic value has changed. */
+	last_logic = ctx->last_logic;
+	changed = memcmp(last_logic, sample, unit_size) != 0;
+	changed |= snum_curr == 0;
+	if (!changed)
+		return SR_OK;
+	memcpy(last_logic, sample, unit_size);
+
+	/* Start the sample number's text for logic-only setups. */
+	if (ctx->immediate_write) {
+		append_vcd_timestamp(ctx, out, snum_curr, FALSE);
+	}
+
+	/* Iterate over individual logic channels. */
+	for (p = 0; p < ctx->enabled_count; p++) {
 		/*
-		 * Unlink the item from the list. Void cached positions.
-		 * Append its timestamp and values to the caller's text.
+		 * TODO Check whether the mapping from
+		 * data image positions to channel numbers
+		 * is required. Experiments suggest that
+		 * the data image "is dense", and packs
+		 * bits of enabled channels, and leaves no
+		 * room for positions of disabled channels.
 		 */
-		dumped++;
-		if (with_queue_stats)
-			sr_dbg("%s(), dump nr %" PRIu64,
-				__func__, item->samplenum);
-		if (ctx->vcd_queue_last == node)
-			ctx->vcd_queue_last = NULL;
-		*listref = g_list_remove_link(*listref, node);
-		rc = unqueue_item(ctx, item, out);
-		queue_free_item(ctx, item);
+		desc = &ctx->channels[p];
+		if (desc->type != SR_CHANNEL_LOGIC)
+			continue;
+		index = desc->index;
+		prevbit = desc->last.logic;
+
+		/* Skip over unchanged values. */
+		curbit = sample[index / 8];
+		curbit = (curbit & (1 << (index % 8))) ? 1 : 0;
+		if (snum_curr != 0 && prevbit == curbit)
+			continue;
+		desc->last.logic = curbit;
+
+		/*
+		 * Queue, or immediately emit the text for
+		 * the observed value change.
+		 */
+		if (ctx->immediate_write) {
+			g_string_append_c(out, ' ');
+			format_vcd_value_bit(out, curbit, desc->name);
+			continue;
+		}
+		rc = queue_push(&ctx->queues[desc->queue], snum_curr,
+			p, curbit);
 		if (rc != SR_OK)
 			return rc;
 	}
@@ -981,27 +953,25 @@ static int write_completed_changes(struct context *ctx, GString *out)
 
 /* Get packets from the session feed, generate output text. */
 static int receive(const struct sr_output *o,
-	const struct sr_datafeed_packet *packet, GString **out)
+	const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
 	struct vcd_channel_desc *desc;
 	uint64_t snum_curr;
-	size_t count, index, p, unit_size;
+	size_t count, index, unit_size, desc_idx;
 	gboolean changed;
-	GString *s_val;
-	uint8_t *sample, *last_logic, prevbit, curbit;
+	uint8_t *sample;
 	GSList *channels;
 	struct sr_channel *channel;
 	int rc;
 	float *floats, value;
-	double ts;
 
-	*out = NULL;
 	if (!o || !o->priv)
 		return SR_ERR_BUG;
 	ctx = o->priv;
@@ -1017,7 +987,7 @@ static int receive(const struct sr_output *o,
 		}
 		break;
 	case SR_DF_LOGIC:
-		*out = chk_header(o);
+		chk_header(o, out);
 
 		logic = packet->payload;
 		sample = logic->data;
@@ -1026,73 +996,41 @@ static int receive(const struct sr_output *o,
 		snum_curr = get_last_snum_logic(ctx);
 		upd_last_snum_logic(ctx, count);
 
-		last_logic = ctx->last_logic;
 		while (count--) {
-			/* Check whether any logic value has changed. */
-			changed = memcmp(last_logic, sample, unit_size) != 0;
-			changed |= snum_curr == 0;
-			if (changed)
-				memcpy(last_logic, sample, unit_size);
-
-			/*
-			 * Start or continue tracking that sample number.
-			 * Avoid string copies for logic-only setups.
-			 */
-			if (changed) {
-				if (ctx->immediate_write) {
-					ts = snum_to_ts(ctx, snum_curr);
-					append_vcd_timestamp(*out, ts, FALSE);
-				} else {
-					queue_samplenum(ctx, snum_curr);
-				}
-			}
-
-			/* Iterate over individual logic channels. */
-			for (p = 0; changed && p < ctx->enabled_count; p++) {
-				/*
-				 * TODO Check whether the mapping from
-				 * data image positions to channel numbers
-				 * is required. Experiments suggest that
-				 * the data image "is dense", and packs
-				 * bits of enabled channels, and leaves no
-				 * room for positions of disabled channels.
-				 */
-				desc = &ctx->channels[p];
-				if (desc->type != SR_CHANNEL_LOGIC)
-					continue;
-				index = desc->index;
-				prevbit = desc->last.logic;
-
-				/* Skip over unchanged values. */
-				curbit = sample[index / 8];
-				curbit = (curbit & (1 << (index % 8))) ? 1 : 0;
-				if (snum_curr != 0 && prevbit == curbit)
-					continue;
-				desc->last.logic = curbit;
-
-				/*
-				 * Queue, or immediately emit the text for
-				 * the observed value change.
-				 */
-				if (ctx->immediate_write) {
-					g_string_append_c(*out, ' ');
-					s_val = *out;
-				} else {
-					s_val = queue_value_text_prep(ctx);
-					if (!s_val)
-						break;
-				}
-				format_vcd_value_bit(s_val, curbit, desc->name);
-			}
-
-			/* Advance to next set of logic samples. */
+			rc = write_logic_sample(ctx, out, sample, unit_size,
+				snum_curr);
+			if (rc != SR_OK)
+				return rc;
 			snum_curr++;
 			sample += unit_size;
 		}
-		write_completed_changes(ctx, *out);
+		write_completed_changes(ctx, out);
+		break;
+	case SR_DF_LOGIC_RLE:
+		chk_header(o, out);
+
+		/*
+		 * Values can only change at the start of a run. All other
+		 * samples of the run repeat the value, which is exactly
+		 * what VCD does not print. Just advance the sample number.
+		 */
+		logic_rle = packet->payload;
+		sample = logic_rle->values;
+		unit_size = logic_rle->unitsize;
+		snum_curr = get_last_snum_logic(ctx);
+		upd_last_snum_logic(ctx, logic_rle->num_samples);
+		for (index = 0; index < logic_rle->num_runs; index++) {
+			rc = write_logic_sample(ctx, out, sample, unit_size,
+				snum_curr);
+			if (rc != SR_OK)
+				return rc;
+			snum_curr += logic_rle->lengths[index];
+			sample += unit_size;
+		}
+		write_completed_changes(ctx, out);
 		break;
 	case SR_DF_ANALOG:
-		*out = chk_header(o);
+		chk_header(o, out);
 
 		/*
 		 * This implementation expects one analog packet per
@@ -1117,6 +1055,7 @@ static int receive(const struct sr_output *o,
 			return SR_OK;
 		if (desc->type != SR_CHANNEL_ANALOG)
 			return SR_ERR;
+		desc_idx = index;
 		snum_curr = get_last_snum_analog(desc);
 		upd_last_snum_analog(desc, count);
 
@@ -1149,26 +1088,29 @@ static int receive(const struct sr_output *o,
 
 			/* Queue, or emit the timestamp and the new value. */
 			if (ctx->immediate_write) {
-				ts = snum_to_ts(ctx, snum_curr + index);
-				append_vcd_timestamp(*out, ts, FALSE);
-				s_val = *out;
-			} else {
-				queue_samplenum(ctx, snum_curr + index);
-				s_val = queue_value_text_prep(ctx);
+				append_vcd_timestamp(ctx, out,
+					snum_curr + index, FALSE);
+				format_vcd_value_real(out, value, desc->name);
+				continue;
+			}
+			rc = queue_push(&ctx->queues[desc->queue],
+				snum_curr + index, desc_idx, value);
+			if (rc != SR_OK) {
+				g_free(floats);
+				return rc;
 			}
-			format_vcd_value_real(s_val, value, desc->name);
 		}
 
 		g_free(floats);
-		write_completed_changes(ctx, *out);
+		write_completed_changes(ctx, out);
 		break;
 	case SR_DF_END:
-		*out = chk_header(o);
-		/* Push the final timestamp as length indicator. */
-		snum_curr = get_max_snum_flush(ctx);
-		queue_samplenum(ctx, snum_curr);
+		chk_header(o, out);
 		/* Flush previously queued value changes. */
-		write_completed_changes(ctx, *out);
+		snum_curr = get_max_snum_flush(ctx);
+		write_completed_changes(ctx, out);
+		/* Push the final timestamp as length indicator. */
+		append_vcd_timestamp(ctx, out, snum_curr, TRUE);
 		break;
 	}
 
@@ -1179,25 +1121,24 @@ static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
 	struct vcd_channel_desc *desc;
+	size_t i;
 
 	if (!o || !o->priv)
 		return SR_ERR_ARG;
 
 	ctx = o->priv;
 
-	if (with_pool_stats)
-		sr_info("STATS: alloc/reuse %zu/%zu, pool/free %zu/%zu",
-			ctx->alloced, ctx->reused, ctx->pooled, ctx->freed);
-	queue_drain_pool(ctx);
-	if (with_pool_stats)
-		sr_info("STATS: alloc/reuse %zu/%zu, pool/free %zu/%zu",
-			ctx->alloced, ctx->reused, ctx->pooled, ctx->freed);
+	for (i = 0; i < ctx->queue_count; i++)
+		g_free(ctx->queues[i].changes);
+	g_free(ctx->queues);
+	g_free(ctx->heap);
 
 	while (ctx->enabled_count--) {
 		desc = &ctx->channels[ctx->enabled_count];
 		g_string_free(desc->name, TRUE);
 	}
 	g_free(ctx->channels);
+	g_free(ctx->last_logic);
 	g_free(ctx);
 
 	return SR_OK;
@@ -1208,9 +1149,9 @@ struct sr_output_module output_vcd = {
 	.name = "VCD",
 	.desc = "Value Change Dump data",
 	.exts = (const char*[]){"vcd", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_LOGIC_RLE,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.receive_append = receive,
 	.cleanup = cleanup,
 };
@@ -28,11 +28,15 @@
 
 #define LOG_PREFIX "scpi_serial"
 
+/* How long a read waits for receive data before it returns. */
+#define READ_WAIT_MS 10
+
 #ifdef HAVE_SERIAL_COMM
 
 struct scpi_serial {
 	struct sr_serial_dev_inst *serial;
 	gboolean got_newline;
+	gboolean response_started;
 };
 
 /* Default serial port options for some known USB devices */
@@ -118,6 +122,7 @@ static int scpi_serial_open(struct sr_scpi_dev_inst *scpi)
 		return SR_ERR;
 
 	sscpi->got_newline = FALSE;
+	sscpi->response_started = FALSE;
 
 	return SR_OK;
 }
@@ -172,6 +177,7 @@ static int scpi_serial_read_begin(void *priv)
 {
 	struct scpi_serial *sscpi = priv;
 	sscpi->got_newline = FALSE;
+	sscpi->response_started = FALSE;
 
 	return SR_OK;
 }
@@ -179,13 +185,27 @@ static int scpi_serial_read_begin(void *priv)
 static int scpi_serial_read_data(void *priv, char *buf, int maxlen)
 {
 	struct scpi_serial *sscpi = priv;
-	int ret;
+	int ret, skip;
 
-	/* Try to read new data into the buffer. */
-	ret = serial_read_nonblocking(sscpi->serial, buf, maxlen);
+	/* Wait briefly for new data, instead of having the caller spin. */
+	ret = serial_read_available(sscpi->serial, buf, maxlen, READ_WAIT_MS);
 	if (ret < 0)
 		return ret;
 
+	/*
+	 * Drop the CR of an NL+CR terminator which arrived after the
+	 * previous response was complete.
+	 */
+	if (!sscpi->response_started) {
+		for (skip = 0; skip < ret && buf[skip] == '\r'; skip++)
+			;
+		if (skip) {
+			ret -= skip;
+			memmove(buf, &buf[skip], ret);
+		}
+		sscpi->response_started = ret > 0;
+	}
+
 	/*
 	 * Check for line termination at the end of the receive data.
 	 * Handle the usual case of NL, as well as the unusual NL+CR
@@ -39,6 +39,9 @@
 #define LOG_PREFIX "serial"
 /** @endcond */
 
+/* Size of the chunks which serial_readline() reads at a time. */
+#define READLINE_CHUNK_SIZE 256
+
 /**
  * @file
  *
@@ -173,6 +176,10 @@ SR_PRIV int serial_close(struct sr_serial_dev_inst *serial)
 		g_string_free(serial->rcv_buffer, TRUE);
 		serial->rcv_buffer = NULL;
 	}
+	if (rc == SR_OK && serial->readahead) {
+		g_string_free(serial->readahead, TRUE);
+		serial->readahead = NULL;
+	}
 
 	return rc;
 }
@@ -197,6 +204,8 @@ SR_PRIV int serial_flush(struct sr_serial_dev_inst *serial)
 	sr_spew("Flushing serial port %s.", serial->port);
 
 	sr_ser_discard_queued_data(serial);
+	if (serial->readahead)
+		g_string_truncate(serial->readahead, 0);
 
 	if (!serial->lib_funcs || !serial->lib_funcs->flush)
 		return SR_ERR_NA;
@@ -388,6 +397,8 @@ SR_PRIV size_t serial_has_receive_data(struct sr_serial_dev_inst *serial)
 		lib_count = serial->lib_funcs->get_rx_avail(serial);
 
 	buf_count = sr_ser_has_queued_data(serial);
+	if (serial->readahead)
+		buf_count += serial->readahead->len;
 
 	return lib_count + buf_count;
 }
@@ -452,16 +463,11 @@ SR_PRIV int serial_write_nonblocking(struct sr_serial_dev_inst *serial,
 	return _serial_write(serial, buf, count, 1, 0);
 }
 
-static int _serial_read(struct sr_serial_dev_inst *serial,
+static int _serial_read_lib(struct sr_serial_dev_inst *serial,
 	void *buf, size_t count, int nonblocking, unsigned int timeout_ms)
 {
 	ssize_t ret;
 
-	if (!serial) {
-		sr_dbg("Invalid serial port.");
-		return SR_ERR;
-	}
-
 	if (!serial->lib_funcs || !serial->lib_funcs->read)
 		return SR_ERR_NA;
 	ret = serial->lib_funcs->read(serial, buf, count,
@@ -472,6 +478,39 @@ static int _serial_read(struct sr_serial_dev_inst *serial,
 	return ret;
 }
 
+static int _serial_read(struct sr_serial_dev_inst *serial,
+	void *buf, size_t count, int nonblocking, unsigned int timeout_ms)
+{
+	size_t copied;
+	int ret;
+
+	if (!serial) {
+		sr_dbg("Invalid serial port.");
+		return SR_ERR;
+	}
+
+	/*
+	 * Hand out data which serial_readline() has read ahead first.
+	 * The rest is read in the caller's mode, blocking reads still
+	 * wait up to the full timeout for it.
+	 */
+	copied = 0;
+	if (serial->readahead && serial->readahead->len) {
+		copied = MIN(count, serial->readahead->len);
+		memcpy(buf, serial->readahead->str, copied);
+		g_string_erase(serial->readahead, 0, copied);
+		if (copied == count)
+			return copied;
+	}
+
+	ret = _serial_read_lib(serial, (uint8_t *)buf + copied, count - copied,
+		nonblocking, timeout_ms);
+	if (ret < 0)
+		return copied ? (int)copied : ret;
+
+	return copied + ret;
+}
+
 /**
  * Read a number of bytes from the specified serial port, block until finished.
  *
@@ -513,6 +552,55 @@ SR_PRIV int serial_read_nonblocking(struct sr_serial_dev_inst *serial,
 	return _serial_read(serial, buf, count, 1, 0);
 }
 
+/* Wait for the first byte, then take what else is available. */
+static int _serial_read_available(struct sr_serial_dev_inst *serial,
+	void *buf, size_t count, unsigned int timeout_ms,
+	int (*read)(struct sr_serial_dev_inst *serial, void *buf,
+		size_t count, int nonblocking, unsigned int timeout_ms))
+{
+	int ret, more;
+
+	if (!count)
+		return 0;
+	if (!timeout_ms)
+		return read(serial, buf, count, 1, 0);
+
+	ret = read(serial, buf, 1, 0, timeout_ms);
+	if (ret <= 0 || count == 1)
+		return ret;
+	more = read(serial, (uint8_t *)buf + ret, count - ret, 1, 0);
+	if (more > 0)
+		ret += more;
+
+	return ret;
+}
+
+/**
+ * Read up to @a count bytes from the specified serial port, waiting for
+ * receive data when none is available yet.
+ *
+ * Returns as soon as some data was received, or when the timeout has
+ * expired. Waiting is done by the transport, e.g. on the readiness of
+ * the port's file descriptor, there is no polling.
+ *
+ * @param serial Previously initialized serial port structure.
+ * @param buf Buffer where to store the bytes that are read.
+ * @param[in] count The maximum number of bytes to read.
+ * @param[in] timeout_ms How long to wait for data, or 0 to not wait.
+ *
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Other error.
+ * @retval other The number of bytes read, 0 when the timeout expired.
+ *
+ * @private
+ */
+SR_PRIV int serial_read_available(struct sr_serial_dev_inst *serial,
+	void *buf, size_t count, unsigned int timeout_ms)
+{
+	return _serial_read_available(serial, buf, count, timeout_ms,
+		_serial_read);
+}
+
 /**
  * Set serial parameters for the specified serial port.
  *
@@ -721,6 +809,17 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 			flow, rts, dtr);
 }
 
+/* Move up to count bytes of read ahead data to the caller's buffer. */
+static size_t readline_take(GString *readahead, char *buf,
+	size_t count, size_t skip)
+{
+	memcpy(buf, readahead->str, count);
+	buf[count] = '\0';
+	g_string_erase(readahead, 0, MIN(count + skip, readahead->len));
+
+	return count;
+}
+
 /**
  * Read a line from the specified serial port.
  *
@@ -730,6 +829,10 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
  * @param[in] timeout_ms How long to wait for a line to come in.
  *
  * Reading stops when CR or LF is found, which is stripped from the buffer.
+ * Only one of CR or LF gets consumed per call.
+ *
+ * Receive data gets read in chunks. Data past the end of the line is
+ * kept, and is seen by the next read from the port.
  *
  * @retval SR_OK Success.
  * @retval SR_ERR Failure.
@@ -739,8 +842,11 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial,
 	char **buf, int *buflen, gint64 timeout_ms)
 {
-	gint64 start, remaining;
-	int maxlen, len;
+	GString *rx;
+	gint64 deadline, remaining;
+	size_t maxlen, searchlen, oldlen;
+	const char *cr, *lf;
+	int ret;
 
 	if (!serial) {
 		sr_dbg("Invalid serial port.");
@@ -752,33 +858,47 @@ SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial,
 		return -1;
 	}
 
-	start = g_get_monotonic_time();
-	remaining = timeout_ms;
-
-	maxlen = *buflen;
-	*buflen = len = 0;
+	if (*buflen < 2) {
+		*buflen = 0;
+		return SR_OK;
+	}
+	maxlen = *buflen - 1;
+	*buflen = 0;
+
+	if (!serial->readahead)
+		serial->readahead = g_string_sized_new(READLINE_CHUNK_SIZE);
+	rx = serial->readahead;
+	deadline = g_get_monotonic_time() + timeout_ms * 1000;
+	searchlen = 0;
 	while (1) {
-		len = maxlen - *buflen - 1;
-		if (len < 1)
+		/* Look for the line end in data which was not searched yet. */
+		lf = memchr(rx->str + searchlen, '\n',
+			MIN(rx->len, maxlen) - MIN(searchlen, maxlen));
+		cr = memchr(rx->str + searchlen, '\r',
+			(lf ? (size_t)(lf - rx->str) : MIN(rx->len, maxlen)) -
+			MIN(searchlen, maxlen));
+		if (cr || lf) {
+			*buflen = readline_take(rx, *buf,
+				(cr ? cr : lf) - rx->str, 1);
+			break;
+		}
+		if (rx->len >= maxlen) {
+			*buflen = readline_take(rx, *buf, maxlen, 0);
 			break;
-		len = serial_read_blocking(serial, *buf + *buflen, 1, remaining);
-		if (len > 0) {
-			*buflen += len;
-			*(*buf + *buflen) = '\0';
-			if (*buflen > 0 && (*(*buf + *buflen - 1) == '\r'
-					|| *(*buf + *buflen - 1) == '\n')) {
-				/* Strip CR/LF and terminate. */
-				*(*buf + --*buflen) = '\0';
-				break;
-			}
 		}
-		/* Reduce timeout by time elapsed. */
-		remaining = timeout_ms - ((g_get_monotonic_time() - start) / 1000);
-		if (remaining <= 0)
-			/* Timeout */
+		searchlen = rx->len;
+
+		/* Receive another chunk, or return what we have on timeout. */
+		remaining = (deadline - g_get_monotonic_time()) / 1000;
+		oldlen = rx->len;
+		g_string_set_size(rx, oldlen + READLINE_CHUNK_SIZE);
+		ret = _serial_read_available(serial, rx->str + oldlen,
+			READLINE_CHUNK_SIZE, MAX(remaining, 0), _serial_read_lib);
+		g_string_set_size(rx, oldlen + MAX(ret, 0));
+		if (ret <= 0) {
+			*buflen = readline_take(rx, *buf, rx->len, 0);
 			break;
-		if (len < 1)
-			g_usleep(2000);
+		}
 	}
 	if (*buflen)
 		sr_dbg("Received %d: '%s'.", *buflen, *buf);
@@ -983,6 +1103,32 @@ SR_PRIV int sr_serial_extract_options(GSList *options,
 
 #ifdef HAVE_SERIAL_COMM
 
+/*
+ * Data which serial_readline() has read ahead does not make the port
+ * readable. Keep running the caller's callback while it consumes that
+ * data, so that each line is handled without waiting for more input.
+ */
+static int serial_source_dispatch(int fd, int revents, void *cb_data)
+{
+	struct sr_serial_dev_inst *serial;
+	sr_receive_data_callback cb;
+	size_t pending;
+	int ret;
+
+	serial = cb_data;
+	cb = serial->source_cb;
+	ret = cb(fd, revents, serial->source_cb_data);
+	while (ret && serial->source_cb == cb &&
+			serial->readahead && serial->readahead->len) {
+		pending = serial->readahead->len;
+		ret = cb(fd, G_IO_IN, serial->source_cb_data);
+		if (!serial->readahead || serial->readahead->len >= pending)
+			break;
+	}
+
+	return ret;
+}
+
 /** @private */
 SR_PRIV int serial_source_add(struct sr_session *session,
 	struct sr_serial_dev_inst *serial, int events, int timeout,
@@ -1001,8 +1147,11 @@ SR_PRIV int serial_source_add(struct sr_session *session,
 	if (!serial->lib_funcs || !serial->lib_funcs->setup_source_add)
 		return SR_ERR_NA;
 
+	serial->source_cb = cb;
+	serial->source_cb_data = cb_data;
+
 	return serial->lib_funcs->setup_source_add(session, serial,
-		events, timeout, cb, cb_data);
+		events, timeout, serial_source_dispatch, serial);
 }
 
 /** @private */
@@ -1017,6 +1166,8 @@ SR_PRIV int serial_source_remove(struct sr_session *session,
 	if (!serial->lib_funcs || !serial->lib_funcs->setup_source_remove)
 		return SR_ERR_NA;
 
+	serial->source_cb = NULL;
+
 	return serial->lib_funcs->setup_source_remove(session, serial);
 }
 
@@ -225,6 +225,7 @@ SR_API int sr_session_new(struct sr_context *ctx,
 	session->ctx = ctx;
 
 	g_mutex_init(&session->main_mutex);
+	g_mutex_init(&session->dispatch_mutex);
 
 	/* To maintain API compatibility, we need a lookup table
 	 * which maps poll_object IDs to GSource* pointers.
@@ -261,6 +262,7 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	g_hash_table_unref(session->event_sources);
 
+	g_mutex_clear(&session->dispatch_mutex);
 	g_mutex_clear(&session->main_mutex);
 
 	g_free(session);
@@ -505,6 +507,248 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Set whether the session's datafeed callbacks accept RLE logic data.
+ *
+ * Drivers may emit logic data as SR_DF_LOGIC_RLE packets. Unless the
+ * application declared that its datafeed callbacks handle this packet
+ * type, the session expands run-length encoded data and passes
+ * SR_DF_LOGIC packets to transforms and datafeed callbacks instead.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param accept TRUE when callbacks accept SR_DF_LOGIC_RLE packets.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_logic_rle_set(struct sr_session *session,
+		gboolean accept)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	session->logic_rle = accept;
+
+	return SR_OK;
+}
+
+/**
+ * Get whether the session's datafeed callbacks accept RLE logic data.
+ *
+ * @param session The session to use.
+ *
+ * @retval TRUE SR_DF_LOGIC_RLE packets are passed to callbacks as is.
+ * @retval FALSE RLE data gets expanded, or NULL session was passed.
+ *
+ * @since 0.6.0
+ */
+SR_API gboolean sr_session_logic_rle_get(struct sr_session *session)
+{
+	if (!session)
+		return FALSE;
+
+	return session->logic_rle;
+}
+
+/**
+ * Set whether the session's datafeed callbacks accept timestamped
+ * analog data.
+ *
+ * Drivers may emit analog data as SR_DF_ANALOG_TIMED packets, which
+ * carry the host time of each sample. Unless the application declared
+ * that its datafeed callbacks handle this packet type, the session
+ * passes the samples as SR_DF_ANALOG packets without the timestamps.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param accept TRUE when callbacks accept SR_DF_ANALOG_TIMED packets.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_analog_timed_set(struct sr_session *session,
+		gboolean accept)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	session->analog_timed = accept;
+
+	return SR_OK;
+}
+
+/**
+ * Get whether the session's datafeed callbacks accept timestamped
+ * analog data.
+ *
+ * @param session The session to use.
+ *
+ * @retval TRUE SR_DF_ANALOG_TIMED packets are passed to callbacks as is.
+ * @retval FALSE Timestamps get dropped, or NULL session was passed.
+ *
+ * @since 0.6.0
+ */
+SR_API gboolean sr_session_analog_timed_get(struct sr_session *session)
+{
+	if (!session)
+		return FALSE;
+
+	return session->analog_timed;
+}
+
+/**
+ * Let drivers of low rate devices batch up analog readings.
+ *
+ * Drivers of multimeters, LCR meters, scales and power supplies send
+ * each reading in a packet of its own by default. With batching, they
+ * collect the readings of each channel and send them when max_samples
+ * readings were collected, or when the oldest of them has been held
+ * back for max_age_ms. Each reading keeps the time it was taken, see
+ * sr_session_analog_timed_set().
+ *
+ * Takes effect when the next acquisition starts.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param max_samples Most readings per packet, 0 or 1 to not batch.
+ * @param max_age_ms Longest time to hold back a reading, 0 for no limit.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_analog_batch_set(struct sr_session *session,
+		size_t max_samples, uint64_t max_age_ms)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	session->analog_batch_samples = max_samples;
+	session->analog_batch_age_ms = max_age_ms;
+
+	return SR_OK;
+}
+
+/**
+ * Get the session's batching of analog readings.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param max_samples Receives the most readings per packet. Can be NULL.
+ * @param max_age_ms Receives the longest time to hold back a reading.
+ *                   Can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_analog_batch_get(struct sr_session *session,
+		size_t *max_samples, uint64_t *max_age_ms)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (max_samples)
+		*max_samples = session->analog_batch_samples;
+	if (max_age_ms)
+		*max_age_ms = session->analog_batch_age_ms;
+
+	return SR_OK;
+}
+
+/**
+ * Set up datafeed dispatch on a separate thread.
+ *
+ * By default, transforms and datafeed callbacks run in the context of
+ * the code which sends a packet, which often is a USB completion handler.
+ * A slow consumer then delays the acquisition, and samples may get lost.
+ *
+ * With a non-zero queue depth, packets are queued, and a consumer thread
+ * which the session starts and stops runs the transforms and datafeed
+ * callbacks. Packets are passed on in the order they were sent. All of
+ * them were dispatched when the session's stopped callback runs.
+ *
+ * Datafeed callbacks must then be prepared to run on a thread other
+ * than the session's main loop.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param queue_depth Maximum number of queued packets, 0 to dispatch in
+ *                    the sender's context (the default).
+ * @param overflow How to handle a full queue.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dispatch_set(struct sr_session *session,
+		size_t queue_depth, enum sr_dispatch_overflow overflow)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (overflow != SR_DISPATCH_OVERFLOW_BLOCK &&
+			overflow != SR_DISPATCH_OVERFLOW_DROP)
+		return SR_ERR_ARG;
+
+	if (queue_depth > G_MAXINT / 2)
+		return SR_ERR_ARG;
+
+	if (session->running) {
+		sr_err("Cannot change dispatch while the session is running.");
+		return SR_ERR;
+	}
+
+	session->dispatch_depth = queue_depth;
+	session->dispatch_drop = overflow == SR_DISPATCH_OVERFLOW_DROP;
+
+	return SR_OK;
+}
+
+/**
+ * Get statistics of datafeed dispatch on a separate thread.
+ *
+ * While the session is running, this returns the current values. After
+ * the session stopped, the values of the last run are returned.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats Where to store the statistics. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dispatch_stats_get(struct sr_session *session,
+		struct sr_session_dispatch_stats *stats)
+{
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&session->dispatch_mutex);
+	if (session->dispatch)
+		sr_session_dispatch_stats_read(session->dispatch, stats);
+	else
+		*stats = session->dispatch_stats;
+	g_mutex_unlock(&session->dispatch_mutex);
+
+	return SR_OK;
+}
+
 /**
  * Get the trigger assigned to this session.
  *
@@ -671,6 +915,28 @@ static unsigned int session_source_attach(struct sr_session *session,
 	return id;
 }
 
+/*
+ * Terminate datafeed dispatch on a separate thread. Packets which are
+ * still queued get passed to the callbacks before this returns.
+ */
+static void session_dispatch_stop(struct sr_session *session)
+{
+	struct sr_session_dispatch *dispatch;
+
+	dispatch = session->dispatch;
+	if (!dispatch)
+		return;
+
+	sr_session_dispatch_finish(dispatch);
+
+	g_mutex_lock(&session->dispatch_mutex);
+	sr_session_dispatch_stats_read(dispatch, &session->dispatch_stats);
+	session->dispatch = NULL;
+	g_mutex_unlock(&session->dispatch_mutex);
+
+	sr_session_dispatch_free(dispatch);
+}
+
 /* Idle handler; invoked when the number of registered event sources
  * for a running session drops to zero.
  */
@@ -690,6 +956,7 @@ static gboolean delayed_stop_check(void *data)
 		return G_SOURCE_REMOVE;
 
 	session->running = FALSE;
+	session_dispatch_stop(session);
 	unset_main_context(session);
 
 	sr_info("Stopped.");
@@ -754,6 +1021,7 @@ SR_API int sr_session_start(struct sr_session *session)
 {
 	struct sr_dev_inst *sdi;
 	struct sr_channel *ch;
+	struct sr_session_dispatch *dispatch;
 	GSList *l, *c, *lend;
 	int ret;
 
@@ -808,6 +1076,21 @@ SR_API int sr_session_start(struct sr_session *session)
 
 	sr_info("Starting.");
 
+	/* Optionally run the datafeed callbacks on a separate thread. */
+	dispatch = NULL;
+	if (session->dispatch_depth) {
+		dispatch = sr_session_dispatch_new(session->dispatch_depth,
+			session->dispatch_drop);
+		if (!dispatch) {
+			unset_main_context(session);
+			return SR_ERR;
+		}
+	}
+	g_mutex_lock(&session->dispatch_mutex);
+	memset(&session->dispatch_stats, 0, sizeof(session->dispatch_stats));
+	session->dispatch = dispatch;
+	g_mutex_unlock(&session->dispatch_mutex);
+
 	session->running = TRUE;
 
 	/* Have all devices start acquisition. */
@@ -837,6 +1120,7 @@ SR_API int sr_session_start(struct sr_session *session)
 		 * sources... */
 		session->running = FALSE;
 
+		session_dispatch_stop(session);
 		unset_main_context(session);
 		return ret;
 	}
@@ -1035,6 +1319,8 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_rle *rle;
+	const struct sr_datafeed_analog_timed *timed;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1066,6 +1352,17 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_RLE packet (%" PRIu64 " runs, "
+		       "%" PRIu64 " samples, unitsize = %d).", rle->num_runs,
+		       rle->num_samples, rle->unitsize);
+		break;
+	case SR_DF_ANALOG_TIMED:
+		timed = packet->payload;
+		sr_dbg("bus: Received SR_DF_ANALOG_TIMED packet (%d samples).",
+		       timed->analog.num_samples);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
@@ -1108,6 +1405,78 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
+/**
+ * Send a packet whose sample data lives in a reference counted buffer.
+ *
+ * Datafeed callbacks can keep the sample data beyond the callback's
+ * lifetime by taking a reference to @a buf via sr_packet_buffer_ref(),
+ * and sr_packet_copy() shares the data instead of copying it.
+ *
+ * @param sdi Device instance. Must not be NULL.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param buf The buffer holding the packet's sample data. May be NULL,
+ *            in which case this is equivalent to sr_session_send().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf)
+{
+	int ret;
+
+	if (!buf)
+		return sr_session_send(sdi, packet);
+
+	sr_buffer_dispatch_push(buf);
+	ret = sr_session_send(sdi, packet);
+	sr_buffer_dispatch_pop();
+
+	return ret;
+}
+
+/*
+ * Pass run-length encoded logic data as SR_DF_LOGIC packets to the
+ * session, for consumers which don't accept SR_DF_LOGIC_RLE.
+ */
+static int session_send_rle_expanded(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint64_t run_idx, run_pos, chunk_count, count;
+	uint8_t *buf;
+	int ret;
+
+	chunk_count = MIN(rle->num_samples, LOGIC_RLE_EXPAND_CHUNK);
+	if (!chunk_count || !rle->unitsize)
+		return SR_OK;
+	buf = g_try_malloc(chunk_count * rle->unitsize);
+	if (!buf)
+		return SR_ERR_MALLOC;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	logic.data = buf;
+
+	ret = SR_OK;
+	run_idx = run_pos = 0;
+	while (ret == SR_OK) {
+		count = sr_logic_rle_expand(rle, &run_idx, &run_pos,
+			buf, chunk_count);
+		if (!count)
+			break;
+		logic.length = count * rle->unitsize;
+		ret = sr_session_send_sync(sdi, &packet);
+	}
+	g_free(buf);
+
+	return ret;
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -1124,12 +1493,6 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
-	GSList *l;
-	struct datafeed_callback *cb_struct;
-	struct sr_datafeed_packet *packet_in, *packet_out;
-	struct sr_transform *t;
-	int ret;
-
 	if (!sdi) {
 		sr_err("%s: sdi was NULL", __func__);
 		return SR_ERR_ARG;
@@ -1145,6 +1508,50 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_BUG;
 	}
 
+	/* Hand the packet to the dispatch thread, if the session has one. */
+	if (sdi->session->dispatch)
+		return sr_session_dispatch_push(sdi->session->dispatch,
+			sdi, packet);
+
+	return sr_session_send_sync(sdi, packet);
+}
+
+/**
+ * Run a packet through the transforms and datafeed callbacks.
+ *
+ * This is what sr_session_send() does, in the context of the calling
+ * thread, when the session does not dispatch on a separate thread.
+ *
+ * @param sdi The device instance which sent the packet. Must not be NULL.
+ * @param packet The datafeed packet. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Error in a transform module.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_sync(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+	struct sr_datafeed_packet *packet_in, *packet_out, untimed;
+	const struct sr_datafeed_analog_timed *timed;
+	struct sr_transform *t;
+	int ret;
+
+	/* Expand RLE logic data unless the application accepts it. */
+	if (packet->type == SR_DF_LOGIC_RLE && !sdi->session->logic_rle)
+		return session_send_rle_expanded(sdi, packet->payload);
+
+	/* Drop analog timestamps unless the application accepts them. */
+	if (packet->type == SR_DF_ANALOG_TIMED && !sdi->session->analog_timed) {
+		timed = packet->payload;
+		untimed.type = SR_DF_ANALOG;
+		untimed.payload = &timed->analog;
+		packet = &untimed;
+	}
+
 	/*
 	 * Pass the packet to the first transform module. If that returns
 	 * another packet (instead of NULL), pass that packet to the next
@@ -1181,7 +1588,7 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	 * callbacks.
 	 */
 	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+		if (sr_log_enabled(SR_LOG_DBG))
 			datafeed_dump(packet);
 		cb_struct = l->data;
 		cb_struct->cb(sdi, packet, cb_struct->cb_data);
@@ -1494,6 +1901,61 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 	meta_copy->config = g_slist_append(meta_copy->config, item);
 }
 
+/*
+ * Copies of buffer backed packets share the sample data, and hold a
+ * reference to the buffer until the copy gets freed. sr_packet_copy()
+ * allocates every copy this way, so sr_packet_free() finds the buffer
+ * next to the packet.
+ */
+struct packet_copy {
+	struct sr_datafeed_packet packet;
+	struct sr_buffer *buf;
+};
+
+/* Copy an analog payload, share the data of buffer backed packets. */
+static void copy_analog(const struct sr_datafeed_analog *analog,
+		struct sr_datafeed_analog *analog_copy, struct sr_buffer *buf)
+{
+	if (buf) {
+		analog_copy->data = analog->data;
+	} else {
+		analog_copy->data = g_malloc(analog->encoding->unitsize *
+				analog->num_samples);
+		memcpy(analog_copy->data, analog->data,
+				analog->encoding->unitsize *
+				analog->num_samples);
+	}
+	analog_copy->num_samples = analog->num_samples;
+#if GLIB_CHECK_VERSION(2, 67, 3)
+	analog_copy->encoding = g_memdup2(analog->encoding,
+			sizeof(*analog->encoding));
+	analog_copy->meaning = g_memdup2(analog->meaning,
+			sizeof(*analog->meaning));
+	analog_copy->spec = g_memdup2(analog->spec, sizeof(*analog->spec));
+#else
+	analog_copy->encoding = g_memdup(analog->encoding,
+			sizeof(*analog->encoding));
+	analog_copy->meaning = g_memdup(analog->meaning,
+			sizeof(*analog->meaning));
+	analog_copy->spec = g_memdup(analog->spec, sizeof(*analog->spec));
+#endif
+	analog_copy->meaning->channels = g_slist_copy(
+			analog->meaning->channels);
+}
+
+static void free_analog(const struct sr_datafeed_analog *analog,
+		struct sr_buffer *buf)
+{
+	if (buf)
+		sr_buffer_unref(buf);
+	else
+		g_free(analog->data);
+	g_free(analog->encoding);
+	g_slist_free(analog->meaning->channels);
+	g_free(analog->meaning);
+	g_free(analog->spec);
+}
+
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy)
 {
@@ -1501,19 +1963,23 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_datafeed_meta *meta_copy;
 	const struct sr_datafeed_logic *logic;
 	struct sr_datafeed_logic *logic_copy;
-	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
-	struct sr_analog_encoding *encoding_copy;
-	struct sr_analog_meaning *meaning_copy;
-	struct sr_analog_spec *spec_copy;
+	const struct sr_datafeed_logic_rle *rle;
+	struct sr_datafeed_logic_rle *rle_copy;
+	const struct sr_datafeed_analog_timed *timed;
+	struct sr_datafeed_analog_timed *timed_copy;
+	struct packet_copy *pcopy;
 	uint8_t *payload;
 
-	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
+	pcopy = g_malloc0(sizeof(*pcopy));
+	*copy = &pcopy->packet;
 	(*copy)->type = packet->type;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1534,6 +2000,12 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 			return SR_ERR;
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
+		pcopy->buf = sr_packet_buffer_ref(packet);
+		if (pcopy->buf) {
+			logic_copy->data = logic->data;
+			(*copy)->payload = logic_copy;
+			break;
+		}
 		logic_copy->data = g_malloc(logic->length * logic->unitsize);
 		if (!logic_copy->data) {
 			g_free(logic_copy);
@@ -1543,29 +2015,43 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
-		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
-		analog_copy->num_samples = analog->num_samples;
-#if GLIB_CHECK_VERSION(2, 67, 3)
-		encoding_copy = g_memdup2(analog->encoding, sizeof(*analog->encoding));
-		meaning_copy = g_memdup2(analog->meaning, sizeof(*analog->meaning));
-		spec_copy = g_memdup2(analog->spec, sizeof(*analog->spec));
-#else
-		encoding_copy = g_memdup(analog->encoding, sizeof(*analog->encoding));
-		meaning_copy = g_memdup(analog->meaning, sizeof(*analog->meaning));
-		spec_copy = g_memdup(analog->spec, sizeof(*analog->spec));
-#endif
-		analog_copy->encoding = encoding_copy;
-		analog_copy->meaning = meaning_copy;
-		analog_copy->meaning->channels = g_slist_copy(
-				analog->meaning->channels);
-		analog_copy->spec = spec_copy;
+		pcopy->buf = sr_packet_buffer_ref(packet);
+		copy_analog(packet->payload, analog_copy, pcopy->buf);
 		(*copy)->payload = analog_copy;
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		rle_copy = g_malloc(sizeof(*rle_copy));
+		rle_copy->num_runs = rle->num_runs;
+		rle_copy->num_samples = rle->num_samples;
+		rle_copy->unitsize = rle->unitsize;
+		rle_copy->values = g_try_malloc(rle->num_runs * rle->unitsize);
+		rle_copy->lengths = g_try_malloc(
+				rle->num_runs * sizeof(rle->lengths[0]));
+		if (rle->num_runs && (!rle_copy->values || !rle_copy->lengths)) {
+			g_free(rle_copy->values);
+			g_free(rle_copy->lengths);
+			g_free(rle_copy);
+			return SR_ERR;
+		}
+		memcpy(rle_copy->values, rle->values,
+				rle->num_runs * rle->unitsize);
+		memcpy(rle_copy->lengths, rle->lengths,
+				rle->num_runs * sizeof(rle->lengths[0]));
+		(*copy)->payload = rle_copy;
+		break;
+	case SR_DF_ANALOG_TIMED:
+		timed = packet->payload;
+		timed_copy = g_malloc(sizeof(*timed_copy));
+		copy_analog(&timed->analog, &timed_copy->analog, NULL);
+		timed_copy->timestamps = g_malloc(timed->analog.num_samples *
+				sizeof(timed->timestamps[0]));
+		memcpy(timed_copy->timestamps, timed->timestamps,
+				timed->analog.num_samples *
+				sizeof(timed->timestamps[0]));
+		(*copy)->payload = timed_copy;
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 		return SR_ERR;
@@ -1578,13 +2064,19 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
-	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_rle *rle;
+	const struct sr_datafeed_analog_timed *timed;
 	struct sr_config *src;
+	struct sr_buffer *buf;
 	GSList *l;
 
+	buf = ((struct packet_copy *)packet)->buf;
+
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1603,16 +2095,26 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
+		if (buf)
+			sr_buffer_unref(buf);
+		else
+			g_free(logic->data);
 		g_free((void *)packet->payload);
 		break;
 	case SR_DF_ANALOG:
-		analog = packet->payload;
-		g_free(analog->data);
-		g_free(analog->encoding);
-		g_slist_free(analog->meaning->channels);
-		g_free(analog->meaning);
-		g_free(analog->spec);
+		free_analog(packet->payload, buf);
+		g_free((void *)packet->payload);
+		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		g_free(rle->values);
+		g_free(rle->lengths);
+		g_free((void *)packet->payload);
+		break;
+	case SR_DF_ANALOG_TIMED:
+		timed = packet->payload;
+		free_analog(&timed->analog, NULL);
+		g_free(timed->timestamps);
 		g_free((void *)packet->payload);
 		break;
 	default:
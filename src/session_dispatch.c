@@ -0,0 +1,314 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Datafeed dispatch on a consumer thread.
+ *
+ * Acquisition code (often running in libusb completion handlers) only
+ * enqueues packets, transforms and datafeed callbacks run on a separate
+ * thread. This keeps slow consumers from delaying the resubmission of
+ * USB transfers.
+ *
+ * The queue is a bounded ring. The producer and the consumer each own
+ * one index, which are published with atomic operations. The mutex and
+ * the condition variables are only taken when one side has to sleep,
+ * or needs to wake up the other side which announced that it sleeps.
+ * Producers are serialized by a separate mutex, which is uncontended
+ * in the common case of a single acquisition thread.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "session"
+/** @endcond */
+
+struct dispatch_item {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+	struct sr_buffer *buf;
+};
+
+struct sr_session_dispatch {
+	struct dispatch_item *items;
+	guint mask;
+	gboolean drop;
+
+	/*
+	 * Next slot to read, written by the consumer only, and next slot
+	 * to write, written by producers only. Both count up and wrap
+	 * around, unsigned arithmetic keeps their difference valid.
+	 */
+	guint head;
+	guint tail;
+
+	/* Serializes producers, protects the statistics. */
+	GMutex push_mutex;
+	struct sr_session_dispatch_stats stats;
+
+	/* Sleeping and waking up either side. */
+	GMutex wait_mutex;
+	GCond not_empty;
+	GCond not_full;
+	gint consumer_waiting;
+	gint producer_waiting;
+	gint stop;
+
+	GThread *thread;
+};
+
+static guint dispatch_fill(struct sr_session_dispatch *dispatch)
+{
+	return (guint)g_atomic_int_get(&dispatch->tail) -
+		(guint)g_atomic_int_get(&dispatch->head);
+}
+
+static gboolean is_data_packet(const struct sr_datafeed_packet *packet)
+{
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+	case SR_DF_ANALOG:
+	case SR_DF_LOGIC_RLE:
+	case SR_DF_ANALOG_TIMED:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static void dispatch_item_run(struct dispatch_item *item)
+{
+	if (item->buf)
+		sr_buffer_dispatch_push(item->buf);
+	sr_session_send_sync(item->sdi, item->packet);
+	if (item->buf)
+		sr_buffer_dispatch_pop();
+
+	sr_packet_free(item->packet);
+	sr_buffer_unref(item->buf);
+}
+
+static gpointer dispatch_thread(gpointer data)
+{
+	struct sr_session_dispatch *dispatch;
+	struct dispatch_item item;
+	guint head;
+
+	dispatch = data;
+
+	for (;;) {
+		if (!dispatch_fill(dispatch)) {
+			g_mutex_lock(&dispatch->wait_mutex);
+			g_atomic_int_set(&dispatch->consumer_waiting, 1);
+			while (!dispatch_fill(dispatch) &&
+					!g_atomic_int_get(&dispatch->stop))
+				g_cond_wait(&dispatch->not_empty,
+					&dispatch->wait_mutex);
+			g_atomic_int_set(&dispatch->consumer_waiting, 0);
+			g_mutex_unlock(&dispatch->wait_mutex);
+			/* Only terminate when drained. */
+			if (!dispatch_fill(dispatch))
+				break;
+		}
+
+		head = (guint)g_atomic_int_get(&dispatch->head);
+		item = dispatch->items[head & dispatch->mask];
+		g_atomic_int_set(&dispatch->head, head + 1);
+
+		if (g_atomic_int_get(&dispatch->producer_waiting)) {
+			g_mutex_lock(&dispatch->wait_mutex);
+			g_cond_signal(&dispatch->not_full);
+			g_mutex_unlock(&dispatch->wait_mutex);
+		}
+
+		dispatch_item_run(&item);
+	}
+
+	return NULL;
+}
+
+/**
+ * Start dispatching datafeed packets on a separate thread.
+ *
+ * @param depth Maximum number of queued packets. Gets rounded up to
+ *              the next power of two.
+ * @param drop Drop data packets when the queue is full, instead of
+ *             blocking the sender until the consumer caught up.
+ *
+ * @return The dispatcher, or NULL upon error.
+ *
+ * @private
+ */
+SR_PRIV struct sr_session_dispatch *sr_session_dispatch_new(size_t depth,
+		gboolean drop)
+{
+	struct sr_session_dispatch *dispatch;
+	size_t size;
+	GError *error;
+
+	if (!depth || depth > G_MAXINT / 2)
+		return NULL;
+	if (sr_next_power_of_two(depth - 1, NULL, &size) != SR_OK)
+		return NULL;
+
+	dispatch = g_malloc0(sizeof(*dispatch));
+	dispatch->items = g_malloc0(size * sizeof(dispatch->items[0]));
+	dispatch->mask = size - 1;
+	dispatch->drop = drop;
+	g_mutex_init(&dispatch->push_mutex);
+	g_mutex_init(&dispatch->wait_mutex);
+	g_cond_init(&dispatch->not_empty);
+	g_cond_init(&dispatch->not_full);
+
+	error = NULL;
+	dispatch->thread = g_thread_try_new("sr-dispatch", dispatch_thread,
+		dispatch, &error);
+	if (!dispatch->thread) {
+		sr_err("Cannot create datafeed dispatch thread: %s.",
+			error->message);
+		g_error_free(error);
+		sr_session_dispatch_free(dispatch);
+		return NULL;
+	}
+	sr_dbg("Dispatching datafeed on a separate thread, "
+		"queue depth %zu.", size);
+
+	return dispatch;
+}
+
+/**
+ * Dispatch all queued packets, then terminate the consumer thread.
+ *
+ * Must not be called while packets still get sent, and not from within
+ * a datafeed callback.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_dispatch_finish(struct sr_session_dispatch *dispatch)
+{
+	if (!dispatch || !dispatch->thread)
+		return;
+
+	g_mutex_lock(&dispatch->wait_mutex);
+	g_atomic_int_set(&dispatch->stop, 1);
+	g_cond_signal(&dispatch->not_empty);
+	g_mutex_unlock(&dispatch->wait_mutex);
+
+	g_thread_join(dispatch->thread);
+	dispatch->thread = NULL;
+}
+
+/**
+ * Release a dispatcher. Terminates the consumer thread if needed.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_dispatch_free(struct sr_session_dispatch *dispatch)
+{
+	if (!dispatch)
+		return;
+
+	sr_session_dispatch_finish(dispatch);
+
+	g_cond_clear(&dispatch->not_full);
+	g_cond_clear(&dispatch->not_empty);
+	g_mutex_clear(&dispatch->wait_mutex);
+	g_mutex_clear(&dispatch->push_mutex);
+	g_free(dispatch->items);
+	g_free(dispatch);
+}
+
+/**
+ * Queue a packet for dispatch on the consumer thread.
+ *
+ * The packet gets copied. Buffer backed sample data is shared with the
+ * copy, which avoids copying the samples.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_dispatch_push(struct sr_session_dispatch *dispatch,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct dispatch_item *item;
+	guint fill, tail;
+	int ret;
+
+	g_mutex_lock(&dispatch->push_mutex);
+
+	fill = dispatch_fill(dispatch);
+	if (fill > dispatch->mask) {
+		if (dispatch->drop && is_data_packet(packet)) {
+			dispatch->stats.dropped++;
+			g_mutex_unlock(&dispatch->push_mutex);
+			return SR_OK;
+		}
+		dispatch->stats.stalls++;
+		g_mutex_lock(&dispatch->wait_mutex);
+		g_atomic_int_set(&dispatch->producer_waiting, 1);
+		while (dispatch_fill(dispatch) > dispatch->mask)
+			g_cond_wait(&dispatch->not_full, &dispatch->wait_mutex);
+		g_atomic_int_set(&dispatch->producer_waiting, 0);
+		g_mutex_unlock(&dispatch->wait_mutex);
+	}
+
+	tail = (guint)g_atomic_int_get(&dispatch->tail);
+	item = &dispatch->items[tail & dispatch->mask];
+	ret = sr_packet_copy(packet, &item->packet);
+	if (ret != SR_OK) {
+		g_free(item->packet);
+		item->packet = NULL;
+		g_mutex_unlock(&dispatch->push_mutex);
+		return ret;
+	}
+	item->sdi = sdi;
+	item->buf = sr_packet_buffer_ref(packet);
+	g_atomic_int_set(&dispatch->tail, tail + 1);
+
+	dispatch->stats.packets++;
+	fill = dispatch_fill(dispatch);
+	if (fill > dispatch->stats.max_fill)
+		dispatch->stats.max_fill = fill;
+
+	g_mutex_unlock(&dispatch->push_mutex);
+
+	if (g_atomic_int_get(&dispatch->consumer_waiting)) {
+		g_mutex_lock(&dispatch->wait_mutex);
+		g_cond_signal(&dispatch->not_empty);
+		g_mutex_unlock(&dispatch->wait_mutex);
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Get a snapshot of a dispatcher's statistics.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_dispatch_stats_read(
+		struct sr_session_dispatch *dispatch,
+		struct sr_session_dispatch_stats *stats)
+{
+	g_mutex_lock(&dispatch->push_mutex);
+	*stats = dispatch->stats;
+	g_mutex_unlock(&dispatch->push_mutex);
+}
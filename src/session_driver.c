@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -34,8 +35,44 @@
 #define CHUNKSIZE (4 * 1024 * 1024)
 /** @endcond */
 
+/*
+ * Archive members up to this size get decompressed ahead of time, on
+ * worker threads. Larger ones get streamed, which bounds the memory
+ * held by the prefetch window.
+ */
+#define PREFETCH_MAX_SIZE (16 * 1024 * 1024)
+#define PREFETCH_MAX_THREADS 8
+
 SR_PRIV struct sr_dev_driver session_driver_info;
 
+/* An archive member holding sample data. */
+struct session_chunk {
+	zip_uint64_t zip_index;
+	uint64_t size;
+	/* 0 for logic data, 1-based analog channel number otherwise. */
+	int analog_channel;
+	gboolean stream;
+	/* Filled in by the prefetch workers. */
+	gboolean done;
+	struct sr_buffer *buf;
+};
+
+struct session_prefetch {
+	char *filename;
+	struct session_chunk *chunks;
+	guint num_chunks;
+	guint depth;
+	GThread **threads;
+	guint num_threads;
+	GMutex mutex;
+	GCond cond;
+	/* Next chunk which a worker picks up. */
+	guint next_job;
+	/* Workers only pick up chunks below this index. */
+	guint window_end;
+	gboolean stop;
+};
+
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
@@ -46,10 +83,18 @@ struct session_vdev {
 	int unitsize;
 	int num_logic_channels;
 	int num_analog_channels;
-	int cur_analog_channel;
 	GArray *analog_channels;
-	int cur_chunk;
 	gboolean finished;
+	struct sr_buffer_pool *chunk_pool;
+	uint64_t limit_samples;
+	uint64_t samples_read;
+	/* Archive members with sample data, in the order of emission. */
+	GArray *chunks;
+	guint cur_chunk;
+	/* Current chunk's data, when it was decompressed ahead. */
+	struct sr_buffer *chunk_buf;
+	uint64_t chunk_offset;
+	struct session_prefetch *prefetch;
 };
 
 static const uint32_t devopts[] = {
@@ -59,145 +104,400 @@ static const uint32_t devopts[] = {
 	SR_CONF_NUM_ANALOG_CHANNELS | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
+	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 };
 
+static struct sr_buffer *chunk_decompress(struct zip *archive,
+		const struct session_chunk *chunk)
+{
+	struct zip_file *zf;
+	struct sr_buffer *buf;
+	uint8_t *data;
+	uint64_t done;
+	zip_int64_t ret;
+
+	if (!(buf = sr_buffer_new(chunk->size)))
+		return NULL;
+
+	if (!(zf = zip_fopen_index(archive, chunk->zip_index, 0))) {
+		sr_err("Failed to open chunk: %s.", zip_strerror(archive));
+		sr_buffer_unref(buf);
+		return NULL;
+	}
+	data = sr_buffer_data_get(buf);
+	for (done = 0; done < chunk->size; done += ret) {
+		ret = zip_fread(zf, data + done, chunk->size - done);
+		if (ret <= 0)
+			break;
+	}
+	zip_fclose(zf);
+	if (done != chunk->size) {
+		sr_err("Failed to read chunk.");
+		sr_buffer_unref(buf);
+		return NULL;
+	}
+
+	return buf;
+}
+
+/*
+ * Decompress chunks within the prefetch window, in order. libzip
+ * archives must not be shared between threads, each worker opens
+ * the session file on its own.
+ */
+static gpointer prefetch_thread(gpointer data)
+{
+	struct session_prefetch *prefetch;
+	struct session_chunk *chunk;
+	struct sr_buffer *buf;
+	struct zip *archive;
+	guint idx;
+
+	prefetch = data;
+
+	if (!(archive = zip_open(prefetch->filename, 0, NULL)))
+		sr_err("Failed to open session file '%s'.", prefetch->filename);
+
+	g_mutex_lock(&prefetch->mutex);
+	while (!prefetch->stop) {
+		if (prefetch->next_job >= prefetch->window_end) {
+			g_cond_wait(&prefetch->cond, &prefetch->mutex);
+			continue;
+		}
+		idx = prefetch->next_job++;
+		chunk = &prefetch->chunks[idx];
+		g_mutex_unlock(&prefetch->mutex);
+
+		buf = NULL;
+		if (!chunk->stream && archive)
+			buf = chunk_decompress(archive, chunk);
+
+		g_mutex_lock(&prefetch->mutex);
+		chunk->buf = buf;
+		chunk->done = TRUE;
+		g_cond_broadcast(&prefetch->cond);
+	}
+	g_mutex_unlock(&prefetch->mutex);
+
+	if (archive)
+		zip_discard(archive);
+
+	return NULL;
+}
+
+static void prefetch_free(struct session_prefetch *prefetch)
+{
+	guint i;
+
+	if (!prefetch)
+		return;
+
+	g_mutex_lock(&prefetch->mutex);
+	prefetch->stop = TRUE;
+	g_cond_broadcast(&prefetch->cond);
+	g_mutex_unlock(&prefetch->mutex);
+	for (i = 0; i < prefetch->num_threads; i++) {
+		if (prefetch->threads[i])
+			g_thread_join(prefetch->threads[i]);
+	}
+
+	for (i = 0; i < prefetch->num_chunks; i++) {
+		sr_buffer_unref(prefetch->chunks[i].buf);
+		prefetch->chunks[i].buf = NULL;
+	}
+	g_cond_clear(&prefetch->cond);
+	g_mutex_clear(&prefetch->mutex);
+	g_free(prefetch->threads);
+	g_free(prefetch->filename);
+	g_free(prefetch);
+}
+
+static struct session_prefetch *prefetch_new(const char *filename,
+		GArray *chunks)
+{
+	struct session_prefetch *prefetch;
+	guint i, num_threads;
+	GError *error;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	num_threads = g_get_num_processors();
+#else
+	num_threads = 2;
+#endif
+	num_threads = MIN(num_threads, PREFETCH_MAX_THREADS);
+	num_threads = MIN(num_threads, chunks->len);
+	if (num_threads < 2)
+		return NULL;
+
+	prefetch = g_malloc0(sizeof(*prefetch));
+	prefetch->filename = g_strdup(filename);
+	prefetch->chunks = (struct session_chunk *)chunks->data;
+	prefetch->num_chunks = chunks->len;
+	prefetch->depth = 2 * num_threads;
+	prefetch->window_end = MIN(prefetch->depth, prefetch->num_chunks);
+	g_mutex_init(&prefetch->mutex);
+	g_cond_init(&prefetch->cond);
+	prefetch->threads = g_malloc0(num_threads * sizeof(GThread *));
+	prefetch->num_threads = num_threads;
+
+	for (i = 0; i < num_threads; i++) {
+		error = NULL;
+		prefetch->threads[i] = g_thread_try_new("sr-prefetch",
+			prefetch_thread, prefetch, &error);
+		if (!prefetch->threads[i]) {
+			sr_err("Cannot create prefetch thread: %s.",
+				error->message);
+			g_error_free(error);
+			prefetch_free(prefetch);
+			return NULL;
+		}
+	}
+	sr_dbg("Decompressing ahead on %u threads.", num_threads);
+
+	return prefetch;
+}
+
+/*
+ * Get a chunk's data, waiting for the workers as needed. Advances the
+ * prefetch window. Returns NULL for chunks which need to be streamed,
+ * or upon error.
+ */
+static struct sr_buffer *prefetch_get(struct session_prefetch *prefetch,
+		guint idx)
+{
+	struct session_chunk *chunk;
+	struct sr_buffer *buf;
+
+	chunk = &prefetch->chunks[idx];
+
+	g_mutex_lock(&prefetch->mutex);
+	if (prefetch->window_end < idx + prefetch->depth) {
+		prefetch->window_end = MIN(idx + prefetch->depth,
+			prefetch->num_chunks);
+		g_cond_broadcast(&prefetch->cond);
+	}
+	while (!chunk->done)
+		g_cond_wait(&prefetch->cond, &prefetch->mutex);
+	buf = chunk->buf;
+	chunk->buf = NULL;
+	g_mutex_unlock(&prefetch->mutex);
+
+	return buf;
+}
+
+static int add_chunk(struct session_vdev *vdev, struct session_chunk *chunk,
+		const struct zip_stat *zs)
+{
+	if (!sr_zip_compression_supported(zs->comp_method, FALSE)) {
+		sr_err("Capture file '%s' uses unsupported compression"
+			" method %u.", zs->name, (unsigned)zs->comp_method);
+		return SR_ERR_NA;
+	}
+
+	chunk->zip_index = zs->index;
+	chunk->size = zs->size;
+	chunk->stream = zs->size > PREFETCH_MAX_SIZE;
+	g_array_append_val(vdev->chunks, *chunk);
+
+	return SR_OK;
+}
+
+/* Collect a capture file's chunks, or the unchunked capture file. */
+static int add_chunks(struct session_vdev *vdev, const char *basename,
+		int analog_channel)
+{
+	struct session_chunk chunk;
+	struct zip_stat zs;
+	char capturefile[128];
+	int num, ret;
+
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.analog_channel = analog_channel;
+
+	/* capturefile is always the unchunked base name. */
+	if (zip_stat(vdev->archive, basename, 0, &zs) != -1) {
+		/* No chunks, just a single capture file. */
+		return add_chunk(vdev, &chunk, &zs);
+	}
+
+	for (num = 1; ; num++) {
+		snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d",
+			basename, num);
+		if (zip_stat(vdev->archive, capturefile, 0, &zs) == -1)
+			break;
+		if ((ret = add_chunk(vdev, &chunk, &zs)) != SR_OK)
+			return ret;
+	}
+	if (num == 1 && !analog_channel)
+		sr_err("No capture file '%s' in session file '%s'.",
+			basename, vdev->sessionfile);
+
+	return SR_OK;
+}
+
+static void next_chunk(struct session_vdev *vdev)
+{
+	const struct session_chunk *chunk, *next;
+
+	if (vdev->capfile) {
+		zip_fclose(vdev->capfile);
+		vdev->capfile = NULL;
+	}
+	sr_buffer_unref(vdev->chunk_buf);
+	vdev->chunk_buf = NULL;
+	vdev->chunk_offset = 0;
+
+	chunk = &g_array_index(vdev->chunks, struct session_chunk,
+		vdev->cur_chunk);
+	vdev->cur_chunk++;
+	if (vdev->cur_chunk < vdev->chunks->len) {
+		next = &g_array_index(vdev->chunks, struct session_chunk,
+			vdev->cur_chunk);
+		if (next->analog_channel != chunk->analog_channel)
+			vdev->samples_read = 0;
+	}
+}
+
 static gboolean stream_session_data(struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	struct session_chunk *chunk;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[128];
-	void *buf;
+	struct sr_buffer *buf;
+	uint8_t *data;
+	size_t unitsize;
+	uint64_t len, remain;
+	zip_int64_t ret;
 
-	got_data = FALSE;
 	vdev = sdi->priv;
 
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
-		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
-				vdev->capturefile = g_strdup_printf("analog-1-%d",
-						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
-				vdev->cur_analog_channel++;
-				vdev->cur_chunk = 0;
-				return TRUE;
-			} else {
-				/* We got all the chunks, finish up. */
-				g_free(vdev->capturefile);
-
-				/* If the file has logic channels, the initial value for
-				 * capturefile is set by stream_session_data() - however only
-				 * once. In order to not mess this mechanism up, we simulate
-				 * this here if needed. For purely analog files, capturefile
-				 * is not set.
-				 */
-				if (vdev->num_logic_channels)
-					vdev->capturefile = g_strdup("logic-1");
-				else
-					vdev->capturefile = NULL;
-				return FALSE;
-			}
-		}
-	}
+	for (;;) {
+		if (vdev->cur_chunk >= vdev->chunks->len)
+			return FALSE;
+		chunk = &g_array_index(vdev->chunks, struct session_chunk,
+			vdev->cur_chunk);
 
-	buf = g_malloc(CHUNKSIZE);
-
-	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
-
-	if (ret > 0) {
-		if (vdev->cur_analog_channel != 0) {
-			got_data = TRUE;
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			/* TODO: Use proper 'digits' value for this device (and its modes). */
-			sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
-			analog.meaning->channels = g_slist_prepend(NULL,
-					g_array_index(vdev->analog_channels,
-						struct sr_channel *, vdev->cur_analog_channel - 1));
-			analog.num_samples = ret / sizeof(float);
-			analog.meaning->mq = SR_MQ_VOLTAGE;
-			analog.meaning->unit = SR_UNIT_VOLT;
-			analog.meaning->mqflags = SR_MQFLAG_DC;
-			analog.data = (float *) buf;
-		} else if (vdev->unitsize) {
-			got_data = TRUE;
-			if (ret % vdev->unitsize != 0)
-				sr_warn("Read size %d not a multiple of the"
-					" unit size %d.", ret, vdev->unitsize);
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = ret;
-			logic.unitsize = vdev->unitsize;
-			logic.data = buf;
-		} else {
+		/* unitsize is not defined for purely analog session files. */
+		unitsize = chunk->analog_channel ? sizeof(float) : (size_t)vdev->unitsize;
+		if (!unitsize) {
 			/*
 			 * Neither analog data, nor logic which has
 			 * unitsize, must be an unexpected API use.
 			 */
 			sr_warn("Neither analog nor logic data. Ignoring.");
+			next_chunk(vdev);
+			continue;
 		}
-		if (got_data) {
-			vdev->bytes_read += ret;
-			sr_session_send(sdi, &packet);
+		/* Each channel's data ends at the sample limit. */
+		if (vdev->limit_samples && vdev->samples_read >= vdev->limit_samples) {
+			next_chunk(vdev);
+			continue;
 		}
+
+		len = CHUNKSIZE / unitsize * unitsize;
+		if (vdev->prefetch && !chunk->stream) {
+			if (!vdev->chunk_buf) {
+				vdev->chunk_buf = prefetch_get(vdev->prefetch,
+					vdev->cur_chunk);
+				if (!vdev->chunk_buf)
+					return FALSE;
+			}
+			buf = sr_buffer_ref(vdev->chunk_buf);
+			data = sr_buffer_data_get(buf);
+			data += vdev->chunk_offset;
+			len = MIN(len, chunk->size - vdev->chunk_offset);
+			vdev->chunk_offset += len;
+		} else {
+			if (vdev->prefetch)
+				prefetch_get(vdev->prefetch, vdev->cur_chunk);
+			if (!vdev->capfile) {
+				vdev->capfile = zip_fopen_index(vdev->archive,
+					chunk->zip_index, 0);
+				if (!vdev->capfile)
+					return FALSE;
+			}
+			if (!(buf = sr_buffer_pool_get(vdev->chunk_pool)))
+				return FALSE;
+			data = sr_buffer_data_get(buf);
+			ret = zip_fread(vdev->capfile, data, len);
+			len = ret > 0 ? ret : 0;
+		}
+		if (!len) {
+			/* done with this capture file */
+			sr_buffer_unref(buf);
+			next_chunk(vdev);
+			continue;
+		}
+		break;
+	}
+
+	if (vdev->limit_samples) {
+		remain = (vdev->limit_samples - vdev->samples_read) * unitsize;
+		len = MIN(len, remain);
+		vdev->samples_read += len / unitsize;
+	}
+
+	if (chunk->analog_channel) {
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		/* TODO: Use proper 'digits' value for this device (and its modes). */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+		analog.meaning->channels = g_slist_prepend(NULL,
+				g_array_index(vdev->analog_channels,
+					struct sr_channel *, chunk->analog_channel - 1));
+		analog.num_samples = len / sizeof(float);
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = SR_MQFLAG_DC;
+		analog.data = (float *)data;
 	} else {
-		/* done with this capture file */
+		if (len % unitsize != 0)
+			sr_warn("Read size %" PRIu64 " not a multiple of the"
+				" unit size %zu.", len, unitsize);
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = len;
+		logic.unitsize = unitsize;
+		logic.data = data;
+	}
+	vdev->bytes_read += len;
+	sr_session_send_buffer(sdi, &packet, buf);
+	if (chunk->analog_channel)
+		g_slist_free(analog.meaning->channels);
+	sr_buffer_unref(buf);
+
+	return TRUE;
+}
+
+static void stream_session_end(struct session_vdev *vdev)
+{
+	prefetch_free(vdev->prefetch);
+	vdev->prefetch = NULL;
+	sr_buffer_unref(vdev->chunk_buf);
+	vdev->chunk_buf = NULL;
+	if (vdev->chunks) {
+		g_array_free(vdev->chunks, TRUE);
+		vdev->chunks = NULL;
+	}
+	if (vdev->capfile) {
 		zip_fclose(vdev->capfile);
 		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
-		}
 	}
-	g_free(buf);
-
-	return got_data;
+	if (vdev->archive) {
+		zip_discard(vdev->archive);
+		vdev->archive = NULL;
+	}
+	sr_buffer_pool_destroy(vdev->chunk_pool);
+	vdev->chunk_pool = NULL;
+	if (vdev->analog_channels) {
+		g_array_free(vdev->analog_channels, TRUE);
+		vdev->analog_channels = NULL;
+	}
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -216,14 +516,7 @@ static int receive_data(int fd, int revents, void *cb_data)
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
-	if (vdev->capfile) {
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-	}
-	if (vdev->archive) {
-		zip_discard(vdev->archive);
-		vdev->archive = NULL;
-	}
+	stream_session_end(vdev);
 
 	std_session_send_df_end(sdi);
 
@@ -278,6 +571,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_UNITSIZE:
 		*data = g_variant_new_uint64(vdev->unitsize);
 		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		*data = g_variant_new_uint64(vdev->limit_samples);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -318,6 +614,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_NUM_ANALOG_CHANNELS:
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		vdev->limit_samples = g_variant_get_uint64(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -334,13 +633,13 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
-	int ret;
+	int ret, i;
 	GSList *l;
 	struct sr_channel *ch;
+	char *basename;
 
 	vdev = sdi->priv;
 	vdev->bytes_read = 0;
-	vdev->cur_analog_channel = 0;
 	vdev->analog_channels = g_array_sized_new(FALSE, FALSE,
 			sizeof(struct sr_channel *), vdev->num_analog_channels);
 	for (l = sdi->channels; l; l = l->next) {
@@ -348,8 +647,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		if (ch->type == SR_CHANNEL_ANALOG)
 			g_array_append_val(vdev->analog_channels, ch);
 	}
-	vdev->cur_chunk = 0;
 	vdev->finished = FALSE;
+	vdev->samples_read = 0;
 
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
@@ -357,9 +656,43 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
 		sr_err("Failed to open session file '%s': "
 		       "zip error %d.", vdev->sessionfile, ret);
+		g_array_free(vdev->analog_channels, TRUE);
+		vdev->analog_channels = NULL;
 		return SR_ERR;
 	}
 
+	/* Logic data comes first, followed by each analog channel's. */
+	vdev->chunks = g_array_new(FALSE, FALSE, sizeof(struct session_chunk));
+	vdev->cur_chunk = 0;
+	ret = SR_OK;
+	if (vdev->capturefile)
+		ret = add_chunks(vdev, vdev->capturefile, 0);
+	for (i = 0; ret == SR_OK && i < vdev->num_analog_channels &&
+			i < (int)vdev->analog_channels->len; i++) {
+		basename = g_strdup_printf("analog-1-%d",
+			vdev->num_logic_channels + i + 1);
+		ret = add_chunks(vdev, basename, i + 1);
+		g_free(basename);
+	}
+	if (ret != SR_OK) {
+		g_array_free(vdev->chunks, TRUE);
+		vdev->chunks = NULL;
+		zip_discard(vdev->archive);
+		vdev->archive = NULL;
+		g_array_free(vdev->analog_channels, TRUE);
+		vdev->analog_channels = NULL;
+		return ret;
+	}
+
+	/*
+	 * Chunks get decompressed ahead on worker threads, and are sent
+	 * in order. Large archive members and single threaded operation
+	 * read into reference counted buffers, which get recycled unless
+	 * a consumer holds on to them.
+	 */
+	vdev->prefetch = prefetch_new(vdev->sessionfile, vdev->chunks);
+	vdev->chunk_pool = sr_buffer_pool_new(CHUNKSIZE, 2, 0);
+
 	std_session_send_df_header(sdi);
 
 	/* freewheeling source */
@@ -192,9 +192,38 @@ SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename, struct
 	return sdi;
 }
 
+/*
+ * Have the device report the number of samples in the session file.
+ * Only the archive's directory gets read for that.
+ */
+static void session_set_sample_count(struct sr_dev_inst *sdi,
+		const char *filename)
+{
+	struct sr_sessionfile_reader *reader;
+	uint64_t num_samples, count;
+	unsigned int i;
+
+	if (sr_sessionfile_reader_open(filename, &reader) != SR_OK)
+		return;
+
+	sr_sessionfile_reader_logic_get(reader, NULL, &num_samples);
+	for (i = 0; i < sr_sessionfile_reader_analog_count(reader); i++) {
+		if (sr_sessionfile_reader_analog_get(reader, i, &count) == SR_OK)
+			num_samples = MAX(num_samples, count);
+	}
+	sr_sessionfile_reader_close(reader);
+
+	sr_dbg("Session file has %" PRIu64 " samples.", num_samples);
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(num_samples));
+}
+
 /**
  * Load the session from the specified filename.
  *
+ * The total number of samples in the file is available from the
+ * session's device as SR_CONF_LIMIT_SAMPLES.
+ *
  * @param ctx The context in which to load the session.
  * @param filename The name of the session file to load.
  * @param session The session to load the file into.
@@ -381,6 +410,8 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 				}
 			}
 			g_strfreev(keys);
+			if (sdi && ret == SR_OK)
+				session_set_sample_count(sdi, filename);
 		}
 	}
 	g_strfreev(sections);
@@ -0,0 +1,707 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zip.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "session-file"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Random access to the sample data of libsigrok session files.
+ */
+
+/**
+ * @addtogroup grp_session
+ *
+ * @{
+ */
+
+/** @cond PRIVATE */
+#define ZIP_LOCAL_HEADER_SIG	0x04034b50
+#define ZIP_CENTRAL_HEADER_SIG	0x02014b50
+#define ZIP_EOCD_SIG		0x06054b50
+#define ZIP64_EOCD_SIG		0x06064b50
+#define ZIP64_LOCATOR_SIG	0x07064b50
+#define ZIP_LOCAL_HEADER_SIZE	30
+#define ZIP_CENTRAL_HEADER_SIZE	46
+#define ZIP_EOCD_SIZE		22
+#define ZIP64_EOCD_SIZE		56
+#define ZIP64_LOCATOR_SIZE	20
+#define ZIP64_EXTRA_ID		0x0001
+#define ZIP_MAX_U16		0xffff
+#define ZIP_MAX_U32		0xffffffffULL
+
+struct sessionfile_chunk {
+	uint64_t chunk_num;
+	/* Sample range covered by the chunk. */
+	uint64_t start;
+	uint64_t count;
+	zip_uint64_t zip_index;
+	/* Stored chunks' data in the mapped file, NULL when compressed. */
+	const uint8_t *mapped;
+};
+
+struct sessionfile_stream {
+	uint64_t stream_num;
+	size_t unitsize;
+	GArray *chunks;
+	uint64_t num_samples;
+};
+
+struct sr_sessionfile_reader {
+	struct zip *archive;
+	GMappedFile *mapped;
+	struct sessionfile_stream logic;
+	GArray *analog;
+	/* Most recently decompressed chunk. */
+	const struct sessionfile_chunk *cache_chunk;
+	uint8_t *cache;
+	size_t cache_size;
+};
+/** @endcond */
+
+/*
+ * Locate the data of all stored (uncompressed) archive members in the
+ * mapped file. This walks the ZIP central directory, since libzip does
+ * not expose the location of its members' data.
+ */
+static GHashTable *map_stored_entries(const uint8_t *data, uint64_t len)
+{
+	GHashTable *offsets;
+	const uint8_t *p, *eocd, *name, *extra, *local, *field_end;
+	uint64_t pos, cd_offset, cd_size, entries, idx;
+	uint64_t comp_size, size, offset, data_offset;
+	size_t name_len, extra_len, comment_len, field_len, field_pos;
+	uint16_t method, field_id;
+	uint64_t *value;
+
+	if (len < ZIP_EOCD_SIZE)
+		return NULL;
+
+	/* The end of central directory record is followed by a comment. */
+	eocd = NULL;
+	pos = len - ZIP_EOCD_SIZE;
+	for (;;) {
+		if (read_u32le(&data[pos]) == ZIP_EOCD_SIG) {
+			eocd = &data[pos];
+			break;
+		}
+		if (!pos || len - ZIP_EOCD_SIZE - pos >= ZIP_MAX_U16)
+			break;
+		pos--;
+	}
+	if (!eocd)
+		return NULL;
+
+	entries = read_u16le(&eocd[10]);
+	cd_size = read_u32le(&eocd[12]);
+	cd_offset = read_u32le(&eocd[16]);
+	if (entries == ZIP_MAX_U16 || cd_size == ZIP_MAX_U32 ||
+			cd_offset == ZIP_MAX_U32) {
+		if (pos < ZIP64_LOCATOR_SIZE)
+			return NULL;
+		p = &data[pos - ZIP64_LOCATOR_SIZE];
+		if (read_u32le(p) != ZIP64_LOCATOR_SIG)
+			return NULL;
+		offset = read_u64le(&p[8]);
+		if (offset > len - ZIP64_EOCD_SIZE)
+			return NULL;
+		p = &data[offset];
+		if (read_u32le(p) != ZIP64_EOCD_SIG)
+			return NULL;
+		entries = read_u64le(&p[32]);
+		cd_size = read_u64le(&p[40]);
+		cd_offset = read_u64le(&p[48]);
+	}
+	if (cd_offset > len || cd_size > len - cd_offset)
+		return NULL;
+
+	offsets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	p = &data[cd_offset];
+	for (idx = 0; idx < entries; idx++) {
+		if (p + ZIP_CENTRAL_HEADER_SIZE > &data[cd_offset + cd_size] ||
+				read_u32le(p) != ZIP_CENTRAL_HEADER_SIG)
+			break;
+		method = read_u16le(&p[10]);
+		comp_size = read_u32le(&p[20]);
+		size = read_u32le(&p[24]);
+		name_len = read_u16le(&p[28]);
+		extra_len = read_u16le(&p[30]);
+		comment_len = read_u16le(&p[32]);
+		offset = read_u32le(&p[42]);
+		name = &p[ZIP_CENTRAL_HEADER_SIZE];
+		extra = name + name_len;
+		p = extra + extra_len + comment_len;
+		if (p > &data[cd_offset + cd_size])
+			break;
+
+		/* ZIP64 values are present in the order of the fields. */
+		for (field_pos = 0; field_pos + 4 <= extra_len; ) {
+			field_id = read_u16le(&extra[field_pos]);
+			field_len = read_u16le(&extra[field_pos + 2]);
+			field_pos += 4;
+			if (field_pos + field_len > extra_len)
+				break;
+			if (field_id == ZIP64_EXTRA_ID) {
+				local = &extra[field_pos];
+				field_end = local + field_len;
+				if (size == ZIP_MAX_U32 && local + 8 <= field_end) {
+					size = read_u64le(local);
+					local += 8;
+				}
+				if (comp_size == ZIP_MAX_U32 && local + 8 <= field_end) {
+					comp_size = read_u64le(local);
+					local += 8;
+				}
+				if (offset == ZIP_MAX_U32 && local + 8 <= field_end)
+					offset = read_u64le(local);
+			}
+			field_pos += field_len;
+		}
+
+		if (method != ZIP_CM_STORE || comp_size != size)
+			continue;
+		if (offset > len - ZIP_LOCAL_HEADER_SIZE)
+			continue;
+		local = &data[offset];
+		if (read_u32le(local) != ZIP_LOCAL_HEADER_SIG)
+			continue;
+		data_offset = offset + ZIP_LOCAL_HEADER_SIZE +
+			read_u16le(&local[26]) + read_u16le(&local[28]);
+		if (data_offset > len || size > len - data_offset)
+			continue;
+
+		value = g_malloc(sizeof(*value));
+		*value = data_offset;
+		g_hash_table_insert(offsets,
+			g_strndup((const char *)name, name_len), value);
+	}
+
+	return offsets;
+}
+
+static struct sessionfile_stream *analog_stream_get(
+		struct sr_sessionfile_reader *reader, uint64_t stream_num)
+{
+	struct sessionfile_stream *stream, new_stream;
+	guint i;
+
+	for (i = 0; i < reader->analog->len; i++) {
+		stream = &g_array_index(reader->analog,
+			struct sessionfile_stream, i);
+		if (stream->stream_num == stream_num)
+			return stream;
+	}
+
+	memset(&new_stream, 0, sizeof(new_stream));
+	new_stream.stream_num = stream_num;
+	new_stream.unitsize = sizeof(float);
+	new_stream.chunks = g_array_new(FALSE, FALSE,
+		sizeof(struct sessionfile_chunk));
+	g_array_append_val(reader->analog, new_stream);
+
+	return &g_array_index(reader->analog, struct sessionfile_stream,
+		reader->analog->len - 1);
+}
+
+/* Parse the decimal number at the start of a string, with a suffix. */
+static gboolean parse_number(const char *s, uint64_t *num, const char **end)
+{
+	char *endp;
+
+	if (!g_ascii_isdigit(*s))
+		return FALSE;
+	*num = g_ascii_strtoull(s, &endp, 10);
+	*end = endp;
+
+	return *num > 0 && *num < G_MAXINT;
+}
+
+static gint stream_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct sessionfile_stream *sa, *sb;
+
+	sa = a;
+	sb = b;
+	if (sa->stream_num < sb->stream_num)
+		return -1;
+
+	return sa->stream_num > sb->stream_num;
+}
+
+static gint chunk_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct sessionfile_chunk *ca, *cb;
+
+	ca = a;
+	cb = b;
+	if (ca->chunk_num < cb->chunk_num)
+		return -1;
+
+	return ca->chunk_num > cb->chunk_num;
+}
+
+/*
+ * Sort a stream's chunks, and assign sample ranges to them. Like the
+ * session driver, stop at the first chunk which is missing.
+ */
+static void stream_index(struct sessionfile_stream *stream)
+{
+	struct sessionfile_chunk *chunk;
+	uint64_t start;
+	guint i;
+
+	g_array_sort(stream->chunks, chunk_cmp);
+
+	start = 0;
+	for (i = 0; i < stream->chunks->len; i++) {
+		chunk = &g_array_index(stream->chunks,
+			struct sessionfile_chunk, i);
+		if (chunk->chunk_num != i + 1) {
+			sr_warn("Chunk %" PRIu64 " missing, ignoring %u chunks.",
+				(uint64_t)i + 1, stream->chunks->len - i);
+			g_array_set_size(stream->chunks, i);
+			break;
+		}
+		chunk->start = start;
+		start += chunk->count;
+	}
+	stream->num_samples = start;
+}
+
+static int reader_index(struct sr_sessionfile_reader *reader,
+		const char *capturefile)
+{
+	struct sessionfile_stream *stream;
+	struct sessionfile_chunk chunk;
+	GHashTable *offsets;
+	struct zip_stat zs;
+	const uint8_t *data;
+	const uint64_t *offset;
+	const char *name, *p;
+	uint64_t stream_num, chunk_num;
+	zip_int64_t num_entries, i;
+	size_t cap_len;
+	guint j;
+
+	offsets = NULL;
+	data = NULL;
+	if (reader->mapped) {
+		data = (const uint8_t *)g_mapped_file_get_contents(reader->mapped);
+		offsets = map_stored_entries(data,
+			g_mapped_file_get_length(reader->mapped));
+		if (!offsets)
+			sr_dbg("Cannot map stored chunks, reading all of them.");
+	}
+
+	cap_len = capturefile ? strlen(capturefile) : 0;
+	num_entries = zip_get_num_entries(reader->archive, 0);
+	for (i = 0; i < num_entries; i++) {
+		if (zip_stat_index(reader->archive, i, 0, &zs) < 0)
+			continue;
+		name = zs.name;
+
+		stream = NULL;
+		chunk_num = 0;
+		if (cap_len && !strncmp(name, capturefile, cap_len)) {
+			/* "logic-1" or "logic-1-<chunk>" */
+			p = name + cap_len;
+			if (!*p)
+				chunk_num = 1;
+			else if (*p != '-' || !parse_number(p + 1, &chunk_num, &p) || *p)
+				continue;
+			stream = &reader->logic;
+		} else if (g_str_has_prefix(name, "analog-1-")) {
+			/* "analog-1-<channel>-<chunk>" */
+			p = name + strlen("analog-1-");
+			if (!parse_number(p, &stream_num, &p) || *p != '-')
+				continue;
+			if (!parse_number(p + 1, &chunk_num, &p) || *p)
+				continue;
+			stream = analog_stream_get(reader, stream_num);
+		}
+		if (!stream || !stream->unitsize)
+			continue;
+		if (!sr_zip_compression_supported(zs.comp_method, FALSE)) {
+			sr_err("Chunk '%s' uses unsupported compression"
+				" method %u.", name, (unsigned)zs.comp_method);
+			if (offsets)
+				g_hash_table_destroy(offsets);
+			return SR_ERR_NA;
+		}
+
+		memset(&chunk, 0, sizeof(chunk));
+		chunk.chunk_num = chunk_num;
+		chunk.count = zs.size / stream->unitsize;
+		chunk.zip_index = zs.index;
+		if (zs.size % stream->unitsize)
+			sr_warn("Chunk '%s' size %" PRIu64 " not a multiple"
+				" of the unit size %zu.", name,
+				(uint64_t)zs.size, stream->unitsize);
+		if (offsets && zs.comp_method == ZIP_CM_STORE &&
+				zs.encryption_method == ZIP_EM_NONE &&
+				(offset = g_hash_table_lookup(offsets, name)))
+			chunk.mapped = data + *offset;
+		g_array_append_val(stream->chunks, chunk);
+	}
+	if (offsets)
+		g_hash_table_destroy(offsets);
+
+	/* Analog channels are ordered by their number. */
+	g_array_sort(reader->analog, stream_cmp);
+	stream_index(&reader->logic);
+	for (j = 0; j < reader->analog->len; j++)
+		stream_index(&g_array_index(reader->analog,
+			struct sessionfile_stream, j));
+
+	return SR_OK;
+}
+
+static void stream_free(struct sessionfile_stream *stream)
+{
+	if (stream->chunks)
+		g_array_free(stream->chunks, TRUE);
+}
+
+/**
+ * Open a session file for random access to its sample data.
+ *
+ * The logic data and the data of each analog channel are indexed by
+ * sample number, only the archive's directory and its metadata get
+ * read. Uncompressed archive members are accessed through a memory
+ * mapping of the file, compressed ones get decompressed when a read
+ * covers them.
+ *
+ * A reader must not be used from several threads at the same time.
+ *
+ * @param filename The name of the session file.
+ * @param reader Will be set to the new reader upon success.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_DATA Malformed session file.
+ * @retval SR_ERR This is not a session file.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sessionfile_reader_open(const char *filename,
+		struct sr_sessionfile_reader **reader)
+{
+	struct sr_sessionfile_reader *rd;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	GError *error;
+	char *capturefile;
+	int unitsize, ret;
+
+	if (!filename || !reader)
+		return SR_ERR_ARG;
+	*reader = NULL;
+
+	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+		return ret;
+
+	rd = g_malloc0(sizeof(*rd));
+	rd->analog = g_array_new(FALSE, FALSE,
+		sizeof(struct sessionfile_stream));
+	rd->logic.chunks = g_array_new(FALSE, FALSE,
+		sizeof(struct sessionfile_chunk));
+
+	if (!(rd->archive = zip_open(filename, 0, NULL))) {
+		sr_sessionfile_reader_close(rd);
+		return SR_ERR;
+	}
+	if (zip_stat(rd->archive, "metadata", 0, &zs) < 0 ||
+			!(kf = sr_sessionfile_read_metadata(rd->archive, &zs))) {
+		sr_sessionfile_reader_close(rd);
+		return SR_ERR_DATA;
+	}
+
+	/* Logic data is present when a capture file is set. */
+	error = NULL;
+	capturefile = g_key_file_get_string(kf, "device 1", "capturefile", NULL);
+	unitsize = g_key_file_get_integer(kf, "device 1", "unitsize", &error);
+	if (capturefile && !error && unitsize > 0)
+		rd->logic.unitsize = unitsize;
+	g_clear_error(&error);
+	g_key_file_free(kf);
+
+	/* Not being able to map the file is not fatal. */
+	rd->mapped = g_mapped_file_new(filename, FALSE, &error);
+	if (!rd->mapped) {
+		sr_dbg("Cannot map '%s': %s.", filename, error->message);
+		g_error_free(error);
+	}
+
+	ret = reader_index(rd, capturefile);
+	g_free(capturefile);
+	if (ret != SR_OK) {
+		sr_sessionfile_reader_close(rd);
+		return ret;
+	}
+	*reader = rd;
+
+	return SR_OK;
+}
+
+/**
+ * Close a session file reader.
+ *
+ * @param reader The reader. May be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_sessionfile_reader_close(struct sr_sessionfile_reader *reader)
+{
+	guint i;
+
+	if (!reader)
+		return;
+
+	stream_free(&reader->logic);
+	for (i = 0; i < reader->analog->len; i++)
+		stream_free(&g_array_index(reader->analog,
+			struct sessionfile_stream, i));
+	g_array_free(reader->analog, TRUE);
+	g_free(reader->cache);
+	if (reader->mapped)
+		g_mapped_file_unref(reader->mapped);
+	if (reader->archive)
+		zip_discard(reader->archive);
+	g_free(reader);
+}
+
+/**
+ * Get the size of a session file's logic data.
+ *
+ * @param reader The reader.
+ * @param unitsize Will be set to the number of bytes per sample. Zero
+ *                 when the file contains no logic data. May be NULL.
+ * @param num_samples Will be set to the number of samples. May be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sessionfile_reader_logic_get(
+		const struct sr_sessionfile_reader *reader,
+		unsigned int *unitsize, uint64_t *num_samples)
+{
+	if (!reader)
+		return SR_ERR_ARG;
+
+	if (unitsize)
+		*unitsize = reader->logic.unitsize;
+	if (num_samples)
+		*num_samples = reader->logic.num_samples;
+
+	return SR_OK;
+}
+
+/**
+ * Get the number of analog channels a session file has data for.
+ *
+ * @param reader The reader.
+ *
+ * @return The number of analog channels, 0 upon error.
+ *
+ * @since 0.6.0
+ */
+SR_API unsigned int sr_sessionfile_reader_analog_count(
+		const struct sr_sessionfile_reader *reader)
+{
+	if (!reader)
+		return 0;
+
+	return reader->analog->len;
+}
+
+/**
+ * Get the size of an analog channel's data in a session file.
+ *
+ * @param reader The reader.
+ * @param index The analog channel's index, starting at 0.
+ * @param num_samples Will be set to the number of samples.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sessionfile_reader_analog_get(
+		const struct sr_sessionfile_reader *reader,
+		unsigned int index, uint64_t *num_samples)
+{
+	if (!reader || !num_samples || index >= reader->analog->len)
+		return SR_ERR_ARG;
+
+	*num_samples = g_array_index(reader->analog,
+		struct sessionfile_stream, index).num_samples;
+
+	return SR_OK;
+}
+
+/* Get the uncompressed data of a chunk. */
+static const uint8_t *chunk_data(struct sr_sessionfile_reader *reader,
+		const struct sessionfile_stream *stream,
+		const struct sessionfile_chunk *chunk)
+{
+	struct zip_file *zf;
+	zip_int64_t len;
+	size_t size;
+	uint8_t *buf;
+
+	if (chunk->mapped)
+		return chunk->mapped;
+	if (reader->cache_chunk == chunk)
+		return reader->cache;
+
+	size = chunk->count * stream->unitsize;
+	if (size > reader->cache_size) {
+		buf = g_try_realloc(reader->cache, size);
+		if (!buf) {
+			sr_err("Cannot allocate %zu bytes chunk buffer.", size);
+			return NULL;
+		}
+		reader->cache = buf;
+		reader->cache_size = size;
+	}
+
+	reader->cache_chunk = NULL;
+	zf = zip_fopen_index(reader->archive, chunk->zip_index, 0);
+	if (!zf) {
+		sr_err("Cannot open chunk: %s.", zip_strerror(reader->archive));
+		return NULL;
+	}
+	len = zip_fread(zf, reader->cache, size);
+	zip_fclose(zf);
+	if (len < 0 || (size_t)len != size) {
+		sr_err("Cannot read chunk.");
+		return NULL;
+	}
+	reader->cache_chunk = chunk;
+
+	return reader->cache;
+}
+
+static int stream_read(struct sr_sessionfile_reader *reader,
+		const struct sessionfile_stream *stream,
+		uint64_t start, uint64_t end, uint8_t *data)
+{
+	const struct sessionfile_chunk *chunk;
+	const uint8_t *src;
+	guint lo, hi, mid;
+	uint64_t count;
+
+	if (start > end || end > stream->num_samples)
+		return SR_ERR_ARG;
+	if (start == end)
+		return SR_OK;
+
+	/* Find the chunk which contains the first sample. */
+	lo = 0;
+	hi = stream->chunks->len;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		chunk = &g_array_index(stream->chunks,
+			struct sessionfile_chunk, mid);
+		if (chunk->start <= start)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	while (start < end) {
+		chunk = &g_array_index(stream->chunks,
+			struct sessionfile_chunk, lo++);
+		if (!chunk->count)
+			continue;
+		count = MIN(end, chunk->start + chunk->count) - start;
+		if (!(src = chunk_data(reader, stream, chunk)))
+			return SR_ERR_IO;
+		src += (start - chunk->start) * stream->unitsize;
+		memcpy(data, src, count * stream->unitsize);
+		data += count * stream->unitsize;
+		start += count;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Read a window of logic samples from a session file.
+ *
+ * Only the archive members which cover the window get accessed.
+ *
+ * @param reader The reader.
+ * @param start The first sample to read.
+ * @param end The sample after the last one to read.
+ * @param data Buffer for (end - start) * unitsize bytes of sample data.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or window beyond the data.
+ * @retval SR_ERR_IO Read error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sessionfile_reader_logic_read(
+		struct sr_sessionfile_reader *reader,
+		uint64_t start, uint64_t end, uint8_t *data)
+{
+	if (!reader || (!data && end > start))
+		return SR_ERR_ARG;
+
+	return stream_read(reader, &reader->logic, start, end, data);
+}
+
+/**
+ * Read a window of an analog channel's samples from a session file.
+ *
+ * @param reader The reader.
+ * @param index The analog channel's index, starting at 0.
+ * @param start The first sample to read.
+ * @param end The sample after the last one to read.
+ * @param data Buffer for (end - start) values.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or window beyond the data.
+ * @retval SR_ERR_IO Read error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_sessionfile_reader_analog_read(
+		struct sr_sessionfile_reader *reader, unsigned int index,
+		uint64_t start, uint64_t end, float *data)
+{
+	if (!reader || index >= reader->analog->len || (!data && end > start))
+		return SR_ERR_ARG;
+
+	return stream_read(reader, &g_array_index(reader->analog,
+		struct sessionfile_stream, index), start, end, (uint8_t *)data);
+}
+
+/** @} */
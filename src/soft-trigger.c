@@ -19,6 +19,9 @@
 
 #include <config.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -26,6 +29,31 @@
 #define LOG_PREFIX "soft-trigger"
 /** @endcond */
 
+/*
+ * Trigger stages get compiled into bit masks when the soft trigger is
+ * created. Sample data gets loaded into 64bit words (little endian, so
+ * that channel N is bit N%64 of word N/64 on all platforms), and a stage
+ * is checked with a few word-wide operations, regardless of the number
+ * of matches in the stage.
+ */
+struct soft_trigger_stage {
+	/* Channels with level matches, and their expected levels. */
+	uint64_t *level_mask;
+	uint64_t *level_value;
+	/* Channels with rising, falling, or any edge matches. */
+	uint64_t *rise;
+	uint64_t *fall;
+	uint64_t *edge;
+	gboolean has_edges;
+	/* Enabled channels have matches, the first of them is no level. */
+	gboolean has_enabled;
+	gboolean edge_first;
+	/* Conflicting or unsupported matches, the stage cannot match. */
+	gboolean never;
+	/* No matches supplied, client error. */
+	gboolean no_matches;
+};
+
 SR_PRIV int logic_channel_unitsize(GSList *channels)
 {
 	int number = 0;
@@ -41,6 +69,113 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+static uint64_t load_word(const uint8_t *p, size_t len)
+{
+	uint64_t word;
+
+	word = 0;
+	memcpy(&word, p, MIN(len, sizeof(word)));
+
+	return GUINT64_FROM_LE(word);
+}
+
+static int lowest_bit(uint64_t value)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(value);
+#else
+	int bit;
+
+	for (bit = 0; !(value & 1); bit++)
+		value >>= 1;
+	return bit;
+#endif
+}
+
+static void compile_match(struct soft_trigger_logic *stl,
+		struct soft_trigger_stage *cs, const struct sr_trigger_match *match)
+{
+	int index, word;
+	uint64_t bit;
+
+	if (!match->channel->enabled)
+		/* Ignore disabled channels with a trigger. */
+		return;
+
+	if (!cs->has_enabled)
+		cs->edge_first = match->match != SR_TRIGGER_ZERO &&
+			match->match != SR_TRIGGER_ONE;
+	cs->has_enabled = TRUE;
+
+	index = match->channel->index;
+	if (index < 0 || index >= stl->unitsize * 8) {
+		cs->never = TRUE;
+		return;
+	}
+	word = index / 64;
+	bit = UINT64_C(1) << (index % 64);
+
+	switch (match->match) {
+	case SR_TRIGGER_ZERO:
+	case SR_TRIGGER_ONE:
+		if ((cs->level_mask[word] & bit) &&
+				!(cs->level_value[word] & bit) !=
+				(match->match == SR_TRIGGER_ZERO))
+			/* Both levels on the same channel. */
+			cs->never = TRUE;
+		cs->level_mask[word] |= bit;
+		if (match->match == SR_TRIGGER_ONE)
+			cs->level_value[word] |= bit;
+		break;
+	case SR_TRIGGER_RISING:
+		cs->rise[word] |= bit;
+		cs->has_edges = TRUE;
+		break;
+	case SR_TRIGGER_FALLING:
+		cs->fall[word] |= bit;
+		cs->has_edges = TRUE;
+		break;
+	case SR_TRIGGER_EDGE:
+		cs->edge[word] |= bit;
+		cs->has_edges = TRUE;
+		break;
+	default:
+		/* Analog matches never match on logic data. */
+		cs->never = TRUE;
+		break;
+	}
+}
+
+static void compile_stages(struct soft_trigger_logic *stl)
+{
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_stage *cs;
+	uint64_t *masks;
+	GSList *l, *m;
+	int nw;
+
+	nw = stl->num_words;
+	stl->num_stages = g_slist_length(stl->trigger->stages);
+	stl->stages = g_malloc0(stl->num_stages * sizeof(stl->stages[0]));
+	stl->stage_masks = g_malloc0(stl->num_stages * 5 * nw *
+		sizeof(stl->stage_masks[0]));
+
+	masks = stl->stage_masks;
+	cs = stl->stages;
+	for (l = stl->trigger->stages; l; l = l->next, cs++) {
+		stage = l->data;
+		cs->level_mask = masks;
+		cs->level_value = masks + nw;
+		cs->rise = masks + 2 * nw;
+		cs->fall = masks + 3 * nw;
+		cs->edge = masks + 4 * nw;
+		masks += 5 * nw;
+		cs->no_matches = !stage->matches;
+		for (m = stage->matches; m; m = m->next)
+			compile_match(stl, cs, m->data);
+	}
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
@@ -51,7 +186,9 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 	stl->sdi = sdi;
 	stl->trigger = trigger;
 	stl->unitsize = logic_channel_unitsize(sdi->channels);
+	stl->num_words = (stl->unitsize + 7) / 8;
 	stl->prev_sample = g_malloc0(stl->unitsize);
+	compile_stages(stl);
 	stl->pre_trigger_size = stl->unitsize * pre_trigger_samples;
 	stl->pre_trigger_buffer = g_try_malloc(stl->pre_trigger_size);
 	if (pre_trigger_samples > 0 && !stl->pre_trigger_buffer) {
@@ -77,11 +214,13 @@ SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
+	g_free(stl->stages);
+	g_free(stl->stage_masks);
 	g_free(stl);
 }
 
 static void pre_trigger_append(struct soft_trigger_logic *stl,
-		uint8_t *buf, int len)
+		const uint8_t *buf, int len)
 {
 	/* Avoid uselessly copying more than the pre-trigger size. */
 	if (len > stl->pre_trigger_size) {
@@ -107,6 +246,36 @@ static void pre_trigger_append(struct soft_trigger_logic *stl,
 	}
 }
 
+/* Append the first end samples of run-length encoded data. */
+static void pre_trigger_append_rle(struct soft_trigger_logic *stl,
+		const struct sr_datafeed_logic_rle *rle, uint64_t end)
+{
+	const uint8_t *values;
+	uint64_t max, pos, run_idx, run_start, run_end, count;
+
+	max = stl->pre_trigger_size / stl->unitsize;
+	if (!max || !end)
+		return;
+
+	/* Only the last samples fit, skip the runs before them. */
+	values = rle->values;
+	pos = (end > max) ? end - max : 0;
+	run_idx = 0;
+	run_start = 0;
+	while (run_start + rle->lengths[run_idx] <= pos)
+		run_start += rle->lengths[run_idx++];
+
+	while (pos < end) {
+		run_end = run_start + rle->lengths[run_idx];
+		count = MIN(run_end, end) - pos;
+		while (count--)
+			pre_trigger_append(stl, values + run_idx * stl->unitsize,
+				stl->unitsize);
+		pos = run_start = run_end;
+		run_idx++;
+	}
+}
+
 static void pre_trigger_send(struct soft_trigger_logic *stl,
 		int *pre_trigger_samples)
 {
@@ -138,36 +307,208 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	}
 }
 
-static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+/* Check one sample against a compiled stage, given the previous sample. */
+static gboolean stage_match(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *sample,
+		const uint8_t *prev)
 {
-	int bit, prev_bit;
-	gboolean result;
+	uint64_t cur, last;
+	int w, len;
 
-	stl->count++;
-	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
-		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
-		result = bit != 0;
-	else {
-		/* Edge matches. */
-		if (stl->count == 1)
-			/* First sample, don't have enough for an edge match yet. */
+	if (cs->never)
+		return FALSE;
+
+	for (w = 0; w < stl->num_words; w++) {
+		len = MIN(8, stl->unitsize - w * 8);
+		cur = load_word(sample + w * 8, len);
+		if ((cur ^ cs->level_value[w]) & cs->level_mask[w])
+			return FALSE;
+		if (!cs->has_edges)
+			continue;
+		last = load_word(prev + w * 8, len);
+		if ((~last & cur & cs->rise[w]) != cs->rise[w])
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
-			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
-			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
-			result = prev_bit != bit;
+		if ((last & ~cur & cs->fall[w]) != cs->fall[w])
+			return FALSE;
+		if (((last ^ cur) & cs->edge[w]) != cs->edge[w])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Like stage_match(), for a sample which need not follow the previous
+ * one: the first of the acquisition, or the first after a stage rewind.
+ * The previous sample then is the one that was checked last, or all
+ * zeros. Before any match was checked, a stage whose first match is an
+ * edge does not match.
+ */
+static gboolean stage_check(struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *sample,
+		const uint8_t *prev)
+{
+	gboolean first;
+
+	first = !stl->checked && cs->has_enabled;
+	stl->checked |= cs->has_enabled;
+	if (first && cs->edge_first)
+		return FALSE;
+
+	return stage_match(stl, cs, sample, prev);
+}
+
+/* Pattern with the lowest bit of each lane set. */
+static uint64_t lane_ones(int lane_bits)
+{
+	return lane_bits == 8 ? UINT64_C(0x0101010101010101) :
+		lane_bits == 16 ? UINT64_C(0x0001000100010001) :
+		UINT64_C(0x0000000100000001);
+}
+
+/*
+ * Find the first sample in [first, count) which matches a stage, with
+ * several samples per 64bit word (SWAR). Each sample occupies a lane
+ * of the word, and the previous samples are the word shifted by one
+ * lane. Lanes without any mismatching bits are the matches.
+ */
+static int stage_scan_swar(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *buf,
+		int first, int count)
+{
+	uint64_t ones, high, low, lane_mask;
+	uint64_t lvl_mask, lvl_value, rise, fall, edge;
+	uint64_t cur, prv, carry, mismatch, zero;
+	int lane_bits, per_word, pos;
+
+	lane_bits = stl->unitsize * 8;
+	per_word = 8 / stl->unitsize;
+	ones = lane_ones(lane_bits);
+	high = ones << (lane_bits - 1);
+	low = ~high;
+	lane_mask = (UINT64_C(1) << lane_bits) - 1;
+
+	lvl_mask = (cs->level_mask[0] & lane_mask) * ones;
+	lvl_value = (cs->level_value[0] & lane_mask) * ones;
+	rise = (cs->rise[0] & lane_mask) * ones;
+	fall = (cs->fall[0] & lane_mask) * ones;
+	edge = (cs->edge[0] & lane_mask) * ones;
+
+	carry = load_word(buf + (first - 1) * stl->unitsize, stl->unitsize);
+	for (pos = first; pos + per_word <= count; pos += per_word) {
+		cur = load_word(buf + pos * stl->unitsize, 8);
+		prv = (cur << lane_bits) | carry;
+		mismatch = ((cur ^ lvl_value) & lvl_mask) |
+			((~prv & cur & rise) ^ rise) |
+			((prv & ~cur & fall) ^ fall) |
+			(((prv ^ cur) & edge) ^ edge);
+		zero = ~(((mismatch & low) + low) | mismatch | low);
+		if (zero)
+			return pos + lowest_bit(zero) / lane_bits;
+		carry = cur >> (64 - lane_bits);
+	}
+
+	return pos;
+}
+
+#ifdef __SSE2__
+/* Like stage_scan_swar(), 16 bytes at a time, for 8 and 16 channels. */
+static int stage_scan_sse2(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *buf,
+		int first, int count)
+{
+	__m128i lvl_mask, lvl_value, rise, fall, edge, zero;
+	__m128i cur, last, prv, mismatch;
+	int per_vec, pos, bits;
+
+	per_vec = 16 / stl->unitsize;
+	if (stl->unitsize == 1) {
+		lvl_mask = _mm_set1_epi8((char)cs->level_mask[0]);
+		lvl_value = _mm_set1_epi8((char)cs->level_value[0]);
+		rise = _mm_set1_epi8((char)cs->rise[0]);
+		fall = _mm_set1_epi8((char)cs->fall[0]);
+		edge = _mm_set1_epi8((char)cs->edge[0]);
+	} else {
+		lvl_mask = _mm_set1_epi16((short)cs->level_mask[0]);
+		lvl_value = _mm_set1_epi16((short)cs->level_value[0]);
+		rise = _mm_set1_epi16((short)cs->rise[0]);
+		fall = _mm_set1_epi16((short)cs->fall[0]);
+		edge = _mm_set1_epi16((short)cs->edge[0]);
 	}
+	zero = _mm_setzero_si128();
 
-	return result;
+	/* Only the topmost lane of the previous vector is used. */
+	if (first >= per_vec) {
+		last = _mm_loadu_si128((const __m128i *)(const void *)
+			(buf + (first - per_vec) * stl->unitsize));
+	} else {
+		last = _mm_setzero_si128();
+		memcpy((uint8_t *)&last + 16 - stl->unitsize,
+			buf + (first - 1) * stl->unitsize, stl->unitsize);
+	}
+	for (pos = first; pos + per_vec <= count; pos += per_vec) {
+		cur = _mm_loadu_si128((const __m128i *)(const void *)
+			(buf + pos * stl->unitsize));
+		if (stl->unitsize == 1)
+			prv = _mm_or_si128(_mm_slli_si128(cur, 1),
+				_mm_srli_si128(last, 15));
+		else
+			prv = _mm_or_si128(_mm_slli_si128(cur, 2),
+				_mm_srli_si128(last, 14));
+		mismatch = _mm_and_si128(_mm_xor_si128(cur, lvl_value),
+			lvl_mask);
+		mismatch = _mm_or_si128(mismatch, _mm_xor_si128(
+			_mm_and_si128(_mm_andnot_si128(prv, cur), rise), rise));
+		mismatch = _mm_or_si128(mismatch, _mm_xor_si128(
+			_mm_and_si128(_mm_andnot_si128(cur, prv), fall), fall));
+		mismatch = _mm_or_si128(mismatch, _mm_xor_si128(
+			_mm_and_si128(_mm_xor_si128(prv, cur), edge), edge));
+		if (stl->unitsize == 1)
+			bits = _mm_movemask_epi8(_mm_cmpeq_epi8(mismatch, zero));
+		else
+			bits = _mm_movemask_epi8(_mm_cmpeq_epi16(mismatch, zero));
+		if (bits)
+			return pos + lowest_bit(bits) / stl->unitsize;
+		last = cur;
+	}
+
+	return pos;
+}
+#endif
+
+/*
+ * Find the first sample in [first, count) which matches a stage, where
+ * first is not the buffer's first sample. The bulk of the data is checked
+ * several samples at a time, the remainder one sample at a time.
+ */
+static int stage_scan(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *cs, const uint8_t *buf,
+		int first, int count)
+{
+	int pos;
+
+	if (cs->never)
+		return count;
+
+	pos = first;
+	if (stl->unitsize == 1 || stl->unitsize == 2) {
+#ifdef __SSE2__
+		pos = stage_scan_sse2(stl, cs, buf, pos, count);
+#else
+		pos = stage_scan_swar(stl, cs, buf, pos, count);
+#endif
+	} else if (stl->unitsize == 4) {
+		pos = stage_scan_swar(stl, cs, buf, pos, count);
+	}
+
+	/* Remaining samples, or confirm the match which was found. */
+	for (; pos < count; pos++) {
+		if (stage_match(stl, cs, buf + pos * stl->unitsize,
+				buf + (pos - 1) * stl->unitsize))
+			return pos;
+	}
+
+	return count;
 }
 
 /* Returns the offset (in samples) within buf of where the trigger
@@ -175,65 +516,77 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
-	int offset;
-	int i;
+	const struct soft_trigger_stage *cs;
+	const uint8_t *prev, *sample;
+	int count, offset, i;
 	gboolean match_found;
 
+	if (!stl->unitsize || !stl->num_stages)
+		return SR_ERR_ARG;
+
+	count = len / stl->unitsize;
 	offset = -1;
-	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
+	prev = stl->prev_sample;
+	i = 0;
+	while (i < count) {
+		cs = &stl->stages[stl->cur_stage];
+		if (cs->no_matches)
 			/* No matches supplied, client error. */
 			return SR_ERR_ARG;
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+		sample = buf + i * stl->unitsize;
+		match_found = stage_check(stl, cs, sample, prev);
+		prev = sample;
+		if (!match_found && stl->cur_stage == 0) {
+			/* Skip ahead to the next sample which matches. */
+			i = stage_scan(stl, cs, buf, i + 1, count);
+			if (i >= count)
 				break;
-			}
+			prev = buf + i * stl->unitsize;
+			match_found = TRUE;
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
+
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage + 1 < stl->num_stages) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
-			} else {
-				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
-				pre_trigger_send(stl, pre_trigger_samples);
+				i++;
+				continue;
+			}
+			/* Matched on last stage, send pre-trigger data. */
+			pre_trigger_append(stl, buf, i * stl->unitsize);
+			pre_trigger_send(stl, pre_trigger_samples);
 
-				/* Fire trigger. */
-				offset = i / stl->unitsize;
+			/* Fire trigger. */
+			offset = i;
 
-				std_session_send_df_trigger(stl->sdi);
-				break;
-			}
-		} else if (stl->cur_stage > 0) {
-			/*
-			 * We had a match at an earlier stage, but failed on the
-			 * current stage. However, we may have a match on this
-			 * stage in the next bit -- trigger on 0001 will fail on
-			 * seeing 00001, so we need to go back to stage 0 -- but
-			 * at the next sample from the one that matched originally,
-			 * which the counter increment at the end of the loop
-			 * takes care of.
-			 */
-			i -= stl->cur_stage * stl->unitsize;
-			if (i < -1)
-				i = -1; /* Oops, went back past this buffer. */
-			/* Reset trigger stage. */
-			stl->cur_stage = 0;
+			std_session_send_df_trigger(stl->sdi);
+			break;
 		}
+
+		/*
+		 * We had a match at an earlier stage, but failed on the
+		 * current stage. However, we may have a match on this
+		 * stage in the next bit -- trigger on 0001 will fail on
+		 * seeing 00001, so we need to go back to stage 0 -- but
+		 * at the next sample from the one that matched originally.
+		 * Edges on that sample are relative to the sample which
+		 * just failed, as they always were.
+		 */
+		i -= stl->cur_stage;
+		if (i < -1)
+			i = -1; /* Oops, went back past this buffer. */
+		/* Reset trigger stage. */
+		stl->cur_stage = 0;
+		i++;
+	}
+
+	/* Keep the most recently checked sample for edge matches. */
+	if (count > 0) {
+		i = (offset >= 0) ? offset : count - 1;
+		memcpy(stl->prev_sample, buf + i * stl->unitsize,
+			stl->unitsize);
 	}
 
 	if (offset == -1)
@@ -241,3 +594,116 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 
 	return offset;
 }
+
+/* Move to the run which holds a sample, return the sample's value. */
+static const uint8_t *rle_sample(const struct sr_datafeed_logic_rle *rle,
+		uint64_t pos, uint64_t *run_idx, uint64_t *run_start)
+{
+	while (pos < *run_start)
+		*run_start -= rle->lengths[--*run_idx];
+	while (pos >= *run_start + rle->lengths[*run_idx])
+		*run_start += rle->lengths[(*run_idx)++];
+
+	return (const uint8_t *)rle->values + *run_idx * rle->unitsize;
+}
+
+/*
+ * Like soft_trigger_logic_check(), for run-length encoded data. Returns
+ * the offset (in samples) within the expanded runs of where the trigger
+ * occurred, or -1 if not triggered.
+ *
+ * Stages get checked sample by sample near the start and the end of a
+ * run. Further in, when checks at the first stage don't see anything
+ * but the run's value, they repeat with the same outcome one sample
+ * later: the trigger either fires right away, or never does before the
+ * run's end draws near. Long runs take no longer to check than short
+ * ones.
+ */
+SR_PRIV int64_t soft_trigger_logic_check_rle(struct soft_trigger_logic *stl,
+		const struct sr_datafeed_logic_rle *rle, int *pre_trigger_samples)
+{
+	const struct soft_trigger_stage *cs;
+	const uint8_t *prev, *sample;
+	uint64_t count, pos, run_idx, run_start, run_end;
+	int64_t offset;
+	gboolean match_found, repeat;
+
+	if (!stl->unitsize || !stl->num_stages)
+		return SR_ERR_ARG;
+	if (rle->unitsize != stl->unitsize)
+		return SR_ERR_ARG;
+
+	count = rle->num_samples;
+	offset = -1;
+	prev = stl->prev_sample;
+	run_idx = 0;
+	run_start = 0;
+	repeat = FALSE;
+	pos = 0;
+	while (pos < count) {
+		cs = &stl->stages[stl->cur_stage];
+		if (cs->no_matches)
+			/* No matches supplied, client error. */
+			return SR_ERR_ARG;
+
+		sample = rle_sample(rle, pos, &run_idx, &run_start);
+		run_end = run_start + rle->lengths[run_idx];
+		if (stl->cur_stage == 0) {
+			if (repeat) {
+				/*
+				 * The checks from the previous sample got
+				 * back here without firing. So will those
+				 * from all samples up to the last one whose
+				 * checks stay within the run.
+				 */
+				pos = run_end - (stl->num_stages - 1);
+				prev = sample;
+				repeat = FALSE;
+				continue;
+			}
+			repeat = stl->checked &&
+				pos + stl->num_stages < run_end &&
+				!memcmp(prev, sample, stl->unitsize);
+		}
+
+		match_found = stage_check(stl, cs, sample, prev);
+		prev = sample;
+		if (match_found) {
+			/* Matched on the current stage. */
+			if (stl->cur_stage + 1 < stl->num_stages) {
+				/* Advance to next stage. */
+				stl->cur_stage++;
+				pos++;
+				continue;
+			}
+			/* Matched on last stage, send pre-trigger data. */
+			pre_trigger_append_rle(stl, rle, pos);
+			pre_trigger_send(stl, pre_trigger_samples);
+
+			/* Fire trigger. */
+			offset = pos;
+
+			std_session_send_df_trigger(stl->sdi);
+			break;
+		}
+
+		/* Rewind as soft_trigger_logic_check() does. */
+		if (pos >= (uint64_t)stl->cur_stage)
+			pos = pos - stl->cur_stage + 1;
+		else
+			pos = 0;
+		stl->cur_stage = 0;
+	}
+
+	/* Keep the most recently checked sample for edge matches. */
+	if (count > 0) {
+		pos = (offset >= 0) ? (uint64_t)offset : count - 1;
+		sample = rle_sample(rle, pos, &run_idx, &run_start);
+		memcpy(stl->prev_sample, sample, stl->unitsize);
+	}
+
+	if (offset == -1)
+		pre_trigger_append_rle(stl, rle, count);
+
+	return offset;
+}
@@ -326,6 +326,120 @@ SR_PRIV int sr_atod_ascii(const char *str, double *ret)
 	return SR_OK;
 }
 
+/**
+ * Convert a run of text to a double. The text need not be NUL terminated.
+ * The conversion is strict and accepts the same input as sr_atod_ascii().
+ *
+ * Plain decimal numbers of up to 15 significant digits with small
+ * exponents (which is what most data files contain) get converted
+ * without calling into the C library. Their conversion is exact, the
+ * result is identical to the one of sr_atod_ascii().
+ *
+ * @param str The text to convert.
+ * @param len The text's length in bytes.
+ * @param ret Pointer to double where the result of the conversion will be stored.
+ *
+ * @retval SR_OK Conversion successful.
+ * @retval SR_ERR Failure.
+ *
+ * @private
+ */
+SR_PRIV int sr_atod_ascii_len(const char *str, size_t len, double *ret)
+{
+	/* Powers of ten which are exact doubles. */
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22,
+	};
+	const char *p, *end;
+	char buf[64], *copy;
+	uint64_t mant;
+	int digits, exp10, exp_val;
+	gboolean neg, exp_neg, have_digits;
+	double value;
+	int rc;
+
+	p = str;
+	end = str + len;
+	neg = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+'))
+		p++;
+
+	/* Collect significant digits, and the position of the period. */
+	mant = 0;
+	digits = 0;
+	exp10 = 0;
+	have_digits = FALSE;
+	while (p < end && g_ascii_isdigit(*p)) {
+		have_digits = TRUE;
+		if (mant || *p != '0') {
+			mant = mant * 10 + (*p - '0');
+			if (++digits > 15)
+				goto slow;
+		}
+		p++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		while (p < end && g_ascii_isdigit(*p)) {
+			have_digits = TRUE;
+			if (mant || *p != '0') {
+				mant = mant * 10 + (*p - '0');
+				if (++digits > 15)
+					goto slow;
+			}
+			exp10--;
+			p++;
+		}
+	}
+	if (!have_digits)
+		goto slow;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		exp_neg = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+'))
+			p++;
+		if (p == end || !g_ascii_isdigit(*p))
+			goto slow;
+		exp_val = 0;
+		while (p < end && g_ascii_isdigit(*p) && exp_val < 1000)
+			exp_val = exp_val * 10 + (*p++ - '0');
+		exp10 += exp_neg ? -exp_val : exp_val;
+	}
+	if (p != end)
+		goto slow;
+
+	/*
+	 * The mantissa and the power of ten are exact doubles. A single
+	 * multiplication or division then is correctly rounded.
+	 */
+	if (!mant)
+		value = 0.0;
+	else if (exp10 < -22 || exp10 > 22)
+		goto slow;
+	else if (exp10 < 0)
+		value = (double)mant / pow10[-exp10];
+	else
+		value = (double)mant * pow10[exp10];
+	*ret = neg ? -value : value;
+
+	return SR_OK;
+
+slow:
+	if (len < sizeof(buf)) {
+		memcpy(buf, str, len);
+		buf[len] = '\0';
+		return sr_atod_ascii(buf, ret);
+	}
+	copy = g_strndup(str, len);
+	rc = sr_atod_ascii(copy, ret);
+	g_free(copy);
+
+	return rc;
+}
+
 /**
  * Convert text to a floating point value, and get its precision.
  *
@@ -64,18 +64,17 @@
 #define LOG_PREFIX "tcp"
 
 /**
- * Check whether a file descriptor is readable (without blocking).
+ * Wait until a file descriptor is readable, or a timeout expires.
  *
- * @param[in] fd The file descriptor to check for readability.
+ * @param[in] fd The file descriptor to wait for.
+ * @param[in] timeout_ms The maximum time to wait, 0 doesn't block.
  *
- * @return TRUE when readable, FALSE when read would block or when
+ * @return TRUE when readable, FALSE when the timeout expired or when
  *   readability could not get determined.
  *
  * @since 6.0
- *
- * TODO Move to common code, applies to non-sockets as well.
  */
-SR_PRIV gboolean sr_fd_is_readable(int fd)
+SR_PRIV gboolean sr_fd_wait_readable(int fd, int timeout_ms)
 {
 #if HAVE_POLL
 	struct pollfd fds[1];
@@ -84,7 +83,7 @@ SR_PRIV gboolean sr_fd_is_readable(int fd)
 	memset(fds, 0, sizeof(fds));
 	fds[0].fd = fd;
 	fds[0].events = POLLIN;
-	ret = poll(fds, ARRAY_SIZE(fds), -1);
+	ret = poll(fds, ARRAY_SIZE(fds), timeout_ms);
 	if (ret < 0)
 		return FALSE;
 	if (!ret)
@@ -100,21 +99,40 @@ SR_PRIV gboolean sr_fd_is_readable(int fd)
 
 	FD_ZERO(&rfds);
 	FD_SET(fd, &rfds);
-	memset(&tv, 0, sizeof(tv));
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
 	ret = select(fd + 1, &rfds, NULL, NULL, &tv);
 	if (ret < 0)
 		return FALSE;
 	if (!ret)
 		return FALSE;
-	if (!FD_ISSET(fd, rfds))
+	if (!FD_ISSET(fd, &rfds))
 		return FALSE;
 	return TRUE;
 #else
 	(void)fd;
+	(void)timeout_ms;
 	return FALSE;
 #endif
 }
 
+/**
+ * Check whether a file descriptor is readable (without blocking).
+ *
+ * @param[in] fd The file descriptor to check for readability.
+ *
+ * @return TRUE when readable, FALSE when read would block or when
+ *   readability could not get determined.
+ *
+ * @since 6.0
+ *
+ * TODO Move to common code, applies to non-sockets as well.
+ */
+SR_PRIV gboolean sr_fd_is_readable(int fd)
+{
+	return sr_fd_wait_readable(fd, 0);
+}
+
 /**
  * Create a TCP communication instance.
  *
@@ -0,0 +1,654 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decimate sample data to envelopes, e.g. for overview displays.
+ *
+ * Every window of 'ratio' input samples becomes a pair of output
+ * samples. For analog data that's the window's minimum and maximum.
+ * For logic data the 'logic' option selects what the pair holds:
+ * - transition: The window's first sample, then the first sample with
+ *   all channels inverted which changed within the window.
+ * - min-max: The AND of all samples (low envelope), then the OR of all
+ *   samples (high envelope).
+ * - or, and: The OR or the AND of all samples, twice.
+ *
+ * The samplerate in SR_DF_META packets gets adjusted to match, rates
+ * which would drop below 1Hz become 1Hz. Only per-channel accumulators
+ * are kept between packets, so memory usage does not depend on the
+ * capture's length. An incomplete window at the end of a frame or of
+ * the acquisition is discarded.
+ */
+
+#include <config.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/decimate"
+
+#define DEFAULT_RATIO	1024
+#define MAX_RATIO	(1UL << 30)
+
+enum logic_mode {
+	LOGIC_TRANSITION,
+	LOGIC_MIN_MAX,
+	LOGIC_OR,
+	LOGIC_AND,
+};
+
+static const char *logic_modes[] = {
+	[LOGIC_TRANSITION] = "transition",
+	[LOGIC_MIN_MAX] = "min-max",
+	[LOGIC_OR] = "or",
+	[LOGIC_AND] = "and",
+};
+
+struct analog_window {
+	GSList *channels;
+	size_t num_channels;
+	uint64_t count;
+	float *min, *max;
+};
+
+struct context {
+	uint64_t ratio;
+	enum logic_mode logic_mode;
+
+	/* Logic window, accumulators of unitsize bytes each. */
+	size_t unitsize;
+	uint64_t logic_count;
+	uint8_t *first, *all_and, *all_or, *changed, *last;
+	uint8_t *logic_out;
+	size_t logic_out_size;
+
+	/* Analog windows, one per channel or set of channels. */
+	GSList *analog_windows;
+	float *values;
+	size_t values_size;
+	float *analog_out;
+	size_t analog_out_size;
+
+	/* The META packet with the adjusted samplerate. */
+	struct sr_datafeed_meta meta;
+	GSList *meta_config;
+
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+static void analog_window_free(void *data)
+{
+	struct analog_window *window;
+
+	window = data;
+	g_slist_free(window->channels);
+	g_free(window->min);
+	g_free(window);
+}
+
+static void reset_windows(struct context *ctx)
+{
+	ctx->logic_count = 0;
+	g_slist_free_full(ctx->analog_windows, analog_window_free);
+	ctx->analog_windows = NULL;
+}
+
+static void *grow_buffer(void *buf, size_t *size, size_t need)
+{
+	if (need <= *size)
+		return buf;
+	*size = need;
+
+	return g_realloc(buf, need);
+}
+
+static void logic_set_unitsize(struct context *ctx, size_t unitsize)
+{
+	if (unitsize == ctx->unitsize)
+		return;
+	ctx->unitsize = unitsize;
+	ctx->logic_count = 0;
+	g_free(ctx->first);
+	ctx->first = g_malloc(5 * unitsize);
+	ctx->all_and = ctx->first + unitsize;
+	ctx->all_or = ctx->all_and + unitsize;
+	ctx->changed = ctx->all_or + unitsize;
+	ctx->last = ctx->changed + unitsize;
+}
+
+/*
+ * Accumulate a number of consecutive samples of one window. Unit sizes
+ * which evenly divide 64 bits get processed a word at a time, the word
+ * lanes get folded into the accumulators afterwards.
+ */
+static void logic_accumulate(struct context *ctx,
+		const uint8_t *data, uint64_t count)
+{
+	size_t unitsize, shift, b;
+	uint64_t word, lanes_and, lanes_or, lanes_changed, prev;
+
+	unitsize = ctx->unitsize;
+	if (!ctx->logic_count) {
+		memcpy(ctx->first, data, unitsize);
+		memcpy(ctx->last, data, unitsize);
+		memset(ctx->all_and, 0xff, unitsize);
+		memset(ctx->all_or, 0, unitsize);
+		memset(ctx->changed, 0, unitsize);
+	}
+	ctx->logic_count += count;
+
+	if (8 % unitsize == 0 && count * unitsize >= sizeof(word)) {
+		shift = 8 * unitsize;
+		prev = 0;
+		for (b = 0; b < unitsize; b++)
+			prev |= (uint64_t)ctx->last[b] << (8 * b);
+		lanes_and = ~UINT64_C(0);
+		lanes_or = lanes_changed = 0;
+		while (count * unitsize >= sizeof(word)) {
+			word = read_u64le(data);
+			lanes_and &= word;
+			lanes_or |= word;
+			/* Compare each sample to its predecessor. */
+			if (shift == 64) {
+				lanes_changed |= word ^ prev;
+				prev = word;
+			} else {
+				lanes_changed |= word ^ ((word << shift) | prev);
+				prev = word >> (64 - shift);
+			}
+			data += sizeof(word);
+			count -= sizeof(word) / unitsize;
+		}
+		for (b = 0; b < sizeof(word); b++) {
+			ctx->all_and[b % unitsize] &= lanes_and >> (8 * b);
+			ctx->all_or[b % unitsize] |= lanes_or >> (8 * b);
+			ctx->changed[b % unitsize] |= lanes_changed >> (8 * b);
+		}
+		for (b = 0; b < unitsize; b++)
+			ctx->last[b] = prev >> (8 * b);
+	}
+
+	while (count--) {
+		for (b = 0; b < unitsize; b++) {
+			ctx->all_and[b] &= data[b];
+			ctx->all_or[b] |= data[b];
+			ctx->changed[b] |= data[b] ^ ctx->last[b];
+			ctx->last[b] = data[b];
+		}
+		data += unitsize;
+	}
+}
+
+/* Like logic_accumulate(), for a run of identical samples. */
+static void logic_accumulate_run(struct context *ctx,
+		const uint8_t *value, uint64_t count)
+{
+	/* Repetitions of the value don't change the accumulators. */
+	logic_accumulate(ctx, value, 1);
+	ctx->logic_count += count - 1;
+}
+
+static uint8_t *logic_emit(struct context *ctx, uint8_t *out)
+{
+	size_t unitsize, b;
+	const uint8_t *pair[2];
+
+	unitsize = ctx->unitsize;
+	switch (ctx->logic_mode) {
+	case LOGIC_TRANSITION:
+		for (b = 0; b < unitsize; b++) {
+			out[b] = ctx->first[b];
+			out[unitsize + b] = ctx->first[b] ^ ctx->changed[b];
+		}
+		ctx->logic_count = 0;
+		return out + 2 * unitsize;
+	case LOGIC_MIN_MAX:
+		pair[0] = ctx->all_and;
+		pair[1] = ctx->all_or;
+		break;
+	case LOGIC_OR:
+		pair[0] = pair[1] = ctx->all_or;
+		break;
+	case LOGIC_AND:
+	default:
+		pair[0] = pair[1] = ctx->all_and;
+		break;
+	}
+	memcpy(out, pair[0], unitsize);
+	memcpy(out + unitsize, pair[1], unitsize);
+	ctx->logic_count = 0;
+
+	return out + 2 * unitsize;
+}
+
+/* Returns the number of output bytes. */
+static size_t decimate_logic(struct context *ctx,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data;
+	uint8_t *out;
+	uint64_t count, chunk;
+
+	if (!logic->unitsize)
+		return 0;
+	logic_set_unitsize(ctx, logic->unitsize);
+	count = logic->length / logic->unitsize;
+	ctx->logic_out = grow_buffer(ctx->logic_out, &ctx->logic_out_size,
+		(count / ctx->ratio + 1) * 2 * logic->unitsize);
+
+	data = logic->data;
+	out = ctx->logic_out;
+	while (count) {
+		chunk = MIN(ctx->ratio - ctx->logic_count, count);
+		logic_accumulate(ctx, data, chunk);
+		data += chunk * logic->unitsize;
+		count -= chunk;
+		if (ctx->logic_count == ctx->ratio)
+			out = logic_emit(ctx, out);
+	}
+
+	return out - ctx->logic_out;
+}
+
+/* Returns the number of output bytes. */
+static size_t decimate_logic_rle(struct context *ctx,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	const uint8_t *value;
+	uint8_t *out;
+	uint64_t run, length, chunk;
+
+	if (!rle->unitsize)
+		return 0;
+	logic_set_unitsize(ctx, rle->unitsize);
+	ctx->logic_out = grow_buffer(ctx->logic_out, &ctx->logic_out_size,
+		(rle->num_samples / ctx->ratio + 1) * 2 * rle->unitsize);
+
+	out = ctx->logic_out;
+	for (run = 0; run < rle->num_runs; run++) {
+		value = (const uint8_t *)rle->values + run * rle->unitsize;
+		length = rle->lengths[run];
+		while (length) {
+			chunk = MIN(ctx->ratio - ctx->logic_count, length);
+			logic_accumulate_run(ctx, value, chunk);
+			length -= chunk;
+			if (ctx->logic_count == ctx->ratio)
+				out = logic_emit(ctx, out);
+		}
+	}
+
+	return out - ctx->logic_out;
+}
+
+/* Update a minimum and a maximum with the values' range. */
+static void analog_accumulate(const float *values, size_t count,
+		float *min, float *max)
+{
+	float lo, hi;
+	size_t i;
+#ifdef __SSE2__
+	__m128 v, vlo, vhi;
+	float lanes[4];
+
+	i = 0;
+	if (count >= 8) {
+		vlo = _mm_set1_ps(*min);
+		vhi = _mm_set1_ps(*max);
+		for (; i + 4 <= count; i += 4) {
+			v = _mm_loadu_ps(&values[i]);
+			vlo = _mm_min_ps(v, vlo);
+			vhi = _mm_max_ps(v, vhi);
+		}
+		_mm_storeu_ps(lanes, vlo);
+		lo = MIN(MIN(lanes[0], lanes[1]), MIN(lanes[2], lanes[3]));
+		_mm_storeu_ps(lanes, vhi);
+		hi = MAX(MAX(lanes[0], lanes[1]), MAX(lanes[2], lanes[3]));
+		*min = MIN(lo, *min);
+		*max = MAX(hi, *max);
+	}
+	values += i;
+	count -= i;
+#endif
+
+	lo = *min;
+	hi = *max;
+	for (i = 0; i < count; i++) {
+		lo = values[i] < lo ? values[i] : lo;
+		hi = values[i] > hi ? values[i] : hi;
+	}
+	*min = lo;
+	*max = hi;
+}
+
+static gboolean channels_equal(GSList *a, GSList *b)
+{
+	while (a && b && a->data == b->data) {
+		a = a->next;
+		b = b->next;
+	}
+
+	return !a && !b;
+}
+
+/* Packets with several channels share a window, with one range each. */
+static struct analog_window *analog_window_get(struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	struct analog_window *window;
+	GSList *l;
+
+	for (l = ctx->analog_windows; l; l = l->next) {
+		window = l->data;
+		if (channels_equal(window->channels, analog->meaning->channels))
+			return window;
+	}
+	window = g_malloc0(sizeof(*window));
+	window->channels = g_slist_copy(analog->meaning->channels);
+	window->num_channels = g_slist_length(window->channels);
+	window->min = g_malloc(2 * window->num_channels * sizeof(float));
+	window->max = window->min + window->num_channels;
+	ctx->analog_windows = g_slist_append(ctx->analog_windows, window);
+
+	return window;
+}
+
+/* Like analog_accumulate(), for the interleaved values of several channels. */
+static void analog_accumulate_channels(const float *values, size_t count,
+		size_t num_channels, float *min, float *max)
+{
+	size_t i, ch;
+
+	for (i = 0; i < count; i++) {
+		for (ch = 0; ch < num_channels; ch++) {
+			min[ch] = MIN(values[ch], min[ch]);
+			max[ch] = MAX(values[ch], max[ch]);
+		}
+		values += num_channels;
+	}
+}
+
+/*
+ * Returns the number of output samples. Each window of a packet with
+ * several channels becomes two interleaved samples, all the channels'
+ * minimums and then their maximums.
+ */
+static size_t decimate_analog(struct context *ctx,
+		const struct sr_datafeed_analog *analog)
+{
+	struct analog_window *window;
+	const float *values;
+	float *out;
+	size_t count, num_channels, chunk;
+	int ret;
+
+	if (!analog->meaning->channels)
+		return 0;
+	window = analog_window_get(ctx, analog);
+	num_channels = window->num_channels;
+
+	count = analog->num_samples;
+	ctx->values = grow_buffer(ctx->values, &ctx->values_size,
+		count * num_channels * sizeof(ctx->values[0]));
+	ret = sr_analog_to_float(analog, ctx->values);
+	if (ret != SR_OK)
+		return 0;
+	ctx->analog_out = grow_buffer(ctx->analog_out, &ctx->analog_out_size,
+		(count / ctx->ratio + 1) * 2 * num_channels *
+		sizeof(ctx->analog_out[0]));
+
+	values = ctx->values;
+	out = ctx->analog_out;
+	while (count) {
+		chunk = MIN(ctx->ratio - window->count, count);
+		if (!window->count) {
+			memcpy(window->min, values, num_channels * sizeof(float));
+			memcpy(window->max, values, num_channels * sizeof(float));
+		}
+		if (num_channels == 1)
+			analog_accumulate(values, chunk, window->min, window->max);
+		else
+			analog_accumulate_channels(values, chunk, num_channels,
+				window->min, window->max);
+		window->count += chunk;
+		values += chunk * num_channels;
+		count -= chunk;
+		if (window->count == ctx->ratio) {
+			memcpy(out, window->min, num_channels * sizeof(float));
+			out += num_channels;
+			memcpy(out, window->max, num_channels * sizeof(float));
+			out += num_channels;
+			window->count = 0;
+		}
+	}
+
+	return (out - ctx->analog_out) / num_channels;
+}
+
+static void free_meta_config(struct context *ctx)
+{
+	GSList *l;
+
+	for (l = ctx->meta_config; l; l = l->next)
+		sr_config_free(l->data);
+	g_slist_free(ctx->meta_config);
+	ctx->meta_config = NULL;
+}
+
+/*
+ * Copy a META packet's configuration into the context, with the
+ * samplerate adjusted. The producer's packet is left untouched.
+ * Decimated rates below 1Hz cannot be expressed, they become 1Hz.
+ */
+static void adjust_samplerate(struct context *ctx,
+		const struct sr_datafeed_meta *meta)
+{
+	struct sr_config *src;
+	GVariant *data;
+	uint64_t samplerate, decimated;
+	GSList *l;
+
+	free_meta_config(ctx);
+	for (l = meta->config; l; l = l->next) {
+		src = l->data;
+		data = src->data;
+		if (src->key == SR_CONF_SAMPLERATE) {
+			samplerate = g_variant_get_uint64(src->data);
+			decimated = samplerate * 2 / ctx->ratio;
+			if (samplerate && !decimated) {
+				sr_warn("Samplerate %" PRIu64 "Hz is too low for "
+					"ratio %" PRIu64 ", using 1Hz.",
+					samplerate, ctx->ratio);
+				decimated = 1;
+			}
+			data = g_variant_new_uint64(decimated);
+		}
+		ctx->meta_config = g_slist_append(ctx->meta_config,
+			sr_config_new(src->key, data));
+	}
+	ctx->meta.config = ctx->meta_config;
+}
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+	const char *mode;
+	uint32_t ratio;
+	size_t i;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	ratio = g_variant_get_uint32(g_hash_table_lookup(options, "ratio"));
+	if (ratio < 2 || ratio > MAX_RATIO || (ratio & (ratio - 1))) {
+		sr_err("Ratio must be a power of two from 2 to %lu.", MAX_RATIO);
+		return SR_ERR_ARG;
+	}
+	mode = g_variant_get_string(g_hash_table_lookup(options, "logic"), NULL);
+	for (i = 0; i < ARRAY_SIZE(logic_modes); i++) {
+		if (!strcmp(mode, logic_modes[i]))
+			break;
+	}
+	if (i == ARRAY_SIZE(logic_modes)) {
+		sr_err("Unknown logic mode '%s'.", mode);
+		return SR_ERR_ARG;
+	}
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+	ctx->ratio = ratio;
+	ctx->logic_mode = i;
+
+	return SR_OK;
+}
+
+static int receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_timed *timed;
+	size_t length;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	switch (packet_in->type) {
+	case SR_DF_HEADER:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_END:
+		reset_windows(ctx);
+		break;
+	case SR_DF_META:
+		adjust_samplerate(ctx, packet_in->payload);
+		ctx->packet.type = SR_DF_META;
+		ctx->packet.payload = &ctx->meta;
+		*packet_out = &ctx->packet;
+		return SR_OK;
+	case SR_DF_LOGIC:
+	case SR_DF_LOGIC_RLE:
+		if (packet_in->type == SR_DF_LOGIC)
+			length = decimate_logic(ctx, packet_in->payload);
+		else
+			length = decimate_logic_rle(ctx, packet_in->payload);
+		/* Nothing to send until a window completes. */
+		if (!length) {
+			*packet_out = NULL;
+			return SR_OK;
+		}
+		ctx->logic.length = length;
+		ctx->logic.unitsize = ctx->unitsize;
+		ctx->logic.data = ctx->logic_out;
+		ctx->packet.type = SR_DF_LOGIC;
+		ctx->packet.payload = &ctx->logic;
+		*packet_out = &ctx->packet;
+		return SR_OK;
+	case SR_DF_ANALOG:
+	case SR_DF_ANALOG_TIMED:
+		/* Windows span readings, the result has no timestamps. */
+		if (packet_in->type == SR_DF_ANALOG_TIMED) {
+			timed = packet_in->payload;
+			analog = &timed->analog;
+		} else {
+			analog = packet_in->payload;
+		}
+		length = decimate_analog(ctx, analog);
+		if (!length) {
+			*packet_out = NULL;
+			return SR_OK;
+		}
+		/* Keep the meaning, the values are plain floats now. */
+		sr_analog_init(&ctx->analog, &ctx->encoding, &ctx->meaning,
+			&ctx->spec, analog->encoding->digits);
+		ctx->encoding.is_signed = TRUE;
+		ctx->meaning = *analog->meaning;
+		ctx->spec = *analog->spec;
+		ctx->analog.data = ctx->analog_out;
+		ctx->analog.num_samples = length;
+		ctx->packet.type = SR_DF_ANALOG;
+		ctx->packet.payload = &ctx->analog;
+		*packet_out = &ctx->packet;
+		return SR_OK;
+	default:
+		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
+		break;
+	}
+
+	*packet_out = packet_in;
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	reset_windows(ctx);
+	free_meta_config(ctx);
+	g_free(ctx->first);
+	g_free(ctx->logic_out);
+	g_free(ctx->values);
+	g_free(ctx->analog_out);
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "ratio", "Ratio", "Number of input samples per pair of output samples (power of two)", NULL, NULL },
+	{ "logic", "Logic", "Logic envelope (transition, min-max, or, and)", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	size_t i;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_RATIO));
+		options[1].def = g_variant_ref_sink(g_variant_new_string(logic_modes[0]));
+		for (i = 0; i < ARRAY_SIZE(logic_modes); i++) {
+			options[1].values = g_slist_append(options[1].values,
+				g_variant_ref_sink(g_variant_new_string(logic_modes[i])));
+		}
+	}
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_decimate = {
+	.id = "decimate",
+	.name = "Decimate",
+	.desc = "Reduce sample data to min/max envelopes",
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
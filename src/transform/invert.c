@@ -29,7 +29,9 @@ static int receive(const struct sr_transform *t,
 		struct sr_datafeed_packet **packet_out)
 {
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *rle;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_timed *timed;
 	uint8_t *b;
 	int64_t p;
 	uint64_t i, j, q;
@@ -48,8 +50,21 @@ static int receive(const struct sr_transform *t,
 			}
 		}
 		break;
+	case SR_DF_LOGIC_RLE:
+		/* Inverting the run values inverts every sample. */
+		rle = packet_in->payload;
+		b = rle->values;
+		for (i = 0; i < rle->num_runs * rle->unitsize; i++)
+			b[i] = ~b[i];
+		break;
 	case SR_DF_ANALOG:
-		analog = packet_in->payload;
+	case SR_DF_ANALOG_TIMED:
+		if (packet_in->type == SR_DF_ANALOG_TIMED) {
+			timed = packet_in->payload;
+			analog = &timed->analog;
+		} else {
+			analog = packet_in->payload;
+		}
 		p = analog->encoding->scale.p;
 		q = analog->encoding->scale.q;
 		if (q > INT64_MAX)
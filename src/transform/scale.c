@@ -49,6 +49,7 @@ static int receive(const struct sr_transform *t,
 {
 	struct context *ctx;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_analog_timed *timed;
 
 	if (!t || !t->sdi || !packet_in || !packet_out)
 		return SR_ERR_ARG;
@@ -56,7 +57,13 @@ static int receive(const struct sr_transform *t,
 
 	switch (packet_in->type) {
 	case SR_DF_ANALOG:
-		analog = packet_in->payload;
+	case SR_DF_ANALOG_TIMED:
+		if (packet_in->type == SR_DF_ANALOG_TIMED) {
+			timed = packet_in->payload;
+			analog = &timed->analog;
+		} else {
+			analog = packet_in->payload;
+		}
 		analog->encoding->scale.p *= ctx->factor.p;
 		analog->encoding->scale.q *= ctx->factor.q;
 		break;
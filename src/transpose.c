@@ -0,0 +1,320 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Conversion of channel bit planes to logic samples.
+ *
+ * Several devices transfer sample data as bit planes: A word holds a
+ * number of consecutive samples of one channel, the words for all
+ * enabled channels follow each other, then the next block of words
+ * starts. Turning this into samples is a bit matrix transpose.
+ *
+ * Blocks get split into tiles of 16 channels times 16 samples. Each
+ * tile gets transposed with a few word-wide operations, or with byte
+ * shuffles and movemask instructions when SSE2 (and AVX2) is available,
+ * instead of moving individual bits.
+ */
+
+#include <config.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "transpose"
+/** @endcond */
+
+#define TILE_BITS	16
+#define MAX_SLICES	(SR_BITPLANES_MAX_PLANE_SIZE / sizeof(uint16_t))
+#define MAX_GROUPS	(SR_BITPLANES_MAX_UNITSIZE * 8 / TILE_BITS)
+#define MAX_TILES	(MAX_SLICES * MAX_GROUPS)
+
+#ifndef __SSE2__
+/*
+ * Transpose a 16x16 bit matrix: bit c of row r becomes bit r of row c.
+ * Swaps blocks of 8, 4, 2 and 1 bits between pairs of rows.
+ */
+static void transpose_16x16_swar(const uint16_t *in, uint16_t *out)
+{
+	unsigned int j, k;
+	uint16_t m, t;
+
+	memcpy(out, in, TILE_BITS * sizeof(out[0]));
+	for (j = 8, m = 0x00ff; j; j >>= 1, m ^= m << j) {
+		for (k = 0; k < TILE_BITS; k = (k + j + 1) & ~j) {
+			t = ((out[k] >> j) ^ out[k + j]) & m;
+			out[k] ^= t << j;
+			out[k + j] ^= t;
+		}
+	}
+}
+#else
+/*
+ * Like transpose_16x16_swar(). Collects the low and the high bytes of
+ * all rows in one vector each, movemask then picks one bit of all rows.
+ */
+static void transpose_16x16_sse2(const uint16_t *in, uint16_t *out)
+{
+	__m128i r0, r1, low_bytes, lo, hi;
+	int b;
+
+	r0 = _mm_loadu_si128((const __m128i *)(const void *)&in[0]);
+	r1 = _mm_loadu_si128((const __m128i *)(const void *)&in[8]);
+	low_bytes = _mm_set1_epi16(0x00ff);
+	lo = _mm_packus_epi16(_mm_and_si128(r0, low_bytes),
+		_mm_and_si128(r1, low_bytes));
+	hi = _mm_packus_epi16(_mm_srli_epi16(r0, 8), _mm_srli_epi16(r1, 8));
+	for (b = 7; b >= 0; b--) {
+		out[b] = _mm_movemask_epi8(lo);
+		out[b + 8] = _mm_movemask_epi8(hi);
+		lo = _mm_add_epi8(lo, lo);
+		hi = _mm_add_epi8(hi, hi);
+	}
+}
+#endif
+
+#ifdef __AVX2__
+/* Like transpose_16x16_sse2(), for two adjacent tiles at once. */
+static void transpose_16x16_x2_avx2(const uint16_t *in, uint16_t *out)
+{
+	__m256i r0, r1, low_bytes, lo, hi;
+	uint32_t bits;
+	int b;
+
+	r0 = _mm256_loadu_si256((const __m256i *)(const void *)&in[0]);
+	r1 = _mm256_loadu_si256((const __m256i *)(const void *)&in[16]);
+	low_bytes = _mm256_set1_epi16(0x00ff);
+	/* Packing works per lane, put the tiles back into order. */
+	lo = _mm256_packus_epi16(_mm256_and_si256(r0, low_bytes),
+		_mm256_and_si256(r1, low_bytes));
+	lo = _mm256_permute4x64_epi64(lo, _MM_SHUFFLE(3, 1, 2, 0));
+	hi = _mm256_packus_epi16(_mm256_srli_epi16(r0, 8),
+		_mm256_srli_epi16(r1, 8));
+	hi = _mm256_permute4x64_epi64(hi, _MM_SHUFFLE(3, 1, 2, 0));
+	for (b = 7; b >= 0; b--) {
+		bits = (uint32_t)_mm256_movemask_epi8(lo);
+		out[b] = bits & 0xffff;
+		out[b + 16] = bits >> 16;
+		bits = (uint32_t)_mm256_movemask_epi8(hi);
+		out[b + 8] = bits & 0xffff;
+		out[b + 24] = bits >> 16;
+		lo = _mm256_add_epi8(lo, lo);
+		hi = _mm256_add_epi8(hi, hi);
+	}
+}
+#endif
+
+static void transpose_tiles(const uint16_t *in, uint16_t *out, size_t count)
+{
+	size_t i;
+
+	i = 0;
+#ifdef __AVX2__
+	for (; i + 2 <= count; i += 2)
+		transpose_16x16_x2_avx2(&in[i * TILE_BITS], &out[i * TILE_BITS]);
+#endif
+	for (; i < count; i++) {
+#ifdef __SSE2__
+		transpose_16x16_sse2(&in[i * TILE_BITS], &out[i * TILE_BITS]);
+#else
+		transpose_16x16_swar(&in[i * TILE_BITS], &out[i * TILE_BITS]);
+#endif
+	}
+}
+
+/**
+ * Prepare the conversion of bit planes to samples.
+ *
+ * @param bp The conversion state to initialize.
+ * @param plane_size Size of a channel's bit plane word in bytes, 2, 4
+ *                   or 8. Plane words are little endian.
+ * @param msb_first Whether the most significant bit of a plane word
+ *                  holds the first sample, instead of the least
+ *                  significant bit.
+ * @param channel_mask The enabled channels. Their plane words follow
+ *                     each other in the order of their index.
+ * @param unitsize Size of the resulting samples in bytes, 1, 2 or 4.
+ *                 Channel N is bit N of the little endian samples.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Unsupported layout, or no channel is enabled.
+ *
+ * @private
+ */
+SR_PRIV int sr_bitplanes_init(struct sr_bitplanes *bp, size_t plane_size,
+		gboolean msb_first, uint32_t channel_mask, size_t unitsize)
+{
+	size_t bit;
+
+	memset(bp, 0, sizeof(*bp));
+	if (plane_size != 2 && plane_size != 4 && plane_size != 8)
+		return SR_ERR_ARG;
+	if (unitsize != 1 && unitsize != 2 && unitsize != 4)
+		return SR_ERR_ARG;
+	if (unitsize < sizeof(channel_mask) &&
+			channel_mask >> (8 * unitsize))
+		return SR_ERR_ARG;
+
+	for (bit = 0; bit < 8 * sizeof(channel_mask); bit++) {
+		if (channel_mask & (UINT32_C(1) << bit))
+			bp->positions[bp->plane_count++] = bit;
+	}
+	if (!bp->plane_count)
+		return SR_ERR_ARG;
+
+	bp->plane_size = plane_size;
+	bp->msb_first = msb_first;
+	bp->unitsize = unitsize;
+	bp->block_size = bp->plane_count * plane_size;
+	bp->block_samples = 8 * plane_size;
+
+	return SR_OK;
+}
+
+/**
+ * Convert complete blocks of bit planes to samples.
+ *
+ * @param bp The conversion state, see sr_bitplanes_init().
+ * @param dst Receives block_count * bp->block_samples samples.
+ * @param src Bit plane data, block_count * bp->block_size bytes.
+ * @param block_count Number of blocks to convert.
+ *
+ * @private
+ */
+SR_PRIV void sr_bitplanes_to_samples(const struct sr_bitplanes *bp,
+		uint8_t *dst, const uint8_t *src, size_t block_count)
+{
+	uint16_t tiles[MAX_TILES * TILE_BITS], rows[MAX_TILES * TILE_BITS];
+	size_t slices, groups, tile_count, plane, slice, group, row, k, idx;
+	uint8_t *sample;
+
+	slices = bp->plane_size / sizeof(uint16_t);
+	groups = (8 * bp->unitsize + TILE_BITS - 1) / TILE_BITS;
+	tile_count = slices * groups;
+
+	while (block_count--) {
+		/* Sort the planes' 16 sample slices into tiles. */
+		memset(tiles, 0, tile_count * TILE_BITS * sizeof(tiles[0]));
+		for (plane = 0; plane < bp->plane_count; plane++) {
+			group = bp->positions[plane] / TILE_BITS;
+			row = bp->positions[plane] % TILE_BITS;
+			for (slice = 0; slice < slices; slice++) {
+				tiles[(slice * groups + group) * TILE_BITS + row] =
+					read_u16le(src + slice * sizeof(uint16_t));
+			}
+			src += bp->plane_size;
+		}
+
+		transpose_tiles(tiles, rows, tile_count);
+
+		/* Row k of a tile holds 16 channels of the slice's sample k. */
+		for (slice = 0; slice < slices; slice++) {
+			for (k = 0; k < TILE_BITS; k++) {
+				idx = slice * TILE_BITS + k;
+				if (bp->msb_first)
+					idx = bp->block_samples - 1 - idx;
+				sample = dst + idx * bp->unitsize;
+				if (bp->unitsize == 1) {
+					sample[0] = rows[slice * groups * TILE_BITS + k];
+					continue;
+				}
+				for (group = 0; group < groups; group++) {
+					write_u16le(sample + group * sizeof(uint16_t),
+						rows[(slice * groups + group) * TILE_BITS + k]);
+				}
+			}
+		}
+		dst += bp->block_samples * bp->unitsize;
+	}
+}
+
+/**
+ * Convert a stream of bit planes to samples.
+ *
+ * Blocks may span several calls, a trailing incomplete block is kept
+ * in the conversion state and gets completed by the next call.
+ *
+ * @param bp The conversion state, see sr_bitplanes_init().
+ * @param dst Receives the samples.
+ * @param dst_samples Capacity of dst in samples, at least one block's.
+ * @param src Bit plane data.
+ * @param length Length of src in bytes.
+ * @param samples Receives the number of samples written to dst.
+ *
+ * @return The number of bytes consumed from src. Is less than length
+ *         when dst is full, call again for the remainder.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_bitplanes_convert(struct sr_bitplanes *bp, uint8_t *dst,
+		size_t dst_samples, const uint8_t *src, size_t length,
+		size_t *samples)
+{
+	size_t consumed, copy, blocks;
+
+	*samples = 0;
+	consumed = 0;
+	if (dst_samples < bp->block_samples)
+		return 0;
+
+	/* Complete a block which the previous call had started. */
+	if (bp->pending_len) {
+		copy = MIN(bp->block_size - bp->pending_len, length);
+		memcpy(&bp->pending[bp->pending_len], src, copy);
+		bp->pending_len += copy;
+		consumed += copy;
+		if (bp->pending_len < bp->block_size)
+			return consumed;
+		sr_bitplanes_to_samples(bp, dst, bp->pending, 1);
+		bp->pending_len = 0;
+		dst += bp->block_samples * bp->unitsize;
+		dst_samples -= bp->block_samples;
+		*samples += bp->block_samples;
+	}
+
+	/* Convert complete blocks in place, as many as fit. */
+	blocks = MIN((length - consumed) / bp->block_size,
+		dst_samples / bp->block_samples);
+	sr_bitplanes_to_samples(bp, dst, src + consumed, blocks);
+	consumed += blocks * bp->block_size;
+	*samples += blocks * bp->block_samples;
+
+	/* Keep the start of an incomplete block. */
+	if (length - consumed < bp->block_size) {
+		bp->pending_len = length - consumed;
+		memcpy(bp->pending, src + consumed, bp->pending_len);
+		consumed = length;
+	}
+
+	return consumed;
+}
+
+/**
+ * Discard an incomplete block, e.g. when an acquisition restarts.
+ *
+ * @private
+ */
+SR_PRIV void sr_bitplanes_reset(struct sr_bitplanes *bp)
+{
+	bp->pending_len = 0;
+}
@@ -0,0 +1,887 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Incremental ZIP archive writer.
+ *
+ * libzip rewrites the whole archive (into a temporary file) on every
+ * zip_close() call, which makes repeated appends to a growing archive
+ * expensive. This writer keeps the archive file open and only appends
+ * to it. Entries get compressed by libzip in memory, their compressed
+ * data gets written after the previously added entries.
+ *
+ * The central directory is kept in memory, and gets written behind the
+ * last entry after each addition. The file on disk is a complete and
+ * valid archive at every moment, which keeps the data that was added
+ * so far when the application terminates unexpectedly:
+ *
+ *  - A copy of the current central directory and end records gets
+ *    written beyond where the new entry's trailer will end, and gets
+ *    flushed. The archive is valid, with unused space in between.
+ *  - The new entry, the new central directory and end records get
+ *    written over the previous trailer and the unused space, and get
+ *    flushed. The copy still terminates the file.
+ *  - The file gets truncated behind the new end records.
+ *
+ * Flushing hands the data to the operating system in this order, which
+ * is all it takes when the application terminates. The file only gets
+ * synced to the disk once, when the writer gets closed. Syncing each
+ * step would cost several disk round trips per entry.
+ *
+ * This avoids leaving a stale trailer behind every entry, which would
+ * grow the file quadratically with the number of entries.
+ *
+ * ZIP64 records get written when the archive grows beyond the limits
+ * of the original format. Individual entries are limited to 4GiB.
+ *
+ * Entries can be queued for compression on worker threads. They get
+ * appended to the file in the order in which their compression
+ * completes, which may differ from the order of submission.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef _WIN32
+#include <io.h>
+#endif
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zip.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "zip-writer"
+/** @endcond */
+
+#define ZIP_LOCAL_HEADER_SIG	0x04034b50
+#define ZIP_CENTRAL_HEADER_SIG	0x02014b50
+#define ZIP_EOCD_SIG		0x06054b50
+#define ZIP64_EOCD_SIG		0x06064b50
+#define ZIP64_LOCATOR_SIG	0x07064b50
+
+#define ZIP_LOCAL_HEADER_SIZE	30
+#define ZIP_CENTRAL_HEADER_SIZE	46
+#define ZIP_EOCD_SIZE		22
+#define ZIP64_EOCD_SIZE		56
+#define ZIP64_LOCATOR_SIZE	20
+#define ZIP64_EXTRA_ID		0x0001
+#define ZIP64_EXTRA_SIZE	(4 + 8)
+
+#define ZIP_VERSION_DEFAULT	20
+#define ZIP_VERSION_ZIP64	45
+#define ZIP_VERSION_ZSTD	63
+
+#define ZIP_TRAILER_MAX_SIZE	(ZIP64_EOCD_SIZE + ZIP64_LOCATOR_SIZE + ZIP_EOCD_SIZE)
+
+#define ZIP_MAX_U16		0xffff
+#define ZIP_MAX_U32		0xffffffffULL
+
+/* Queued entries in flight at most, per worker thread. */
+#define ZIP_QUEUE_PER_THREAD	2
+#define ZIP_MAX_THREADS		4
+
+struct sr_zip_writer {
+	/* Protects the file, the directory, and the queue state. */
+	GMutex mutex;
+	FILE *file;
+	char *filename;
+	/* Where the central directory starts, and the next entry goes. */
+	uint64_t data_end;
+	uint64_t entries;
+	GByteArray *cdir;
+	uint16_t dos_time;
+	uint16_t dos_date;
+	gboolean failed;
+	zip_int32_t method;
+	zip_uint32_t level;
+	/* Compression on worker threads. */
+	GThreadPool *pool;
+	GCond queue_cond;
+	guint pending;
+	guint max_pending;
+	int queue_error;
+};
+
+struct zip_writer_job {
+	char *name;
+	void *data;
+	size_t length;
+};
+
+struct zip_writer_entry {
+	uint16_t method;
+	uint32_t crc;
+	uint64_t size;
+	uint64_t comp_size;
+	uint8_t *comp_data;
+};
+
+static int writer_write(struct sr_zip_writer *zw,
+		const void *data, size_t length)
+{
+	if (!length)
+		return SR_OK;
+
+	if (fwrite(data, 1, length, zw->file) != length) {
+		sr_err("Cannot write to '%s': %s.", zw->filename,
+			g_strerror(errno));
+		zw->failed = TRUE;
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Have libzip compress the data into an in-memory archive, and grab
+ * the compressed data as well as the entry's properties from there.
+ */
+static int compress_entry(const void *data, size_t length,
+		zip_int32_t method, zip_uint32_t level,
+		struct zip_writer_entry *entry)
+{
+	zip_error_t error;
+	zip_source_t *memsrc, *datasrc;
+	zip_t *archive;
+	zip_file_t *file;
+	struct zip_stat st;
+	zip_int64_t len, idx;
+	int ret;
+
+	zip_error_init(&error);
+	memsrc = zip_source_buffer_create(NULL, 0, 0, &error);
+	if (!memsrc) {
+		sr_err("Cannot create memory source: %s.",
+			zip_error_strerror(&error));
+		zip_error_fini(&error);
+		return SR_ERR_MALLOC;
+	}
+
+	/* Keep the memory source beyond the archive's lifetime. */
+	zip_source_keep(memsrc);
+	archive = zip_open_from_source(memsrc, ZIP_TRUNCATE, &error);
+	if (!archive) {
+		sr_err("Cannot create memory archive: %s.",
+			zip_error_strerror(&error));
+		zip_source_free(memsrc);
+		zip_source_free(memsrc);
+		zip_error_fini(&error);
+		return SR_ERR;
+	}
+	datasrc = zip_source_buffer(archive, data, length, 0);
+	idx = datasrc ? zip_file_add(archive, "data", datasrc, 0) : -1;
+	if (idx < 0) {
+		sr_err("Cannot add data to memory archive: %s.",
+			zip_strerror(archive));
+		zip_source_free(datasrc);
+		zip_discard(archive);
+		zip_source_free(memsrc);
+		zip_error_fini(&error);
+		return SR_ERR;
+	}
+	if (zip_set_file_compression(archive, idx, method, level) < 0) {
+		sr_err("Cannot set compression method: %s.",
+			zip_strerror(archive));
+		zip_discard(archive);
+		zip_source_free(memsrc);
+		zip_error_fini(&error);
+		return SR_ERR;
+	}
+	if (zip_close(archive) < 0) {
+		sr_err("Cannot compress data: %s.", zip_strerror(archive));
+		zip_discard(archive);
+		zip_source_free(memsrc);
+		zip_error_fini(&error);
+		return SR_ERR;
+	}
+
+	zip_source_keep(memsrc);
+	archive = zip_open_from_source(memsrc, ZIP_RDONLY, &error);
+	if (!archive) {
+		sr_err("Cannot open memory archive: %s.",
+			zip_error_strerror(&error));
+		zip_source_free(memsrc);
+		zip_source_free(memsrc);
+		zip_error_fini(&error);
+		return SR_ERR;
+	}
+	zip_error_fini(&error);
+
+	ret = SR_OK;
+	file = NULL;
+	zip_stat_init(&st);
+	if (zip_stat_index(archive, 0, 0, &st) < 0 ||
+			st.comp_size > ZIP_MAX_U32 - 1 ||
+			!(file = zip_fopen_index(archive, 0, ZIP_FL_COMPRESSED))) {
+		sr_err("Cannot access compressed data: %s.",
+			zip_strerror(archive));
+		ret = SR_ERR;
+	}
+	if (ret == SR_OK) {
+		entry->method = st.comp_method;
+		entry->crc = st.crc;
+		entry->size = st.size;
+		entry->comp_size = st.comp_size;
+		entry->comp_data = g_try_malloc(st.comp_size + 1);
+		if (!entry->comp_data)
+			ret = SR_ERR_MALLOC;
+	}
+	if (ret == SR_OK) {
+		len = zip_fread(file, entry->comp_data, st.comp_size);
+		if (len < 0 || (zip_uint64_t)len != st.comp_size) {
+			sr_err("Cannot read compressed data.");
+			g_free(entry->comp_data);
+			entry->comp_data = NULL;
+			ret = SR_ERR;
+		}
+	}
+	if (file)
+		zip_fclose(file);
+	zip_discard(archive);
+	zip_source_free(memsrc);
+
+	return ret;
+}
+
+static uint16_t version_needed(uint16_t method, gboolean zip64)
+{
+	uint16_t version;
+
+	version = ZIP_VERSION_DEFAULT;
+	if (method != ZIP_CM_STORE && method != ZIP_CM_DEFLATE)
+		version = ZIP_VERSION_ZSTD;
+	if (zip64)
+		version = MAX(version, ZIP_VERSION_ZIP64);
+
+	return version;
+}
+
+static void append_central_header(struct sr_zip_writer *zw,
+		const char *name, const struct zip_writer_entry *entry,
+		uint64_t offset)
+{
+	uint8_t header[ZIP_CENTRAL_HEADER_SIZE + ZIP64_EXTRA_SIZE];
+	uint8_t *p;
+	size_t name_len;
+	gboolean zip64;
+
+	name_len = strlen(name);
+	zip64 = offset >= ZIP_MAX_U32;
+
+	p = header;
+	write_u32le_inc(&p, ZIP_CENTRAL_HEADER_SIG);
+	write_u16le_inc(&p, ZIP_VERSION_ZSTD);
+	write_u16le_inc(&p, version_needed(entry->method, zip64));
+	write_u16le_inc(&p, 0);
+	write_u16le_inc(&p, entry->method);
+	write_u16le_inc(&p, zw->dos_time);
+	write_u16le_inc(&p, zw->dos_date);
+	write_u32le_inc(&p, entry->crc);
+	write_u32le_inc(&p, entry->comp_size);
+	write_u32le_inc(&p, entry->size);
+	write_u16le_inc(&p, name_len);
+	write_u16le_inc(&p, zip64 ? ZIP64_EXTRA_SIZE : 0);
+	write_u16le_inc(&p, 0);
+	write_u16le_inc(&p, 0);
+	write_u16le_inc(&p, 0);
+	write_u32le_inc(&p, 0);
+	write_u32le_inc(&p, zip64 ? ZIP_MAX_U32 : offset);
+
+	g_byte_array_append(zw->cdir, header, ZIP_CENTRAL_HEADER_SIZE);
+	g_byte_array_append(zw->cdir, (const guint8 *)name, name_len);
+	if (zip64) {
+		p = header;
+		write_u16le_inc(&p, ZIP64_EXTRA_ID);
+		write_u16le_inc(&p, 8);
+		write_u64le_inc(&p, offset);
+		g_byte_array_append(zw->cdir, header, ZIP64_EXTRA_SIZE);
+	}
+}
+
+/*
+ * Build the end of central directory records for a central directory
+ * which starts at cd_offset. Returns the records' length.
+ */
+static size_t build_trailer(uint8_t *trailer, uint64_t entries,
+		uint64_t cd_offset, uint64_t cd_size)
+{
+	uint8_t *p;
+
+	p = trailer;
+	if (entries >= ZIP_MAX_U16 || cd_offset >= ZIP_MAX_U32 ||
+			cd_size >= ZIP_MAX_U32) {
+		write_u32le_inc(&p, ZIP64_EOCD_SIG);
+		write_u64le_inc(&p, ZIP64_EOCD_SIZE - 12);
+		write_u16le_inc(&p, ZIP_VERSION_ZIP64);
+		write_u16le_inc(&p, ZIP_VERSION_ZIP64);
+		write_u32le_inc(&p, 0);
+		write_u32le_inc(&p, 0);
+		write_u64le_inc(&p, entries);
+		write_u64le_inc(&p, entries);
+		write_u64le_inc(&p, cd_size);
+		write_u64le_inc(&p, cd_offset);
+
+		write_u32le_inc(&p, ZIP64_LOCATOR_SIG);
+		write_u32le_inc(&p, 0);
+		write_u64le_inc(&p, cd_offset + cd_size);
+		write_u32le_inc(&p, 1);
+	}
+	write_u32le_inc(&p, ZIP_EOCD_SIG);
+	write_u16le_inc(&p, 0);
+	write_u16le_inc(&p, 0);
+	write_u16le_inc(&p, MIN(entries, ZIP_MAX_U16));
+	write_u16le_inc(&p, MIN(entries, ZIP_MAX_U16));
+	write_u32le_inc(&p, MIN(cd_size, ZIP_MAX_U32));
+	write_u32le_inc(&p, MIN(cd_offset, ZIP_MAX_U32));
+	write_u16le_inc(&p, 0);
+
+	return p - trailer;
+}
+
+static int writer_seek(struct sr_zip_writer *zw, uint64_t offset)
+{
+	if (fseeko(zw->file, offset, SEEK_SET) < 0) {
+		sr_err("Cannot seek in '%s': %s.", zw->filename,
+			g_strerror(errno));
+		zw->failed = TRUE;
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/* Write a central directory and its end records at the given offset. */
+static int writer_trailer(struct sr_zip_writer *zw, uint64_t offset,
+		uint64_t entries, const uint8_t *cdir, size_t cd_size)
+{
+	uint8_t trailer[ZIP_TRAILER_MAX_SIZE];
+	size_t length;
+	int ret;
+
+	length = build_trailer(trailer, entries, offset, cd_size);
+
+	ret = writer_seek(zw, offset);
+	if (ret == SR_OK)
+		ret = writer_write(zw, cdir, cd_size);
+	if (ret == SR_OK)
+		ret = writer_write(zw, trailer, length);
+
+	return ret;
+}
+
+/*
+ * Hand everything written so far to the operating system, so that
+ * later writes cannot overtake it.
+ */
+static int writer_flush(struct sr_zip_writer *zw)
+{
+	if (fflush(zw->file) != 0) {
+		sr_err("Cannot write to '%s': %s.", zw->filename,
+			g_strerror(errno));
+		zw->failed = TRUE;
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/* Get the archive onto the disk. */
+static int writer_sync(struct sr_zip_writer *zw)
+{
+	int fd, ret;
+
+	ret = fflush(zw->file);
+	if (ret == 0) {
+		fd = fileno(zw->file);
+#ifdef _WIN32
+		ret = _commit(fd);
+#else
+		ret = fsync(fd);
+#endif
+	}
+	if (ret != 0) {
+		sr_err("Cannot write to '%s': %s.", zw->filename,
+			g_strerror(errno));
+		zw->failed = TRUE;
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+static int writer_truncate(struct sr_zip_writer *zw, uint64_t length)
+{
+	if (fflush(zw->file) != 0 || ftruncate(fileno(zw->file), length) != 0) {
+		sr_err("Cannot truncate '%s': %s.", zw->filename,
+			g_strerror(errno));
+		zw->failed = TRUE;
+		return SR_ERR_IO;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Write a compressed entry behind the previous ones, and update the
+ * central directory. Must be called with the mutex held.
+ */
+static int writer_append(struct sr_zip_writer *zw, const char *name,
+		const struct zip_writer_entry *entry)
+{
+	uint8_t header[ZIP_LOCAL_HEADER_SIZE];
+	uint8_t trailer[ZIP_TRAILER_MAX_SIZE];
+	uint8_t *p;
+	uint64_t offset, cd_offset, file_end;
+	size_t name_len, old_cd_size;
+	int ret;
+
+	if (zw->failed)
+		return SR_ERR_IO;
+
+	name_len = strlen(name);
+	offset = zw->data_end;
+	cd_offset = offset + sizeof(header) + name_len + entry->comp_size;
+
+	p = header;
+	write_u32le_inc(&p, ZIP_LOCAL_HEADER_SIG);
+	write_u16le_inc(&p, version_needed(entry->method, FALSE));
+	write_u16le_inc(&p, 0);
+	write_u16le_inc(&p, entry->method);
+	write_u16le_inc(&p, zw->dos_time);
+	write_u16le_inc(&p, zw->dos_date);
+	write_u32le_inc(&p, entry->crc);
+	write_u32le_inc(&p, entry->comp_size);
+	write_u32le_inc(&p, entry->size);
+	write_u16le_inc(&p, name_len);
+	write_u16le_inc(&p, 0);
+
+	/* The previous directory remains a prefix of the updated one. */
+	old_cd_size = zw->cdir->len;
+	append_central_header(zw, name, entry, offset);
+	file_end = cd_offset + zw->cdir->len +
+		build_trailer(trailer, zw->entries + 1, cd_offset, zw->cdir->len);
+
+	/* Move the current trailer out of the way, then overwrite it. */
+	ret = writer_trailer(zw, file_end, zw->entries,
+		zw->cdir->data, old_cd_size);
+	if (ret == SR_OK)
+		ret = writer_flush(zw);
+	if (ret == SR_OK)
+		ret = writer_seek(zw, offset);
+	if (ret == SR_OK)
+		ret = writer_write(zw, header, sizeof(header));
+	if (ret == SR_OK)
+		ret = writer_write(zw, name, name_len);
+	if (ret == SR_OK)
+		ret = writer_write(zw, entry->comp_data, entry->comp_size);
+	if (ret == SR_OK)
+		ret = writer_trailer(zw, cd_offset, zw->entries + 1,
+			zw->cdir->data, zw->cdir->len);
+	if (ret == SR_OK)
+		ret = writer_flush(zw);
+	if (ret == SR_OK)
+		ret = writer_truncate(zw, file_end);
+	if (ret != SR_OK)
+		return ret;
+
+	zw->data_end = cd_offset;
+	zw->entries++;
+
+	return SR_OK;
+}
+
+static int check_entry(const char *name, size_t length)
+{
+	size_t name_len;
+
+	name_len = strlen(name);
+	if (!name_len || name_len > ZIP_MAX_U16 ||
+			(uint64_t)length >= ZIP_MAX_U32) {
+		sr_err("Cannot add entry '%s' of %zu bytes.", name, length);
+		return SR_ERR_ARG;
+	}
+
+	return SR_OK;
+}
+
+static int writer_add(struct sr_zip_writer *zw, const char *name,
+		const void *data, size_t length)
+{
+	struct zip_writer_entry entry;
+	zip_int32_t method;
+	zip_uint32_t level;
+	int ret;
+
+	g_mutex_lock(&zw->mutex);
+	method = zw->method;
+	level = zw->level;
+	g_mutex_unlock(&zw->mutex);
+
+	/* Compression runs unlocked, concurrently with other entries. */
+	memset(&entry, 0, sizeof(entry));
+	ret = compress_entry(data, length, method, level, &entry);
+	if (ret != SR_OK)
+		return ret;
+
+	g_mutex_lock(&zw->mutex);
+	ret = writer_append(zw, name, &entry);
+	g_mutex_unlock(&zw->mutex);
+	g_free(entry.comp_data);
+
+	return ret;
+}
+
+static void queue_job_free(struct zip_writer_job *job)
+{
+	g_free(job->name);
+	g_free(job->data);
+	g_free(job);
+}
+
+static void queue_thread(gpointer data, gpointer user_data)
+{
+	struct sr_zip_writer *zw;
+	struct zip_writer_job *job;
+	int ret;
+
+	job = data;
+	zw = user_data;
+
+	ret = writer_add(zw, job->name, job->data, job->length);
+	queue_job_free(job);
+
+	g_mutex_lock(&zw->mutex);
+	if (ret != SR_OK && zw->queue_error == SR_OK)
+		zw->queue_error = ret;
+	zw->pending--;
+	g_cond_broadcast(&zw->queue_cond);
+	g_mutex_unlock(&zw->mutex);
+}
+
+static int queue_start(struct sr_zip_writer *zw)
+{
+	GError *error;
+	guint threads;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	threads = g_get_num_processors();
+#else
+	threads = 2;
+#endif
+	threads = CLAMP(threads, 1, ZIP_MAX_THREADS);
+
+	error = NULL;
+	zw->pool = g_thread_pool_new(queue_thread, zw, threads, TRUE, &error);
+	if (!zw->pool) {
+		sr_err("Cannot create compression threads: %s.",
+			error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+	zw->max_pending = threads * ZIP_QUEUE_PER_THREAD;
+	sr_dbg("Compressing on %u threads.", threads);
+
+	return SR_OK;
+}
+
+/*
+ * Wait for all queued entries to get written. Returns the first error
+ * which occurred on a worker thread.
+ */
+static int queue_drain(struct sr_zip_writer *zw)
+{
+	int ret;
+
+	g_mutex_lock(&zw->mutex);
+	while (zw->pending)
+		g_cond_wait(&zw->queue_cond, &zw->mutex);
+	ret = zw->queue_error;
+	g_mutex_unlock(&zw->mutex);
+
+	return ret;
+}
+
+/**
+ * Create a ZIP archive for incremental writes.
+ *
+ * An existing file of the same name gets replaced. Entries get
+ * compressed with libzip's default method unless configured otherwise
+ * by sr_zip_writer_compression_set().
+ *
+ * @param filename The archive's file name.
+ *
+ * @return The writer, or NULL upon error.
+ *
+ * @private
+ */
+SR_PRIV struct sr_zip_writer *sr_zip_writer_open(const char *filename)
+{
+	struct sr_zip_writer *zw;
+	GDateTime *now;
+	FILE *file;
+
+	if (!filename)
+		return NULL;
+
+	file = g_fopen(filename, "wb");
+	if (!file) {
+		sr_err("Cannot create '%s': %s.", filename, g_strerror(errno));
+		return NULL;
+	}
+
+	zw = g_malloc0(sizeof(*zw));
+	g_mutex_init(&zw->mutex);
+	g_cond_init(&zw->queue_cond);
+	zw->file = file;
+	zw->filename = g_strdup(filename);
+	zw->cdir = g_byte_array_new();
+	zw->method = ZIP_CM_DEFAULT;
+	zw->level = 0;
+	zw->queue_error = SR_OK;
+
+	/* All entries share the archive's creation time. */
+	now = g_date_time_new_now_local();
+	zw->dos_time = (g_date_time_get_hour(now) << 11) |
+		(g_date_time_get_minute(now) << 5) |
+		(g_date_time_get_second(now) / 2);
+	zw->dos_date = ((MAX(g_date_time_get_year(now), 1980) - 1980) << 9) |
+		(g_date_time_get_month(now) << 5) |
+		g_date_time_get_day_of_month(now);
+	g_date_time_unref(now);
+
+	/* Start with an empty yet valid archive. */
+	if (writer_trailer(zw, 0, 0, NULL, 0) != SR_OK ||
+			writer_flush(zw) != SR_OK) {
+		sr_zip_writer_close(zw);
+		return NULL;
+	}
+
+	return zw;
+}
+
+/**
+ * Check whether libzip supports a compression method.
+ *
+ * Store and deflate are always available. Support for other methods
+ * depends on how libzip was built.
+ *
+ * @param method The libzip compression method (ZIP_CM_*).
+ * @param compress TRUE to check for compression, FALSE to check for
+ *                 decompression.
+ *
+ * @return TRUE if the method is supported.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_zip_compression_supported(int32_t method,
+		gboolean compress)
+{
+	if (method == ZIP_CM_DEFAULT || method == ZIP_CM_STORE ||
+			method == ZIP_CM_DEFLATE)
+		return TRUE;
+#ifdef HAVE_ZIP_COMPRESSION_METHOD_SUPPORTED
+	return zip_compression_method_supported(method, compress) != 0;
+#else
+	(void)compress;
+	return FALSE;
+#endif
+}
+
+/**
+ * Set the compression method and level for subsequently added entries.
+ *
+ * @param zw The writer.
+ * @param method The libzip compression method (ZIP_CM_*).
+ * @param level The compression level, 0 for the method's default.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The method is not supported by libzip.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_compression_set(struct sr_zip_writer *zw,
+		int32_t method, uint32_t level)
+{
+	if (!zw)
+		return SR_ERR_ARG;
+	if (!sr_zip_compression_supported(method, TRUE)) {
+		sr_err("Compression method %d is not supported.", method);
+		return SR_ERR_NA;
+	}
+
+	g_mutex_lock(&zw->mutex);
+	zw->method = method;
+	zw->level = level;
+	g_mutex_unlock(&zw->mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Add an entry to a ZIP archive.
+ *
+ * The data gets compressed and written to the archive file immediately,
+ * followed by the updated central directory. The caller's buffer is not
+ * referenced after the call returns.
+ *
+ * @param zw The writer.
+ * @param name The entry's name.
+ * @param data The entry's content.
+ * @param length The content's length in bytes.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Write error, the writer is unusable afterwards.
+ * @retval other Compression error.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_add(struct sr_zip_writer *zw, const char *name,
+		const void *data, size_t length)
+{
+	int ret;
+
+	if (!zw || !name || (!data && length))
+		return SR_ERR_ARG;
+	if ((ret = check_entry(name, length)) != SR_OK)
+		return ret;
+
+	return writer_add(zw, name, data, length);
+}
+
+/**
+ * Queue an entry for compression on a worker thread.
+ *
+ * The call only blocks while the number of queued entries is at its
+ * limit, which bounds the amount of memory that pending entries occupy.
+ * Entries get appended to the archive in the order in which their
+ * compression completes. Errors which occur on worker threads get
+ * reported by subsequent calls, and by sr_zip_writer_close().
+ *
+ * @param zw The writer.
+ * @param name The entry's name. Gets copied.
+ * @param data The entry's content, allocated with g_malloc(). The writer
+ *             takes ownership, also when the call fails.
+ * @param length The content's length in bytes.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval other A previously queued entry could not be written.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_queue(struct sr_zip_writer *zw, const char *name,
+		void *data, size_t length)
+{
+	struct zip_writer_job *job;
+	GError *error;
+	int ret;
+
+	if (!zw || !name || (!data && length)) {
+		g_free(data);
+		return SR_ERR_ARG;
+	}
+	if ((ret = check_entry(name, length)) != SR_OK) {
+		g_free(data);
+		return ret;
+	}
+	if (!zw->pool && (ret = queue_start(zw)) != SR_OK) {
+		g_free(data);
+		return ret;
+	}
+
+	g_mutex_lock(&zw->mutex);
+	while (zw->pending >= zw->max_pending && zw->queue_error == SR_OK)
+		g_cond_wait(&zw->queue_cond, &zw->mutex);
+	ret = zw->queue_error;
+	if (ret == SR_OK)
+		zw->pending++;
+	g_mutex_unlock(&zw->mutex);
+	if (ret != SR_OK) {
+		g_free(data);
+		return ret;
+	}
+
+	job = g_malloc(sizeof(*job));
+	job->name = g_strdup(name);
+	job->data = data;
+	job->length = length;
+
+	error = NULL;
+	if (!g_thread_pool_push(zw->pool, job, &error)) {
+		sr_err("Cannot queue entry '%s': %s.", name, error->message);
+		g_error_free(error);
+		queue_job_free(job);
+		g_mutex_lock(&zw->mutex);
+		zw->pending--;
+		g_mutex_unlock(&zw->mutex);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Finalize a ZIP archive and release the writer.
+ *
+ * Waits for all queued entries to get written first, then syncs the
+ * archive to the disk.
+ *
+ * @param zw The writer. May be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_IO The archive could not be written completely.
+ * @retval other A queued entry could not be written.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_close(struct sr_zip_writer *zw)
+{
+	int ret;
+
+	if (!zw)
+		return SR_OK;
+
+	ret = SR_OK;
+	if (zw->pool) {
+		ret = queue_drain(zw);
+		g_thread_pool_free(zw->pool, FALSE, TRUE);
+	}
+
+	/* The archive is complete after every addition, just sync it. */
+	if (ret == SR_OK && zw->failed)
+		ret = SR_ERR_IO;
+	if (ret == SR_OK)
+		ret = writer_sync(zw);
+	if (fclose(zw->file) != 0) {
+		sr_err("Cannot close '%s': %s.", zw->filename,
+			g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+	g_byte_array_free(zw->cdir, TRUE);
+	g_free(zw->filename);
+	g_cond_clear(&zw->queue_cond);
+	g_mutex_clear(&zw->mutex);
+	g_free(zw);
+
+	return ret;
+}
@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
@@ -428,6 +430,153 @@ START_TEST(test_analog_to_float_conv)
 }
 END_TEST
 
+START_TEST(test_analog_to_double)
+{
+	int ret;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int32_t in[3];
+	double dout[3];
+	float fout[3];
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	meaning.channels = g_slist_append(NULL, &ch);
+	analog.num_samples = ARRAY_SIZE(in);
+	analog.data = &in[0];
+	encoding.unitsize = sizeof(in[0]);
+	encoding.is_float = FALSE;
+	encoding.is_signed = TRUE;
+
+	/* Values beyond single precision's 24 bits of mantissa. */
+	in[0] = 16777217;
+	in[1] = -16777219;
+	in[2] = 0;
+	ret = sr_analog_to_double(&analog, &dout[0]);
+	fail_unless(ret == SR_OK, "sr_analog_to_double() failed: %d.", ret);
+	fail_unless(dout[0] == 16777217.0, "%f != 16777217", dout[0]);
+	fail_unless(dout[1] == -16777219.0, "%f != -16777219", dout[1]);
+	fail_unless(dout[2] == 0.0, "%f != 0", dout[2]);
+
+	/* Scale and offset, the float result must match. */
+	encoding.scale.p = 1;
+	encoding.scale.q = 1000;
+	encoding.offset.p = 5;
+	ret = sr_analog_to_double(&analog, &dout[0]);
+	fail_unless(ret == SR_OK, "sr_analog_to_double() failed: %d.", ret);
+	ret = sr_analog_to_float(&analog, &fout[0]);
+	fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.", ret);
+	fail_unless(fabs(dout[0] - 16782.217) < 1e-9, "%f != 16782.217",
+		dout[0]);
+	fail_unless(fout[0] == (float)dout[0], "%f != %f", fout[0], dout[0]);
+
+	/* Unsupported unit size. */
+	encoding.unitsize = 3;
+	ret = sr_analog_to_double(&analog, &dout[0]);
+	fail_unless(ret == SR_ERR, "sr_analog_to_double() passed");
+
+	ret = sr_analog_to_double(NULL, &dout[0]);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_analog_to_double(&analog, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+/*
+ * Micro-benchmark for the analog conversion. Checks the result of
+ * a large conversion. The throughput gets printed when the environment
+ * variable SR_TEST_BENCH is set.
+ */
+START_TEST(test_analog_to_float_bench)
+{
+	static const struct {
+		const char *desc;
+		size_t unit;
+		int is_fp, is_sign, is_be;
+	} *item, items[] = {
+		{ "u8", 1, FALSE, FALSE, FALSE, },
+		{ "i16le", 2, FALSE, TRUE, FALSE, },
+		{ "i16be", 2, FALSE, TRUE, TRUE, },
+		{ "i32le", 4, FALSE, TRUE, FALSE, },
+		{ "f32le", 4, TRUE, FALSE, FALSE, },
+		{ "f32be", 4, TRUE, FALSE, TRUE, },
+	};
+	const size_t num_samples = 1024 * 1024;
+	const int rounds = 10;
+
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	size_t item_idx;
+	uint8_t *in;
+	float *out, one;
+	gint64 start, elapsed;
+	int round, ret;
+	gboolean show;
+
+	show = g_getenv("SR_TEST_BENCH") != NULL;
+	in = g_malloc0(num_samples * sizeof(double));
+	out = g_malloc(num_samples * sizeof(float));
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	meaning.channels = g_slist_append(NULL, &ch);
+	analog.num_samples = num_samples;
+	analog.data = in;
+	encoding.scale.p = 3;
+	encoding.scale.q = 2;
+	encoding.offset.p = 1;
+
+	for (item_idx = 0; item_idx < ARRAY_SIZE(items); item_idx++) {
+		item = &items[item_idx];
+		encoding.unitsize = item->unit;
+		encoding.is_float = item->is_fp;
+		encoding.is_signed = item->is_sign;
+		encoding.is_bigendian = item->is_be;
+
+		/* The last sample holds the value 2, all others are zero. */
+		memset(in, 0, num_samples * item->unit);
+		if (item->is_fp) {
+			one = 2.0;
+			memcpy(&in[(num_samples - 1) * item->unit], &one,
+				sizeof(one));
+			if (item->is_be != host_be)
+				swap_bytes(&in[(num_samples - 1) * item->unit],
+					item->unit);
+		} else if (item->is_be) {
+			in[num_samples * item->unit - 1] = 2;
+		} else {
+			in[(num_samples - 1) * item->unit] = 2;
+		}
+
+		start = g_get_monotonic_time();
+		for (round = 0; round < rounds; round++) {
+			ret = sr_analog_to_float(&analog, out);
+			fail_unless(ret == SR_OK, "%s: conversion failed: %d",
+				item->desc, ret);
+		}
+		elapsed = g_get_monotonic_time() - start;
+
+		fail_unless(out[0] == 1.0, "%s: %f != 1", item->desc, out[0]);
+		fail_unless(out[num_samples - 1] == 4.0, "%s: %f != 4",
+			item->desc, out[num_samples - 1]);
+		if (show)
+			fprintf(stderr, "analog_to_float %s: %.1f Msamples/s\n",
+				item->desc, (double)num_samples * rounds /
+				MAX(elapsed, 1));
+	}
+
+	g_slist_free(meaning.channels);
+	g_free(out);
+	g_free(in);
+}
+END_TEST
+
 START_TEST(test_analog_si_prefix)
 {
 	struct {
@@ -697,6 +846,11 @@ Suite *suite_analog(void)
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
 	tcase_add_test(tc, test_analog_to_float_conv);
+	tcase_add_test(tc, test_analog_to_double);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("analog_to_float_bench");
+	tcase_add_test(tc, test_analog_to_float_bench);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("analog_si_unit");
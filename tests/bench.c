@@ -0,0 +1,685 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark the datafeed pipeline and the file format modules.
+ *
+ * Usage: bench [samples [packet size]]
+ *
+ * All data is synthetic. Every benchmark processes the given number of
+ * samples, in packets of the given size. The results are written to
+ * stdout as a JSON document:
+ *
+ *   {
+ *     "samples": 1000000,
+ *     "packet_size": 65536,
+ *     "results": [
+ *       { "name": "analog_to_float/int16", "samples": 1000000,
+ *         "bytes": 2000000, "seconds": 0.001234,
+ *         "samples_per_sec": 810372771.5, "bytes_per_sec": ... },
+ *       ...
+ *     ]
+ *   }
+ *
+ * "bytes" is the amount of data which the benchmarked code consumed
+ * (input modules) or produced (output modules). Benchmarks which cannot
+ * run, e.g. because the demo driver is not built in, are left out and
+ * a note gets written to stderr.
+ *
+ * Output modules get 8 logic channels and ANALOG_CHANNELS analog
+ * channels, each packet of logic data is followed by one analog packet
+ * per analog channel. The text of output modules which have an input
+ * module of the same name is fed back to that input module.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+
+#define DEFAULT_SAMPLES		1000000ULL
+#define DEFAULT_PACKET		(64 * 1024)
+#define LOGIC_CHANNELS		8
+#define ANALOG_CHANNELS		2
+/* Chunk size for input modules, same as sigrok-cli uses. */
+#define INPUT_CHUNK		(4 * 1024 * 1024)
+
+struct analog_buf {
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+typedef int (*send_callback)(const struct sr_datafeed_packet *packet,
+		void *cb_data);
+
+static struct sr_context *ctx;
+static uint64_t num_samples;
+static size_t packet_size;
+static gboolean first_result = TRUE;
+
+static void report(const char *name, uint64_t samples, uint64_t bytes,
+		gint64 elapsed_us)
+{
+	double seconds;
+
+	seconds = elapsed_us / 1e6;
+	printf("%s\n    { \"name\": \"%s\", \"samples\": %" PRIu64
+		", \"bytes\": %" PRIu64 ", \"seconds\": %.6f"
+		", \"samples_per_sec\": %.1f, \"bytes_per_sec\": %.1f }",
+		first_result ? "" : ",", name, samples, bytes, seconds,
+		seconds > 0 ? samples / seconds : 0.0,
+		seconds > 0 ? bytes / seconds : 0.0);
+	first_result = FALSE;
+}
+
+static void skip(const char *name, const char *reason)
+{
+	fprintf(stderr, "Skipping %s: %s.\n", name, reason);
+}
+
+/* Logic channels toggle at different rates. */
+static void fill_logic(uint8_t *data, uint64_t snum, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		data[i] = ((snum + i) >> 4) ^ ((snum + i) >> 9);
+}
+
+/* Analog channels form slow staircases. */
+static void fill_analog(float *data, uint64_t snum, size_t count,
+		size_t ch)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		data[i] = ((snum + i) >> (6 + ch)) % 16;
+}
+
+static void analog_buf_init(struct analog_buf *buf, void *data,
+		uint64_t count, uint8_t unitsize, gboolean is_float)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->encoding.unitsize = unitsize;
+	buf->encoding.is_signed = TRUE;
+	buf->encoding.is_float = is_float;
+#ifdef WORDS_BIGENDIAN
+	buf->encoding.is_bigendian = TRUE;
+#endif
+	buf->encoding.digits = 3;
+	buf->encoding.is_digits_decimal = TRUE;
+	sr_rational_set(&buf->encoding.scale, 1, 1);
+	sr_rational_set(&buf->encoding.offset, 0, 1);
+	buf->meaning.mq = SR_MQ_VOLTAGE;
+	buf->meaning.unit = SR_UNIT_VOLT;
+	buf->spec.spec_digits = 3;
+	buf->analog.data = data;
+	buf->analog.num_samples = count;
+	buf->analog.encoding = &buf->encoding;
+	buf->analog.meaning = &buf->meaning;
+	buf->analog.spec = &buf->spec;
+}
+
+static void bench_analog(void)
+{
+	struct analog_buf buf;
+	float *fdata, *out;
+	int16_t *idata;
+	uint8_t *logic, state;
+	uint64_t snum;
+	size_t count, i;
+	gint64 start;
+
+	fdata = g_malloc(packet_size * sizeof(fdata[0]));
+	idata = g_malloc(packet_size * sizeof(idata[0]));
+	out = g_malloc(packet_size * sizeof(out[0]));
+	logic = g_malloc(packet_size);
+	fill_analog(fdata, 0, packet_size, 0);
+	for (i = 0; i < packet_size; i++)
+		idata[i] = fdata[i] * 1000;
+
+	analog_buf_init(&buf, fdata, packet_size, sizeof(fdata[0]), TRUE);
+	start = g_get_monotonic_time();
+	for (snum = 0; snum < num_samples; snum += count) {
+		count = MIN(packet_size, num_samples - snum);
+		buf.analog.num_samples = count;
+		sr_analog_to_float(&buf.analog, out);
+	}
+	report("analog_to_float/float", num_samples,
+		num_samples * sizeof(fdata[0]), g_get_monotonic_time() - start);
+
+	analog_buf_init(&buf, idata, packet_size, sizeof(idata[0]), FALSE);
+	sr_rational_set(&buf.encoding.scale, 1, 1000);
+	start = g_get_monotonic_time();
+	for (snum = 0; snum < num_samples; snum += count) {
+		count = MIN(packet_size, num_samples - snum);
+		buf.analog.num_samples = count;
+		sr_analog_to_float(&buf.analog, out);
+	}
+	report("analog_to_float/int16", num_samples,
+		num_samples * sizeof(idata[0]), g_get_monotonic_time() - start);
+
+	analog_buf_init(&buf, fdata, packet_size, sizeof(fdata[0]), TRUE);
+	start = g_get_monotonic_time();
+	for (snum = 0; snum < num_samples; snum += count) {
+		count = MIN(packet_size, num_samples - snum);
+		sr_a2l_threshold(&buf.analog, 7.5, logic, count);
+	}
+	report("a2l_threshold", num_samples,
+		num_samples * sizeof(fdata[0]), g_get_monotonic_time() - start);
+
+	state = 0;
+	start = g_get_monotonic_time();
+	for (snum = 0; snum < num_samples; snum += count) {
+		count = MIN(packet_size, num_samples - snum);
+		sr_a2l_schmitt_trigger(&buf.analog, 5.0, 10.0, &state,
+			logic, count);
+	}
+	report("a2l_schmitt_trigger", num_samples,
+		num_samples * sizeof(fdata[0]), g_get_monotonic_time() - start);
+
+	g_free(fdata);
+	g_free(idata);
+	g_free(out);
+	g_free(logic);
+}
+
+/*
+ * Create a user device with logic and analog channels, which output
+ * modules get their data from.
+ */
+static struct sr_dev_inst *user_dev_new(GSList **analog_channels)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GSList *l;
+	char name[16];
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < LOGIC_CHANNELS + ANALOG_CHANNELS; i++) {
+		snprintf(name, sizeof(name), "%c%d",
+			i < LOGIC_CHANNELS ? 'D' : 'A', i);
+		sr_dev_inst_channel_add(sdi, i, i < LOGIC_CHANNELS ?
+			SR_CHANNEL_LOGIC : SR_CHANNEL_ANALOG, name);
+	}
+	*analog_channels = NULL;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_ANALOG)
+			*analog_channels = g_slist_append(*analog_channels, ch);
+	}
+
+	return sdi;
+}
+
+/* Send a complete acquisition's worth of mixed signal packets. */
+static int send_acquisition(GSList *analog_channels, send_callback cb,
+		void *cb_data)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct analog_buf buf;
+	struct sr_config src;
+	GSList *l;
+	uint8_t *logic_data;
+	float *analog_data;
+	uint64_t snum;
+	size_t count, ch;
+	int ret;
+
+	logic_data = g_malloc(packet_size);
+	analog_data = g_malloc(packet_size * sizeof(analog_data[0]));
+	analog_buf_init(&buf, analog_data, 0, sizeof(analog_data[0]), TRUE);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = cb(&packet, cb_data);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	for (snum = 0; ret == SR_OK && snum < num_samples; snum += count) {
+		count = MIN(packet_size, num_samples - snum);
+
+		fill_logic(logic_data, snum, count);
+		logic.length = count;
+		logic.unitsize = 1;
+		logic.data = logic_data;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		ret = cb(&packet, cb_data);
+
+		ch = 0;
+		for (l = analog_channels; ret == SR_OK && l; l = l->next, ch++) {
+			fill_analog(analog_data, snum, count, ch);
+			buf.meaning.channels = g_slist_append(NULL, l->data);
+			buf.analog.num_samples = count;
+			packet.type = SR_DF_ANALOG;
+			packet.payload = &buf.analog;
+			ret = cb(&packet, cb_data);
+			g_slist_free(buf.meaning.channels);
+		}
+	}
+
+	if (ret == SR_OK) {
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		ret = cb(&packet, cb_data);
+	}
+
+	g_free(logic_data);
+	g_free(analog_data);
+
+	return ret;
+}
+
+struct output_run {
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	GString *text;
+	uint64_t text_size;
+};
+
+static int collect_text(const void *data, size_t length, void *cb_data)
+{
+	struct output_run *run;
+
+	run = cb_data;
+	run->text_size += length;
+	if (run->text)
+		g_string_append_len(run->text, data, length);
+
+	return SR_OK;
+}
+
+static int output_sink_send(const struct sr_datafeed_packet *packet,
+		void *cb_data)
+{
+	struct output_run *run;
+
+	run = cb_data;
+
+	return sr_output_send_sink(run->o, packet, run->sink);
+}
+
+static int output_send(const struct sr_datafeed_packet *packet,
+		void *cb_data)
+{
+	GString *out;
+	int ret;
+
+	out = NULL;
+	ret = sr_output_send(cb_data, packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+
+	return ret;
+}
+
+static void count_datafeed(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	uint64_t *bytes;
+
+	(void)sdi;
+
+	bytes = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		*bytes += logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		*bytes += analog->num_samples * analog->encoding->unitsize;
+		break;
+	default:
+		break;
+	}
+}
+
+static void bench_input(const char *id, const GString *text)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	GString *chunk;
+	uint64_t bytes;
+	size_t off, len;
+	gint64 start;
+	char *name;
+	int ret;
+
+	name = g_strdup_printf("input/%s", id);
+	in = sr_input_new(sr_input_find(id), NULL);
+	if (!in) {
+		skip(name, "cannot create input instance");
+		g_free(name);
+		return;
+	}
+	bytes = 0;
+	sr_session_new(ctx, &session);
+	sr_session_datafeed_callback_add(session, count_datafeed, &bytes);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+
+	chunk = g_string_sized_new(INPUT_CHUNK);
+	ret = SR_OK;
+	start = g_get_monotonic_time();
+	for (off = 0; ret == SR_OK && off < text->len; off += len) {
+		len = MIN(INPUT_CHUNK, text->len - off);
+		g_string_truncate(chunk, 0);
+		g_string_append_len(chunk, text->str + off, len);
+		ret = sr_input_send(in, chunk);
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+	if (ret == SR_OK)
+		report(name, num_samples, text->len,
+			g_get_monotonic_time() - start);
+	else
+		skip(name, "input module failed");
+
+	g_string_free(chunk, TRUE);
+	sr_session_destroy(session);
+	sr_input_free(in);
+	g_free(name);
+}
+
+static void bench_outputs(const struct sr_dev_inst *sdi,
+		GSList *analog_channels)
+{
+	const struct sr_output_module **omods, *omod;
+	struct output_run run;
+	const char *id;
+	gint64 start;
+	char *name;
+	int i, ret;
+
+	omods = sr_output_list();
+	for (i = 0; omods && omods[i]; i++) {
+		omod = omods[i];
+		/* Modules which write files themselves are done separately. */
+		if (sr_output_test_flag(omod, SR_OUTPUT_INTERNAL_IO_HANDLING))
+			continue;
+		id = sr_output_id_get(omod);
+		name = g_strdup_printf("output/%s", id);
+
+		run.o = sr_output_new(omod, NULL, sdi, NULL);
+		if (!run.o) {
+			skip(name, "cannot create output instance");
+			g_free(name);
+			continue;
+		}
+		run.text = sr_input_find(id) ? g_string_new(NULL) : NULL;
+		run.text_size = 0;
+		run.sink = sr_output_sink_new_callback(collect_text, &run, 0);
+
+		start = g_get_monotonic_time();
+		ret = send_acquisition(analog_channels, output_sink_send, &run);
+		if (ret == SR_OK)
+			ret = sr_output_sink_flush(run.sink);
+		if (ret == SR_OK)
+			report(name, num_samples, run.text_size,
+				g_get_monotonic_time() - start);
+		else
+			skip(name, "output module failed");
+
+		sr_output_sink_free(run.sink);
+		sr_output_free(run.o);
+		if (ret == SR_OK && run.text)
+			bench_input(id, run.text);
+		if (run.text)
+			g_string_free(run.text, TRUE);
+		g_free(name);
+	}
+}
+
+static void bench_srzip(const struct sr_dev_inst *sdi,
+		GSList *analog_channels)
+{
+	const struct sr_output_module *omod;
+	const struct sr_output *o;
+	struct sr_session *session;
+	GStatBuf st;
+	uint64_t bytes;
+	gint64 start;
+	char *filename;
+	int fd, ret;
+
+	omod = sr_output_find("srzip");
+	if (!omod) {
+		skip("srzip", "module not available");
+		return;
+	}
+	fd = g_file_open_tmp("sigrok-bench-XXXXXX.sr", &filename, NULL);
+	if (fd < 0) {
+		skip("srzip", "cannot create temporary file");
+		return;
+	}
+	close(fd);
+	g_unlink(filename);
+
+	start = g_get_monotonic_time();
+	o = sr_output_new(omod, NULL, sdi, filename);
+	ret = o ? send_acquisition(analog_channels, output_send,
+		(void *)o) : SR_ERR;
+	if (o)
+		sr_output_free(o);
+	if (ret == SR_OK && g_stat(filename, &st) == 0) {
+		report("srzip/save", num_samples, st.st_size,
+			g_get_monotonic_time() - start);
+	} else {
+		skip("srzip/save", "output module failed");
+		ret = SR_ERR;
+	}
+
+	if (ret == SR_OK) {
+		bytes = 0;
+		start = g_get_monotonic_time();
+		ret = sr_session_load(ctx, filename, &session);
+		if (ret == SR_OK) {
+			sr_session_datafeed_callback_add(session,
+				count_datafeed, &bytes);
+			ret = sr_session_start(session);
+			if (ret == SR_OK)
+				ret = sr_session_run(session);
+			sr_session_destroy(session);
+		}
+		if (ret == SR_OK)
+			report("srzip/load", num_samples, bytes,
+				g_get_monotonic_time() - start);
+		else
+			skip("srzip/load", "cannot load session file");
+	}
+
+	g_unlink(filename);
+	g_free(filename);
+}
+
+/* Run the demo driver in its max-throughput test mode. */
+static int demo_run(struct sr_dev_inst *sdi, unsigned int callbacks,
+		struct sr_trigger *trigger, uint64_t *bytes, gint64 *elapsed)
+{
+	struct sr_session *session;
+	unsigned int i;
+	gint64 start;
+	int ret;
+
+	*bytes = 0;
+	sr_session_new(ctx, &session);
+	sr_session_dev_add(session, sdi);
+	for (i = 0; i < callbacks; i++)
+		sr_session_datafeed_callback_add(session, count_datafeed, bytes);
+	if (trigger)
+		sr_session_trigger_set(session, trigger);
+
+	start = g_get_monotonic_time();
+	ret = sr_session_start(session);
+	if (ret == SR_OK)
+		ret = sr_session_run(session);
+	*elapsed = g_get_monotonic_time() - start;
+
+	sr_session_destroy(session);
+
+	return ret;
+}
+
+static struct sr_dev_inst *demo_dev_new(void)
+{
+	struct sr_dev_driver **drivers, *demo;
+	struct sr_dev_inst *sdi;
+	struct sr_config src[2];
+	GSList *options, *devices;
+	int i;
+
+	demo = NULL;
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			demo = drivers[i];
+	}
+	if (!demo || sr_driver_init(ctx, demo) != SR_OK)
+		return NULL;
+
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_new_int32(LOGIC_CHANNELS);
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_new_int32(0);
+	options = g_slist_append(g_slist_append(NULL, &src[0]), &src[1]);
+	devices = sr_driver_scan(demo, options);
+	g_slist_free(options);
+	g_variant_unref(g_variant_ref_sink(src[0].data));
+	g_variant_unref(g_variant_ref_sink(src[1].data));
+	if (!devices)
+		return NULL;
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	if (sr_dev_open(sdi) != SR_OK)
+		return NULL;
+	if (sr_config_set(sdi, NULL, SR_CONF_TEST_MODE,
+			g_variant_new_string("max-throughput")) != SR_OK ||
+			sr_config_set(sdi, NULL, SR_CONF_BUFFERSIZE,
+			g_variant_new_uint64(packet_size)) != SR_OK ||
+			sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(num_samples)) != SR_OK) {
+		sr_dev_close(sdi);
+		return NULL;
+	}
+
+	return sdi;
+}
+
+static void bench_session(void)
+{
+	static const unsigned int fanout[] = { 1, 4, 16 };
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct sr_channel_group *cg;
+	struct sr_channel *ch;
+	GSList *l;
+	uint64_t bytes;
+	gint64 elapsed;
+	unsigned int i;
+	char name[32];
+
+	sdi = demo_dev_new();
+	if (!sdi) {
+		skip("session", "demo driver not available");
+		return;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(fanout); i++) {
+		snprintf(name, sizeof(name), "session_send/%u", fanout[i]);
+		if (demo_run(sdi, fanout[i], NULL, &bytes, &elapsed) == SR_OK)
+			report(name, num_samples, bytes / fanout[i], elapsed);
+		else
+			skip(name, "acquisition failed");
+	}
+
+	/*
+	 * A trigger on data which never matches, so that all samples
+	 * run through the soft trigger and none get sent.
+	 */
+	cg = NULL;
+	for (l = sr_dev_inst_channel_groups_get(sdi); l; l = l->next) {
+		if (!strcmp(((struct sr_channel_group *)l->data)->name, "Logic"))
+			cg = l->data;
+	}
+	ch = sr_dev_inst_channels_get(sdi)->data;
+	if (cg && sr_config_set(sdi, cg, SR_CONF_PATTERN_MODE,
+			g_variant_new_string("all-low")) == SR_OK) {
+		trigger = sr_trigger_new(NULL);
+		sr_trigger_match_add(sr_trigger_stage_add(trigger), ch,
+			SR_TRIGGER_ONE, 0);
+		if (demo_run(sdi, 1, trigger, &bytes, &elapsed) == SR_OK)
+			report("soft_trigger", num_samples,
+				num_samples * ((LOGIC_CHANNELS + 7) / 8),
+				elapsed);
+		else
+			skip("soft_trigger", "acquisition failed");
+		sr_trigger_free(trigger);
+	} else {
+		skip("soft_trigger", "cannot set pattern");
+	}
+
+	sr_dev_close(sdi);
+}
+
+int main(int argc, char **argv)
+{
+	struct sr_dev_inst *sdi;
+	GSList *analog_channels;
+
+	num_samples = argc > 1 ? strtoull(argv[1], NULL, 0) : DEFAULT_SAMPLES;
+	packet_size = argc > 2 ? strtoul(argv[2], NULL, 0) : DEFAULT_PACKET;
+	if (!num_samples || !packet_size) {
+		fprintf(stderr, "Invalid arguments.\n");
+		return 1;
+	}
+
+	if (sr_init(&ctx) != SR_OK)
+		return 1;
+
+	printf("{\n  \"samples\": %" PRIu64 ",\n  \"packet_size\": %zu,\n"
+		"  \"results\": [", num_samples, packet_size);
+
+	sdi = user_dev_new(&analog_channels);
+
+	bench_analog();
+	bench_outputs(sdi, analog_channels);
+	bench_srzip(sdi, analog_channels);
+	bench_session();
+
+	printf("\n  ]\n}\n");
+
+	g_slist_free(analog_channels);
+	sr_exit(ctx);
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark the VCD output module with mixed logic and analog data.
+ *
+ * Usage: bench_vcd [samples [analog channels [packet size]]]
+ *
+ * Each packet of logic data is followed by one analog packet per
+ * analog channel, which is the order that most mixed signal devices
+ * use. The generated text gets passed to a sink which discards it.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+
+#define DEFAULT_SAMPLES		100000000ULL
+#define DEFAULT_ANALOG		4
+#define DEFAULT_PACKET		(64 * 1024)
+#define LOGIC_CHANNELS		8
+
+static int count_text(const void *data, size_t length, void *cb_data)
+{
+	uint64_t *text_size;
+
+	(void)data;
+
+	text_size = cb_data;
+	*text_size += length;
+
+	return SR_OK;
+}
+
+static void send_packet(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	if (sr_output_send_sink(o, packet, sink) != SR_OK) {
+		fprintf(stderr, "sr_output_send_sink() failed.\n");
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct sr_context *ctx;
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_config src;
+	GSList *analog_channels, *l;
+	uint64_t num_samples, snum, i, text_size;
+	size_t num_analog, packet_size, count, ch;
+	uint8_t *logic_data;
+	float *analog_data;
+	gint64 start, elapsed;
+	char name[16];
+
+	num_samples = argc > 1 ? strtoull(argv[1], NULL, 0) : DEFAULT_SAMPLES;
+	num_analog = argc > 2 ? strtoul(argv[2], NULL, 0) : DEFAULT_ANALOG;
+	packet_size = argc > 3 ? strtoul(argv[3], NULL, 0) : DEFAULT_PACKET;
+	if (!num_samples || !packet_size) {
+		fprintf(stderr, "Invalid arguments.\n");
+		return 1;
+	}
+
+	if (sr_init(&ctx) != SR_OK)
+		return 1;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (ch = 0; ch < LOGIC_CHANNELS + num_analog; ch++) {
+		snprintf(name, sizeof(name), "%c%zu",
+			ch < LOGIC_CHANNELS ? 'D' : 'A', ch);
+		sr_dev_inst_channel_add(sdi, ch, ch < LOGIC_CHANNELS ?
+			SR_CHANNEL_LOGIC : SR_CHANNEL_ANALOG, name);
+	}
+	analog_channels = NULL;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		if (((struct sr_channel *)l->data)->type == SR_CHANNEL_ANALOG)
+			analog_channels = g_slist_append(analog_channels, l->data);
+	}
+
+	o = sr_output_new(sr_output_find("vcd"), NULL, sdi, NULL);
+	if (!o) {
+		fprintf(stderr, "Cannot create VCD output.\n");
+		return 1;
+	}
+
+	logic_data = g_malloc(packet_size);
+	analog_data = g_malloc(packet_size * sizeof(analog_data[0]));
+
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(analog_data[0]);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 3;
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.p = 0;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	memset(&spec, 0, sizeof(spec));
+	spec.spec_digits = 3;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+
+	text_size = 0;
+	sink = sr_output_sink_new_callback(count_text, &text_size, 0);
+	start = g_get_monotonic_time();
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(100)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	send_packet(o, &packet, sink);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	for (snum = 0; snum < num_samples; snum += count) {
+		count = MIN(packet_size, num_samples - snum);
+
+		/* Logic channels toggle at different rates. */
+		for (i = 0; i < count; i++)
+			logic_data[i] = ((snum + i) >> 4) ^ ((snum + i) >> 9);
+		logic.length = count;
+		logic.unitsize = 1;
+		logic.data = logic_data;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		send_packet(o, &packet, sink);
+
+		/* Analog channels form slow staircases. */
+		ch = 0;
+		for (l = analog_channels; l; l = l->next, ch++) {
+			for (i = 0; i < count; i++)
+				analog_data[i] = ((snum + i) >> (6 + ch)) % 16;
+			meaning.channels = g_slist_append(NULL, l->data);
+			analog.data = analog_data;
+			analog.num_samples = count;
+			packet.type = SR_DF_ANALOG;
+			packet.payload = &analog;
+			send_packet(o, &packet, sink);
+			g_slist_free(meaning.channels);
+		}
+	}
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	send_packet(o, &packet, sink);
+	sr_output_sink_flush(sink);
+	elapsed = g_get_monotonic_time() - start;
+
+	printf("vcd: %" PRIu64 " samples, %zu analog channels, "
+		"%" PRIu64 " bytes of text in %.3f s, %.1f Msamples/s\n",
+		num_samples, num_analog, text_size, elapsed / 1e6,
+		elapsed ? (double)num_samples / elapsed : 0.0);
+
+	sr_output_sink_free(sink);
+	sr_output_free(o);
+	g_slist_free(analog_channels);
+	g_free(logic_data);
+	g_free(analog_data);
+	sr_exit(ctx);
+
+	return 0;
+}
@@ -268,6 +268,229 @@ START_TEST(test_endian_write_inc)
 }
 END_TEST
 
+START_TEST(test_logic_rle_expand)
+{
+	uint8_t values[] = { 0x01, 0x00, 0x02, 0x00, 0xff, 0x80, };
+	uint64_t lengths[] = { 3, 1, 5, };
+	const uint8_t expected[] = {
+		0x01, 0x00, 0x01, 0x00, 0x01, 0x00,
+		0x02, 0x00,
+		0xff, 0x80, 0xff, 0x80, 0xff, 0x80, 0xff, 0x80, 0xff, 0x80,
+	};
+	struct sr_datafeed_logic_rle rle;
+	uint8_t buff[sizeof(expected)];
+	uint64_t run_idx, run_pos, count, total;
+
+	rle.num_runs = ARRAY_SIZE(lengths);
+	rle.num_samples = 3 + 1 + 5;
+	rle.unitsize = sizeof(uint16_t);
+	rle.values = values;
+	rle.lengths = lengths;
+
+	/* Expand everything in one go. */
+	memset(buff, 0, sizeof(buff));
+	run_idx = run_pos = 0;
+	count = sr_logic_rle_expand(&rle, &run_idx, &run_pos, buff, 100);
+	fail_unless(count == rle.num_samples);
+	fail_unless(memcmp(buff, expected, sizeof(expected)) == 0);
+	count = sr_logic_rle_expand(&rle, &run_idx, &run_pos, buff, 100);
+	fail_unless(count == 0);
+
+	/* Expand in chunks which don't align with run boundaries. */
+	memset(buff, 0, sizeof(buff));
+	run_idx = run_pos = 0;
+	total = 0;
+	do {
+		count = sr_logic_rle_expand(&rle, &run_idx, &run_pos,
+			&buff[total * rle.unitsize], 2);
+		fail_unless(count <= 2);
+		total += count;
+	} while (count);
+	fail_unless(total == rle.num_samples);
+	fail_unless(memcmp(buff, expected, sizeof(expected)) == 0);
+}
+END_TEST
+
+/* A small random number generator, so that failures can be reproduced. */
+static uint32_t bitplanes_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 8;
+}
+
+/* Convert bit planes to samples one bit at a time. */
+static void bitplanes_reference(size_t plane_size, gboolean msb_first,
+		uint32_t channel_mask, size_t unitsize, uint8_t *dst,
+		const uint8_t *src, size_t block_count)
+{
+	size_t block_samples, bit, byte, k, idx;
+	uint64_t word;
+	uint8_t *sample;
+
+	block_samples = 8 * plane_size;
+	memset(dst, 0, block_count * block_samples * unitsize);
+	while (block_count--) {
+		for (bit = 0; bit < 32; bit++) {
+			if (!(channel_mask & (UINT32_C(1) << bit)))
+				continue;
+			word = 0;
+			for (byte = 0; byte < plane_size; byte++)
+				word |= (uint64_t)src[byte] << (8 * byte);
+			src += plane_size;
+			for (k = 0; k < block_samples; k++) {
+				idx = msb_first ? block_samples - 1 - k : k;
+				if (!(word & (UINT64_C(1) << idx)))
+					continue;
+				sample = dst + k * unitsize;
+				sample[bit / 8] |= 1 << (bit % 8);
+			}
+		}
+		dst += block_samples * unitsize;
+	}
+}
+
+static const uint32_t bitplanes_masks[] = {
+	0x1, 0x80, 0x81, 0x5a, 0xff,
+	0x100, 0x8001, 0x1234, 0xfffe, 0xffff,
+	0x10000, 0x80000001, 0x00f00f00, 0x12345678, 0xffffffff,
+};
+
+/* Convert up to five complete blocks of one layout, compare. */
+static void bitplanes_check_blocks(size_t plane_size, gboolean msb_first,
+		uint32_t mask, size_t unitsize, uint32_t *rnd)
+{
+	struct sr_bitplanes bp;
+	uint8_t src[5 * 32 * 8], dst[5 * 64 * 4 + 1], expected[5 * 64 * 4];
+	size_t i, blocks, length;
+
+	if (unitsize < 4 && mask >> (8 * unitsize)) {
+		fail_unless(sr_bitplanes_init(&bp, plane_size, msb_first,
+			mask, unitsize) == SR_ERR_ARG);
+		return;
+	}
+	fail_unless(sr_bitplanes_init(&bp, plane_size, msb_first, mask,
+		unitsize) == SR_OK);
+
+	for (blocks = 1; blocks <= 5; blocks++) {
+		length = blocks * bp.block_size;
+		for (i = 0; i < length; i++)
+			src[i] = bitplanes_rand(rnd);
+		memset(dst, 0xaa, sizeof(dst));
+		sr_bitplanes_to_samples(&bp, dst, src, blocks);
+		bitplanes_reference(plane_size, msb_first, mask, unitsize,
+			expected, src, blocks);
+		length = blocks * bp.block_samples * unitsize;
+		fail_unless(!memcmp(dst, expected, length),
+			"Plane size %zu, unitsize %zu, mask 0x%08x, "
+			"msb_first %d: wrong samples.", plane_size, unitsize,
+			mask, msb_first);
+		/* Nothing gets written beyond the samples. */
+		fail_unless(dst[length] == 0xaa);
+	}
+}
+
+/*
+ * Check the conversion of complete blocks against the bit by bit
+ * conversion, for all layouts: plane sizes of 2, 4 and 8 bytes, in
+ * both bit orders, for one to all channels of samples of 1, 2 and 4
+ * bytes. Block counts cover pairs of tiles and single tiles.
+ */
+START_TEST(test_bitplanes_to_samples)
+{
+	const size_t plane_sizes[] = { 2, 4, 8 };
+	const size_t unitsizes[] = { 1, 2, 4 };
+	size_t p, u, m;
+	uint32_t rnd;
+
+	rnd = 1;
+	for (p = 0; p < ARRAY_SIZE(plane_sizes); p++) {
+		for (u = 0; u < ARRAY_SIZE(unitsizes); u++) {
+			for (m = 0; m < ARRAY_SIZE(bitplanes_masks); m++) {
+				bitplanes_check_blocks(plane_sizes[p], FALSE,
+					bitplanes_masks[m], unitsizes[u], &rnd);
+				bitplanes_check_blocks(plane_sizes[p], TRUE,
+					bitplanes_masks[m], unitsizes[u], &rnd);
+			}
+		}
+	}
+}
+END_TEST
+
+/*
+ * Convert a stream which arrives in pieces of random size, which split
+ * blocks and plane words, into destinations of random capacity.
+ */
+static void bitplanes_check_stream(size_t plane_size, gboolean msb_first,
+		uint32_t mask, size_t unitsize, uint32_t *rnd)
+{
+	const size_t block_count = 40;
+	struct sr_bitplanes bp;
+	uint8_t *src, *dst, *expected;
+	size_t pos, length, piece, consumed, space, samples, total;
+
+	fail_unless(sr_bitplanes_init(&bp, plane_size, msb_first, mask,
+		unitsize) == SR_OK);
+	length = block_count * bp.block_size;
+	src = g_malloc(length);
+	dst = g_malloc(block_count * bp.block_samples * unitsize);
+	expected = g_malloc(block_count * bp.block_samples * unitsize);
+	for (pos = 0; pos < length; pos++)
+		src[pos] = bitplanes_rand(rnd);
+	bitplanes_reference(plane_size, msb_first, mask, unitsize,
+		expected, src, block_count);
+
+	/* Leftovers of an earlier stream get discarded. */
+	fail_unless(sr_bitplanes_convert(&bp, dst, bp.block_samples,
+		src, 1, &samples) == 1 && !samples);
+	sr_bitplanes_reset(&bp);
+
+	pos = 0;
+	total = 0;
+	while (pos < length) {
+		piece = 1 + bitplanes_rand(rnd) % (3 * bp.block_size);
+		piece = MIN(piece, length - pos);
+		space = bp.block_samples * (1 + bitplanes_rand(rnd) % 4);
+		space = MIN(space, block_count * bp.block_samples - total);
+		consumed = sr_bitplanes_convert(&bp, dst + total * unitsize,
+			space, src + pos, piece, &samples);
+		fail_unless(consumed > 0 && consumed <= piece);
+		fail_unless(samples <= space &&
+			samples % bp.block_samples == 0);
+		pos += consumed;
+		total += samples;
+	}
+	fail_unless(total == block_count * bp.block_samples,
+		"Got %zu samples.", total);
+	fail_unless(!memcmp(dst, expected, total * unitsize),
+		"Plane size %zu, mask 0x%08x: wrong samples.",
+		plane_size, mask);
+
+	g_free(src);
+	g_free(dst);
+	g_free(expected);
+}
+
+START_TEST(test_bitplanes_convert)
+{
+	const size_t plane_sizes[] = { 2, 4, 8 };
+	size_t p, run;
+	uint32_t rnd;
+
+	rnd = 1;
+	for (p = 0; p < ARRAY_SIZE(plane_sizes); p++) {
+		for (run = 0; run < 4; run++) {
+			bitplanes_check_stream(plane_sizes[p], run % 2,
+				0x5a, 1, &rnd);
+			bitplanes_check_stream(plane_sizes[p], run % 2,
+				0x8001, 2, &rnd);
+			bitplanes_check_stream(plane_sizes[p], run % 2,
+				0x00f00f00, 4, &rnd);
+		}
+	}
+}
+END_TEST
+
 Suite *suite_conv(void)
 {
 	Suite *s;
@@ -284,5 +507,14 @@ Suite *suite_conv(void)
 	tcase_add_test(tc, test_endian_write_inc);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("logic_rle");
+	tcase_add_test(tc, test_logic_rle_expand);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("bitplanes");
+	tcase_add_test(tc, test_bitplanes_to_samples);
+	tcase_add_test(tc, test_bitplanes_convert);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
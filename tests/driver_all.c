@@ -17,9 +17,20 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _XOPEN_SOURCE 700
+
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(HAVE_HW_OPENBENCH_LOGIC_SNIFFER) && !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -59,6 +70,826 @@ START_TEST(test_config_get_set_samplerate)
 END_TEST
 #endif
 
+#ifdef HAVE_HW_BAYLIBRE_ACME
+struct acme_state {
+	uint64_t frames;
+	uint64_t values;
+	uint64_t untimed_values;
+	gboolean mismatch;
+	gboolean end_seen;
+};
+
+static void acme_write(const char *root, const char *name,
+		const char *contents, gssize length)
+{
+	char *path, *dir;
+
+	path = g_build_filename(root, name, NULL);
+	dir = g_path_get_dirname(path);
+	fail_unless(g_mkdir_with_parents(dir, 0755) == 0,
+		"Cannot create %s.", dir);
+	fail_unless(g_file_set_contents(path, contents, length, NULL),
+		"Cannot write %s.", path);
+	g_free(dir);
+	g_free(path);
+}
+
+/*
+ * Build a sysfs tree with one revision B energy probe on the first
+ * connector. Its EEPROM has no power switch, no GPIOs get touched.
+ */
+static char *acme_sysfs_create(void)
+{
+	char eeprom[61], *root, *path;
+
+	root = g_dir_make_tmp("sr-test-acme-XXXXXX", NULL);
+	fail_unless(root != NULL, "Cannot create temporary directory.");
+
+	acme_write(root, "class/i2c-adapter/i2c-1/1-0040/name", "ina226\n", -1);
+	path = g_build_filename(root,
+		"class/i2c-adapter/i2c-1/1-0040/hwmon/hwmon0", NULL);
+	fail_unless(g_mkdir_with_parents(path, 0755) == 0,
+		"Cannot create %s.", path);
+	g_free(path);
+
+	memset(eeprom, 0, sizeof(eeprom));
+	eeprom[3] = 1; /* USB probe */
+	eeprom[7] = 'B';
+	acme_write(root, "class/i2c-dev/i2c-1/device/1-0050/eeprom",
+		eeprom, sizeof(eeprom));
+
+	acme_write(root, "class/hwmon/hwmon0/power1_input", "1500000\n", -1);
+	acme_write(root, "class/hwmon/hwmon0/curr1_input", "250\n", -1);
+	acme_write(root, "class/hwmon/hwmon0/in1_input", "5000\n", -1);
+
+	return root;
+}
+
+static void acme_sysfs_remove(const char *path)
+{
+	const char *name;
+	char *child;
+	GDir *dir;
+
+	dir = g_dir_open(path, 0, NULL);
+	if (dir) {
+		while ((name = g_dir_read_name(dir))) {
+			child = g_build_filename(path, name, NULL);
+			acme_sysfs_remove(child);
+			g_free(child);
+		}
+		g_dir_close(dir);
+	}
+	g_remove(path);
+}
+
+static void acme_check_value(struct acme_state *state,
+		const struct sr_datafeed_analog *analog)
+{
+	float value;
+
+	value = *(const float *)analog->data;
+	switch (analog->meaning->mq) {
+	case SR_MQ_POWER:
+		state->mismatch |= value != 1.5f;
+		break;
+	case SR_MQ_CURRENT:
+		state->mismatch |= value != 0.25f;
+		break;
+	case SR_MQ_VOLTAGE:
+		state->mismatch |= value != 5.0f;
+		break;
+	default:
+		state->mismatch = TRUE;
+		break;
+	}
+}
+
+static void acme_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct acme_state *state;
+	const struct sr_datafeed_analog_timed *timed;
+	const struct sr_datafeed_analog *analog;
+
+	(void)sdi;
+
+	state = cb_data;
+	switch (packet->type) {
+	case SR_DF_FRAME_BEGIN:
+		state->frames++;
+		break;
+	case SR_DF_ANALOG_TIMED:
+		timed = packet->payload;
+		if (timed->analog.num_samples != 1 || !timed->timestamps[0]) {
+			state->mismatch = TRUE;
+			break;
+		}
+		acme_check_value(state, &timed->analog);
+		state->values++;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (analog->num_samples != 1) {
+			state->mismatch = TRUE;
+			break;
+		}
+		acme_check_value(state, analog);
+		state->untimed_values++;
+		break;
+	case SR_DF_END:
+		state->end_seen = TRUE;
+		break;
+	}
+}
+
+/*
+ * Have the BayLibre ACME driver find a probe in a fake sysfs tree,
+ * and run an acquisition of five frames.
+ */
+static void acme_run(gboolean accept_timed, struct acme_state *state)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_config src;
+	GSList *devices, *options;
+	GVariant *gvar;
+	char *root;
+	int ret;
+
+	root = acme_sysfs_create();
+	driver = srtest_driver_get("baylibre-acme");
+	srtest_driver_init(srtest_ctx, driver);
+
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_ref_sink(g_variant_new_string(root));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+	fail_unless(g_slist_length(devices) == 1, "Probe not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(g_slist_length(sr_dev_inst_channels_get(sdi)) == 3,
+		"Unexpected channel count.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_analog_timed_set(session, accept_timed);
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_session_dev_add(session, sdi);
+	ret = sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(SR_HZ(100)));
+	fail_unless(ret == SR_OK, "Cannot set samplerate: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(5));
+	fail_unless(ret == SR_OK, "Cannot set sample limit: %d.", ret);
+
+	memset(state, 0, sizeof(*state));
+	sr_session_datafeed_callback_add(session, acme_datafeed_cb, state);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+
+	ret = sr_config_get(driver, sdi, NULL, SR_CONF_SAMPLES_MISSED, &gvar);
+	fail_unless(ret == SR_OK, "Cannot get missed samples: %d.", ret);
+	g_variant_unref(gvar);
+
+	sr_session_destroy(session);
+	acme_sysfs_remove(root);
+	g_free(root);
+}
+
+/*
+ * Check that the BayLibre ACME driver finds a probe in a fake sysfs
+ * tree, and that an acquisition sends complete, timestamped frames.
+ */
+START_TEST(test_baylibre_acme_fake_sysfs)
+{
+	struct acme_state state;
+
+	acme_run(TRUE, &state);
+
+	fail_unless(state.end_seen, "No SR_DF_END packet.");
+	fail_unless(!state.mismatch, "Unexpected values.");
+	fail_unless(state.frames == 5, "Unexpected frame count %" PRIu64 ".",
+		state.frames);
+	fail_unless(state.values == 3 * 5, "Unexpected value count %" PRIu64 ".",
+		state.values);
+	fail_unless(state.untimed_values == 0, "Unexpected untimed values.");
+}
+END_TEST
+
+/*
+ * Check that timestamped readings reach applications which don't
+ * accept them as plain analog packets.
+ */
+START_TEST(test_baylibre_acme_untimed)
+{
+	struct acme_state state;
+
+	acme_run(FALSE, &state);
+
+	fail_unless(state.end_seen, "No SR_DF_END packet.");
+	fail_unless(!state.mismatch, "Unexpected values.");
+	fail_unless(state.values == 0, "Unexpected timestamped values.");
+	fail_unless(state.untimed_values == 3 * 5,
+		"Unexpected value count %" PRIu64 ".", state.untimed_values);
+}
+END_TEST
+#endif
+
+#if defined(HAVE_HW_OPENBENCH_LOGIC_SNIFFER) && !defined(_WIN32)
+/*
+ * A stand-in for an OLS on the master side of a pty. It answers the
+ * ID and metadata commands, records the flags and sends a prepared
+ * sample dump in random chunk sizes when the capture gets armed.
+ */
+struct ols_standin {
+	int master;
+	int slave;
+	char *port;
+	GThread *thread;
+	GRand *rand;
+	gint stop;
+	uint32_t num_probes;
+	gboolean id_seen;
+	gboolean flags_seen;
+	uint32_t flags;
+	const uint8_t *dump;
+	size_t dump_len;
+};
+
+/* Acquired samples, as the session delivers them. */
+struct ols_state {
+	GByteArray *data;
+	uint16_t unitsize;
+	gboolean mismatch;
+	gboolean end_seen;
+};
+
+static gboolean ols_standin_wait(struct ols_standin *standin, short events)
+{
+	struct pollfd pfd;
+
+	pfd.fd = standin->master;
+	pfd.events = events;
+	while (!g_atomic_int_get(&standin->stop)) {
+		if (poll(&pfd, 1, 20) > 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void ols_standin_write(struct ols_standin *standin,
+		const uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len && ols_standin_wait(standin, POLLOUT)) {
+		ret = write(standin->master, buf, len);
+		if (ret < 0 && errno != EAGAIN && errno != EINTR)
+			return;
+		if (ret > 0) {
+			buf += ret;
+			len -= ret;
+		}
+	}
+}
+
+static gboolean ols_standin_read(struct ols_standin *standin,
+		uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len && ols_standin_wait(standin, POLLIN)) {
+		ret = read(standin->master, buf, len);
+		if (ret < 0 && errno != EAGAIN && errno != EINTR)
+			g_usleep(1000);
+		if (ret > 0) {
+			buf += ret;
+			len -= ret;
+		}
+	}
+
+	return len == 0;
+}
+
+static void ols_standin_send_dump(struct ols_standin *standin)
+{
+	size_t pos, len;
+
+	for (pos = 0; pos < standin->dump_len; pos += len) {
+		len = g_rand_int_range(standin->rand, 1, 5000);
+		len = MIN(len, standin->dump_len - pos);
+		ols_standin_write(standin, standin->dump + pos, len);
+		if (g_rand_boolean(standin->rand))
+			g_usleep(1000);
+	}
+}
+
+static gpointer ols_standin_thread(gpointer data)
+{
+	struct ols_standin *standin;
+	uint8_t cmd, arg[4];
+	uint8_t metadata[] = {
+		0x01, 'S', 't', 'a', 'n', 'd', '-', 'i', 'n', 0x00,
+		0x20, 0x00, 0x00, 0x00, 0x00,
+		0x21, 0x00, 0x04, 0x00, 0x00,
+		0x23, 0x05, 0xf5, 0xe1, 0x00,
+		0x00,
+	};
+
+	standin = data;
+	metadata[14] = standin->num_probes;
+	while (ols_standin_read(standin, &cmd, 1)) {
+		if ((cmd & 0x80) && !ols_standin_read(standin, arg, 4))
+			break;
+		switch (cmd) {
+		case 0x02:
+			standin->id_seen = TRUE;
+			ols_standin_write(standin, (const uint8_t *)"1SLO", 4);
+			break;
+		case 0x04:
+			ols_standin_write(standin, metadata, sizeof(metadata));
+			break;
+		case 0x82:
+			standin->flags_seen = TRUE;
+			standin->flags = arg[0] | arg[1] << 8 |
+				arg[2] << 16 | (uint32_t)arg[3] << 24;
+			break;
+		case 0x01:
+			ols_standin_send_dump(standin);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void ols_standin_start(struct ols_standin *standin)
+{
+	struct termios tio;
+
+	standin->master = posix_openpt(O_RDWR | O_NOCTTY);
+	fail_unless(standin->master >= 0, "Cannot open a pty.");
+	fail_unless(grantpt(standin->master) == 0 &&
+		unlockpt(standin->master) == 0, "Cannot unlock the pty.");
+	standin->port = g_strdup(ptsname(standin->master));
+	fcntl(standin->master, F_SETFL,
+		fcntl(standin->master, F_GETFL) | O_NONBLOCK);
+
+	/*
+	 * Keep the slave side open all the time. Without it, reading
+	 * from the master fails while the driver has the port closed.
+	 */
+	standin->slave = open(standin->port, O_RDWR | O_NOCTTY);
+	fail_unless(standin->slave >= 0, "Cannot open %s.", standin->port);
+	fail_unless(tcgetattr(standin->slave, &tio) == 0,
+		"Cannot get the pty attributes.");
+	tio.c_iflag &= ~(BRKINT | ICRNL | INLCR | IGNCR | ISTRIP | IXON);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tcsetattr(standin->slave, TCSANOW, &tio);
+
+	standin->rand = g_rand_new_with_seed(0x0115);
+	standin->thread = g_thread_new("ols-standin", ols_standin_thread,
+		standin);
+}
+
+static void ols_standin_stop(struct ols_standin *standin)
+{
+	g_atomic_int_set(&standin->stop, 1);
+	g_thread_join(standin->thread);
+	g_rand_free(standin->rand);
+	close(standin->slave);
+	close(standin->master);
+	g_free(standin->port);
+}
+
+/*
+ * Make up a capture of limit samples, and the dump an OLS sends for
+ * it: the last sample first, with the bytes of the enabled channel
+ * groups only. In RLE mode the high bit of the last byte marks a
+ * count, and a count of n makes the following sample repeat n + 1
+ * times. The last run may overshoot the limit.
+ */
+static GByteArray *ols_dump_create(GRand *rand, unsigned int groups,
+		gboolean rle, size_t unitsize, size_t limit, uint8_t *expected)
+{
+	GByteArray *dump;
+	uint8_t raw[4], sample[4], byte;
+	size_t num_groups, last, num_samples, k, run, max_run, i, n;
+	uint32_t value, count;
+
+	num_groups = last = 0;
+	for (i = 0; i < 4; i++) {
+		if (groups & (1 << i)) {
+			num_groups++;
+			last = i;
+		}
+	}
+	max_run = num_groups == 1 ? 0x80 : 5000;
+	num_samples = rle ? limit : (limit + 3) / 4 * 4;
+
+	dump = g_byte_array_new();
+	for (k = 0; k < num_samples; k += run) {
+		value = g_rand_int(rand);
+		for (i = n = 0; i < 4; i++) {
+			sample[i] = groups & (1 << i) ? value >> (i * 8) : 0;
+			if (groups & (1 << i))
+				raw[n++] = sample[i];
+		}
+		run = 1;
+		if (rle) {
+			raw[num_groups - 1] &= 0x7f;
+			sample[last] &= 0x7f;
+			if (g_rand_boolean(rand))
+				run = g_rand_int_range(rand, 1, 5);
+			else
+				run = g_rand_int_range(rand, 1, max_run + 1);
+		}
+		if (run > 1 || (rle && g_rand_boolean(rand))) {
+			count = run - 1;
+			for (i = 0; i < num_groups; i++) {
+				byte = count >> (i * 8);
+				g_byte_array_append(dump, &byte, 1);
+			}
+			dump->data[dump->len - 1] |= 0x80;
+		}
+		g_byte_array_append(dump, raw, num_groups);
+		for (i = k; i < MIN(k + run, limit); i++)
+			memcpy(expected + (limit - 1 - i) * unitsize,
+				sample, unitsize);
+	}
+
+	return dump;
+}
+
+static void ols_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct ols_state *state;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	state = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (logic->unitsize != state->unitsize)
+			state->mismatch = TRUE;
+		g_byte_array_append(state->data, logic->data, logic->length);
+		break;
+	case SR_DF_END:
+		state->end_seen = TRUE;
+		break;
+	}
+}
+
+/*
+ * Have the OLS driver find the stand-in, and acquire limit samples
+ * with the given channel groups enabled. The samples have to match
+ * the made up capture.
+ */
+static void ols_run(struct ols_standin *standin, GRand *rand,
+		uint32_t num_probes, unsigned int groups, gboolean rle,
+		size_t limit)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_channel *ch;
+	struct sr_config src;
+	struct ols_state state;
+	GSList *devices, *options, *l;
+	GByteArray *dump;
+	uint8_t *expected;
+	size_t unitsize;
+	uint32_t disabled;
+	int ret;
+
+	driver = srtest_driver_get("ols");
+	srtest_driver_init(srtest_ctx, driver);
+
+	standin->num_probes = num_probes;
+	standin->id_seen = standin->flags_seen = FALSE;
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_ref_sink(g_variant_new_string(standin->port));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+	fail_unless(standin->id_seen, "Cannot use %s as a serial port.",
+		standin->port);
+	fail_unless(g_slist_length(devices) == 1, "Stand-in not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(g_slist_length(sr_dev_inst_channels_get(sdi)) == num_probes,
+		"Unexpected channel count.");
+
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		sr_dev_channel_enable(ch, (groups >> (ch->index / 8)) & 1);
+	}
+
+	unitsize = (num_probes + 7) / 8;
+	expected = g_malloc(limit * unitsize);
+	dump = ols_dump_create(rand, groups, rle, unitsize, limit, expected);
+	standin->dump = dump->data;
+	standin->dump_len = dump->len;
+
+	sr_session_new(srtest_ctx, &session);
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_session_dev_add(session, sdi);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(limit));
+	fail_unless(ret == SR_OK, "Cannot set sample limit: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_RLE,
+		g_variant_new_boolean(rle));
+	fail_unless(ret == SR_OK, "Cannot set RLE: %d.", ret);
+
+	memset(&state, 0, sizeof(state));
+	state.data = g_byte_array_new();
+	state.unitsize = unitsize;
+	sr_session_datafeed_callback_add(session, ols_datafeed_cb, &state);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(session);
+	sr_dev_close(sdi);
+
+	disabled = (~groups & 0xf) << 2;
+	fail_unless(standin->flags_seen, "No flags were set.");
+	fail_unless((standin->flags & 0x3c) == disabled,
+		"Unexpected channel groups in flags 0x%x.", standin->flags);
+	fail_unless(!!(standin->flags & 0x100) == rle,
+		"Unexpected RLE flag in flags 0x%x.", standin->flags);
+	fail_unless(state.end_seen, "No SR_DF_END packet.");
+	fail_unless(!state.mismatch, "Unexpected unitsize.");
+	fail_unless(state.data->len == limit * unitsize,
+		"Unexpected sample count %zu.", state.data->len / unitsize);
+	fail_unless(!memcmp(state.data->data, expected, limit * unitsize),
+		"Samples differ (groups 0x%x, RLE %d).", groups, rle);
+
+	g_byte_array_free(state.data, TRUE);
+	g_byte_array_free(dump, TRUE);
+	g_free(expected);
+}
+
+/*
+ * Check the decoding of OLS sample dumps, with and without RLE, for
+ * unitsizes 1 to 4 and several channel group masks. The stand-in
+ * sends the dumps in random chunks, so samples and RLE counts get
+ * split across reads.
+ */
+START_TEST(test_ols_standin)
+{
+	static const struct {
+		uint32_t num_probes;
+		unsigned int groups;
+		gboolean rle;
+	} runs[] = {
+		{ 8, 0x1, FALSE }, { 8, 0x1, TRUE },
+		{ 16, 0x2, FALSE }, { 16, 0x3, TRUE },
+		{ 24, 0x5, FALSE }, { 24, 0x6, TRUE },
+		{ 32, 0xf, FALSE }, { 32, 0xf, TRUE },
+		{ 32, 0x9, FALSE }, { 32, 0x8, TRUE },
+	};
+	struct ols_standin standin;
+	GRand *rand;
+	size_t i;
+
+	memset(&standin, 0, sizeof(standin));
+	ols_standin_start(&standin);
+	rand = g_rand_new_with_seed(21);
+	for (i = 0; i < ARRAY_SIZE(runs); i++) {
+		ols_run(&standin, rand, runs[i].num_probes, runs[i].groups,
+			runs[i].rle, g_rand_int_range(rand, 4, 20000));
+	}
+	g_rand_free(rand);
+	ols_standin_stop(&standin);
+}
+END_TEST
+#endif
+
+#ifdef HAVE_HW_DEMO
+/* Averaged demo readings, as the session delivers them. */
+struct batch_state {
+	struct sr_dev_inst *sdi;
+	struct sr_channel_group *cg;
+	/* Number of logic packets after which the MQ flags change. */
+	uint64_t flags_switch;
+	uint64_t logic_packets;
+	GArray *sizes;
+	GArray *flags;
+	uint64_t readings;
+	int64_t last_timestamp;
+	gboolean mismatch;
+	gboolean end_seen;
+};
+
+static void batch_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct batch_state *state;
+	const struct sr_datafeed_analog_timed *timed;
+	uint64_t size, flags, i;
+	GVariant *mq;
+
+	(void)sdi;
+
+	state = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		if (++state->logic_packets != state->flags_switch)
+			break;
+		mq = g_variant_new("(ut)", (uint32_t)SR_MQ_VOLTAGE,
+			(uint64_t)SR_MQFLAG_AC);
+		if (sr_config_set(state->sdi, state->cg,
+				SR_CONF_MEASURED_QUANTITY, mq) != SR_OK)
+			state->mismatch = TRUE;
+		break;
+	case SR_DF_ANALOG:
+		state->mismatch = TRUE;
+		break;
+	case SR_DF_ANALOG_TIMED:
+		timed = packet->payload;
+		size = timed->analog.num_samples;
+		flags = timed->analog.meaning->mqflags;
+		g_array_append_val(state->sizes, size);
+		g_array_append_val(state->flags, flags);
+		for (i = 0; i < size; i++) {
+			if (timed->timestamps[i] < state->last_timestamp)
+				state->mismatch = TRUE;
+			state->last_timestamp = timed->timestamps[i];
+		}
+		state->readings += size;
+		break;
+	case SR_DF_END:
+		state->end_seen = TRUE;
+		break;
+	}
+}
+
+/*
+ * Run an acquisition with the demo driver's one analog channel in
+ * averaging mode. Every avg_samples samples make a reading, and so
+ * does the rest of the samples which the driver generates at a time.
+ * The logic channel stays enabled when the MQ flags get switched.
+ */
+static void batch_run(struct batch_state *state, uint64_t samplerate,
+		uint64_t avg_samples, uint64_t limit_samples,
+		uint64_t max_samples, uint64_t max_age_ms)
+{
+	struct sr_dev_driver *driver;
+	struct sr_session *session;
+	struct sr_config src[2];
+	struct sr_channel *ch;
+	struct sr_channel_group *cg;
+	GSList *devices, *options, *l;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_ref_sink(g_variant_new_int32(1));
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_ref_sink(g_variant_new_int32(1));
+	options = g_slist_append(NULL, &src[0]);
+	options = g_slist_append(options, &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src[0].data);
+	g_variant_unref(src[1].data);
+	fail_unless(g_slist_length(devices) == 1, "Demo device not found.");
+	state->sdi = devices->data;
+	g_slist_free(devices);
+
+	for (l = sr_dev_inst_channels_get(state->sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC && !state->flags_switch)
+			sr_dev_channel_enable(ch, FALSE);
+	}
+	for (l = sr_dev_inst_channel_groups_get(state->sdi); l; l = l->next) {
+		cg = l->data;
+		if (!strcmp(cg->name, "A0"))
+			state->cg = cg;
+	}
+	fail_unless(state->cg != NULL, "No channel group for A0.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_analog_timed_set(session, TRUE);
+	sr_session_analog_batch_set(session, max_samples, max_age_ms);
+	ret = sr_dev_open(state->sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_session_dev_add(session, state->sdi);
+	ret = sr_config_set(state->sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(samplerate));
+	fail_unless(ret == SR_OK, "Cannot set samplerate: %d.", ret);
+	ret = sr_config_set(state->sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(limit_samples));
+	fail_unless(ret == SR_OK, "Cannot set sample limit: %d.", ret);
+	ret = sr_config_set(state->sdi, NULL, SR_CONF_AVERAGING,
+		g_variant_new_boolean(TRUE));
+	fail_unless(ret == SR_OK, "Cannot enable averaging: %d.", ret);
+	ret = sr_config_set(state->sdi, NULL, SR_CONF_AVG_SAMPLES,
+		g_variant_new_uint64(avg_samples));
+	fail_unless(ret == SR_OK, "Cannot set averaging: %d.", ret);
+
+	state->sizes = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	state->flags = g_array_new(FALSE, FALSE, sizeof(uint64_t));
+	sr_session_datafeed_callback_add(session, batch_datafeed_cb, state);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(session);
+
+	fail_unless(state->end_seen, "No SR_DF_END packet.");
+	fail_unless(!state->mismatch, "Unexpected packets.");
+}
+
+static void batch_state_free(struct batch_state *state)
+{
+	g_array_free(state->sizes, TRUE);
+	g_array_free(state->flags, TRUE);
+}
+
+/* Readings get sent when enough of them were collected. */
+START_TEST(test_demo_batch_count)
+{
+	struct batch_state state;
+	static const uint64_t expected[] = { 4, 4, 2 };
+	size_t i;
+
+	memset(&state, 0, sizeof(state));
+	batch_run(&state, SR_KHZ(1), 1, 10, 4, 0);
+
+	fail_unless(state.readings == 10, "Unexpected reading count %" PRIu64 ".",
+		state.readings);
+	fail_unless(state.sizes->len == ARRAY_SIZE(expected),
+		"Unexpected packet count %u.", state.sizes->len);
+	for (i = 0; i < ARRAY_SIZE(expected); i++) {
+		fail_unless(g_array_index(state.sizes, uint64_t, i) == expected[i],
+			"Unexpected size of packet %zu.", i);
+	}
+	batch_state_free(&state);
+}
+END_TEST
+
+/*
+ * Readings get sent when they get too old, also while the device
+ * doesn't take new ones. The demo driver takes one reading every
+ * 100ms, they may be held back for 50ms. Checking the age only when
+ * new readings arrive would send them in pairs.
+ */
+START_TEST(test_demo_batch_age)
+{
+	struct batch_state state;
+	size_t i;
+
+	memset(&state, 0, sizeof(state));
+	batch_run(&state, SR_HZ(100), 1000, 50, 1000, 50);
+
+	fail_unless(state.sizes->len >= 2, "Only %u packets.", state.sizes->len);
+	for (i = 0; i < state.sizes->len; i++) {
+		fail_unless(g_array_index(state.sizes, uint64_t, i) == 1,
+			"Unexpected size of packet %zu.", i);
+	}
+	batch_state_free(&state);
+}
+END_TEST
+
+/* Readings of another format don't go into the same packet. */
+START_TEST(test_demo_batch_format)
+{
+	struct batch_state state;
+	uint64_t first, last;
+
+	memset(&state, 0, sizeof(state));
+	state.flags_switch = 2;
+	batch_run(&state, SR_HZ(100), 1, 50, 1000, 0);
+
+	fail_unless(state.readings == 50, "Unexpected reading count %" PRIu64 ".",
+		state.readings);
+	fail_unless(state.sizes->len >= 2, "Only %u packets.", state.sizes->len);
+	first = g_array_index(state.flags, uint64_t, 0);
+	last = g_array_index(state.flags, uint64_t, state.flags->len - 1);
+	fail_unless(first == SR_MQFLAG_DC, "Unexpected flags 0x%" PRIx64 ".", first);
+	fail_unless(last == SR_MQFLAG_AC, "Unexpected flags 0x%" PRIx64 ".", last);
+	batch_state_free(&state);
+}
+END_TEST
+#endif
+
 Suite *suite_driver_all(void)
 {
 	Suite *s;
@@ -74,5 +905,30 @@ Suite *suite_driver_all(void)
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
 
+#ifdef HAVE_HW_BAYLIBRE_ACME
+	tc = tcase_create("baylibre-acme");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_baylibre_acme_fake_sysfs);
+	tcase_add_test(tc, test_baylibre_acme_untimed);
+	suite_add_tcase(s, tc);
+#endif
+
+#if defined(HAVE_HW_OPENBENCH_LOGIC_SNIFFER) && !defined(_WIN32)
+	tc = tcase_create("openbench-logic-sniffer");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_ols_standin);
+	suite_add_tcase(s, tc);
+#endif
+
+#ifdef HAVE_HW_DEMO
+	tc = tcase_create("demo-batch");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_demo_batch_count);
+	tcase_add_test(tc, test_demo_batch_age);
+	tcase_add_test(tc, test_demo_batch_format);
+	suite_add_tcase(s, tc);
+#endif
+
 	return s;
 }
@@ -19,10 +19,13 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
+#define MAX_CHANNELS 256
+
 /* Check whether at least one input module is available. */
 START_TEST(test_input_available)
 {
@@ -33,6 +36,628 @@ START_TEST(test_input_available)
 }
 END_TEST
 
+/* The datafeed of an input module, as the session delivers it. */
+struct feed_state {
+	/* All packets, serialized. Only the start time is left out. */
+	GString *feed;
+	GByteArray *logic;
+	unsigned int logic_unitsize;
+	/* Analog values by channel index, double precision as sent. */
+	GArray *analog[MAX_CHANNELS];
+	GString *names;
+	uint64_t samplerate;
+	gboolean end_seen;
+};
+
+static void feed_state_init(struct feed_state *state)
+{
+	size_t i;
+
+	memset(state, 0, sizeof(*state));
+	state->feed = g_string_new(NULL);
+	state->logic = g_byte_array_new();
+	for (i = 0; i < ARRAY_SIZE(state->analog); i++)
+		state->analog[i] = g_array_new(FALSE, FALSE, sizeof(double));
+	state->names = g_string_new(NULL);
+}
+
+static void feed_state_free(struct feed_state *state)
+{
+	size_t i;
+
+	g_string_free(state->feed, TRUE);
+	g_byte_array_free(state->logic, TRUE);
+	for (i = 0; i < ARRAY_SIZE(state->analog); i++)
+		g_array_free(state->analog[i], TRUE);
+	g_string_free(state->names, TRUE);
+}
+
+static void feed_analog(struct feed_state *state,
+		const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *encoding;
+	const struct sr_analog_meaning *meaning;
+	const struct sr_channel *ch;
+	size_t num_channels, size, i;
+	const uint8_t *data;
+	double value;
+	float fvalue;
+	GSList *l;
+
+	encoding = analog->encoding;
+	meaning = analog->meaning;
+	num_channels = g_slist_length(meaning->channels);
+	g_string_append_printf(state->feed,
+		"analog %u mq %d unit %d flags %" PRIu64 " size %u float %d "
+		"signed %d be %d scale %" PRId64 "/%" PRIu64
+		" offset %" PRId64 "/%" PRIu64 " digits %d %d",
+		analog->num_samples, meaning->mq, meaning->unit,
+		(uint64_t)meaning->mqflags, encoding->unitsize,
+		encoding->is_float, encoding->is_signed,
+		encoding->is_bigendian, encoding->scale.p, encoding->scale.q,
+		encoding->offset.p, encoding->offset.q, encoding->digits,
+		analog->spec->spec_digits);
+	for (l = meaning->channels; l; l = l->next) {
+		ch = l->data;
+		g_string_append_printf(state->feed, " %s", ch->name);
+	}
+	g_string_append_c(state->feed, '\n');
+	size = analog->num_samples * num_channels * encoding->unitsize;
+	g_string_append_len(state->feed, analog->data, size);
+
+	/* Keep the values of single channel packets for inspection. */
+	fail_unless(encoding->is_float, "Analog data is not float.");
+	if (num_channels != 1)
+		return;
+	ch = meaning->channels->data;
+	fail_unless(ch->index < MAX_CHANNELS, "Too many channels.");
+	data = analog->data;
+	for (i = 0; i < analog->num_samples; i++) {
+		if (encoding->unitsize == sizeof(double)) {
+			memcpy(&value, &data[i * sizeof(value)], sizeof(value));
+		} else {
+			memcpy(&fvalue, &data[i * sizeof(fvalue)], sizeof(fvalue));
+			value = fvalue;
+		}
+		g_array_append_val(state->analog[ch->index], value);
+	}
+}
+
+static void feed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_state *state;
+	const struct sr_datafeed_header *header;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_channel *ch;
+	const struct sr_config *src;
+	char *text;
+	GSList *l;
+
+	state = cb_data;
+	fail_unless(!state->end_seen, "Packet after SR_DF_END.");
+
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		header = packet->payload;
+		for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+			ch = l->data;
+			g_string_append_printf(state->names, "%s%s:%c",
+				state->names->len ? "," : "", ch->name,
+				ch->type == SR_CHANNEL_LOGIC ? 'L' : 'A');
+		}
+		g_string_append_printf(state->feed, "header %d %s\n",
+			header->feed_version, state->names->str);
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			text = g_variant_print(src->data, TRUE);
+			g_string_append_printf(state->feed, "meta %u %s\n",
+				src->key, text);
+			g_free(text);
+			if (src->key == SR_CONF_SAMPLERATE)
+				state->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_string_append_printf(state->feed, "logic %u %" PRIu64 "\n",
+			logic->unitsize, logic->length);
+		g_string_append_len(state->feed, logic->data, logic->length);
+		g_byte_array_append(state->logic, logic->data, logic->length);
+		state->logic_unitsize = logic->unitsize;
+		break;
+	case SR_DF_ANALOG:
+		feed_analog(state, packet->payload);
+		break;
+	case SR_DF_END:
+		g_string_append(state->feed, "end\n");
+		state->end_seen = TRUE;
+		break;
+	default:
+		g_string_append_printf(state->feed, "type %u\n", packet->type);
+		break;
+	}
+}
+
+static void option_set(GHashTable *options, const char *key, GVariant *value)
+{
+	g_hash_table_insert(options, g_strdup(key), g_variant_ref_sink(value));
+}
+
+static GHashTable *options_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+}
+
+/*
+ * Have an input module process text, which gets sent in chunks of the
+ * given size. The session gets set up when the device becomes ready,
+ * like applications do.
+ */
+static void input_run(const char *id, GHashTable *options,
+		const char *text, size_t len, size_t chunk,
+		struct feed_state *state)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *buf;
+	size_t pos, count;
+	int ret;
+
+	in = sr_input_new(sr_input_find(id), options);
+	fail_unless(in != NULL, "Cannot create '%s' input.", id);
+
+	session = NULL;
+	for (pos = 0; pos < len; pos += count) {
+		count = MIN(chunk, len - pos);
+		buf = g_string_new_len(&text[pos], count);
+		ret = sr_input_send(in, buf);
+		g_string_free(buf, TRUE);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		if (session || !(sdi = sr_input_dev_inst_get(in)))
+			continue;
+		sr_session_new(srtest_ctx, &session);
+		sr_session_datafeed_callback_add(session, feed_cb, state);
+		sr_session_dev_add(session, sdi);
+	}
+	fail_unless(session != NULL, "Input device did not become ready.");
+
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(state->end_seen, "No SR_DF_END.");
+
+	sr_session_destroy(session);
+	sr_input_free(in);
+}
+
+/* Check analog values against the C library's conversion of their text. */
+static void check_analog(const GArray *values, const char **texts,
+		size_t count)
+{
+	double expected, value;
+	size_t i;
+
+	fail_unless(values->len == count, "Expected %zu values, got %u.",
+		count, values->len);
+	for (i = 0; i < count; i++) {
+		expected = g_ascii_strtod(texts[i], NULL);
+		value = g_array_index(values, double, i);
+		fail_unless(!memcmp(&value, &expected, sizeof(value)),
+			"Text %s got parsed as %.17g.", texts[i], value);
+	}
+}
+
+/*
+ * Check CSV input with comments, a multi-character column separator,
+ * and timestamp, logic and analog columns.
+ */
+START_TEST(test_input_csv_columns)
+{
+	const char *text =
+		"; Exported by some tool\n"
+		"time::bits::hex::volt::amp ; the header\n"
+		"0.001::1::a::1.5::-2\n"
+		"0.002::0::5::-0::3e-3 ; a comment\n"
+		"\n"
+		"  ; an indented comment\n"
+		"0.003::1::F::123456789012345::1e22\n";
+	const uint8_t logic[] = { 0x15, 0x0a, 0x1f };
+	const char *volt[] = { "1.5", "-0", "123456789012345" };
+	const char *amp[] = { "-2", "3e-3", "1e22" };
+	struct feed_state state;
+	GHashTable *options;
+	size_t chunk;
+
+	options = options_new();
+	option_set(options, "column_formats", g_variant_new_string("t,l,x4,2a"));
+	option_set(options, "column_separator", g_variant_new_string("::"));
+
+	/* All at once, and split into lines and words. */
+	for (chunk = strlen(text); chunk; chunk = chunk > 7 ? 7 : 0) {
+		feed_state_init(&state);
+		input_run("csv", options, text, strlen(text), chunk, &state);
+
+		fail_unless(!strcmp(state.names->str, "bits:L,hex[0]:L,"
+			"hex[1]:L,hex[2]:L,hex[3]:L,volt:A,amp:A"),
+			"Unexpected channels: %s.", state.names->str);
+		fail_unless(state.samplerate == SR_KHZ(1),
+			"Unexpected samplerate %" PRIu64 ".", state.samplerate);
+		fail_unless(state.logic_unitsize == 1 &&
+			state.logic->len == sizeof(logic) &&
+			!memcmp(state.logic->data, logic, sizeof(logic)),
+			"Unexpected logic data.");
+		check_analog(state.analog[5], volt, ARRAY_SIZE(volt));
+		check_analog(state.analog[6], amp, ARRAY_SIZE(amp));
+		feed_state_free(&state);
+	}
+
+	g_hash_table_destroy(options);
+}
+END_TEST
+
+/*
+ * Check analog values in the CSV input around the limits of the number
+ * parser's fast path: up to 15 significant digits, and powers of ten up
+ * to 22. Values beyond get converted by the C library. Either way the
+ * result must be the correctly rounded value.
+ */
+START_TEST(test_input_csv_numbers)
+{
+	const char *numbers[] = {
+		"123456789012345", "-123456789012345", "1234567890123456",
+		"9007199254740993", "123456789012345.6", "0.000123456789012345",
+		"000000000000000000001.5", "123456789012345e7",
+		"999999999999999e22", "999999999999999e-22", "1e22", "1e-22",
+		"1e23", "1e-23", "0.1e-21", "10e-23", "-4.5e22", "2.5E+22",
+		"0.1", "+.5", "5.", "-0", "0e30", "7e-0",
+		"1.7976931348623157e308", "2.2250738585072014e-308",
+	};
+	struct feed_state state;
+	GHashTable *options;
+	GString *text;
+	size_t i;
+
+	text = g_string_new(NULL);
+	for (i = 0; i < ARRAY_SIZE(numbers); i++)
+		g_string_append_printf(text, "%s\r\n", numbers[i]);
+
+	options = options_new();
+	option_set(options, "column_formats", g_variant_new_string("a"));
+	option_set(options, "header", g_variant_new_boolean(FALSE));
+
+	feed_state_init(&state);
+	input_run("csv", options, text->str, text->len, text->len, &state);
+	check_analog(state.analog[0], numbers, ARRAY_SIZE(numbers));
+	feed_state_free(&state);
+
+	g_hash_table_destroy(options);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+/*
+ * Have an input module process the same text with one parser thread
+ * and with several, sent at once and in pieces that split lines and
+ * words. The datafeed must be identical. Returns the single threaded
+ * result for further checks.
+ */
+static void check_threads(const char *id, GHashTable *options,
+		const GString *text, struct feed_state *serial)
+{
+	const uint32_t threads[] = { 1, 2, 3, 0 };
+	const size_t chunks[] = { 4093, 65521, 0 };
+	struct feed_state state;
+	size_t i, j, chunk;
+
+	option_set(options, "threads", g_variant_new_uint32(1));
+	feed_state_init(serial);
+	input_run(id, options, text->str, text->len, text->len, serial);
+
+	for (i = 0; i < ARRAY_SIZE(threads); i++) {
+		option_set(options, "threads", g_variant_new_uint32(threads[i]));
+		for (j = 0; j < ARRAY_SIZE(chunks); j++) {
+			chunk = chunks[j] ? chunks[j] : text->len;
+			feed_state_init(&state);
+			input_run(id, options, text->str, text->len, chunk,
+				&state);
+			fail_unless(state.feed->len == serial->feed->len &&
+				!memcmp(state.feed->str, serial->feed->str,
+					serial->feed->len),
+				"%s datafeed differs with %u threads, chunk %zu.",
+				id, threads[i], chunk);
+			feed_state_free(&state);
+		}
+	}
+}
+
+/*
+ * Check that the CSV input's datafeed does not depend on the number
+ * of parser threads. The text has comments, blank lines, timestamps,
+ * and analog values of which some exceed the number parser's fast
+ * path. It is large enough to get split into several parts.
+ */
+START_TEST(test_input_csv_threads)
+{
+	const size_t rows = 60000;
+	struct feed_state serial;
+	GHashTable *options;
+	GString *text;
+	size_t i;
+
+	text = g_string_new("; Generated for the threads test\n"
+		"time::bit::nibble::volt::small ; channel names\n");
+	for (i = 0; i < rows; i++) {
+		if (i % 97 == 0)
+			g_string_append_printf(text, "; comment %zu\n", i);
+		if (i % 211 == 0)
+			g_string_append(text, "\n  ; indented\n");
+		g_string_append_printf(text, "%zu.%06zu::%zu::%c::%d.%03zu::%zue-%zu",
+			(i + 1) / 1000000, (i + 1) % 1000000, (i / 3) & 1,
+			"0123456789abcDEF"[i % 16], (int)(i % 2001) - 1000,
+			i * 7 % 1000, i * 13 % 1000, i % 25);
+		if (i % 13 == 0)
+			g_string_append(text, " ; trailing");
+		/* The last line has no line feed. */
+		if (i + 1 < rows)
+			g_string_append_c(text, '\n');
+	}
+
+	options = options_new();
+	option_set(options, "column_formats",
+		g_variant_new_string("t,l,x4,a,a"));
+	option_set(options, "column_separator", g_variant_new_string("::"));
+
+	check_threads("csv", options, text, &serial);
+	fail_unless(serial.samplerate == SR_MHZ(1),
+		"Unexpected samplerate %" PRIu64 ".", serial.samplerate);
+	fail_unless(serial.logic->len == rows, "Expected %zu samples, got %u.",
+		rows, serial.logic->len);
+	fail_unless(serial.analog[5]->len == rows &&
+		serial.analog[6]->len == rows, "Unexpected analog sample count.");
+	feed_state_free(&serial);
+
+	g_hash_table_destroy(options);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+static void append_bits(GString *text, unsigned int value, size_t count)
+{
+	g_string_append_c(text, 'b');
+	while (count--)
+		g_string_append_c(text, value & (1 << count) ? '1' : '0');
+}
+
+/*
+ * Check that the VCD input's datafeed does not depend on the number
+ * of parser threads. Comments span lines, and some lines get left to
+ * the serial parser (an 'x' value within $dumpoff).
+ */
+START_TEST(test_input_vcd_threads)
+{
+	const size_t steps = 100000;
+	struct feed_state serial;
+	GHashTable *options;
+	GString *text;
+	uint64_t timestamp;
+	size_t i;
+
+	text = g_string_new("$date today $end\n"
+		"$version threads test $end\n"
+		"$comment\n  spans\n  several lines\n$end\n"
+		"$timescale 1us $end\n"
+		"$scope module top $end\n"
+		"$var wire 1 ! clk $end\n"
+		"$var wire 4 \" nibble $end\n"
+		"$var real 64 & volt $end\n"
+		"$var integer 4 ' count $end\n"
+		"$var string 1 % msg $end\n"
+		"$upscope $end\n"
+		"$enddefinitions $end\n"
+		"#0\n$dumpvars\n0!\nb0 \"\nr0 &\nb0 '\nsInit %\n$end\n");
+	timestamp = 0;
+	for (i = 0; i < steps; i++) {
+		timestamp += 1 + i % 3;
+		g_string_append_printf(text, "#%" PRIu64 "\n%c!\n",
+			timestamp, i & 1 ? '1' : '0');
+		if (i % 3 == 0) {
+			append_bits(text, i / 3, i % 4 + 1);
+			g_string_append(text, " \"\n");
+		}
+		if (i % 5 == 0)
+			g_string_append_printf(text, "r%d.%02zu &\n",
+				(int)(i % 201) - 100, i % 100);
+		if (i % 7 == 0) {
+			append_bits(text, i / 7, 4);
+			g_string_append(text, " '\n");
+		}
+		if (i % 11 == 0)
+			g_string_append(text, "sHello %\n");
+		if (i % 50 == 0)
+			g_string_append(text, "$comment\n #1 1! not data\n$end\n");
+		if (i % 17 == 0)
+			g_string_append(text, "$comment one line $end\n");
+		if (i == steps * 9 / 10)
+			g_string_append(text, "$dumpoff\nx!\n$end\n");
+	}
+
+	options = options_new();
+	check_threads("vcd", options, text, &serial);
+	fail_unless(serial.samplerate == SR_MHZ(1),
+		"Unexpected samplerate %" PRIu64 ".", serial.samplerate);
+	fail_unless(serial.logic->len == timestamp + 1,
+		"Expected %" PRIu64 " samples, got %u.",
+		timestamp + 1, serial.logic->len);
+	feed_state_free(&serial);
+
+	g_hash_table_destroy(options);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+/* Printable characters for VCD identifiers, except the keyword start. */
+static const char vcd_id_chars[] =
+	"!\"#%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	"[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+
+/*
+ * Get a unique identifier of one to four characters for a signal (up
+ * to the square of the character count). The length cycles, so that
+ * short identifiers are prefixes of longer ones.
+ */
+static void vcd_id(char *id, size_t sig)
+{
+	const size_t base = sizeof(vcd_id_chars) - 1;
+	size_t len, value;
+
+	len = 1 + sig % 4;
+	if (len < 2 && sig >= base)
+		len = 2;
+	id[len] = '\0';
+	for (value = sig; len--; value /= base)
+		id[len] = vcd_id_chars[value % base];
+}
+
+static gboolean vcd_wire_bit(size_t sig, size_t step)
+{
+	return ((sig * 2654435761u + step * 40503u) >> 13) & 1;
+}
+
+static unsigned int vcd_bus_value(size_t step)
+{
+	return (step * 5 + step / 4) & 0xf;
+}
+
+static float vcd_real_value(size_t sig, size_t step)
+{
+	return (float)((step * (sig + 3)) % 37) / 4 - 2;
+}
+
+/*
+ * Check that all signals of a VCD file with many signals land on their
+ * channels. Identifiers have up to five characters and are prefixes of
+ * each other. One wire shares its identifier with another, and a string
+ * signal gets ignored. Analog signals get declared between logic ones.
+ */
+START_TEST(test_input_vcd_signals)
+{
+	const size_t wires = 150, reals = 3, steps = 64;
+	const char *bus_id = "~}|{z", *str_id = "~}|{y";
+	const size_t alias_of = 7;
+	/* The wire of each logic channel, the bus is past the wires. */
+	size_t ch_wire[160], bus_ch, ch_count;
+	struct feed_state serial;
+	GHashTable *options;
+	GString *text, *names;
+	const uint8_t *sample;
+	char id[8];
+	size_t i, step, ch;
+	gboolean bit;
+	float value;
+
+	text = g_string_new("$timescale 1us $end\n$scope module top $end\n");
+	names = g_string_new(NULL);
+	ch_count = 0;
+	bus_ch = 0;
+	for (i = 0; i < wires; i++) {
+		vcd_id(id, i);
+		g_string_append_printf(text, "$var wire 1 %s w%zu $end\n",
+			id, i);
+		g_string_append_printf(names, "top.w%zu:L,", i);
+		ch_wire[ch_count++] = i;
+		if (i % 50 == 49) {
+			g_string_append_printf(text,
+				"$var real 64 ~}|{%zu r%zu $end\n",
+				i / 50, i / 50);
+		}
+		if (i == 74) {
+			g_string_append_printf(text,
+				"$var wire 4 %s bus $end\n", bus_id);
+			g_string_append(names, "top.bus.0:L,top.bus.1:L,"
+				"top.bus.2:L,top.bus.3:L,");
+			bus_ch = ch_count;
+			for (ch = 0; ch < 4; ch++)
+				ch_wire[ch_count++] = wires;
+		}
+		if (i == 120) {
+			vcd_id(id, alias_of);
+			g_string_append_printf(text,
+				"$var wire 1 %s alias $end\n", id);
+			g_string_append(names, "top.alias:L,");
+			ch_wire[ch_count++] = alias_of;
+			g_string_append_printf(text,
+				"$var string 1 %s msg $end\n", str_id);
+		}
+	}
+	for (i = 0; i < reals; i++)
+		g_string_append_printf(names, "%stop.r%zu:A", i ? "," : "", i);
+	g_string_append(text, "$upscope $end\n$enddefinitions $end\n");
+
+	/* Only send changes, the real values change in every step. */
+	for (step = 0; step < steps; step++) {
+		g_string_append_printf(text, "#%zu\n", step);
+		for (i = 0; i < wires; i++) {
+			bit = vcd_wire_bit(i, step);
+			if (step && bit == vcd_wire_bit(i, step - 1))
+				continue;
+			vcd_id(id, i);
+			g_string_append_printf(text, "%d%s\n", bit, id);
+		}
+		append_bits(text, vcd_bus_value(step), 4);
+		g_string_append_printf(text, " %s\nsstep%zu %s\n",
+			bus_id, step, str_id);
+		for (i = 0; i < reals; i++) {
+			g_string_append_printf(text, "r%g ~}|{%zu\n",
+				vcd_real_value(i, step), i);
+		}
+	}
+
+	options = options_new();
+	check_threads("vcd", options, text, &serial);
+	fail_unless(!strcmp(serial.names->str, names->str),
+		"Unexpected channels: %s.", serial.names->str);
+	fail_unless(serial.logic_unitsize == (ch_count + 7) / 8 &&
+		serial.logic->len == steps * serial.logic_unitsize,
+		"Unexpected logic data size.");
+	for (step = 0; step < steps; step++) {
+		sample = &serial.logic->data[step * serial.logic_unitsize];
+		for (ch = 0; ch < ch_count; ch++) {
+			bit = (sample[ch / 8] >> (ch % 8)) & 1;
+			i = ch_wire[ch];
+			if (i == wires)
+				fail_unless(bit == !!(vcd_bus_value(step) &
+					(1 << (ch - bus_ch))),
+					"Bus bit %zu wrong in step %zu.",
+					ch - bus_ch, step);
+			else
+				fail_unless(bit == vcd_wire_bit(i, step),
+					"Wire %zu wrong in step %zu.", i, step);
+		}
+	}
+	for (i = 0; i < reals; i++) {
+		fail_unless(serial.analog[ch_count + i]->len == steps,
+			"Expected %zu values for r%zu.", steps, i);
+		for (step = 0; step < steps; step++) {
+			value = g_array_index(serial.analog[ch_count + i],
+				double, step);
+			fail_unless(value == vcd_real_value(i, step),
+				"Real r%zu wrong in step %zu.", i, step);
+		}
+	}
+	feed_state_free(&serial);
+
+	g_hash_table_destroy(options);
+	g_string_free(names, TRUE);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
 Suite *suite_input_all(void)
 {
 	Suite *s;
@@ -44,5 +669,23 @@ Suite *suite_input_all(void)
 	tcase_add_test(tc, test_input_available);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("csv");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_csv_columns);
+	tcase_add_test(tc, test_input_csv_numbers);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("threads");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 60);
+	tcase_add_test(tc, test_input_csv_threads);
+	tcase_add_test(tc, test_input_vcd_threads);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("vcd");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_vcd_signals);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
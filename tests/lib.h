@@ -54,5 +54,7 @@ Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
 Suite *suite_conv(void);
+Suite *suite_log(void);
+Suite *suite_modbus(void);
 
 #endif
@@ -0,0 +1,174 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+static GString *messages;
+static int message_count;
+
+static int collect(void *cb_data, int loglevel, const char *format,
+		va_list args)
+{
+	(void)cb_data;
+
+	g_string_append_printf(messages, "<%d>", loglevel);
+	g_string_append_vprintf(messages, format, args);
+	g_string_append_c(messages, '\n');
+	message_count++;
+
+	return SR_OK;
+}
+
+/*
+ * Check that the ring records messages until it gets flushed. Changing
+ * the loglevel emits a debug message, which is used here.
+ */
+START_TEST(test_log_ring)
+{
+	messages = g_string_new(NULL);
+	message_count = 0;
+
+	fail_unless(sr_log_ring_start(0) == SR_ERR_ARG);
+	fail_unless(sr_log_ring_start(16) == SR_OK);
+	fail_unless(sr_log_ring_start(16) == SR_ERR);
+
+	sr_log_loglevel_set(SR_LOG_DBG);
+	sr_log_loglevel_set(SR_LOG_SPEW);
+	fail_unless(message_count == 0);
+	fail_unless(sr_log_ring_flush(collect, NULL) == SR_OK);
+	fail_unless(message_count == 2, "Got %d messages.", message_count);
+	fail_unless(strstr(messages->str, "loglevel set to 4.") != NULL,
+		"Unexpected messages: %s", messages->str);
+	fail_unless(strstr(messages->str, "loglevel set to 5.") != NULL,
+		"Unexpected messages: %s", messages->str);
+
+	/* Flushed messages don't show up again. */
+	fail_unless(sr_log_ring_flush(collect, NULL) == SR_OK);
+	fail_unless(message_count == 2);
+
+	sr_log_loglevel_set(SR_LOG_WARN);
+	fail_unless(sr_log_ring_stop() == SR_OK);
+	fail_unless(sr_log_ring_stop() == SR_ERR);
+	fail_unless(sr_log_ring_flush(collect, NULL) == SR_ERR);
+
+	g_string_free(messages, TRUE);
+}
+END_TEST
+
+/* Check that overwritten messages get reported. */
+START_TEST(test_log_ring_lost)
+{
+	int i;
+
+	messages = g_string_new(NULL);
+	message_count = 0;
+
+	fail_unless(sr_log_ring_start(4) == SR_OK);
+	for (i = 0; i < 10; i++)
+		sr_log_loglevel_set(SR_LOG_DBG);
+	fail_unless(sr_log_ring_flush(collect, NULL) == SR_OK);
+	fail_unless(message_count == 5, "Got %d messages.", message_count);
+	fail_unless(strstr(messages->str, "6 messages were lost") != NULL,
+		"Unexpected messages: %s", messages->str);
+
+	sr_log_loglevel_set(SR_LOG_WARN);
+	fail_unless(sr_log_ring_stop() == SR_OK);
+
+	g_string_free(messages, TRUE);
+}
+END_TEST
+
+/*
+ * Check that messages come out of the ring as they went in. The CSV
+ * input's message about invalid text prints the column with a
+ * precision, the input which follows must not end up in the ring.
+ */
+START_TEST(test_log_ring_precision)
+{
+	const char *expected =
+		"<1>input/csv: Invalid text '1x' in binary type column 1 "
+		"in line 2.\n";
+	const struct sr_input *in;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *text;
+	int i;
+
+	messages = g_string_new(NULL);
+	message_count = 0;
+	text = g_string_new(NULL);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("column_formats"),
+		g_variant_ref_sink(g_variant_new_string("b")));
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	g_hash_table_insert(options, g_strdup("threads"),
+		g_variant_ref_sink(g_variant_new_uint32(1)));
+
+	fail_unless(sr_log_ring_start(16) == SR_OK);
+	in = sr_input_new(sr_input_find("csv"), options);
+	fail_unless(in != NULL);
+	g_string_assign(text, "1\n");
+	fail_unless(sr_input_send(in, text) == SR_OK);
+	fail_unless(sr_input_dev_inst_get(in) != NULL);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	g_string_assign(text, "1x\n");
+	for (i = 0; i < 100000; i++)
+		g_string_append(text, "1\n");
+	fail_unless(sr_input_send(in, text) != SR_OK);
+	fail_unless(sr_log_ring_flush(collect, NULL) == SR_OK);
+	fail_unless(sr_log_ring_stop() == SR_OK);
+
+	fail_unless(strstr(messages->str, expected) != NULL,
+		"Unexpected messages: %s", messages->str);
+
+	sr_session_destroy(session);
+	sr_input_free(in);
+	g_hash_table_destroy(options);
+	g_string_free(text, TRUE);
+	g_string_free(messages, TRUE);
+}
+END_TEST
+
+Suite *suite_log(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("log");
+
+	tc = tcase_create("ring");
+	tcase_add_test(tc, test_log_ring);
+	tcase_add_test(tc, test_log_ring_lost);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("ring_input");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_log_ring_precision);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -46,6 +46,8 @@ int main(void)
 	srunner_add_suite(srunner, suite_trigger());
 	srunner_add_suite(srunner, suite_analog());
 	srunner_add_suite(srunner, suite_conv());
+	srunner_add_suite(srunner, suite_log());
+	srunner_add_suite(srunner, suite_modbus());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
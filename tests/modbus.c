@@ -0,0 +1,430 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+/*
+ * The Modbus TCP transport (src/modbus/modbus_tcp.c, src/tcp.c) is
+ * built into the test program. These stand in for the logging and the
+ * session, which the transport doesn't use here.
+ */
+SR_PRIV int sr_log_cur_level = SR_LOG_NONE;
+
+SR_PRIV int sr_log(int loglevel, const char *format, ...)
+{
+	(void)loglevel;
+	(void)format;
+
+	return SR_OK;
+}
+
+SR_PRIV int sr_session_source_add(struct sr_session *session, int fd,
+		int events, int timeout, sr_receive_data_callback cb, void *cb_data)
+{
+	(void)session;
+	(void)fd;
+	(void)events;
+	(void)timeout;
+	(void)cb;
+	(void)cb_data;
+
+	return SR_ERR_NA;
+}
+
+SR_PRIV int sr_session_source_remove(struct sr_session *session, int fd)
+{
+	(void)session;
+	(void)fd;
+
+	return SR_ERR_NA;
+}
+
+SR_PRIV extern const struct sr_modbus_dev_inst modbus_tcp_dev;
+
+#if !defined(_WIN32)
+/* Register addresses which make the stand-in server misbehave. */
+#define ADDR_BAD_HEADER		0xbad0
+#define ADDR_UNKNOWN_REPLY	0x0e0e
+#define ADDR_NO_REPLY		0x5170
+
+#define MAX_REQUESTS		16
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/*
+ * A Modbus TCP stand-in server. It answers reads of holding registers
+ * with the register addresses as their values. It collects batch
+ * requests before it replies to them in reverse order, and splits the
+ * replies across several sends.
+ */
+struct modbus_server {
+	int listen_fd;
+	char port[8];
+	GThread *thread;
+	GRand *rand;
+	gint stop;
+	gint connections;
+	unsigned int batch;
+};
+
+struct modbus_request {
+	uint8_t header[7];
+	uint8_t pdu[253];
+};
+
+static gboolean server_wait(struct modbus_server *server, int fd,
+		short events)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	while (!g_atomic_int_get(&server->stop)) {
+		if (poll(&pfd, 1, 20) > 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gboolean server_read(struct modbus_server *server, int fd,
+		uint8_t *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		if (!server_wait(server, fd, POLLIN))
+			return FALSE;
+		ret = recv(fd, buf, len, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return FALSE;
+		buf += ret;
+		len -= ret;
+	}
+
+	return TRUE;
+}
+
+/* Send a frame in random pieces, so that it arrives split up. */
+static void server_send(struct modbus_server *server, int fd,
+		const uint8_t *buf, size_t len)
+{
+	size_t piece;
+	ssize_t ret;
+
+	while (len) {
+		piece = g_rand_int_range(server->rand, 1, len + 1);
+		ret = send(fd, buf, piece, MSG_NOSIGNAL);
+		if (ret <= 0)
+			return;
+		buf += ret;
+		len -= ret;
+		g_usleep(g_rand_int_range(server->rand, 0, 500));
+	}
+}
+
+static void server_reply(struct modbus_server *server, int fd,
+		const struct modbus_request *req)
+{
+	uint8_t frame[7 + 253];
+	unsigned int address, count, i;
+
+	address = RB16(&req->pdu[1]);
+	count = RB16(&req->pdu[3]);
+	if (address == ADDR_NO_REPLY)
+		return;
+
+	memcpy(frame, req->header, 7);
+	WB16(&frame[4], 3 + 2 * count);
+	frame[7] = req->pdu[0];
+	frame[8] = 2 * count;
+	for (i = 0; i < count; i++)
+		WB16(&frame[9 + 2 * i], address + i);
+
+	if (address == ADDR_BAD_HEADER)
+		WB16(&frame[2], 0x1234);
+	if (address == ADDR_UNKNOWN_REPLY) {
+		WB16(&frame[0], RB16(&req->header[0]) ^ 0x8000);
+		server_send(server, fd, frame, 9 + 2 * count);
+		memcpy(frame, req->header, 2);
+	}
+	server_send(server, fd, frame, 9 + 2 * count);
+}
+
+static void server_serve(struct modbus_server *server, int fd)
+{
+	struct modbus_request reqs[MAX_REQUESTS];
+	unsigned int num_reqs, len;
+
+	num_reqs = 0;
+	while (server_read(server, fd, reqs[num_reqs].header, 7)) {
+		len = RB16(&reqs[num_reqs].header[4]);
+		fail_unless(len >= 2 && len <= 254, "Invalid request length.");
+		if (!server_read(server, fd, reqs[num_reqs].pdu, len - 1))
+			break;
+		fail_unless(reqs[num_reqs].pdu[0] == 0x03,
+			"Unexpected function code.");
+		if (++num_reqs < server->batch)
+			continue;
+		while (num_reqs)
+			server_reply(server, fd, &reqs[--num_reqs]);
+	}
+}
+
+static gpointer server_thread(gpointer data)
+{
+	struct modbus_server *server;
+	int fd;
+
+	server = data;
+	while (server_wait(server, server->listen_fd, POLLIN)) {
+		fd = accept(server->listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		g_atomic_int_inc(&server->connections);
+		server_serve(server, fd);
+		close(fd);
+	}
+
+	return NULL;
+}
+
+static void server_start(struct modbus_server *server, unsigned int batch)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+
+	memset(server, 0, sizeof(*server));
+	server->batch = batch;
+	server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(server->listen_fd >= 0, "Cannot create a socket.");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addrlen = sizeof(addr);
+	fail_unless(bind(server->listen_fd, (struct sockaddr *)&addr,
+		sizeof(addr)) == 0, "Cannot bind the socket.");
+	fail_unless(listen(server->listen_fd, 4) == 0, "Cannot listen.");
+	fail_unless(getsockname(server->listen_fd, (struct sockaddr *)&addr,
+		&addrlen) == 0, "Cannot get the port.");
+	snprintf(server->port, sizeof(server->port), "%u",
+		ntohs(addr.sin_port));
+
+	server->rand = g_rand_new_with_seed(502);
+	server->thread = g_thread_new("modbus-server", server_thread, server);
+}
+
+static void server_stop(struct modbus_server *server)
+{
+	g_atomic_int_set(&server->stop, 1);
+	g_thread_join(server->thread);
+	g_rand_free(server->rand);
+	close(server->listen_fd);
+}
+
+static struct sr_modbus_dev_inst *modbus_connect(struct modbus_server *server)
+{
+	struct sr_modbus_dev_inst *modbus;
+	char *resource, **params;
+	int ret;
+
+	modbus = g_malloc(sizeof(*modbus));
+	*modbus = modbus_tcp_dev;
+	modbus->priv = g_malloc0(modbus->priv_size);
+	resource = g_strdup_printf("tcp-modbus/127.0.0.1/%s", server->port);
+	params = g_strsplit(resource, "/", 0);
+	ret = modbus->dev_inst_new(modbus->priv, resource, params, NULL, 1);
+	fail_unless(ret == SR_OK, "Cannot create the instance: %d.", ret);
+	g_strfreev(params);
+	g_free(resource);
+
+	ret = modbus->open(modbus->priv);
+	fail_unless(ret == SR_OK, "Cannot connect: %d.", ret);
+
+	return modbus;
+}
+
+static void modbus_disconnect(struct sr_modbus_dev_inst *modbus)
+{
+	modbus->close(modbus->priv);
+	modbus->free(modbus->priv);
+	g_free(modbus->priv);
+	g_free(modbus);
+}
+
+static void modbus_request(struct sr_modbus_dev_inst *modbus,
+		unsigned int address, unsigned int count)
+{
+	uint8_t pdu[5];
+	int ret;
+
+	pdu[0] = 0x03;
+	WB16(&pdu[1], address);
+	WB16(&pdu[3], count);
+	ret = modbus->send(modbus->priv, pdu, sizeof(pdu));
+	fail_unless(ret == SR_OK, "Cannot send request: %d.", ret);
+}
+
+/* Read the next reply, its registers must hold their addresses. */
+static void modbus_check_reply(struct sr_modbus_dev_inst *modbus,
+		unsigned int address, unsigned int count)
+{
+	uint8_t function_code, buf[250];
+	unsigned int i;
+	int ret;
+
+	ret = modbus->read_begin(modbus->priv, &function_code, 1000);
+	fail_unless(ret == SR_OK, "No reply for address %u: %d.", address, ret);
+	fail_unless(function_code == 0x03, "Unexpected function code.");
+	fail_unless(modbus->read_data(modbus->priv, buf, 1) == 1,
+		"Cannot read the byte count.");
+	fail_unless(buf[0] == 2 * count, "Unexpected byte count %u.", buf[0]);
+	ret = modbus->read_data(modbus->priv, buf, 2 * count);
+	fail_unless(ret == (int)(2 * count), "Short reply: %d.", ret);
+	for (i = 0; i < count; i++) {
+		fail_unless(RB16(&buf[2 * i]) == address + i,
+			"Reply for address %u has the wrong data.", address);
+	}
+	modbus->read_end(modbus->priv);
+}
+
+/*
+ * Pipelined requests get their replies in request order, even when the
+ * server replies in reverse order, splits frames and sends replies for
+ * unknown transactions.
+ */
+START_TEST(test_modbus_tcp_pipelined)
+{
+	struct modbus_server server;
+	struct sr_modbus_dev_inst *modbus;
+	unsigned int round, i, address[8];
+
+	server_start(&server, ARRAY_SIZE(address));
+	modbus = modbus_connect(&server);
+	fail_unless(modbus->max_pending >= ARRAY_SIZE(address),
+		"Too few requests may be in flight.");
+
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < ARRAY_SIZE(address); i++) {
+			address[i] = i == round ? ADDR_UNKNOWN_REPLY :
+				1000 * round + 10 * i;
+			modbus_request(modbus, address[i], i + 1);
+		}
+		for (i = 0; i < ARRAY_SIZE(address); i++)
+			modbus_check_reply(modbus, address[i], i + 1);
+	}
+	fail_unless(g_atomic_int_get(&server.connections) == 1,
+		"Unexpected reconnect.");
+
+	modbus_disconnect(modbus);
+	server_stop(&server);
+}
+END_TEST
+
+/* A frame header which doesn't make sense makes the transport reconnect. */
+START_TEST(test_modbus_tcp_bad_header)
+{
+	struct modbus_server server;
+	struct sr_modbus_dev_inst *modbus;
+	uint8_t function_code;
+	int ret;
+
+	server_start(&server, 1);
+	modbus = modbus_connect(&server);
+
+	modbus_request(modbus, 10, 2);
+	modbus_check_reply(modbus, 10, 2);
+	modbus_request(modbus, ADDR_BAD_HEADER, 2);
+	ret = modbus->read_begin(modbus->priv, &function_code, 1000);
+	fail_unless(ret == SR_ERR_DATA, "Bad header not detected: %d.", ret);
+
+	modbus_request(modbus, 20, 3);
+	modbus_check_reply(modbus, 20, 3);
+	fail_unless(g_atomic_int_get(&server.connections) == 2,
+		"No reconnect after the bad header.");
+
+	modbus_disconnect(modbus);
+	server_stop(&server);
+}
+END_TEST
+
+/* A missing reply times out after the given time, later ones still work. */
+START_TEST(test_modbus_tcp_timeout)
+{
+	struct modbus_server server;
+	struct sr_modbus_dev_inst *modbus;
+	uint8_t function_code;
+	gint64 start, elapsed;
+	int ret;
+
+	server_start(&server, 1);
+	modbus = modbus_connect(&server);
+
+	modbus_request(modbus, ADDR_NO_REPLY, 1);
+	start = g_get_monotonic_time();
+	ret = modbus->read_begin(modbus->priv, &function_code, 200);
+	elapsed = g_get_monotonic_time() - start;
+	fail_unless(ret == SR_ERR_TIMEOUT, "No timeout: %d.", ret);
+	fail_unless(elapsed >= 200000 && elapsed < 2000000,
+		"Timeout after %" PRId64 " us.", elapsed);
+
+	modbus_request(modbus, 30, 1);
+	modbus_check_reply(modbus, 30, 1);
+
+	modbus_disconnect(modbus);
+	server_stop(&server);
+}
+END_TEST
+#endif
+
+Suite *suite_modbus(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("modbus");
+
+	tc = tcase_create("tcp");
+#if !defined(_WIN32)
+	tcase_add_test(tc, test_modbus_tcp_pipelined);
+	tcase_add_test(tc, test_modbus_tcp_bad_header);
+	tcase_add_test(tc, test_modbus_tcp_timeout);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -18,7 +18,9 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +98,595 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+/* Send a packet to a sink, or append its text to a string. */
+static void output_send(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink, GString *text)
+{
+	GString *out;
+	int ret;
+
+	if (sink) {
+		ret = sr_output_send_sink(o, packet, sink);
+		fail_unless(ret == SR_OK, "sr_output_send_sink() failed.");
+		return;
+	}
+
+	out = NULL;
+	ret = sr_output_send(o, packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed.");
+	if (out) {
+		g_string_append_len(text, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+/* Feed a few packets of logic data to an output instance. */
+static void output_feed(const struct sr_output *o,
+		struct sr_output_sink *sink, GString *text)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t data[300];
+	unsigned int i, j;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.data = data;
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < sizeof(data); j++)
+			data[j] = (i * sizeof(data) + j) >> 3;
+		logic.length = sizeof(data) - i * 7;
+		output_send(o, &packet, sink, text);
+	}
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	output_send(o, &packet, sink, text);
+}
+
+/*
+ * Check whether sr_output_send_sink() creates the same text as
+ * sr_output_send() does.
+ */
+START_TEST(test_output_sink)
+{
+	char *ids[] = { "bits", "hex", "ascii", "binary", "csv" };
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	GString *text;
+	const char *buf;
+	size_t i, len;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		text = g_string_new(NULL);
+		o = sr_output_new(sr_output_find(ids[i]), NULL, sdi, NULL);
+		fail_unless(o != NULL, "Cannot create '%s' output.", ids[i]);
+		output_feed(o, NULL, text);
+		sr_output_free(o);
+
+		sink = sr_output_sink_new_buffer();
+		fail_unless(sink != NULL, "Cannot create buffer sink.");
+		o = sr_output_new(sr_output_find(ids[i]), NULL, sdi, NULL);
+		fail_unless(o != NULL, "Cannot create '%s' output.", ids[i]);
+		output_feed(o, sink, NULL);
+		sr_output_free(o);
+
+		buf = sr_output_sink_buffer_get(sink, &len);
+		fail_unless(len == text->len && !memcmp(buf, text->str, len),
+			"Sink text differs for '%s'.", ids[i]);
+		sr_output_sink_free(sink);
+		g_string_free(text, TRUE);
+	}
+}
+END_TEST
+
+/* Create a CSV output without the header comment, which has a date. */
+static const struct sr_output *csv_new(const struct sr_dev_inst *sdi,
+		const char *value, const char *record, const char *label,
+		gboolean time, gboolean trigger)
+{
+	const struct sr_output *o;
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	g_hash_table_insert(options, g_strdup("value"),
+		g_variant_ref_sink(g_variant_new_string(value)));
+	g_hash_table_insert(options, g_strdup("record"),
+		g_variant_ref_sink(g_variant_new_string(record)));
+	g_hash_table_insert(options, g_strdup("label"),
+		g_variant_ref_sink(g_variant_new_string(label)));
+	g_hash_table_insert(options, g_strdup("time"),
+		g_variant_ref_sink(g_variant_new_boolean(time)));
+	g_hash_table_insert(options, g_strdup("dedup"),
+		g_variant_ref_sink(g_variant_new_boolean(time)));
+	g_hash_table_insert(options, g_strdup("trigger"),
+		g_variant_ref_sink(g_variant_new_boolean(trigger)));
+
+	o = sr_output_new(sr_output_find("csv"), options, sdi, NULL);
+	fail_unless(o != NULL, "Cannot create 'csv' output.");
+	g_hash_table_destroy(options);
+
+	return o;
+}
+
+static void csv_send_type(const struct sr_output *o, int type, GString *text)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
+
+	packet.type = type;
+	packet.payload = NULL;
+	if (type == SR_DF_HEADER) {
+		memset(&header, 0, sizeof(header));
+		header.feed_version = 1;
+		packet.payload = &header;
+	}
+	output_send(o, &packet, NULL, text);
+}
+
+static void csv_send_logic(const struct sr_output *o,
+		const uint8_t *data, size_t length, GString *text)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.length = length;
+	logic.data = (void *)data;
+	output_send(o, &packet, NULL, text);
+}
+
+/* Send volts of one or more channels, interleaved like drivers do. */
+static void csv_send_analog(const struct sr_output *o, GSList *channels,
+		const float *data, uint32_t num_samples, GString *text)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.scale.p = 1;
+	encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = channels;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog.data = (void *)data;
+	analog.num_samples = num_samples;
+
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	output_send(o, &packet, NULL, text);
+}
+
+static void csv_check(GString *text, const char *expected)
+{
+	fail_unless(!strcmp(text->str, expected),
+		"Unexpected CSV text:\n%s\nExpected:\n%s", text->str, expected);
+	g_string_truncate(text, 0);
+}
+
+/*
+ * Check the text of analog values. It is "%g" for values which need
+ * up to six digits, more digits are kept. Values out of the fast path's
+ * range are formatted by the C library.
+ */
+START_TEST(test_output_csv_float)
+{
+	const float values[] = {
+		0.1, 1e-05, 123456789, -2.5, -0.0, 0, 100000, 1234567,
+		1e6, 0.0001, -0.001, 3.1415927, 2.0 / 3, -1e-13, 1e20,
+	};
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	GSList *channels;
+	GString *text;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+	channels = sr_dev_inst_channels_get(sdi);
+
+	text = g_string_new(NULL);
+	o = csv_new(sdi, ",", "\n", "off", FALSE, FALSE);
+	csv_send_type(o, SR_DF_HEADER, text);
+	csv_send_analog(o, channels, values, ARRAY_SIZE(values), text);
+	csv_send_type(o, SR_DF_END, text);
+	sr_output_free(o);
+	csv_check(text, "0.1\n1e-05\n1.2345679e+08\n-2.5\n-0\n0\n100000\n"
+		"1234567\n1e+06\n0.0001\n-0.001\n3.1415927\n0.6666667\n"
+		"-1e-13\n1e+20\n");
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+/*
+ * Check that mixed signal rows get their values from the right columns,
+ * with a disabled channel in between, and analog channels which are
+ * sent in another order than the device has them. Also check that
+ * multi-character separators get removed completely at the end of rows,
+ * and that "label=channel" leaves the channels' names alone.
+ */
+START_TEST(test_output_csv_mixed)
+{
+	const uint8_t logic[] = { 0x01, 0x04, 0x07 };
+	/* A1 and A0 interleaved. */
+	const float analog[] = { 10, 1.5, 20, -2, 30, 0.25 };
+	const char *names[] = { "D0", "D1", "D2", "A0", "A1" };
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	const struct sr_output *o;
+	GSList *l, *channels;
+	GString *text;
+	int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_LOGIC, "D1");
+	sr_dev_inst_channel_add(sdi, 2, SR_CHANNEL_LOGIC, "D2");
+	sr_dev_inst_channel_add(sdi, 3, SR_CHANNEL_ANALOG, "A0");
+	sr_dev_inst_channel_add(sdi, 4, SR_CHANNEL_ANALOG, "A1");
+	channels = NULL;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (!strcmp(ch->name, "D1"))
+			sr_dev_channel_enable(ch, FALSE);
+		if (ch->type == SR_CHANNEL_ANALOG)
+			channels = g_slist_prepend(channels, ch);
+	}
+
+	text = g_string_new(NULL);
+	for (i = 0; i < 2; i++) {
+		o = csv_new(sdi, ",", "\n", "channel", FALSE, FALSE);
+		csv_send_type(o, SR_DF_HEADER, text);
+		csv_send_logic(o, logic, sizeof(logic), text);
+		csv_send_analog(o, channels, analog, 3, text);
+		csv_send_type(o, SR_DF_END, text);
+		sr_output_free(o);
+		csv_check(text, "D0,D2,A0,A1\n"
+			"1,0,1.5,10\n0,1,-2,20\n1,1,0.25,30\n");
+	}
+
+	o = csv_new(sdi, "; ", "\r\n", "units", FALSE, TRUE);
+	csv_send_type(o, SR_DF_HEADER, text);
+	csv_send_type(o, SR_DF_TRIGGER, text);
+	csv_send_logic(o, logic, sizeof(logic), text);
+	csv_send_analog(o, channels, analog, 3, text);
+	csv_send_type(o, SR_DF_END, text);
+	sr_output_free(o);
+	csv_check(text, "logic; logic; V; V; Trigger\r\n"
+		"1; 0; 1.5; 10; 1\r\n0; 1; -2; 20; 0\r\n1; 1; 0.25; 30; 0\r\n");
+
+	o = csv_new(sdi, "; ", "\r\n", "off", FALSE, FALSE);
+	csv_send_type(o, SR_DF_HEADER, text);
+	csv_send_logic(o, logic, sizeof(logic), text);
+	csv_send_analog(o, channels, analog, 3, text);
+	csv_send_type(o, SR_DF_END, text);
+	sr_output_free(o);
+	csv_check(text, "1; 0; 1.5; 10\r\n0; 1; -2; 20\r\n1; 1; 0.25; 30\r\n");
+
+	for (l = sr_dev_inst_channels_get(sdi), i = 0; l; l = l->next, i++) {
+		ch = l->data;
+		fail_unless(!strcmp(ch->name, names[i]),
+			"Channel name got changed.");
+	}
+
+	g_slist_free(channels);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+#ifdef HAVE_HW_DEMO
+/*
+ * Check the time column, which needs the samplerate of a device. Rows
+ * which dedup removes must not shift the time of the rows which follow.
+ * At 125MHz, sample 15 is at 120ns, which floating point math got as
+ * 119ns.
+ */
+START_TEST(test_output_csv_time)
+{
+	const uint8_t data1[] = { 0, 0, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1 };
+	const uint8_t data2[] = { 1, 0 };
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_config src[2];
+	GSList *devices, *options;
+	GString *text;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_ref_sink(g_variant_new_int32(1));
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_ref_sink(g_variant_new_int32(0));
+	options = g_slist_append(NULL, &src[0]);
+	options = g_slist_append(options, &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src[0].data);
+	g_variant_unref(src[1].data);
+	fail_unless(g_slist_length(devices) == 1, "Demo device not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	ret = sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(SR_MHZ(125)));
+	fail_unless(ret == SR_OK, "Cannot set samplerate: %d.", ret);
+
+	text = g_string_new(NULL);
+	o = csv_new(sdi, ",", "\n", "channel", TRUE, FALSE);
+	csv_send_type(o, SR_DF_HEADER, text);
+	csv_send_logic(o, data1, sizeof(data1), text);
+	csv_send_logic(o, data2, sizeof(data2), text);
+	csv_send_type(o, SR_DF_END, text);
+	sr_output_free(o);
+	csv_check(text, "Time,D0\n0,0\n16,1\n40,0\n112,1\n120,1\n"
+		"128,1\n136,0\n");
+	g_string_free(text, TRUE);
+
+	sr_dev_close(sdi);
+}
+END_TEST
+#endif
+
+static const struct sr_output *srzip_new(const struct sr_dev_inst *sdi,
+		const char *codec, uint32_t level)
+{
+	const struct sr_output *o;
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("codec"),
+		g_variant_ref_sink(g_variant_new_string(codec)));
+	g_hash_table_insert(options, g_strdup("level"),
+		g_variant_ref_sink(g_variant_new_uint32(level)));
+	o = sr_output_new(sr_output_find("srzip"), options, sdi, "level.sr");
+	g_hash_table_destroy(options);
+
+	return o;
+}
+
+/* Compression levels out of the codec's range get rejected. */
+START_TEST(test_output_srzip_level)
+{
+	const struct {
+		const char *codec;
+		uint32_t level;
+		gboolean valid;
+	} levels[] = {
+		{ "deflate", 0, TRUE }, { "deflate", 9, TRUE },
+		{ "deflate", 10, FALSE }, { "deflate", 100, FALSE },
+		{ "store", 0, TRUE }, { "store", 1, FALSE },
+	};
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	size_t i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	for (i = 0; i < ARRAY_SIZE(levels); i++) {
+		o = srzip_new(sdi, levels[i].codec, levels[i].level);
+		fail_unless((o != NULL) == levels[i].valid,
+			"Level %u of codec '%s' %s.", levels[i].level,
+			levels[i].codec, o ? "accepted" : "rejected");
+		if (o)
+			sr_output_free(o);
+	}
+}
+END_TEST
+
+#define VCD_SAMPLES	20000
+#define VCD_LOGIC	5
+#define VCD_ANALOG	2
+#define VCD_SAMPLERATE	SR_KHZ(250)
+
+struct vcd_data {
+	uint8_t logic[VCD_SAMPLES];
+	float analog[VCD_ANALOG][VCD_SAMPLES];
+};
+
+static uint32_t vcd_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 8;
+}
+
+/*
+ * Logic data with steady stretches and bursts of changes. Analog data
+ * with steady stretches, a slow wave, and values which the "%.16g"
+ * fast path cannot format.
+ */
+static void vcd_data_create(struct vcd_data *data)
+{
+	const float odd[] = {
+		1e20, -1e-07, 0.1, -2.5, 0, NAN, 123456.7, 2.5e-05, 0.0001,
+		3e16, 9999999999999999.0,
+	};
+	uint32_t state, r;
+	size_t i;
+
+	state = 1;
+	for (i = 0; i < VCD_SAMPLES; i++) {
+		r = vcd_rand(&state);
+		if (i && (i / 1000) % 3 != 1 && r % 8)
+			data->logic[i] = data->logic[i - 1];
+		else
+			data->logic[i] = r % (1 << VCD_LOGIC);
+		data->analog[0][i] = (i / 50) % 4 ? (float)(i / 50) / 6 :
+			odd[(i / 200) % ARRAY_SIZE(odd)];
+		data->analog[1][i] = 3.3 * sinf(i / 300.0);
+	}
+}
+
+/*
+ * The VCD text the implementation which kept one text per sample
+ * number in a sorted list created. It had the values of a sample
+ * number in the order of their arrival, which is logic first, then
+ * the analog channels when the feed keeps them behind the logic data.
+ */
+static void vcd_reference(const struct vcd_data *data, GString *text)
+{
+	GString *values;
+	float last[VCD_ANALOG];
+	uint64_t snum;
+	uint8_t bit;
+	size_t i;
+
+	values = g_string_new(NULL);
+	for (snum = 0; snum < VCD_SAMPLES; snum++) {
+		g_string_truncate(values, 0);
+		for (i = 0; i < VCD_LOGIC; i++) {
+			bit = (data->logic[snum] >> i) & 1;
+			if (snum && bit == ((data->logic[snum - 1] >> i) & 1))
+				continue;
+			g_string_append_printf(values, "%s%d%c",
+				values->len ? " " : "", bit, (char)('!' + i));
+		}
+		for (i = 0; i < VCD_ANALOG; i++) {
+			if (snum && data->analog[i][snum] == last[i])
+				continue;
+			last[i] = data->analog[i][snum];
+			g_string_append_printf(values, "%sr%.16g %c",
+				values->len ? " " : "", last[i],
+				(char)('!' + VCD_LOGIC + i));
+		}
+		if (!values->len)
+			continue;
+		g_string_append_printf(text, "\n#%.0f %s",
+			(double)snum / VCD_SAMPLERATE * SR_MHZ(1), values->str);
+	}
+	g_string_append_printf(text, "\n#%.0f\n",
+		(double)VCD_SAMPLES / VCD_SAMPLERATE * SR_MHZ(1));
+	g_string_free(values, TRUE);
+}
+
+static void vcd_send_samplerate(const struct sr_output *o, GString *text)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(VCD_SAMPLERATE));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	output_send(o, &packet, NULL, text);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+/*
+ * Check the VCD text of mixed logic and analog data against the text
+ * of the previous implementation, byte by byte. The logic data runs
+ * ahead of the analog channels by varying amounts, such that the value
+ * changes of all channels get queued and merged.
+ */
+START_TEST(test_output_vcd_mixed)
+{
+	const char *names[] = { "D0", "D1", "D2", "D3", "D4", "A0", "A1" };
+	struct vcd_data *data;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	const struct sr_output *o;
+	GSList *l, *channels[VCD_ANALOG];
+	GString *text, *expected;
+	size_t pos[1 + VCD_ANALOG], next, i;
+	uint32_t state;
+	const char *values;
+
+	data = g_malloc(sizeof(*data));
+	vcd_data_create(data);
+	expected = g_string_new(NULL);
+	vcd_reference(data, expected);
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		sr_dev_inst_channel_add(sdi, i, i < VCD_LOGIC ?
+			SR_CHANNEL_LOGIC : SR_CHANNEL_ANALOG, names[i]);
+	}
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_ANALOG)
+			channels[ch->index - VCD_LOGIC] = g_slist_append(NULL, ch);
+	}
+
+	text = g_string_new(NULL);
+	o = sr_output_new(sr_output_find("vcd"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Cannot create 'vcd' output.");
+	vcd_send_samplerate(o, text);
+	memset(pos, 0, sizeof(pos));
+	state = 2;
+	while (pos[VCD_ANALOG] < VCD_SAMPLES) {
+		next = pos[0] + 1 + vcd_rand(&state) % 700;
+		next = MIN(next, VCD_SAMPLES);
+		if (next > pos[0])
+			csv_send_logic(o, &data->logic[pos[0]],
+				next - pos[0], text);
+		pos[0] = next;
+		for (i = 0; i < VCD_ANALOG; i++) {
+			next = pos[i + 1] + 1 + vcd_rand(&state) % 500;
+			next = MIN(next, pos[i]);
+			if (next == pos[i + 1])
+				continue;
+			csv_send_analog(o, channels[i],
+				&data->analog[i][pos[i + 1]],
+				next - pos[i + 1], text);
+			pos[i + 1] = next;
+		}
+	}
+	csv_send_type(o, SR_DF_END, text);
+	sr_output_free(o);
+
+	/* The header has the date, compare what follows it. */
+	values = strstr(text->str, "$enddefinitions $end\n");
+	fail_unless(values != NULL, "No VCD header.");
+	values += strlen("$enddefinitions $end\n");
+	for (i = 0; values[i] && values[i] == expected->str[i]; i++)
+		;
+	fail_unless(!values[i] && i == expected->len,
+		"VCD text differs at offset %zu.", i);
+
+	for (i = 0; i < VCD_ANALOG; i++)
+		g_slist_free(channels[i]);
+	g_string_free(text, TRUE);
+	g_string_free(expected, TRUE);
+	g_free(data);
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -112,5 +703,29 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("srzip");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_srzip_level);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("vcd");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_vcd_mixed);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sink");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_sink);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("csv");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_csv_float);
+	tcase_add_test(tc, test_output_csv_mixed);
+#ifdef HAVE_HW_DEMO
+	tcase_add_test(tc, test_output_csv_time);
+#endif
+	suite_add_tcase(s, tc);
+
 	return s;
 }
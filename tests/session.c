@@ -19,7 +19,10 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
 
@@ -185,6 +188,698 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/*
+ * Check dispatch settings and the statistics of an idle session.
+ * If invalid settings are accepted (or it segfaults) this test will fail.
+ */
+START_TEST(test_session_dispatch_set)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_dispatch_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_dispatch_set(sess, 64, SR_DISPATCH_OVERFLOW_BLOCK);
+	fail_unless(ret == SR_OK);
+	ret = sr_session_dispatch_set(sess, 64, SR_DISPATCH_OVERFLOW_DROP);
+	fail_unless(ret == SR_OK);
+	ret = sr_session_dispatch_set(sess, 0, SR_DISPATCH_OVERFLOW_BLOCK);
+	fail_unless(ret == SR_OK);
+	ret = sr_session_dispatch_set(sess, 64, 0);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_dispatch_set(NULL, 64, SR_DISPATCH_OVERFLOW_BLOCK);
+	fail_unless(ret == SR_ERR_ARG);
+
+	/* Nothing was dispatched yet. */
+	memset(&stats, 0xff, sizeof(stats));
+	ret = sr_session_dispatch_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK);
+	fail_unless(stats.packets == 0 && stats.dropped == 0);
+	fail_unless(stats.stalls == 0 && stats.max_fill == 0);
+	ret = sr_session_dispatch_stats_get(sess, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Check that packets which are not backed by a buffer get copied.
+ * If the copy shares the sender's memory this test will fail.
+ */
+START_TEST(test_packet_copy_unbacked)
+{
+	int ret;
+	uint8_t samples[4] = { 0x01, 0x02, 0x03, 0x04 };
+	struct sr_datafeed_logic logic, *logic_copy;
+	struct sr_datafeed_packet packet, *copy;
+
+	logic.length = sizeof(samples);
+	logic.unitsize = 1;
+	logic.data = samples;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	/* Outside of a datafeed callback, there is no buffer to share. */
+	fail_unless(sr_packet_buffer_ref(&packet) == NULL);
+	fail_unless(sr_packet_buffer_ref(NULL) == NULL);
+
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK);
+	logic_copy = (struct sr_datafeed_logic *)copy->payload;
+	fail_unless(logic_copy->data != logic.data);
+	fail_unless(!memcmp(logic_copy->data, samples, sizeof(samples)));
+	sr_packet_free(copy);
+}
+END_TEST
+
+/*
+ * Check the session's settings for timestamped and batched analog data.
+ * If the settings don't stick this test will fail.
+ */
+START_TEST(test_session_analog_batch_set)
+{
+	int ret;
+	struct sr_session *sess;
+	size_t max_samples;
+	uint64_t max_age_ms;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	/* Without opting in, timestamps get dropped and nothing is batched. */
+	fail_unless(sr_session_analog_timed_get(sess) == FALSE);
+	ret = sr_session_analog_batch_get(sess, &max_samples, &max_age_ms);
+	fail_unless(ret == SR_OK);
+	fail_unless(max_samples == 0 && max_age_ms == 0);
+
+	ret = sr_session_analog_timed_set(sess, TRUE);
+	fail_unless(ret == SR_OK);
+	fail_unless(sr_session_analog_timed_get(sess) == TRUE);
+	ret = sr_session_analog_batch_set(sess, 100, 2000);
+	fail_unless(ret == SR_OK);
+	ret = sr_session_analog_batch_get(sess, &max_samples, &max_age_ms);
+	fail_unless(ret == SR_OK);
+	fail_unless(max_samples == 100 && max_age_ms == 2000);
+
+	fail_unless(sr_session_analog_timed_set(NULL, TRUE) == SR_ERR_ARG);
+	fail_unless(sr_session_analog_timed_get(NULL) == FALSE);
+	fail_unless(sr_session_analog_batch_set(NULL, 1, 0) == SR_ERR_ARG);
+	fail_unless(sr_session_analog_batch_get(NULL, NULL, NULL) == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Check that copies of timestamped analog packets have their own
+ * samples and timestamps. If anything differs this test will fail.
+ */
+START_TEST(test_packet_copy_analog_timed)
+{
+	int ret;
+	float values[3] = { 1.5, 2.5, 3.5 };
+	int64_t timestamps[3] = { 1000000, 1100000, 1200000 };
+	struct sr_datafeed_analog_timed timed, *timed_copy;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_datafeed_packet packet, *copy;
+
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(values[0]);
+	encoding.is_float = TRUE;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	memset(&spec, 0, sizeof(spec));
+	timed.analog.data = values;
+	timed.analog.num_samples = G_N_ELEMENTS(values);
+	timed.analog.encoding = &encoding;
+	timed.analog.meaning = &meaning;
+	timed.analog.spec = &spec;
+	timed.timestamps = timestamps;
+	packet.type = SR_DF_ANALOG_TIMED;
+	packet.payload = &timed;
+
+	ret = sr_packet_copy(&packet, &copy);
+	fail_unless(ret == SR_OK);
+	fail_unless(copy->type == SR_DF_ANALOG_TIMED);
+	timed_copy = (struct sr_datafeed_analog_timed *)copy->payload;
+	fail_unless(timed_copy->analog.num_samples == G_N_ELEMENTS(values));
+	fail_unless(timed_copy->analog.data != timed.analog.data);
+	fail_unless(!memcmp(timed_copy->analog.data, values, sizeof(values)));
+	fail_unless(timed_copy->timestamps != timestamps);
+	fail_unless(!memcmp(timed_copy->timestamps, timestamps,
+		sizeof(timestamps)));
+	fail_unless(timed_copy->analog.meaning->mq == SR_MQ_VOLTAGE);
+	sr_packet_free(copy);
+}
+END_TEST
+
+#define SESSIONFILE_SAMPLES (5 * 1024 * 1024)
+
+static uint8_t sessionfile_sample(uint64_t idx)
+{
+	return (idx * 7 + (idx >> 12)) & 0xff;
+}
+
+/* Write a session file with logic data which spans several chunks. */
+static char *sessionfile_create(GHashTable *options)
+{
+	struct sr_dev_inst *sdi;
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GString *out;
+	uint8_t *samples;
+	char *filename;
+	uint64_t i;
+	int fd, ret;
+
+	fd = g_file_open_tmp("sr-test-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Cannot create temporary file.");
+	close(fd);
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+	o = sr_output_new(sr_output_find("srzip"), options, sdi, filename);
+	fail_unless(o != NULL, "Cannot create srzip output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	out = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	samples = g_malloc(SESSIONFILE_SAMPLES);
+	for (i = 0; i < SESSIONFILE_SAMPLES; i++)
+		samples[i] = sessionfile_sample(i);
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	for (i = 0; i < SESSIONFILE_SAMPLES; i += logic.length) {
+		logic.length = MIN(1000 * 1000, SESSIONFILE_SAMPLES - i);
+		logic.data = &samples[i];
+		out = NULL;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	}
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	sr_output_free(o);
+	g_free(samples);
+
+	return filename;
+}
+
+/*
+ * Check random access to a session file's samples, across chunk
+ * boundaries. If any window's data differs this test will fail.
+ */
+START_TEST(test_sessionfile_reader)
+{
+	int ret;
+	struct sr_sessionfile_reader *reader;
+	char *filename;
+	unsigned int unitsize;
+	uint64_t num_samples, i;
+	uint8_t buf[64];
+	static const uint64_t starts[] = {
+		0, 4 * 1024 * 1024 - 20, SESSIONFILE_SAMPLES - 64, 12345,
+	};
+	size_t j;
+
+	filename = sessionfile_create(NULL);
+
+	ret = sr_sessionfile_reader_open(filename, &reader);
+	fail_unless(ret == SR_OK, "sr_sessionfile_reader_open() failed: %d.", ret);
+	sr_sessionfile_reader_logic_get(reader, &unitsize, &num_samples);
+	fail_unless(unitsize == 1);
+	fail_unless(num_samples == SESSIONFILE_SAMPLES,
+		"Unexpected sample count %" PRIu64 ".", num_samples);
+	fail_unless(sr_sessionfile_reader_analog_count(reader) == 0);
+
+	for (j = 0; j < ARRAY_SIZE(starts); j++) {
+		ret = sr_sessionfile_reader_logic_read(reader,
+			starts[j], starts[j] + sizeof(buf), buf);
+		fail_unless(ret == SR_OK, "Read at %" PRIu64 " failed.", starts[j]);
+		for (i = 0; i < sizeof(buf); i++)
+			fail_unless(buf[i] == sessionfile_sample(starts[j] + i),
+				"Wrong sample %" PRIu64 ".", starts[j] + i);
+	}
+	ret = sr_sessionfile_reader_logic_read(reader,
+		SESSIONFILE_SAMPLES - 1, SESSIONFILE_SAMPLES + 1, buf);
+	fail_unless(ret == SR_ERR_ARG, "Read beyond the end worked.");
+
+	sr_sessionfile_reader_close(reader);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check that loading a session file reports its sample count.
+ * If the session device doesn't report it this test will fail.
+ */
+START_TEST(test_sessionfile_load_samples)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	GSList *devlist;
+	GVariant *gvar;
+	char *filename;
+
+	filename = sessionfile_create(NULL);
+
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	devlist = NULL;
+	sr_session_dev_list(sess, &devlist);
+	fail_unless(g_slist_length(devlist) == 1);
+	sdi = devlist->data;
+	ret = sr_config_get(sr_dev_inst_driver_get(sdi), sdi, NULL,
+		SR_CONF_LIMIT_SAMPLES, &gvar);
+	fail_unless(ret == SR_OK, "Cannot get the sample count: %d.", ret);
+	fail_unless(g_variant_get_uint64(gvar) == SESSIONFILE_SAMPLES);
+	g_variant_unref(gvar);
+	g_slist_free(devlist);
+	sr_session_destroy(sess);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check that files written with other srzip options read back. Small
+ * stored chunks make sure that members which got appended out of order
+ * are found. If any sample differs this test will fail.
+ */
+START_TEST(test_sessionfile_codecs)
+{
+	int ret;
+	struct sr_sessionfile_reader *reader;
+	GHashTable *options;
+	char *filename;
+	unsigned int unitsize;
+	uint64_t num_samples, i, j;
+	uint8_t *buf;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "codec",
+		g_variant_ref_sink(g_variant_new_string("store")));
+	g_hash_table_insert(options, "chunksize",
+		g_variant_ref_sink(g_variant_new_uint64(64 * 1024)));
+	filename = sessionfile_create(options);
+	g_hash_table_destroy(options);
+
+	ret = sr_sessionfile_reader_open(filename, &reader);
+	fail_unless(ret == SR_OK, "sr_sessionfile_reader_open() failed: %d.", ret);
+	sr_sessionfile_reader_logic_get(reader, &unitsize, &num_samples);
+	fail_unless(num_samples == SESSIONFILE_SAMPLES,
+		"Unexpected sample count %" PRIu64 ".", num_samples);
+
+	buf = g_malloc(1024 * 1024);
+	for (i = 0; i < num_samples; i += 1024 * 1024) {
+		ret = sr_sessionfile_reader_logic_read(reader,
+			i, i + 1024 * 1024, buf);
+		fail_unless(ret == SR_OK, "Read at %" PRIu64 " failed.", i);
+		for (j = 0; j < 1024 * 1024; j++)
+			fail_unless(buf[j] == sessionfile_sample(i + j),
+				"Wrong sample %" PRIu64 ".", i + j);
+	}
+	g_free(buf);
+
+	sr_sessionfile_reader_close(reader);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+struct replay_state {
+	uint64_t num_samples;
+	uint64_t num_packets;
+	GThread *main_thread;
+	gboolean other_thread;
+	gboolean mismatch;
+	gboolean end_seen;
+	gboolean after_end;
+};
+
+static void replay_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct replay_state *state;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i;
+
+	(void)sdi;
+
+	state = cb_data;
+	state->num_packets++;
+	if (g_thread_self() != state->main_thread)
+		state->other_thread = TRUE;
+	if (state->end_seen)
+		state->after_end = TRUE;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		data = logic->data;
+		for (i = 0; i < logic->length; i++) {
+			if (data[i] != sessionfile_sample(state->num_samples + i))
+				state->mismatch = TRUE;
+		}
+		state->num_samples += logic->length;
+		break;
+	case SR_DF_END:
+		state->end_seen = TRUE;
+		break;
+	}
+}
+
+/*
+ * Check that replaying a session file sends all samples in order.
+ * If any sample is missing or out of order this test will fail.
+ */
+START_TEST(test_sessionfile_replay)
+{
+	int ret;
+	struct sr_session *sess;
+	struct replay_state state;
+	char *filename;
+
+	filename = sessionfile_create(NULL);
+
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	memset(&state, 0, sizeof(state));
+	state.main_thread = g_thread_self();
+	sr_session_datafeed_callback_add(sess, replay_datafeed_cb, &state);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	fail_unless(state.end_seen, "No SR_DF_END packet.");
+	fail_unless(!state.after_end, "Packets after SR_DF_END.");
+	fail_unless(!state.mismatch, "Samples out of order.");
+	fail_unless(!state.other_thread, "Dispatched on another thread.");
+	fail_unless(state.num_samples == SESSIONFILE_SAMPLES,
+		"Unexpected sample count %" PRIu64 ".", state.num_samples);
+	sr_session_destroy(sess);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Check that replaying a session file through the dispatch thread
+ * passes all packets on, in order, and that the statistics add up.
+ * If any packet is missing or out of order this test will fail.
+ */
+START_TEST(test_sessionfile_replay_dispatch)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_dispatch_stats stats;
+	struct replay_state state;
+	char *filename;
+
+	filename = sessionfile_create(NULL);
+
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	/* A short queue, so that the sender has to wait at times. */
+	ret = sr_session_dispatch_set(sess, 2, SR_DISPATCH_OVERFLOW_BLOCK);
+	fail_unless(ret == SR_OK);
+	memset(&state, 0, sizeof(state));
+	state.main_thread = g_thread_self();
+	sr_session_datafeed_callback_add(sess, replay_datafeed_cb, &state);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+
+	fail_unless(state.end_seen, "No SR_DF_END packet.");
+	fail_unless(!state.after_end, "Packets after SR_DF_END.");
+	fail_unless(!state.mismatch, "Samples out of order.");
+	fail_unless(state.other_thread, "Not dispatched on another thread.");
+	fail_unless(state.num_samples == SESSIONFILE_SAMPLES,
+		"Unexpected sample count %" PRIu64 ".", state.num_samples);
+
+	ret = sr_session_dispatch_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK);
+	fail_unless(stats.packets == state.num_packets,
+		"Queued %" PRIu64 " packets, dispatched %" PRIu64 ".",
+		stats.packets, state.num_packets);
+	fail_unless(stats.dropped == 0, "Packets were dropped.");
+	fail_unless(stats.max_fill >= 1 && stats.max_fill <= 2,
+		"Unexpected maximum fill %" PRIu64 ".", stats.max_fill);
+	sr_session_destroy(sess);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+struct held_packet {
+	struct sr_buffer *buf;
+	struct sr_datafeed_packet *copy;
+	uint64_t first_sample;
+};
+
+struct buffer_state {
+	GSList *held;
+	uint64_t num_samples;
+	gboolean unbacked;
+	gboolean outside;
+	gboolean unshared;
+};
+
+/* Keep all logic data past the callback, via buffer refs and copies. */
+static void buffer_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct buffer_state *state;
+	struct held_packet *held;
+	const struct sr_datafeed_logic *logic, *logic_copy;
+	const uint8_t *data, *start;
+
+	(void)sdi;
+
+	state = cb_data;
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	held = g_malloc0(sizeof(*held));
+	held->first_sample = state->num_samples;
+	state->num_samples += logic->length;
+
+	held->buf = sr_packet_buffer_ref(packet);
+	if (!held->buf) {
+		state->unbacked = TRUE;
+	} else {
+		data = logic->data;
+		start = sr_buffer_data_get(held->buf);
+		if (data < start || data + logic->length >
+				start + sr_buffer_size_get(held->buf))
+			state->outside = TRUE;
+	}
+
+	if (sr_packet_copy(packet, &held->copy) != SR_OK) {
+		state->unshared = TRUE;
+	} else {
+		logic_copy = held->copy->payload;
+		if (logic_copy->data != logic->data)
+			state->unshared = TRUE;
+	}
+
+	state->held = g_slist_append(state->held, held);
+}
+
+/*
+ * Check that replayed sample data is backed by buffers, that copies
+ * share it, and that it stays valid after the session has ended. If
+ * any held sample changes, this test will fail.
+ */
+START_TEST(test_sessionfile_buffer_ref)
+{
+	int ret;
+	struct sr_session *sess;
+	struct buffer_state state;
+	struct held_packet *held;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	char *filename;
+	uint64_t i;
+	GSList *l;
+
+	filename = sessionfile_create(NULL);
+
+	ret = sr_session_load(srtest_ctx, filename, &sess);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	memset(&state, 0, sizeof(state));
+	sr_session_datafeed_callback_add(sess, buffer_datafeed_cb, &state);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	sr_session_destroy(sess);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(state.num_samples == SESSIONFILE_SAMPLES,
+		"Unexpected sample count %" PRIu64 ".", state.num_samples);
+	fail_unless(!state.unbacked, "Packet without a buffer.");
+	fail_unless(!state.outside, "Packet data outside of its buffer.");
+	fail_unless(!state.unshared, "Packet copy does not share the data.");
+
+	/* The session, and its buffer pools, are gone by now. */
+	for (l = state.held; l; l = l->next) {
+		held = l->data;
+		logic = held->copy->payload;
+		data = logic->data;
+		for (i = 0; i < logic->length; i++) {
+			fail_unless(data[i] ==
+				sessionfile_sample(held->first_sample + i),
+				"Wrong sample %" PRIu64 ".",
+				held->first_sample + i);
+		}
+		sr_packet_free(held->copy);
+		sr_buffer_unref(held->buf);
+		g_free(held);
+	}
+	g_slist_free(state.held);
+}
+END_TEST
+
+#ifdef HAVE_HW_DEMO
+struct throughput_state {
+	uint64_t samples;
+	uint64_t throughput;
+	gboolean meta_after_end;
+	gboolean end_seen;
+};
+
+static void throughput_datafeed_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct throughput_state *state;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+
+	state = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		state->samples += logic->length / logic->unitsize;
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key != SR_CONF_THROUGHPUT)
+				continue;
+			state->throughput = g_variant_get_uint64(src->data);
+			state->meta_after_end |= state->end_seen;
+		}
+		break;
+	case SR_DF_END:
+		state->end_seen = TRUE;
+		break;
+	}
+}
+
+/*
+ * Check that the demo driver's max-throughput test mode reports the
+ * samples per second it achieved, in a META packet before SR_DF_END and
+ * through SR_CONF_THROUGHPUT.
+ */
+START_TEST(test_session_demo_throughput)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct throughput_state state;
+	struct sr_config src;
+	GSList *devices, *options;
+	GVariant *gvar;
+	gint64 start, elapsed;
+	uint64_t limit;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	src.key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src.data = g_variant_ref_sink(g_variant_new_int32(0));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+	fail_unless(devices != NULL, "Demo device not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	sr_session_new(srtest_ctx, &session);
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_session_dev_add(session, sdi);
+	ret = sr_config_set(sdi, NULL, SR_CONF_TEST_MODE,
+		g_variant_new_string("max-throughput"));
+	fail_unless(ret == SR_OK, "Cannot set the test mode: %d.", ret);
+	limit = 4 * 1000 * 1000;
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(limit));
+	fail_unless(ret == SR_OK, "Cannot set sample limit: %d.", ret);
+
+	memset(&state, 0, sizeof(state));
+	sr_session_datafeed_callback_add(session, throughput_datafeed_cb, &state);
+	start = g_get_monotonic_time();
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+	elapsed = g_get_monotonic_time() - start;
+
+	fail_unless(state.end_seen, "No SR_DF_END packet.");
+	fail_unless(state.samples >= limit, "Only %" PRIu64 " samples.",
+		state.samples);
+	fail_unless(state.throughput > 0, "No throughput in a META packet.");
+	fail_unless(!state.meta_after_end, "Throughput sent after SR_DF_END.");
+	/* The driver's time span lies within the test's. */
+	fail_unless(state.throughput >= state.samples * 1e6 / elapsed * 0.99,
+		"Throughput %" PRIu64 " too low.", state.throughput);
+
+	ret = sr_config_get(driver, sdi, NULL, SR_CONF_THROUGHPUT, &gvar);
+	fail_unless(ret == SR_OK, "Cannot get the throughput: %d.", ret);
+	fail_unless(g_variant_get_uint64(gvar) == state.throughput,
+		"The throughput differs from the META packet's.");
+	g_variant_unref(gvar);
+
+	sr_session_destroy(session);
+}
+END_TEST
+#endif
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +904,32 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("packet");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_dispatch_set);
+	tcase_add_test(tc, test_packet_copy_unbacked);
+	tcase_add_test(tc, test_session_analog_batch_set);
+	tcase_add_test(tc, test_packet_copy_analog_timed);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("sessionfile");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_sessionfile_reader);
+	tcase_add_test(tc, test_sessionfile_load_samples);
+	tcase_add_test(tc, test_sessionfile_replay);
+	tcase_add_test(tc, test_sessionfile_replay_dispatch);
+	tcase_add_test(tc, test_sessionfile_buffer_ref);
+	tcase_add_test(tc, test_sessionfile_codecs);
+	suite_add_tcase(s, tc);
+
+#ifdef HAVE_HW_DEMO
+	tc = tcase_create("demo");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_set_timeout(tc, 30);
+	tcase_add_test(tc, test_session_demo_throughput);
+	suite_add_tcase(s, tc);
+#endif
+
 	return s;
 }
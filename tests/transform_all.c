@@ -19,8 +19,10 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 /* Check whether at least one transform module is available. */
@@ -96,6 +98,294 @@ START_TEST(test_transform_options)
 }
 END_TEST
 
+static GString *decimated;
+static uint64_t decimated_samplerate;
+
+static void datafeed_decimated(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	struct sr_config *src;
+	GSList *l;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				decimated_samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1);
+		g_string_append_len(decimated, logic->data, logic->length);
+		break;
+	default:
+		break;
+	}
+}
+
+static GHashTable *decimate_options(uint32_t ratio, const char *logic)
+{
+	GHashTable *options;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("ratio"),
+		g_variant_ref_sink(g_variant_new_uint32(ratio)));
+	g_hash_table_insert(options, g_strdup("logic"),
+		g_variant_ref_sink(g_variant_new_string(logic)));
+
+	return options;
+}
+
+/* Check the 'decimate' transform's logic envelope, via the binary input. */
+START_TEST(test_transform_decimate)
+{
+	const struct sr_transform_module *tmod;
+	const struct sr_transform *t;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *buf;
+	uint8_t all_and, all_or;
+	size_t i, j;
+
+	buf = g_string_sized_new(1000);
+	for (i = 0; i < 1000; i++)
+		g_string_append_c(buf, (i * 37) ^ (i >> 3));
+	decimated = g_string_new(NULL);
+	decimated_samplerate = 0;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("samplerate"),
+		g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1))));
+	in = sr_input_new(sr_input_find("binary"), options);
+	g_hash_table_destroy(options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_decimated, NULL);
+	sr_session_dev_add(session, sdi);
+
+	tmod = sr_transform_find("decimate");
+	fail_unless(tmod != NULL, "Couldn't find the 'decimate' module.");
+	options = decimate_options(1000, "min-max");
+	t = sr_transform_new(tmod, options, sdi);
+	g_hash_table_destroy(options);
+	fail_unless(t == NULL, "Ratio must be a power of two.");
+	options = decimate_options(8, "min-max");
+	t = sr_transform_new(tmod, options, sdi);
+	g_hash_table_destroy(options);
+	fail_unless(t != NULL, "Failed to create transform instance.");
+
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+
+	/* An incomplete window at the end gets discarded. */
+	fail_unless(decimated_samplerate == SR_KHZ(250),
+		"Unexpected samplerate %" PRIu64 ".", decimated_samplerate);
+	fail_unless(decimated->len == 2 * (buf->len / 8),
+		"Unexpected output length %zu.", decimated->len);
+	for (i = 0; i < decimated->len / 2; i++) {
+		all_and = 0xff;
+		all_or = 0;
+		for (j = 8 * i; j < 8 * i + 8; j++) {
+			all_and &= buf->str[j];
+			all_or |= buf->str[j];
+		}
+		fail_unless((uint8_t)decimated->str[2 * i] == all_and);
+		fail_unless((uint8_t)decimated->str[2 * i + 1] == all_or);
+	}
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	sr_transform_free(t);
+	g_string_free(decimated, TRUE);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
+/* Samplerates which would decimate to zero become 1Hz, data still flows. */
+START_TEST(test_transform_decimate_low_rate)
+{
+	const struct sr_transform *t;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *buf;
+
+	buf = g_string_new(NULL);
+	g_string_set_size(buf, 4096);
+	memset(buf->str, 0x55, buf->len);
+	decimated = g_string_new(NULL);
+	decimated_samplerate = 0;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("samplerate"),
+		g_variant_ref_sink(g_variant_new_uint64(100)));
+	in = sr_input_new(sr_input_find("binary"), options);
+	g_hash_table_destroy(options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_decimated, NULL);
+	sr_session_dev_add(session, sdi);
+
+	options = decimate_options(1024, "or");
+	t = sr_transform_new(sr_transform_find("decimate"), options, sdi);
+	g_hash_table_destroy(options);
+	fail_unless(t != NULL, "Failed to create transform instance.");
+
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+
+	fail_unless(decimated_samplerate == 1,
+		"Unexpected samplerate %" PRIu64 ".", decimated_samplerate);
+	fail_unless(decimated->len == 2 * 4,
+		"Unexpected output length %zu.", decimated->len);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	sr_transform_free(t);
+	g_string_free(decimated, TRUE);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
+static void decimate_send_analog(const struct sr_transform *t,
+		GSList *channels, const float *data, uint32_t num_samples,
+		GArray *result)
+{
+	struct sr_datafeed_packet packet, *packet_out;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	const struct sr_datafeed_analog *out;
+	size_t count;
+	int ret;
+
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 3;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = channels;
+	memset(&spec, 0, sizeof(spec));
+	analog.data = (void *)data;
+	analog.num_samples = num_samples;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	packet_out = NULL;
+	ret = t->module->receive(t, &packet, &packet_out);
+	fail_unless(ret == SR_OK, "Cannot decimate: %d.", ret);
+	if (!packet_out)
+		return;
+	fail_unless(packet_out->type == SR_DF_ANALOG);
+	out = packet_out->payload;
+	fail_unless(out->meaning->channels == channels,
+		"The output has different channels.");
+	fail_unless(out->encoding->is_float &&
+		out->encoding->unitsize == sizeof(float));
+	count = out->num_samples * g_slist_length(channels);
+	g_array_append_vals(result, out->data, count);
+}
+
+/*
+ * Check the analog envelope of packets with several channels. Each
+ * channel gets its own range, also when other packets interleave.
+ */
+START_TEST(test_transform_decimate_analog)
+{
+	const struct sr_transform *t;
+	struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	struct sr_channel ch[2];
+	GSList *both, *single;
+	GHashTable *options;
+	GArray *result, *result_single;
+	float data[2 * 20], single_data[9];
+	float lo, hi, value;
+	size_t i, w, c;
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+	options = decimate_options(8, "min-max");
+	t = sr_transform_new(sr_transform_find("decimate"), options, sdi);
+	g_hash_table_destroy(options);
+	fail_unless(t != NULL, "Failed to create transform instance.");
+
+	memset(ch, 0, sizeof(ch));
+	both = g_slist_append(g_slist_append(NULL, &ch[0]), &ch[1]);
+	single = g_slist_append(NULL, &ch[0]);
+	for (i = 0; i < 20; i++) {
+		data[2 * i] = (float)((i * 7) % 11) - 5;
+		data[2 * i + 1] = ((i * 5) % 13) * 0.5f + 100;
+	}
+	for (i = 0; i < ARRAY_SIZE(single_data); i++)
+		single_data[i] = -1000.0f * i;
+
+	/* Windows span packets, the single channel has a window of its own. */
+	result = g_array_new(FALSE, FALSE, sizeof(float));
+	result_single = g_array_new(FALSE, FALSE, sizeof(float));
+	decimate_send_analog(t, both, &data[0], 5, result);
+	decimate_send_analog(t, single, single_data, 9, result_single);
+	decimate_send_analog(t, both, &data[2 * 5], 15, result);
+
+	fail_unless(result->len == 2 * 2 * 2,
+		"Unexpected output length %u.", result->len);
+	for (w = 0; w < 2; w++) {
+		for (c = 0; c < 2; c++) {
+			lo = hi = data[2 * 8 * w + c];
+			for (i = 8 * w; i < 8 * w + 8; i++) {
+				value = data[2 * i + c];
+				lo = MIN(lo, value);
+				hi = MAX(hi, value);
+			}
+			fail_unless(g_array_index(result, float, 4 * w + c) == lo,
+				"Unexpected minimum, window %zu channel %zu.", w, c);
+			fail_unless(g_array_index(result, float, 4 * w + 2 + c) == hi,
+				"Unexpected maximum, window %zu channel %zu.", w, c);
+		}
+	}
+	fail_unless(result_single->len == 2 &&
+		g_array_index(result_single, float, 0) == -7000.0f &&
+		g_array_index(result_single, float, 1) == 0.0f,
+		"Unexpected single channel output.");
+
+	g_array_free(result, TRUE);
+	g_array_free(result_single, TRUE);
+	g_slist_free(both);
+	g_slist_free(single);
+	sr_transform_free(t);
+	sr_input_free(in);
+}
+END_TEST
+
 Suite *suite_transform_all(void)
 {
 	Suite *s;
@@ -110,6 +400,9 @@ Suite *suite_transform_all(void)
 	tcase_add_test(tc, test_transform_desc);
 	tcase_add_test(tc, test_transform_find);
 	tcase_add_test(tc, test_transform_options);
+	tcase_add_test(tc, test_transform_decimate);
+	tcase_add_test(tc, test_transform_decimate_low_rate);
+	tcase_add_test(tc, test_transform_decimate_analog);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -20,8 +20,10 @@
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 /* Test lots of triggers/stages/matches/channels */
@@ -249,6 +251,467 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+/*
+ * The soft trigger (src/soft-trigger.c) is built into the test program.
+ * These stand in for the session, and keep what it sends.
+ */
+static GString *soft_trigger_sent;
+static int soft_trigger_fired;
+
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	fail_unless(packet->type == SR_DF_LOGIC);
+	logic = packet->payload;
+	g_string_append_len(soft_trigger_sent, logic->data, logic->length);
+
+	return SR_OK;
+}
+
+SR_PRIV int std_session_send_df_trigger(const struct sr_dev_inst *sdi)
+{
+	(void)sdi;
+
+	soft_trigger_fired++;
+
+	return SR_OK;
+}
+
+#define REF_MAX_UNITSIZE 16
+
+/*
+ * The soft trigger's original sample by sample matcher, which the
+ * optimized one must agree with. Edge matches compare against the
+ * sample which was checked last, also after a stage rewind, and never
+ * match on the very first check.
+ */
+struct ref_trigger {
+	const struct sr_trigger *trigger;
+	int unitsize;
+	int count;
+	int cur_stage;
+	uint8_t prev_sample[REF_MAX_UNITSIZE];
+};
+
+static gboolean ref_check_match(struct ref_trigger *ref,
+		const uint8_t *sample, const struct sr_trigger_match *match)
+{
+	int index, bit, prev_bit;
+
+	ref->count++;
+	index = match->channel->index;
+	bit = sample[index / 8] & (1 << (index % 8));
+	if (match->match == SR_TRIGGER_ZERO)
+		return bit == 0;
+	if (match->match == SR_TRIGGER_ONE)
+		return bit != 0;
+	if (ref->count == 1)
+		return FALSE;
+	prev_bit = ref->prev_sample[index / 8] & (1 << (index % 8));
+	if (match->match == SR_TRIGGER_RISING)
+		return prev_bit == 0 && bit != 0;
+	if (match->match == SR_TRIGGER_FALLING)
+		return prev_bit != 0 && bit == 0;
+	if (match->match == SR_TRIGGER_EDGE)
+		return prev_bit != bit;
+
+	return FALSE;
+}
+
+static int ref_check(struct ref_trigger *ref, const uint8_t *buf, int len)
+{
+	const struct sr_trigger_stage *stage;
+	const struct sr_trigger_match *match;
+	const uint8_t *sample;
+	GSList *l_stage, *l;
+	gboolean match_found;
+	int i;
+
+	for (i = 0; i < len / ref->unitsize; i++) {
+		sample = buf + i * ref->unitsize;
+		l_stage = g_slist_nth(ref->trigger->stages, ref->cur_stage);
+		stage = l_stage->data;
+		match_found = TRUE;
+		for (l = stage->matches; l; l = l->next) {
+			match = l->data;
+			if (!match->channel->enabled)
+				continue;
+			if (!ref_check_match(ref, sample, match)) {
+				match_found = FALSE;
+				break;
+			}
+		}
+		memcpy(ref->prev_sample, sample, ref->unitsize);
+		if (match_found) {
+			if (!l_stage->next)
+				return i;
+			ref->cur_stage++;
+		} else if (ref->cur_stage > 0) {
+			/* Retry from the sample after the first stage's match. */
+			i -= ref->cur_stage;
+			if (i < -1)
+				i = -1;
+			ref->cur_stage = 0;
+		}
+	}
+
+	return -1;
+}
+
+/* A small random number generator, so that failures can be reproduced. */
+static uint32_t trigger_rand(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 8;
+}
+
+/*
+ * Compare the soft trigger with the reference matcher for random data
+ * and random triggers of a device with some number of channels. The
+ * data gets checked in buffers of random size, so that edges and stage
+ * rewinds cross buffer boundaries. Returns the number of triggers which
+ * fired.
+ */
+static int soft_trigger_compare(int num_channels, int pre_trigger,
+		uint32_t seed, int runs)
+{
+	const int matches[] = {
+		SR_TRIGGER_ZERO, SR_TRIGGER_ONE, SR_TRIGGER_RISING,
+		SR_TRIGGER_FALLING, SR_TRIGGER_EDGE,
+	};
+	const int num_samples = 3000;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch, *pool[5];
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl;
+	struct ref_trigger ref;
+	GByteArray *data;
+	GSList *l;
+	uint8_t *sample, *prev;
+	int unitsize, run, i, j, s, m, num_stages, num_matches;
+	int pos, len, offset, ref_offset, pre_samples, expected, fired;
+	uint32_t rnd;
+
+	rnd = seed;
+	unitsize = (num_channels + 7) / 8;
+	fail_unless(unitsize <= REF_MAX_UNITSIZE);
+	sdi = g_malloc0(sizeof(*sdi));
+	for (i = 0; i < num_channels; i++) {
+		ch = g_malloc0(sizeof(*ch));
+		ch->index = i;
+		ch->type = SR_CHANNEL_LOGIC;
+		ch->enabled = TRUE;
+		ch->name = g_strdup_printf("D%d", i);
+		sdi->channels = g_slist_append(sdi->channels, ch);
+	}
+	/* Triggers use channels in the first and in the last byte. */
+	pool[0] = g_slist_nth_data(sdi->channels, 0);
+	pool[1] = g_slist_nth_data(sdi->channels, 1);
+	pool[2] = g_slist_nth_data(sdi->channels, 2);
+	pool[3] = g_slist_nth_data(sdi->channels, num_channels - 2);
+	pool[4] = g_slist_nth_data(sdi->channels, num_channels - 1);
+
+	data = g_byte_array_new();
+	g_byte_array_set_size(data, num_samples * unitsize);
+	soft_trigger_sent = g_string_new(NULL);
+	fired = 0;
+
+	for (run = 0; run < runs; run++) {
+		/* Random data, the trigger channels toggle at random. */
+		sample = data->data;
+		for (i = 0; i < num_samples; i++, sample += unitsize) {
+			for (j = 0; j < unitsize; j++)
+				sample[j] = trigger_rand(&rnd);
+			if (!i)
+				continue;
+			prev = sample - unitsize;
+			for (j = 0; j < 5; j++) {
+				m = pool[j]->index;
+				sample[m / 8] &= ~(1 << (m % 8));
+				sample[m / 8] |= prev[m / 8] & (1 << (m % 8));
+				if (trigger_rand(&rnd) % 4 == 0)
+					sample[m / 8] ^= 1 << (m % 8);
+			}
+		}
+
+		/* Up to four stages with up to three matches each. */
+		trigger = sr_trigger_new(NULL);
+		num_stages = 1 + trigger_rand(&rnd) % 4;
+		for (s = 0; s < num_stages; s++) {
+			stage = sr_trigger_stage_add(trigger);
+			num_matches = 1 + trigger_rand(&rnd) % 3;
+			for (m = 0; m < num_matches; m++) {
+				sr_trigger_match_add(stage,
+					pool[trigger_rand(&rnd) % 5],
+					matches[trigger_rand(&rnd) % 5], 0);
+			}
+		}
+		/* Disabled channels' matches get ignored. */
+		for (j = 0; j < 5; j++)
+			pool[j]->enabled = trigger_rand(&rnd) % 8 != 0;
+
+		stl = soft_trigger_logic_new(sdi, trigger, pre_trigger);
+		fail_unless(stl != NULL);
+		memset(&ref, 0, sizeof(ref));
+		ref.trigger = trigger;
+		ref.unitsize = unitsize;
+		g_string_truncate(soft_trigger_sent, 0);
+		soft_trigger_fired = 0;
+
+		for (pos = 0; pos < num_samples; pos += len) {
+			/* Often single samples, sometimes large blocks. */
+			switch (trigger_rand(&rnd) % 4) {
+			case 0:
+				len = 1;
+				break;
+			case 1:
+				len = 1 + trigger_rand(&rnd) % 8;
+				break;
+			default:
+				len = 1 + trigger_rand(&rnd) % 400;
+				break;
+			}
+			len = MIN(len, num_samples - pos);
+			sample = data->data + pos * unitsize;
+			ref_offset = ref_check(&ref, sample, len * unitsize);
+			pre_samples = -1;
+			offset = soft_trigger_logic_check(stl, sample,
+				len * unitsize, &pre_samples);
+			fail_unless(offset == ref_offset,
+				"Seed %u run %d: trigger at %d, expected %d "
+				"(sample %d).", seed, run, offset, ref_offset,
+				pos);
+			if (offset < 0) {
+				fail_unless(!soft_trigger_fired);
+				continue;
+			}
+
+			/* The samples before the trigger, up to the limit. */
+			expected = MIN(pos + offset, pre_trigger);
+			fail_unless(soft_trigger_fired == 1);
+			fail_unless(pre_samples == expected,
+				"Seed %u run %d: %d pre-trigger samples, "
+				"expected %d.", seed, run, pre_samples,
+				expected);
+			fail_unless(soft_trigger_sent->len ==
+				(size_t)expected * unitsize &&
+				!memcmp(soft_trigger_sent->str, data->data +
+				(pos + offset - expected) * unitsize,
+				expected * unitsize),
+				"Seed %u run %d: wrong pre-trigger data.",
+				seed, run);
+			fired++;
+			break;
+		}
+
+		soft_trigger_logic_free(stl);
+		sr_trigger_free(trigger);
+	}
+
+	g_string_free(soft_trigger_sent, TRUE);
+	g_byte_array_free(data, TRUE);
+	for (l = sdi->channels; l; l = l->next) {
+		ch = l->data;
+		g_free(ch->name);
+		g_free(ch);
+	}
+	g_slist_free(sdi->channels);
+	g_free(sdi);
+
+	return fired;
+}
+
+/* Check one packet's runs, and the same samples expanded. */
+static void soft_trigger_compare_rle(struct soft_trigger_logic *stl_rle,
+		struct soft_trigger_logic *stl, const struct sr_datafeed_logic_rle *rle,
+		int64_t *offset, GString *sent)
+{
+	GByteArray *data;
+	const uint8_t *values;
+	uint64_t i, j;
+	int pre_samples, rle_pre_samples, rle_fired;
+
+	values = rle->values;
+	data = g_byte_array_new();
+	for (i = 0; i < rle->num_runs; i++) {
+		for (j = 0; j < rle->lengths[i]; j++)
+			g_byte_array_append(data, values + i * rle->unitsize,
+				rle->unitsize);
+	}
+
+	g_string_truncate(soft_trigger_sent, 0);
+	soft_trigger_fired = 0;
+	rle_pre_samples = -1;
+	*offset = soft_trigger_logic_check_rle(stl_rle, rle, &rle_pre_samples);
+	rle_fired = soft_trigger_fired;
+	g_string_truncate(sent, 0);
+	g_string_append_len(sent, soft_trigger_sent->str,
+		soft_trigger_sent->len);
+
+	g_string_truncate(soft_trigger_sent, 0);
+	soft_trigger_fired = 0;
+	pre_samples = -1;
+	fail_unless(soft_trigger_logic_check(stl, data->data, data->len,
+		&pre_samples) == *offset, "RLE trigger at %" PRId64 ".",
+		*offset);
+	fail_unless(soft_trigger_fired == rle_fired);
+	fail_unless(pre_samples == rle_pre_samples);
+	fail_unless(sent->len == soft_trigger_sent->len &&
+		!memcmp(sent->str, soft_trigger_sent->str, sent->len),
+		"Wrong RLE pre-trigger data.");
+
+	g_byte_array_free(data, TRUE);
+}
+
+/*
+ * Compare the soft trigger's checks of run-length encoded data with
+ * those of the expanded samples. Runs are mostly short, or so long
+ * that checks skip most of their samples, and some have the same value
+ * as the run before them.
+ */
+START_TEST(test_soft_trigger_rle)
+{
+	const int matches[] = {
+		SR_TRIGGER_ZERO, SR_TRIGGER_ONE, SR_TRIGGER_RISING,
+		SR_TRIGGER_FALLING, SR_TRIGGER_EDGE,
+	};
+	const int num_channels[] = { 4, 16, 70 };
+	const int pre_trigger[] = { 0, 3, 100, 20000 };
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl_rle, *stl;
+	struct sr_datafeed_logic_rle rle;
+	GByteArray *values;
+	GString *sent;
+	GSList *l;
+	uint64_t lengths[64];
+	uint8_t value[REF_MAX_UNITSIZE];
+	int64_t offset;
+	size_t c;
+	int unitsize, pre, run, packet, i, s, m, num_stages, num_matches, fired;
+	uint32_t rnd;
+
+	rnd = 1;
+	fired = 0;
+	soft_trigger_sent = g_string_new(NULL);
+	sent = g_string_new(NULL);
+	values = g_byte_array_new();
+	for (c = 0; c < ARRAY_SIZE(num_channels); c++) {
+		unitsize = (num_channels[c] + 7) / 8;
+		sdi = g_malloc0(sizeof(*sdi));
+		for (i = 0; i < num_channels[c]; i++) {
+			ch = g_malloc0(sizeof(*ch));
+			ch->index = i;
+			ch->type = SR_CHANNEL_LOGIC;
+			ch->enabled = TRUE;
+			ch->name = g_strdup_printf("D%d", i);
+			sdi->channels = g_slist_append(sdi->channels, ch);
+		}
+
+		for (run = 0; run < 200; run++) {
+			pre = pre_trigger[run % ARRAY_SIZE(pre_trigger)];
+			/* Matches on the first three channels only. */
+			trigger = sr_trigger_new(NULL);
+			num_stages = 1 + trigger_rand(&rnd) % 4;
+			for (s = 0; s < num_stages; s++) {
+				stage = sr_trigger_stage_add(trigger);
+				num_matches = 1 + trigger_rand(&rnd) % 3;
+				for (m = 0; m < num_matches; m++) {
+					sr_trigger_match_add(stage,
+						g_slist_nth_data(sdi->channels,
+						trigger_rand(&rnd) % 3),
+						matches[trigger_rand(&rnd) % 5], 0);
+				}
+			}
+			stl_rle = soft_trigger_logic_new(sdi, trigger, pre);
+			stl = soft_trigger_logic_new(sdi, trigger, pre);
+			fail_unless(stl_rle && stl);
+
+			memset(value, 0, sizeof(value));
+			offset = -1;
+			for (packet = 0; packet < 20 && offset < 0; packet++) {
+				g_byte_array_set_size(values, 0);
+				rle.num_runs = 1 + trigger_rand(&rnd) %
+					ARRAY_SIZE(lengths);
+				rle.num_samples = 0;
+				for (i = 0; i < (int)rle.num_runs; i++) {
+					if (trigger_rand(&rnd) % 4)
+						value[0] ^= 1 << (trigger_rand(&rnd) % 3);
+					if (trigger_rand(&rnd) % 8 == 0)
+						value[unitsize - 1] ^= 0x80;
+					g_byte_array_append(values, value,
+						unitsize);
+					if (trigger_rand(&rnd) % 4)
+						lengths[i] = 1 + trigger_rand(&rnd) % 4;
+					else
+						lengths[i] = 1 + trigger_rand(&rnd) % 5000;
+					rle.num_samples += lengths[i];
+				}
+				rle.unitsize = unitsize;
+				rle.values = values->data;
+				rle.lengths = lengths;
+				soft_trigger_compare_rle(stl_rle, stl, &rle,
+					&offset, sent);
+			}
+			if (offset >= 0)
+				fired++;
+
+			soft_trigger_logic_free(stl_rle);
+			soft_trigger_logic_free(stl);
+			sr_trigger_free(trigger);
+		}
+
+		for (l = sdi->channels; l; l = l->next) {
+			ch = l->data;
+			g_free(ch->name);
+			g_free(ch);
+		}
+		g_slist_free(sdi->channels);
+		g_free(sdi);
+	}
+	g_byte_array_free(values, TRUE);
+	g_string_free(sent, TRUE);
+	g_string_free(soft_trigger_sent, TRUE);
+
+	/* Some runs must get past all stages, for the test to matter. */
+	fail_unless(fired > 100, "Only %d triggers fired.", fired);
+}
+END_TEST
+
+/*
+ * Check the soft trigger's word-wide and SIMD scans against the sample
+ * by sample matcher, for all supported sample sizes: one, two and four
+ * bytes (scanned several samples at a time), and sizes which take one
+ * or more 64bit words per sample.
+ */
+START_TEST(test_soft_trigger_matcher)
+{
+	const int num_channels[] = { 8, 5, 16, 12, 32, 24, 64, 72, 100 };
+	const int pre_trigger[] = { 0, 1, 7, 500, 5000 };
+	size_t i, j;
+	int fired;
+
+	for (i = 0; i < ARRAY_SIZE(num_channels); i++) {
+		fired = 0;
+		for (j = 0; j < ARRAY_SIZE(pre_trigger); j++) {
+			fired += soft_trigger_compare(num_channels[i],
+				pre_trigger[j], 1 + i * 100 + j, 40);
+		}
+		/* Some runs must get past all stages, for the test to matter. */
+		fail_unless(fired > 50, "Only %d of %d triggers fired.",
+			fired, 40 * (int)ARRAY_SIZE(pre_trigger));
+	}
+}
+END_TEST
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -276,5 +739,11 @@ Suite *suite_trigger(void)
 	tcase_add_test(tc, test_trigger_match_add_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("soft");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_soft_trigger_matcher);
+	tcase_add_test(tc, test_soft_trigger_rle);
+	suite_add_tcase(s, tc);
+
 	return s;
 }